@@ -74,12 +74,84 @@ typedef void skiparray_free_fun(void *key,
 typedef int skiparray_level_fun(uint64_t prng_state_in,
     uint64_t *prng_state_out, void *udata);
 
+/* Hash a key/value pair (VALUE is NULL when ignoring values), for
+ * digests. Pairs that should count as equal when diffing must hash
+ * equal; the result is mixed further, so it needn't be uniform. */
+typedef uint64_t skiparray_hash_fun(const void *key,
+    const void *value, void *udata);
+
+/* Structural events, for tracing. These are only reported when the
+ * library is built with SKIPARRAY_TRACE defined (and with
+ * SKIPARRAY_TRACE_USDT too, also fired as USDT probes in the
+ * "skiparray" provider, named after the event, using <sys/sdt.h>).
+ * Otherwise the trace sites compile out entirely. */
+enum skiparray_trace_event_type {
+    /* A full node split. COUNT is the pairs left in the node, OTHER
+     * those moved to the new node, and HEIGHT the new node's. */
+    SKIPARRAY_TRACE_SPLIT,
+    /* A node merged with a neighbor. COUNT is the pairs in the merged
+     * node, and OTHER how many it absorbed. */
+    SKIPARRAY_TRACE_MERGE,
+    /* Pairs shifted over from a neighbor instead of merging. COUNT is
+     * the pairs in the node afterward, and OTHER how many moved. */
+    SKIPARRAY_TRACE_SHIFT,
+    /* An empty node unlinked and freed. HEIGHT is the node's. */
+    SKIPARRAY_TRACE_UNLINK,
+    /* The skiparray's height changed. HEIGHT is the new height, and
+     * OTHER the old one. */
+    SKIPARRAY_TRACE_HEIGHT,
+    /* The first iterator was created, locking the skiparray against
+     * changes, or the last one freed, unlocking it. */
+    SKIPARRAY_TRACE_LOCK,
+    SKIPARRAY_TRACE_UNLOCK,
+};
+
+struct skiparray_trace_event {
+    enum skiparray_trace_event_type type;
+    /* CLOCK_MONOTONIC nanoseconds when the operation started and
+     * ended; they are equal for instant events. */
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint16_t count;
+    uint16_t other;
+    uint8_t height;
+};
+
+/* Called with each structural event. It must not modify the
+ * skiparray. */
+typedef void skiparray_trace_fun(const struct skiparray_trace_event *event,
+    void *udata);
+
+/* Opaque handle for a node pool. See skiparray_pool_new below. */
+struct skiparray_pool;
+
+/* Opaque handle for an arena. See skiparray_arena_new below. */
+struct skiparray_arena;
+
+/* Opaque handle for a pager. See skiparray_pager_new below. */
+struct skiparray_pager;
+
+/* Opaque handle for a write-ahead log. See skiparray_wal_new below. */
+struct skiparray_wal;
+
 /* Configuration for the skiparray.
  * All fields are optional except cmp. */
 struct skiparray_config {
     /* How many key/value pairs should be stored in each node?
-     * Must be >= 2, or 0 for the default. */
+     * Must be >= 2, or 0 for the default. While the skiparray only
+     * has one node, its arrays start small and grow geometrically up
+     * to node_size (except with a node pool), so small skiparrays
+     * don't pay for full-size nodes. */
     uint16_t node_size;
+
+    /* If nonzero, nodes adapt to how they are used: each node tracks
+     * its writes (inserts and deletions) and scans (iterators passing
+     * through it). Write-heavy nodes split at progressively smaller
+     * sizes, down to node_size_min, so inserts and deletions move
+     * fewer pairs, while scan-heavy nodes split at and merge up to
+     * larger sizes, up to node_size, for fewer hops. Must be >= 2 and
+     * <= node_size, or 0 to always split at node_size. */
+    uint16_t node_size_min;
     /* At most how many express levels should the skiparray have?
      * A max_level of 0 will use the default. */
     uint8_t max_level;
@@ -95,6 +167,38 @@ struct skiparray_config {
     skiparray_free_fun *free;     /* optional */
     skiparray_level_fun *level;   /* optional */
     void *udata;                  /* callback data, opaque to library */
+
+    /* If non-NULL, allocate nodes from this pool rather than via the
+     * memory callback. The pool's node_size and ignore_values settings
+     * must match the skiparray's, its max_level must be at least the
+     * skiparray's, and it must outlive the skiparray. */
+    struct skiparray_pool *pool;
+
+    /* If non-NULL, allocate everything for the skiparray (including
+     * its nodes, iterators, builder, and fold state) from this arena,
+     * and ignore the memory callback. Cannot be combined with pool. */
+    struct skiparray_arena *arena;
+
+    /* If non-NULL, page node contents out through this pager, so the
+     * skiparray can grow larger than memory. A pager can only be used
+     * by one skiparray at a time, and cannot be combined with pool or
+     * arena. */
+    struct skiparray_pager *pager;
+
+    /* If non-NULL, log every set, forget, and pop to this write-ahead
+     * log before applying it. A WAL can only be used by one skiparray
+     * at a time. */
+    struct skiparray_wal *wal;
+
+    /* If non-NULL, keep content digests for skiparray_diff: each node
+     * has a digest of its pairs' hashes, rolled up along the express
+     * lanes. Changes only mark them stale, and they are recomputed
+     * (for just the changed parts) as a diff needs them. */
+    skiparray_hash_fun *hash;
+
+    /* If non-NULL, and the library was built with SKIPARRAY_TRACE,
+     * call this with every structural event (see above). */
+    skiparray_trace_fun *trace;
 };
 
 /* Allocate a new skiparray. */
@@ -111,11 +215,17 @@ skiparray_new(const struct skiparray_config *config,
 /* Free a skiparray. If the skiparray's configuration's free callback
  * was non-NULL, then it will be called with every key, value pair and
  * udata. Any iterators associated with this skiparray will be freed,
- * and pointers to them will become stale. */
+ * and pointers to them will become stale.
+ *
+ * If the skiparray was allocated in an arena, its memory is not freed
+ * until the arena is reset or freed, so without a free callback this
+ * doesn't need to walk the skiparray at all. */
 void skiparray_free(struct skiparray *sa);
 
 /* Get the value associated with a key.
- * Returns whether the value was found. */
+ * Returns whether the value was found. In paged mode, this also
+ * returns false if a page couldn't be read (see the pager's
+ * on_error callback). */
 bool
 skiparray_get(const struct skiparray *sa,
     const void *key, void **value);
@@ -148,6 +258,8 @@ enum skiparray_set_res {
     SKIPARRAY_SET_ERROR_NULL = -1,
     SKIPARRAY_SET_ERROR_MEMORY = -2,
     SKIPARRAY_SET_ERROR_LOCKED = -3,
+    SKIPARRAY_SET_ERROR_WAL = -4,   /* couldn't log it; nothing changed */
+    SKIPARRAY_SET_ERROR_PAGE = -5,  /* couldn't read a page; nothing changed */
 };
 enum skiparray_set_res
 skiparray_set(struct skiparray *sa, void *key, void *value);
@@ -173,6 +285,8 @@ enum skiparray_forget_res {
     SKIPARRAY_FORGET_ERROR_NULL = -1,
     SKIPARRAY_FORGET_ERROR_MEMORY = -2,
     SKIPARRAY_FORGET_ERROR_LOCKED = -3,
+    SKIPARRAY_FORGET_ERROR_WAL = -4,
+    SKIPARRAY_FORGET_ERROR_PAGE = -5,
 };
 enum skiparray_forget_res
 skiparray_forget(struct skiparray *sa, const void *key,
@@ -187,10 +301,78 @@ skiparray_member(const struct skiparray *sa,
 size_t
 skiparray_count(const struct skiparray *sa);
 
+/* Structural statistics for a skiparray, for capacity planning and
+ * tuning node_size. Only node headers are read, so this doesn't page
+ * in any nodes. */
+#define SKIPARRAY_STATS_FILL_BUCKETS 10
+struct skiparray_stats {
+    size_t nodes;
+    size_t pairs;
+    uint8_t height;             /* levels in use */
+    /* Nodes by how full they are (pairs over the node's split limit),
+     * in tenths: fill[i] counts nodes at least i/10 full, and full
+     * nodes are counted in the last bucket. */
+    size_t fill[SKIPARRAY_STATS_FILL_BUCKETS];
+    /* heights[i] counts nodes exactly i + 1 levels high, and
+     * level_nodes[i] counts the nodes linked on level i (those at
+     * least i + 1 high). */
+    size_t heights[SKIPARRAY_MAX_MAX_LEVEL];
+    size_t level_nodes[SKIPARRAY_MAX_MAX_LEVEL];
+    /* The average number of nodes passed on each level on the way to
+     * a node, over all nodes: on level L, those between the last node
+     * before it on level L + 1 (where the path drops to level L) and
+     * the node, which is roughly how far searches walk. */
+    double avg_hops[SKIPARRAY_MAX_MAX_LEVEL];
+    /* Bytes used by node headers (including forward pointers and
+     * digest rollups), and by key and value arrays in memory. With a
+     * node pool, blocks are split the same way. */
+    size_t header_bytes;
+    size_t key_bytes;
+    size_t value_bytes;
+};
+
+void
+skiparray_stats(const struct skiparray *sa, struct skiparray_stats *stats);
+
+/* Hot-path counters, for telling whether a slowdown comes from deeper
+ * searches, more splits and merges, or more pairs being moved. They
+ * are only kept when the library is built with SKIPARRAY_COUNTERS
+ * defined (`make CDEFS=-DSKIPARRAY_COUNTERS`), and otherwise compile
+ * out entirely. */
+#define SKIPARRAY_COUNTERS_HIST_BUCKETS 16
+struct skiparray_counters {
+    uint64_t cmp_calls;         /* calls to the cmp callback */
+    uint64_t searches;
+    /* Nodes visited on each level by searches. */
+    uint64_t search_visits[SKIPARRAY_MAX_MAX_LEVEL];
+    /* Searches by how many comparisons they made: bucket 0 counts
+     * those with none, bucket i those with 2^(i-1) to 2^i - 1, and the
+     * last bucket also counts any with more. Every get, set, forget,
+     * and iterator seek does one search. */
+    uint64_t search_cmp_hist[SKIPARRAY_COUNTERS_HIST_BUCKETS];
+    uint64_t splits;
+    uint64_t merges;            /* nodes merged into a neighbor */
+    uint64_t shifts;            /* pairs shifted over instead */
+    uint64_t moved_bytes;       /* key and value bytes moved */
+    uint64_t unlinks;
+    uint64_t unlink_visits;     /* nodes visited finding predecessors */
+};
+
+/* Copy SA's counters into *COUNTERS. Returns false (and zeroes them)
+ * if the library was built without SKIPARRAY_COUNTERS. */
+bool
+skiparray_counters(const struct skiparray *sa,
+    struct skiparray_counters *counters);
+
+/* Zero SA's counters. */
+void
+skiparray_counters_reset(struct skiparray *sa);
+
 /* Get the first binding. */
 enum skiparray_first_res {
     SKIPARRAY_FIRST_OK,
     SKIPARRAY_FIRST_EMPTY,
+    SKIPARRAY_FIRST_ERROR_PAGE = -1,
 };
 enum skiparray_first_res
 skiparray_first(const struct skiparray *sa,
@@ -200,6 +382,7 @@ skiparray_first(const struct skiparray *sa,
 enum skiparray_last_res {
     SKIPARRAY_LAST_OK,
     SKIPARRAY_LAST_EMPTY,
+    SKIPARRAY_LAST_ERROR_PAGE = -1,
 };
 enum skiparray_last_res
 skiparray_last(const struct skiparray *sa,
@@ -210,6 +393,8 @@ enum skiparray_pop_res {
     SKIPARRAY_POP_EMPTY,
     SKIPARRAY_POP_ERROR_MEMORY = -1,
     SKIPARRAY_POP_ERROR_LOCKED = -2,
+    SKIPARRAY_POP_ERROR_WAL = -3,
+    SKIPARRAY_POP_ERROR_PAGE = -4,
 };
 
 /* Get and remove the first binding. */
@@ -222,6 +407,37 @@ enum skiparray_pop_res
 skiparray_pop_last(struct skiparray *sa,
     void **key, void **value);
 
+/* Repack the skiparray's pairs into fewer, fuller nodes, and reassign
+ * node heights so the express lanes are evenly spaced (as with
+ * skiparray_builder_new_balanced). After heavy churn, nodes may be
+ * close to the half-full merge threshold; compacting shrinks memory
+ * usage and shortens searches and scans.
+ *
+ * TARGET_FILL is the fraction of node_size to fill each node to,
+ * > 0 and <= 1; it is raised to the merge threshold (half full) if
+ * lower. The skiparray cannot be compacted while it has iterators. */
+enum skiparray_compact_res {
+    SKIPARRAY_COMPACT_DONE,
+    SKIPARRAY_COMPACT_MORE,     /* step budget used up, not done yet */
+    SKIPARRAY_COMPACT_ERROR_LOCKED = -1,
+    SKIPARRAY_COMPACT_ERROR_MISUSE = -2,
+    SKIPARRAY_COMPACT_ERROR_MEMORY = -3,
+    SKIPARRAY_COMPACT_ERROR_PAGE = -4,
+};
+enum skiparray_compact_res
+skiparray_compact(struct skiparray *sa, double target_fill);
+
+/* Incrementally compact the skiparray, producing at most BUDGET
+ * compacted nodes (BUDGET must be > 0). Returns MORE if there is more
+ * to do, or DONE once the last node has been compacted. The position
+ * is kept between calls, so compaction can be interleaved with other
+ * operations (e.g. run between requests); if those modify an
+ * already compacted part of the skiparray it may end up less
+ * compact, but remains valid. The next call after DONE starts over. */
+enum skiparray_compact_res
+skiparray_compact_step(struct skiparray *sa, double target_fill,
+    size_t budget);
+
 /* Opaque handle to a skiparray iterator. */
 struct skiparray_iter;
 
@@ -234,6 +450,7 @@ enum skiparray_iter_new_res {
     SKIPARRAY_ITER_NEW_OK,
     SKIPARRAY_ITER_NEW_EMPTY,
     SKIPARRAY_ITER_NEW_ERROR_MEMORY = -1,
+    SKIPARRAY_ITER_NEW_ERROR_PAGE = -2,
 };
 enum skiparray_iter_new_res
 skiparray_iter_new(struct skiparray *sa,
@@ -245,11 +462,19 @@ skiparray_iter_new(struct skiparray *sa,
 void
 skiparray_iter_free(struct skiparray_iter *iter);
 
+enum skiparray_iter_step_res {
+    SKIPARRAY_ITER_STEP_OK,
+    SKIPARRAY_ITER_STEP_END,
+    SKIPARRAY_ITER_STEP_ERROR_PAGE = -1, /* position not updated */
+};
+
 enum skiparray_iter_seek_endpoint {
     SKIPARRAY_ITER_SEEK_FIRST,
     SKIPARRAY_ITER_SEEK_LAST,
 };
-void
+/* Returns OK, or ERROR_PAGE (without moving) in paged mode if the
+ * endpoint's page couldn't be read. */
+enum skiparray_iter_step_res
 skiparray_iter_seek_endpoint(struct skiparray_iter *iter,
     enum skiparray_iter_seek_endpoint end);
 
@@ -260,16 +485,13 @@ enum skiparray_iter_seek_res {
     SKIPARRAY_ITER_SEEK_NOT_FOUND, /* now at first binding with > key */
     SKIPARRAY_ITER_SEEK_ERROR_BEFORE_FIRST, /* position not updated */
     SKIPARRAY_ITER_SEEK_ERROR_AFTER_LAST,   /* position not updated */
+    SKIPARRAY_ITER_SEEK_ERROR_PAGE,         /* position not updated */
 };
 enum skiparray_iter_seek_res
 skiparray_iter_seek(struct skiparray_iter *iter,
     const void *key);
 
 /* Seek to the next binding; returns END if at the last pair. */
-enum skiparray_iter_step_res {
-    SKIPARRAY_ITER_STEP_OK,
-    SKIPARRAY_ITER_STEP_END,
-};
 enum skiparray_iter_step_res
 skiparray_iter_next(struct skiparray_iter *iter);
 
@@ -304,6 +526,16 @@ enum skiparray_builder_new_res
 skiparray_builder_new(const struct skiparray_config *cfg,
     bool skip_ascending_key_check, struct skiparray_builder **builder);
 
+/* Allocate a skiparray builder that assigns node heights
+ * deterministically by node index, rather than with the level callback:
+ * every 2^k-th node reaches level k (up to max_level), as in a
+ * perfectly balanced skip list. The worst-case search path of the
+ * resulting skiparray is then fixed by its size. Later insertions
+ * into the finished skiparray use the level callback as usual. */
+enum skiparray_builder_new_res
+skiparray_builder_new_balanced(const struct skiparray_config *cfg,
+    bool skip_ascending_key_check, struct skiparray_builder **builder);
+
 /* Free (and abandon) a skiparray that is still being built. */
 void
 skiparray_builder_free(struct skiparray_builder *b);
@@ -375,6 +607,7 @@ enum skiparray_fold_res {
     SKIPARRAY_FOLD_OK,
     SKIPARRAY_FOLD_ERROR_MISUSE = -1,
     SKIPARRAY_FOLD_ERROR_MEMORY = -2,
+    SKIPARRAY_FOLD_ERROR_PAGE = -3,
 };
 enum skiparray_fold_res
 skiparray_fold_init(enum skiparray_fold_type direction,
@@ -409,10 +642,12 @@ skiparray_fold_halt(struct skiparray_fold_state *fs);
 
 /* Step a fold in progress. This will call the appropriate callbacks and
  * return OK if there are more bindings to process, or free fs and
- * return DONE. */
+ * return DONE. In paged mode, if a page can't be read, it frees fs
+ * and returns ERROR_PAGE. */
 enum skiparray_fold_next_res {
     SKIPARRAY_FOLD_NEXT_OK,
     SKIPARRAY_FOLD_NEXT_DONE,
+    SKIPARRAY_FOLD_NEXT_ERROR_PAGE = -1,
 };
 enum skiparray_fold_next_res
 skiparray_fold_next(struct skiparray_fold_state *fs);
@@ -426,9 +661,633 @@ skiparray_filter_fun(const void *key, const void *value, void *udata);
  * key/value pairs. The new skiparray will have the same comparison
  * and memory callbacks as the original.
  *
- * Returns NULL on allocation failure, or the new skiparray. */
+ * Returns NULL on allocation failure (or, in paged mode, if a page
+ * can't be read), or the new skiparray. */
 struct skiparray *
 skiparray_filter(struct skiparray *sa,
     skiparray_filter_fun *fun, void *udata);
 
+/* A node pool allocates each node (its header and its key and value
+ * arrays) as a single fixed-size block, and keeps blocks for freed
+ * nodes on a free list for reuse. This avoids calling the memory
+ * callback when nodes split and merge. A pool can be shared by
+ * several skiparrays, provided they use the same node_size and
+ * ignore_values settings, and none has a higher max_level than the pool. */
+struct skiparray_pool_config {
+    /* These must match the configuration of any skiparrays using the
+     * pool, except that max_level only needs to be at least theirs;
+     * 0 uses the same defaults as skiparray_config. */
+    uint16_t node_size;
+    uint8_t max_level;
+    bool ignore_values;
+
+    /* Keep at most this many free blocks on the free list; any more
+     * are released immediately. 0 for the default. */
+    size_t high_watermark;
+    /* skiparray_pool_trim releases free blocks down to this many. */
+    size_t low_watermark;
+
+    skiparray_memory_fun *memory; /* optional */
+    void *udata;                  /* callback data for memory */
+};
+
+/* Default high_watermark for a node pool. */
+#define SKIPARRAY_POOL_DEF_HIGH_WATERMARK 64
+
+enum skiparray_pool_new_res {
+    SKIPARRAY_POOL_NEW_OK,
+    SKIPARRAY_POOL_NEW_ERROR_NULL = -1,
+    SKIPARRAY_POOL_NEW_ERROR_CONFIG = -2,
+    SKIPARRAY_POOL_NEW_ERROR_MEMORY = -3,
+};
+enum skiparray_pool_new_res
+skiparray_pool_new(const struct skiparray_pool_config *config,
+    struct skiparray_pool **pool);
+
+/* Free a node pool, and any blocks on its free list. All skiparrays
+ * using the pool must already be freed. */
+void
+skiparray_pool_free(struct skiparray_pool *pool);
+
+/* Release free blocks until at most low_watermark remain. */
+void
+skiparray_pool_trim(struct skiparray_pool *pool);
+
+/* Allocate blocks until at least COUNT are on the free list, or
+ * until the high watermark is reached. Returns false on allocation
+ * failure. */
+bool
+skiparray_pool_reserve(struct skiparray_pool *pool, size_t count);
+
+/* Counters for a node pool. */
+struct skiparray_pool_stats {
+    size_t block_size;   /* bytes per block */
+    size_t in_use;       /* blocks currently used by nodes */
+    size_t cached;       /* blocks on the free list */
+    size_t hits;         /* node allocations served by the free list */
+    size_t misses;       /* node allocations that called memory */
+    size_t releases;     /* blocks returned to the pool by freed nodes */
+    size_t frees;        /* blocks returned to the memory callback */
+};
+
+void
+skiparray_pool_stats(const struct skiparray_pool *pool,
+    struct skiparray_pool_stats *stats);
+
+/* An arena is a bump allocator for short-lived skiparrays: everything
+ * they allocate comes from large chunks, and resetting or freeing the
+ * arena releases all of it at once, without walking any of the
+ * skiparrays. Memory released during their lifetimes (such as nodes
+ * freed by merges) is kept on the arena's free lists for reuse. An
+ * arena can be shared by several skiparrays. */
+struct skiparray_arena_config {
+    /* Size of each chunk requested from the memory callback.
+     * 0 for the default. */
+    size_t chunk_size;
+
+    skiparray_memory_fun *memory; /* optional */
+    void *udata;                  /* callback data for memory */
+};
+
+/* Default chunk_size for an arena. */
+#define SKIPARRAY_ARENA_DEF_CHUNK_SIZE (64 * 1024)
+
+enum skiparray_arena_new_res {
+    SKIPARRAY_ARENA_NEW_OK,
+    SKIPARRAY_ARENA_NEW_ERROR_NULL = -1,
+    SKIPARRAY_ARENA_NEW_ERROR_MEMORY = -2,
+};
+enum skiparray_arena_new_res
+skiparray_arena_new(const struct skiparray_arena_config *config,
+    struct skiparray_arena **arena);
+
+/* Drop every skiparray (and iterator, builder, etc.) allocated in the
+ * arena, but keep its chunks for reuse. They must not be used after
+ * this, and there is no need to call skiparray_free on them first
+ * unless their free callback needs to be called. */
+void
+skiparray_arena_reset(struct skiparray_arena *arena);
+
+/* Drop everything allocated in the arena, as with
+ * skiparray_arena_reset, and free the arena itself. */
+void
+skiparray_arena_free(struct skiparray_arena *arena);
+
+/* Counters for an arena. */
+struct skiparray_arena_stats {
+    size_t chunks;         /* chunks allocated */
+    size_t reserved;       /* bytes in chunks */
+    size_t used;           /* bytes handed out from chunks */
+    size_t recycled;       /* allocations served by the free lists */
+};
+
+void
+skiparray_arena_stats(const struct skiparray_arena *arena,
+    struct skiparray_arena_stats *stats);
+
+
+/* Binary serialization. skiparray_dump writes a versioned stream with
+ * one block per node, each holding the node's encoded pairs in order
+ * (optionally followed by a CRC-32), and skiparray_load reads it back
+ * through the builder, without comparing keys. Keys and values are
+ * converted to and from bytes by callbacks. All integers in the
+ * stream are little-endian. */
+
+/* Write LEN bytes from BUF to the output. Return false on error. */
+typedef bool
+skiparray_write_fun(const uint8_t *buf, size_t len, void *udata);
+
+/* Read exactly LEN bytes from the input into BUF. Return false on
+ * error or if the input ends first. */
+typedef bool
+skiparray_read_fun(uint8_t *buf, size_t len, void *udata);
+
+/* Encode a key or value into BUF (which has room for BUF_SIZE bytes),
+ * and set *LEN to the encoded length. If *LEN > BUF_SIZE, nothing
+ * needs to be written: it will be called again with a larger buffer.
+ * Return false on error. */
+typedef bool
+skiparray_encode_fun(const void *x, uint8_t *buf, size_t buf_size,
+    size_t *len, void *udata);
+
+/* Decode a key or value from LEN bytes in BUF into *X.
+ * Return false on error. */
+typedef bool
+skiparray_decode_fun(const uint8_t *buf, size_t len,
+    void **x, void *udata);
+
+struct skiparray_dump_config {
+    skiparray_write_fun *write;
+    skiparray_encode_fun *encode_key;
+    skiparray_encode_fun *encode_value; /* unused if ignoring values */
+    bool checksum;              /* add a CRC-32 to every block */
+    void *udata;                /* callback data */
+};
+
+enum skiparray_dump_res {
+    SKIPARRAY_DUMP_OK,
+    SKIPARRAY_DUMP_ERROR_MISUSE = -1,
+    SKIPARRAY_DUMP_ERROR_MEMORY = -2,
+    SKIPARRAY_DUMP_ERROR_WRITE = -3,
+    SKIPARRAY_DUMP_ERROR_ENCODE = -4,
+    SKIPARRAY_DUMP_ERROR_PAGE = -5, /* couldn't read a paged-out node */
+};
+enum skiparray_dump_res
+skiparray_dump(const struct skiparray *sa,
+    const struct skiparray_dump_config *config);
+
+struct skiparray_load_config {
+    skiparray_read_fun *read;
+    skiparray_decode_fun *decode_key;
+    skiparray_decode_fun *decode_value; /* unused if ignoring values */
+    bool balanced;              /* build as skiparray_builder_new_balanced */
+    void *udata;                /* callback data */
+};
+
+/* Load a skiparray written by skiparray_dump, configured by CONFIG
+ * (which should have a comparison function consistent with the
+ * dumped key order). Checksums are verified if present. If the
+ * stream has values but CONFIG ignores them, they are skipped
+ * without decoding; if it has no values, they will be NULL.
+ *
+ * On error, any keys and values decoded so far are passed to
+ * CONFIG's free callback (if any). */
+enum skiparray_load_res {
+    SKIPARRAY_LOAD_OK,
+    SKIPARRAY_LOAD_ERROR_MISUSE = -1,
+    SKIPARRAY_LOAD_ERROR_MEMORY = -2,
+    SKIPARRAY_LOAD_ERROR_READ = -3,
+    SKIPARRAY_LOAD_ERROR_FORMAT = -4,   /* bad magic, version, or sizes */
+    SKIPARRAY_LOAD_ERROR_CHECKSUM = -5,
+    SKIPARRAY_LOAD_ERROR_DECODE = -6,
+    SKIPARRAY_LOAD_ERROR_CHAIN = -7,    /* checkpoints out of sequence */
+};
+enum skiparray_load_res
+skiparray_load(const struct skiparray_config *config,
+    const struct skiparray_load_config *load_config,
+    struct skiparray **sa);
+
+/* Incremental checkpoints. Every node notes when its pairs change
+ * (including by splitting, merging, and compaction), and
+ * skiparray_checkpoint_incremental only writes the nodes changed
+ * since the last checkpoint, as blocks tagged with a node ID,
+ * followed by a manifest of every node's ID in order -- a few bytes
+ * per node. The first checkpoint is a base with every node, and
+ * later ones are deltas against it, forming a chain.
+ *
+ * The blocks hold pairs as in skiparray_dump, but checkpoints are a
+ * separate format: they can only be read by skiparray_load_checkpoints.
+ * A failed checkpoint doesn't count: the next one will write
+ * everything it would have. */
+enum skiparray_dump_res
+skiparray_checkpoint_incremental(struct skiparray *sa,
+    const struct skiparray_dump_config *config);
+
+/* Write a base checkpoint, with every node, starting a new chain.
+ * Once it's written, older checkpoints are no longer needed. */
+enum skiparray_dump_res
+skiparray_checkpoint_base(struct skiparray *sa,
+    const struct skiparray_dump_config *config);
+
+/* Load a skiparray from a chain of COUNT checkpoints: a base, then
+ * each delta written after it, in order, read with the corresponding
+ * LOAD_CONFIGS entry (whose balanced flag is only used from the
+ * first). Returns SKIPARRAY_LOAD_ERROR_CHAIN if they don't form an
+ * unbroken chain. Each is read in one pass, but the base's header is
+ * read first, then the deltas, then the rest of the base. The deltas'
+ * blocks are kept in memory until their pairs are appended, but the
+ * base's are appended as they are read, so beyond the new skiparray,
+ * loading only needs memory for the deltas. Only the blocks the
+ * final manifest refers to are decoded. The loaded skiparray's next
+ * checkpoint will start a new chain. Errors are otherwise as for
+ * skiparray_load. */
+enum skiparray_load_res
+skiparray_load_checkpoints(const struct skiparray_config *config,
+    const struct skiparray_load_config *load_configs, size_t count,
+    struct skiparray **sa);
+
+/* Memory-mapped, read-only skiparrays. skiparray_dump_mapped writes
+ * the pairs in a layout that can be searched in place: a block per
+ * level-0 node, with the keys (and values) addressed by offset, and
+ * an express index of each block's first key at the end of the file.
+ * skiparray_open_mapped maps such a file and only checks its header
+ * and trailer, so opening takes constant time regardless of size;
+ * pages are read in by the OS as lookups touch them.
+ *
+ * Keys and values are only available as the bytes they were encoded
+ * to, so the comparison function and fold callbacks are passed
+ * pointers to struct skiparray_bytes, which point into the mapping
+ * and remain valid until it is closed. */
+
+/* Write SA in the mapped layout. CONFIG's write callback receives the
+ * file's bytes in order; checksum is ignored. */
+enum skiparray_dump_res
+skiparray_dump_mapped(const struct skiparray *sa,
+    const struct skiparray_dump_config *config);
+
+struct skiparray_bytes {
+    const uint8_t *bytes;
+    size_t len;
+};
+
+/* Opaque handle to a mapped, read-only skiparray. */
+struct skiparray_ro;
+
+/* Map the file at PATH, written by skiparray_dump_mapped. CMP is
+ * called with two const struct skiparray_bytes pointers (and a NULL
+ * udata) and must be consistent with the dumped key order; if NULL,
+ * keys are compared bytewise, shorter keys first on a tie. The file
+ * is not read beyond its header and trailer; a damaged file can
+ * give wrong results, but lookups stay within the mapping. */
+enum skiparray_open_mapped_res {
+    SKIPARRAY_OPEN_MAPPED_OK,
+    SKIPARRAY_OPEN_MAPPED_ERROR_MISUSE = -1,
+    SKIPARRAY_OPEN_MAPPED_ERROR_MEMORY = -2,
+    SKIPARRAY_OPEN_MAPPED_ERROR_IO = -3,     /* see errno */
+    SKIPARRAY_OPEN_MAPPED_ERROR_FORMAT = -4, /* bad magic, version, or sizes */
+};
+enum skiparray_open_mapped_res
+skiparray_open_mapped(const char *path, skiparray_cmp_fun *cmp,
+    struct skiparray_ro **ro);
+
+/* Unmap and free RO. Any remaining iterators must be freed first. */
+void
+skiparray_close_mapped(struct skiparray_ro *ro);
+
+size_t
+skiparray_ro_count(const struct skiparray_ro *ro);
+
+/* Get the value associated with KEY. Returns whether it was found;
+ * if so and VALUE is non-NULL, it is set to the value's bytes (with
+ * a length of 0 if the file has no values). */
+bool
+skiparray_ro_get(const struct skiparray_ro *ro,
+    const struct skiparray_bytes *key, struct skiparray_bytes *value);
+
+/* Iterators over a mapped skiparray. These behave like the
+ * corresponding skiparray_iter functions, but do not lock anything. */
+struct skiparray_ro_iter;
+
+enum skiparray_iter_new_res
+skiparray_ro_iter_new(struct skiparray_ro *ro,
+    struct skiparray_ro_iter **res);
+
+void
+skiparray_ro_iter_free(struct skiparray_ro_iter *iter);
+
+void
+skiparray_ro_iter_seek_endpoint(struct skiparray_ro_iter *iter,
+    enum skiparray_iter_seek_endpoint end);
+
+enum skiparray_iter_seek_res
+skiparray_ro_iter_seek(struct skiparray_ro_iter *iter,
+    const struct skiparray_bytes *key);
+
+enum skiparray_iter_step_res
+skiparray_ro_iter_next(struct skiparray_ro_iter *iter);
+
+enum skiparray_iter_step_res
+skiparray_ro_iter_prev(struct skiparray_ro_iter *iter);
+
+void
+skiparray_ro_iter_get(struct skiparray_ro_iter *iter,
+    struct skiparray_bytes *key, struct skiparray_bytes *value);
+
+/* Fold over every pair, passing CB pointers to struct skiparray_bytes
+ * for the key and value. */
+enum skiparray_fold_res
+skiparray_ro_fold(enum skiparray_fold_type direction,
+    const struct skiparray_ro *ro, skiparray_fold_fun *cb, void *udata);
+
+/* Paged skiparrays. With a pager, at most cache_nodes nodes keep their
+ * pairs in memory; the rest are evicted (by the CLOCK algorithm) to
+ * pages, which are written, read, and released by callbacks. Every
+ * node's header (with its express lane links) and its last pair, which
+ * searches compare against, stay in memory, so a lookup reads at most
+ * one page. Pages are only rewritten if the node changed since it was
+ * last read in.
+ *
+ * Evicting a node encodes its pairs and then passes them to the
+ * skiparray's free callback, and reading it back in decodes new
+ * copies, so in paged mode the skiparray owns its keys and values:
+ * pointers returned by get, first, last, or an iterator are only
+ * valid until the next call on the skiparray.
+ *
+ * If a page can't be read back in -- the read or a decode callback
+ * fails, or memory runs out -- the on_error callback (if any) is told
+ * why, and can return true to try again. Otherwise the operation
+ * returns ERROR_PAGE (skiparray_get and skiparray_member return false,
+ * and skiparray_filter returns NULL). Operations that change the
+ * skiparray read in every page they need before changing anything;
+ * the node stays paged out, and later operations will try to read it
+ * again. A failed write leaves the node in memory, to be tried again
+ * later. */
+
+/* Store LEN bytes from BUF as a page, and set *PAGE_ID to the ID it
+ * can be read back with. Return false on error. */
+typedef bool
+skiparray_page_write_fun(const uint8_t *buf, size_t len,
+    uint64_t *page_id, void *udata);
+
+/* Read the LEN bytes of page PAGE_ID into BUF. */
+typedef bool
+skiparray_page_read_fun(uint64_t page_id, uint8_t *buf, size_t len,
+    void *udata);
+
+/* Page PAGE_ID (of LEN bytes) is no longer needed. */
+typedef void
+skiparray_page_release_fun(uint64_t page_id, size_t len, void *udata);
+
+enum skiparray_pager_error {
+    SKIPARRAY_PAGER_ERROR_READ,   /* the read callback failed */
+    SKIPARRAY_PAGER_ERROR_DECODE, /* a decode callback failed, or bad page */
+    SKIPARRAY_PAGER_ERROR_MEMORY,
+};
+
+/* Page PAGE_ID couldn't be read back in, because of ERROR. Return true
+ * to try reading it again, or false to fail the operation. */
+typedef bool
+skiparray_pager_error_fun(enum skiparray_pager_error error,
+    uint64_t page_id, void *udata);
+
+struct skiparray_pager_config {
+    /* How many nodes can have their pairs in memory at once. This is
+     * a target: each operation may briefly exceed it by the handful of
+     * nodes it uses. 0 for the default. */
+    size_t cache_nodes;
+
+    skiparray_page_write_fun *write;     /* required */
+    skiparray_page_read_fun *read;       /* required */
+    skiparray_page_release_fun *release; /* optional */
+    skiparray_pager_error_fun *on_error; /* optional */
+    void *store_udata;  /* callback data for write, read, release, on_error */
+
+    skiparray_encode_fun *encode_key;    /* required */
+    skiparray_encode_fun *encode_value;  /* unused if ignoring values */
+    skiparray_decode_fun *decode_key;    /* required */
+    skiparray_decode_fun *decode_value;  /* unused if ignoring values */
+    void *udata;                /* callback data for encoding and decoding */
+};
+
+/* Default cache_nodes for a pager. */
+#define SKIPARRAY_PAGER_DEF_CACHE_NODES 1024
+
+enum skiparray_pager_new_res {
+    SKIPARRAY_PAGER_NEW_OK,
+    SKIPARRAY_PAGER_NEW_ERROR_NULL = -1,
+    SKIPARRAY_PAGER_NEW_ERROR_CONFIG = -2,
+    SKIPARRAY_PAGER_NEW_ERROR_MEMORY = -3,
+};
+enum skiparray_pager_new_res
+skiparray_pager_new(const struct skiparray_pager_config *config,
+    struct skiparray_pager **pager);
+
+/* Free a pager. Its skiparray must already be freed. */
+void
+skiparray_pager_free(struct skiparray_pager *pager);
+
+/* Counters for a pager. */
+struct skiparray_pager_stats {
+    size_t resident;     /* nodes with their pairs in memory */
+    size_t faults;       /* nodes read back in */
+    size_t evictions;    /* nodes evicted */
+    size_t writes;       /* pages written */
+    size_t write_errors; /* failed page writes */
+    size_t read_errors;  /* failed page reads, including retried ones */
+};
+
+void
+skiparray_pager_stats(const struct skiparray_pager *pager,
+    struct skiparray_pager_stats *stats);
+
+/* A page store in a local file, for a pager's write, read, and release
+ * callbacks (with store_udata set to the page file). Freed pages are
+ * reused by later writes of a similar size. The file is scratch space:
+ * it is truncated when opened, and its contents are only meaningful to
+ * the open page file. */
+struct skiparray_page_file;
+
+enum skiparray_page_file_open_res {
+    SKIPARRAY_PAGE_FILE_OPEN_OK,
+    SKIPARRAY_PAGE_FILE_OPEN_ERROR_NULL = -1,
+    SKIPARRAY_PAGE_FILE_OPEN_ERROR_MEMORY = -2,
+    SKIPARRAY_PAGE_FILE_OPEN_ERROR_IO = -3, /* see errno */
+};
+enum skiparray_page_file_open_res
+skiparray_page_file_open(const char *path,
+    struct skiparray_page_file **pf);
+
+/* Close the page file. Its pager must already be freed. */
+void
+skiparray_page_file_close(struct skiparray_page_file *pf);
+
+bool
+skiparray_page_file_write(const uint8_t *buf, size_t len,
+    uint64_t *page_id, void *udata);
+
+bool
+skiparray_page_file_read(uint64_t page_id, uint8_t *buf, size_t len,
+    void *udata);
+
+void
+skiparray_page_file_release(uint64_t page_id, size_t len, void *udata);
+
+/* Write-ahead logging. A skiparray configured with a WAL encodes a
+ * record for every set, forget, and pop (pops are logged as forgetting
+ * the popped key) before applying it, and returns ERROR_WAL without
+ * changing anything if the record can't be logged. Records are
+ * buffered and written in groups, as frames with a CRC-32, so after a
+ * crash the log ends in at most one incomplete frame. Building (with
+ * the builder or skiparray_load) and compacting aren't logged.
+ *
+ * To recover, load the last snapshot (see skiparray_dump) and replay
+ * the log written since it with skiparray_replay. */
+
+/* Make everything written so far durable, e.g. with fsync(2).
+ * Return false on error. */
+typedef bool
+skiparray_sync_fun(void *udata);
+
+/* When to call the sync callback. */
+enum skiparray_wal_sync {
+    /* Never; leave it to the OS (or skiparray_wal_flush's caller). */
+    SKIPARRAY_WAL_SYNC_NONE,
+    /* After writing each group of records. */
+    SKIPARRAY_WAL_SYNC_GROUP,
+    /* Write and sync every record before applying its change.
+     * This disables grouping. If the sync fails, the change returns
+     * ERROR_WAL and isn't applied, but its record has been written,
+     * so (as with any failed commit) a replay may still apply it. */
+    SKIPARRAY_WAL_SYNC_EVERY,
+};
+
+struct skiparray_wal_config {
+    /* Append to the log. A failed write should leave the log as it
+     * was, since its records will be written again by the next flush. */
+    skiparray_write_fun *write; /* required */
+    skiparray_sync_fun *sync;   /* required, unless sync is NONE */
+    void *log_udata;            /* callback data for write and sync */
+    enum skiparray_wal_sync sync_policy;
+
+    /* Buffer records until at least this many bytes are pending, then
+     * write them as one frame. 0 for the default. */
+    size_t group_bytes;
+
+    skiparray_encode_fun *encode_key;   /* required */
+    skiparray_encode_fun *encode_value; /* unused if ignoring values */
+    void *udata;                /* callback data for encoding */
+};
+
+/* Default group_bytes for a WAL. */
+#define SKIPARRAY_WAL_DEF_GROUP_BYTES 4096
+
+enum skiparray_wal_new_res {
+    SKIPARRAY_WAL_NEW_OK,
+    SKIPARRAY_WAL_NEW_ERROR_NULL = -1,
+    SKIPARRAY_WAL_NEW_ERROR_CONFIG = -2,
+    SKIPARRAY_WAL_NEW_ERROR_MEMORY = -3,
+};
+enum skiparray_wal_new_res
+skiparray_wal_new(const struct skiparray_wal_config *config,
+    struct skiparray_wal **wal);
+
+/* Free a WAL. Its skiparray must already be freed. Records that
+ * haven't been written yet are discarded, so flush it first. */
+void
+skiparray_wal_free(struct skiparray_wal *wal);
+
+/* Write any buffered records, and sync unless the sync policy is
+ * NONE. Call this wherever changes need to be durable (e.g. before
+ * acknowledging a request), since with grouping, a change is applied
+ * in memory before its record is written. If a sync fails, it is
+ * retried by the next flush. */
+enum skiparray_wal_flush_res {
+    SKIPARRAY_WAL_FLUSH_OK,
+    SKIPARRAY_WAL_FLUSH_ERROR_WRITE = -1,
+    SKIPARRAY_WAL_FLUSH_ERROR_SYNC = -2,
+};
+enum skiparray_wal_flush_res
+skiparray_wal_flush(struct skiparray_wal *wal);
+
+/* Counters for a WAL. */
+struct skiparray_wal_stats {
+    size_t records;      /* records logged, including pending */
+    size_t pending;      /* records not written yet */
+    size_t frames;       /* frames written */
+    size_t bytes;        /* bytes written */
+    size_t syncs;        /* successful syncs */
+    size_t write_errors;
+    size_t sync_errors;
+};
+
+void
+skiparray_wal_stats(const struct skiparray_wal *wal,
+    struct skiparray_wal_stats *stats);
+
+struct skiparray_replay_config {
+    skiparray_read_fun *read;   /* required */
+    skiparray_decode_fun *decode_key;   /* required */
+    skiparray_decode_fun *decode_value; /* unused if ignoring values */
+    void *udata;                /* callback data */
+};
+
+/* Apply a log written by a WAL to SA (normally loaded from the
+ * snapshot the log starts after). Changes made by replaying are not
+ * logged again, even if SA has a WAL.
+ *
+ * Records are applied in batches. Once SA is large, each batch is
+ * sorted by key and only the last change to each key is applied
+ * (passing the rest to SA's free callback); batches that are large
+ * relative to SA are merged with its pairs in a single pass, which is
+ * much faster than making the same calls again. Decoded keys and
+ * values replace existing ones, which are passed to the free callback.
+ *
+ * Reading stops at the end of the input, or at the first incomplete
+ * or damaged frame (as left by a crash), which returns TRUNCATED after
+ * applying everything before it. On error, earlier batches may have
+ * been applied. */
+enum skiparray_replay_res {
+    SKIPARRAY_REPLAY_OK,
+    SKIPARRAY_REPLAY_TRUNCATED,
+    SKIPARRAY_REPLAY_ERROR_MISUSE = -1,
+    SKIPARRAY_REPLAY_ERROR_LOCKED = -2,
+    SKIPARRAY_REPLAY_ERROR_MEMORY = -3,
+    SKIPARRAY_REPLAY_ERROR_FORMAT = -4, /* not a log, or bad records */
+    SKIPARRAY_REPLAY_ERROR_DECODE = -5,
+    SKIPARRAY_REPLAY_ERROR_PAGE = -6,   /* couldn't read a paged-out node */
+};
+enum skiparray_replay_res
+skiparray_replay(struct skiparray *sa,
+    const struct skiparray_replay_config *config);
+
+/* Diff two skiparrays with digests (see the config's hash field),
+ * calling ON_ADDED for each pair only in B, ON_REMOVED for each pair
+ * only in A, and ON_CHANGED (with B's key) for each key in both whose
+ * pairs hash differently. Any of them can be NULL.
+ *
+ * Wherever both skiparrays have a node or express-lane span covering
+ * the same range of keys with equal digests, the whole span is
+ * skipped without looking at its pairs, so replicas with the same
+ * history (which split their nodes at the same keys) diff in time
+ * proportional to what changed. Elsewhere, pairs are compared one by
+ * one until node boundaries line up again.
+ *
+ * A and B need the same comparison function, and both or neither use
+ * values; their hash functions must agree. The callbacks must not
+ * modify either skiparray. */
+typedef void
+skiparray_diff_changed_fun(void *key, void *value_a, void *value_b,
+    void *udata);
+
+enum skiparray_diff_res {
+    SKIPARRAY_DIFF_OK,
+    SKIPARRAY_DIFF_ERROR_MISUSE = -1,
+    SKIPARRAY_DIFF_ERROR_MEMORY = -2,
+    SKIPARRAY_DIFF_ERROR_PAGE = -3,
+};
+enum skiparray_diff_res
+skiparray_diff(struct skiparray *a, struct skiparray *b,
+    skiparray_fold_fun *on_added, skiparray_fold_fun *on_removed,
+    skiparray_diff_changed_fun *on_changed, void *udata);
+
 #endif
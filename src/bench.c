@@ -8,6 +8,15 @@
 #include <getopt.h>
 
 #include "skiparray.h"
+#include "bench_baseline.h"
+#include "bench_hist.h"
+#include "bench_hwc.h"
+#include "bench_keys.h"
+#include "bench_mt.h"
+#include "bench_report.h"
+#include "bench_sweep.h"
+#include "bench_sys.h"
+#include "bench_ycsb.h"
 
 #include <sys/time.h>
 
@@ -22,6 +31,10 @@ get_usec_delta(struct timeval *pre, struct timeval *post) {
 
 #define TIME(NAME)                                                      \
         struct timeval timer_##NAME = { 0, 0 };                         \
+        struct hwc_sample hwc_##NAME;                                   \
+        hwc_read(&hwc_##NAME);                                          \
+        uint64_t cmps_##NAME = (keys == NULL ? 0 : keys->cmp_calls);    \
+        (void)cmps_##NAME;                                              \
         int timer_res_##NAME = gettimeofday(&timer_##NAME, NULL);       \
         (void)timer_res_##NAME;                                         \
         assert(0 == timer_res_##NAME);                                  \
@@ -29,25 +42,62 @@ get_usec_delta(struct timeval *pre, struct timeval *post) {
 #define CMP_TIME(LABEL, LIMIT, N1, N2)                                  \
     do {                                                                \
         size_t usec_delta = get_usec_delta(&timer_##N1, &timer_##N2);   \
+        struct hwc_sample hwc_delta;                                    \
+        hwc_diff(&hwc_##N1, &hwc_##N2, &hwc_delta);                     \
+        uint64_t cmp_delta = cmps_##N2 - cmps_##N1;                     \
+        if (trial_state == TRIAL_WARMUP) { break; }                     \
+        if (trial_state == TRIAL_TIMED) {                               \
+            trial_record(LABEL, usec_delta, &hwc_delta, cmp_delta);     \
+            if (report_format == REPORT_TEXT) { break; }                \
+        }                                                               \
+        if (report_format != REPORT_TEXT) {                             \
+            report(LABEL, LIMIT, usec_delta, &hwc_delta, cmp_delta);    \
+            break;                                                      \
+        }                                                               \
         double usec_per = usec_delta / (double)LIMIT;                   \
         double per_second = usec_per_sec / usec_per;                    \
         printf("%-30s limit %9zu %9.3f msec, %6.3f usec per, "          \
             "%11.3f K ops/sec",                                         \
             LABEL, LIMIT, usec_delta / (double)msec_per_sec,            \
             usec_per, per_second / 1000);                               \
+        if (keys != NULL) {                                             \
+            printf(", %.1f cmp/op", cmp_delta / (double)LIMIT);         \
+        }                                                               \
         if (track_memory) {                                             \
             printf(", %g MB hwm, %g w/e",                               \
                 memory_hwm / (1024.0 * 1024),                           \
                 memory_hwm / (1.0 * sizeof(void *) * LIMIT));           \
         }                                                               \
         printf("\n");                                                   \
+        if (use_hwc) { print_hwc(&hwc_delta, LIMIT); }                  \
+        if (latency_batch > 0) { print_latency(); }                     \
     } while(0)                                                          \
 
 #define TDIFF() CMP_TIME(__func__, limit, pre, post)
 
+/* Run a timed operation. With -L, also time it (or every batch of
+ * latency_batch operations), and record the time per operation in the
+ * latency histogram. STMT can't declare variables. */
+#define OP(STMT)                                                        \
+    do {                                                                \
+        if (latency_batch == 0) {                                       \
+            STMT;                                                       \
+        } else {                                                        \
+            if (latency_pending == 0) { latency_start = hist_now_ns(); }\
+            STMT;                                                       \
+            if (++latency_pending == latency_batch) {                   \
+                latency_flush();                                        \
+            }                                                           \
+        }                                                               \
+    } while (0)
+
 #define MAX_LIMITS 64
 #define DEF_LIMIT ((size_t)1000000)
 #define DEF_CYCLES ((size_t)1)
+/* -S runs this workload, without -w. */
+#define DEF_SWEEP_WORKLOAD "b"
+/* -C flags significant changes bigger than this. */
+#define COMPARE_THRESHOLD 0.03
 
 static const int prime = 7919;
 static size_t cycles = DEF_CYCLES;
@@ -56,20 +106,248 @@ static uint8_t limit_count = 0;
 static size_t limits[MAX_LIMITS];
 static size_t node_size = SKIPARRAY_DEF_NODE_SIZE;
 static const char *name;
+static char *base_names;        /* -B */
 static bool track_memory;
+static bool use_pool;
 static size_t memory_used;
 static size_t memory_hwm;       /* allocation high-water mark */
 
+/* Per-operation latency, with -L. */
+static size_t latency_batch;    /* 0: off */
+static size_t latency_pending;  /* operations since latency_start */
+static uint64_t latency_start;
+static struct hist latency;
+
+/* With -w, run a YCSB-style workload instead of the benchmarks. */
+static bool use_ycsb;
+static struct ycsb_workload ycsb;
+
+/* With -S, run it across node sizes and max levels. */
+static bool use_sweep;
+static struct sweep_grid sweep;
+
+/* With -t, run the multi-threaded benchmark instead. */
+static struct mt_workload mt;
+
+/* Parameters for the batch benchmarks (folds, filter, and seeks),
+ * set with -F. */
+#define MAX_FOLD_INPUTS 64
+static struct {
+    uint8_t inputs;             /* skiparrays merged by fold_multi */
+    double overlap;             /* fraction of keys in two inputs */
+    double selectivity;         /* fraction of pairs filter keeps */
+    size_t jump;                /* keys between seek_forward's seeks */
+} batch = {
+    .inputs = 4,
+    .overlap = 0.5,
+    .selectivity = 0.1,
+    .jump = 64,
+};
+
+/* With -K, run the key benchmarks with each kind of costlier key,
+ * counting comparisons. */
+static char *key_names;
+static struct keys *keys;       /* the current kind's, or NULL */
+
+static void
+latency_flush(void) {
+    if (latency_pending == 0) { return; }
+    const uint64_t elapsed = hist_now_ns() - latency_start;
+    hist_record_n(&latency, elapsed / latency_pending, latency_pending);
+    latency_pending = 0;
+}
+
+static void
+print_latency(void) {
+    latency_flush();
+    hist_print("", &latency);
+}
+
+/* With -H, count hardware events during each benchmark. */
+static bool use_hwc;
+
+static void
+hwc_diff(const struct hwc_sample *pre, const struct hwc_sample *post,
+    struct hwc_sample *delta) {
+    for (size_t i = 0; i < HWC_EVENT_COUNT; i++) {
+        delta->counts[i] = post->counts[i] - pre->counts[i];
+    }
+}
+
+static void
+hwc_per_op(const struct hwc_sample *delta, size_t limit, double *per_op) {
+    for (size_t i = 0; i < HWC_EVENT_COUNT; i++) {
+        per_op[i] = (hwc_available(i) && limit > 0
+            ? delta->counts[i] / (double)limit : -1);
+    }
+}
+
+static void
+print_hwc(const struct hwc_sample *delta, size_t limit) {
+    double per_op[HWC_EVENT_COUNT];
+    hwc_per_op(delta, limit, per_op);
+    const char *sep = NULL;
+    for (size_t i = 0; i < HWC_EVENT_COUNT; i++) {
+        if (per_op[i] < 0) { continue; }
+        if (sep == NULL) { printf("%-30s per op:", ""); }
+        printf("%s%.3f %s", sep == NULL ? " " : sep, per_op[i], hwc_name(i));
+        sep = ", ";
+    }
+    if (sep == NULL) { return; }   /* none available */
+    if (per_op[HWC_CYCLES] > 0 && per_op[HWC_INSTRUCTIONS] >= 0) {
+        printf(", IPC %.2f", per_op[HWC_INSTRUCTIONS] / per_op[HWC_CYCLES]);
+    }
+    printf("\n");
+}
+
+/* With -o, results are printed as CSV or JSON instead, and -C
+ * compares two CSV files. */
+static enum report_format report_format;
+static size_t cycle;
+static char *compare_paths;
+
+static void
+report(const char *label, size_t limit, size_t usec_delta,
+    const struct hwc_sample *hwc_delta, uint64_t cmp_delta) {
+    latency_flush();
+    double hwc[HWC_EVENT_COUNT];
+    hwc_per_op(hwc_delta, limit, hwc);
+    const struct report_result r = {
+        .name = label,
+        .limit = limit,
+        .node_size = node_size,
+        .seed = rng_seed,
+        .cycle = cycle,
+        .usec = usec_delta,
+        .memory_hwm = (track_memory ? memory_hwm : 0),
+        .latency = (latency_batch > 0 ? &latency : NULL),
+        .hwc = (use_hwc ? hwc : NULL),
+        .cmp_per_op = (keys == NULL ? -1 : cmp_delta / (double)limit),
+    };
+    report_result(report_format, &r);
+}
+
+/* With -R, each benchmark is run -W times untimed, to warm up caches,
+ * the allocator, and the CPU clock, then -R times timed, and the
+ * results are summarized. */
+#define DEF_WARMUPS ((size_t)1)
+static size_t warmups = DEF_WARMUPS;
+static size_t reps;             /* 0: just run once */
+static int pin_cpu = -1;
+
+enum trial_state {
+    TRIAL_OFF,
+    TRIAL_WARMUP,               /* discard results */
+    TRIAL_TIMED,                /* collect results */
+};
+static enum trial_state trial_state;
+static size_t trial_rep;
+static size_t trial_count;
+static double trial_usec[REPORT_MAX_SAMPLES];
+static const char *trial_label;
+static size_t trial_hwm;
+static struct hwc_sample trial_hwc; /* summed over the runs */
+static uint64_t trial_cmps;     /* ditto */
+
+static void
+trial_record(const char *label, size_t usec_delta,
+    const struct hwc_sample *hwc_delta, uint64_t cmp_delta) {
+    trial_label = label;
+    if (trial_count < REPORT_MAX_SAMPLES) {
+        trial_usec[trial_count++] = (double)usec_delta;
+        trial_cmps += cmp_delta;
+        for (size_t i = 0; i < HWC_EVENT_COUNT; i++) {
+            trial_hwc.counts[i] += hwc_delta->counts[i];
+        }
+    }
+    if (memory_hwm > trial_hwm) { trial_hwm = memory_hwm; }
+}
+
+/* Print the median time, like CMP_TIME, then its spread: the standard
+ * deviation, and the 95% confidence interval of the mean. Hardware
+ * counts are averaged over the runs. */
+static void
+print_trials(size_t limit) {
+    struct report_stats st;
+    report_stats(trial_usec, trial_count, &st);
+    const double usec_per = st.median / limit;
+    printf("%-30s limit %9zu %9.3f msec, %6.3f usec per, "
+        "%11.3f K ops/sec, median of %zu, sd %.1f%%, 95%% CI +/- %.1f%%",
+        trial_label, limit, st.median / msec_per_sec, usec_per,
+        usec_per_sec / usec_per / 1000, trial_count,
+        (st.mean == 0 ? 0 : 100 * st.stddev / st.mean),
+        (st.mean == 0 ? 0 : 100 * st.ci95 / st.mean));
+    if (keys != NULL) {
+        printf(", %.1f cmp/op", trial_cmps / (double)(limit * trial_count));
+    }
+    if (track_memory) {
+        printf(", %g MB hwm, %g w/e", trial_hwm / (1024.0 * 1024),
+            trial_hwm / (1.0 * sizeof(void *) * limit));
+    }
+    printf("\n");
+    if (use_hwc) { print_hwc(&trial_hwc, limit * trial_count); }
+    if (latency_batch > 0) { print_latency(); }
+}
+
 static void
 usage(void) {
-    fprintf(stderr, "Usage: benchmarks [-c <cycles>] [-l <limit>] [-m]\n");
-    fprintf(stderr, "                  [-n <name>] [-r <seed>] [-s <size>]\n\n");
+    fprintf(stderr, "Usage: benchmarks [-B <structures>] [-c <cycles>] [-F <settings>]\n");
+    fprintf(stderr, "                  [-H] [-K <keys>] [-l <limit>] [-L <batch>] [-m]\n");
+    fprintf(stderr, "                  [-n <name>] [-o <format>] [-p <cpu>] [-P] [-r <seed>]\n");
+    fprintf(stderr, "                  [-R <reps>] [-s <size>] [-S <max_levels>] [-W <warmups>]\n");
+    fprintf(stderr, "                  [-t <threads>] [-T <mode>] [-w <workload>]\n");
+    fprintf(stderr, "       benchmarks -C <base.csv>,<new.csv>\n\n");
+    fprintf(stderr, "  -B: run the baseline benchmarks on each of a comma-separated\n");
+    fprintf(stderr, "      list of structures: skiparray, sorted (a sorted array),\n");
+    fprintf(stderr, "      rbtree, bptree (a B+-tree), skiplist, or 'all'.\n");
+    fprintf(stderr, "  -C: compare two -o csv results, <base.csv>,<new.csv>, flagging\n");
+    fprintf(stderr, "      significant regressions (needs -c 2 or more for each).\n");
     fprintf(stderr, "  -c: run multiple cycles of benchmarks (def. 1)\n");
+    fprintf(stderr, "  -F: settings for the fold, filter, and seek benchmarks:\n");
+    fprintf(stderr, "      inputs= (fold_multi's skiparrays, def. %u), overlap= (the\n",
+        batch.inputs);
+    fprintf(stderr, "      fraction of keys in two of them, def. %g), select= (the\n",
+        batch.overlap);
+    fprintf(stderr, "      fraction filter keeps, def. %g), jump= (keys between\n",
+        batch.selectivity);
+    fprintf(stderr, "      seek_forward's seeks, def. %zu), e.g. 'inputs=8,overlap=0.1'.\n",
+        batch.jump);
+    fprintf(stderr, "  -H: count cycles, instructions, LLC, dTLB, and branch misses\n");
+    fprintf(stderr, "      per operation, with perf_event_open (Linux only).\n");
+    fprintf(stderr, "  -K: run the key benchmarks, counting comparisons, with each of\n");
+    fprintf(stderr, "      a comma-separated list of heap-allocated key kinds: string\n");
+    fprintf(stderr, "      (random), prefix (strings with long shared prefixes),\n");
+    fprintf(stderr, "      struct (32-byte composite keys), or 'all'.\n");
     fprintf(stderr, "  -l: set limit(s); comma-separated, default %zu.\n", DEF_LIMIT);
+    fprintf(stderr, "  -L: time operations in batches of <batch> (1: each one), and\n");
+    fprintf(stderr, "      print latency percentiles. This adds timer overhead.\n");
     fprintf(stderr, "  -m: track the memory high-water mark, in MB and words/entry.\n");
     fprintf(stderr, "  -n: run one benchmark. 'help' prints available benchmarks.\n");
+    fprintf(stderr, "  -o: output format: text (default), csv, or json.\n");
+    fprintf(stderr, "  -p: pin the process to CPU <cpu>.\n");
+    fprintf(stderr, "  -P: allocate nodes from a node pool.\n");
     fprintf(stderr, "  -r: set RNG seed.\n");
+    fprintf(stderr, "  -R: after warmups, run each benchmark <reps> times, and print\n");
+    fprintf(stderr, "      the median, standard deviation, and 95%% confidence\n");
+    fprintf(stderr, "      interval; also warn about CPU frequency scaling.\n");
     fprintf(stderr, "  -s: node size, default %d.\n", SKIPARRAY_DEF_NODE_SIZE);
+    fprintf(stderr, "  -S: run the -w workload (default '%s') at node sizes %d to\n",
+        DEF_SWEEP_WORKLOAD, SWEEP_MIN_NODE_SIZE);
+    fprintf(stderr, "      %d and each of a comma-separated list of max levels,\n",
+        SWEEP_MAX_NODE_SIZE);
+    fprintf(stderr, "      print a Pareto table, and recommend a configuration.\n");
+    fprintf(stderr, "  -t: run <threads> threads doing random gets and sets, each\n");
+    fprintf(stderr, "      <limit> times after a warmup, pinned to CPUs.\n");
+    fprintf(stderr, "  -T: how -t threads access skiparrays: 'mutex' (default), one\n");
+    fprintf(stderr, "      skiparray behind a mutex, or 'private', one per thread,\n");
+    fprintf(stderr, "      then optionally ',read=<percent>' (def. 90), ',nopin'.\n");
+    fprintf(stderr, "  -W: untimed warmup runs before -R's, default %zu.\n", DEF_WARMUPS);
+    fprintf(stderr, "  -w: load <limit> records, then run <limit> operations of a\n");
+    fprintf(stderr, "      YCSB-style workload: a preset, 'a' to 'f', and/or settings:\n");
+    fprintf(stderr, "      read=, update=, insert=, scan=, rmw=, delete= (weights),\n");
+    fprintf(stderr, "      dist=uniform|zipfian|latest|hotspot, theta=, hot_set=,\n");
+    fprintf(stderr, "      hot_ops=, scan_max=, key_size=, value_size=, e.g.\n");
+    fprintf(stderr, "      '-w a' or '-w b,dist=hotspot,value_size=100'.\n");
     exit(EXIT_FAILURE);
 }
 
@@ -98,14 +376,51 @@ parse_limits(char *optarg) {
     return true;
 }
 
+/* Parse -F's comma-separated settings: inputs=, overlap=, select=,
+ * and jump=. */
+static bool
+parse_batch(char *optarg) {
+    for (char *arg = strtok(optarg, ","); arg; arg = strtok(NULL, ",")) {
+        char *eq = strchr(arg, '=');
+        if (eq == NULL) { return false; }
+        *eq = '\0';
+        const char *value = eq + 1;
+        if (0 == strcmp(arg, "inputs")) {
+            const unsigned long inputs = strtoul(value, NULL, 0);
+            if (inputs < 1 || inputs > MAX_FOLD_INPUTS) { return false; }
+            batch.inputs = (uint8_t)inputs;
+        } else if (0 == strcmp(arg, "overlap")) {
+            batch.overlap = strtod(value, NULL);
+            if (!(batch.overlap >= 0 && batch.overlap <= 1)) { return false; }
+        } else if (0 == strcmp(arg, "select")) {
+            batch.selectivity = strtod(value, NULL);
+            if (!(batch.selectivity >= 0 && batch.selectivity <= 1)) {
+                return false;
+            }
+        } else if (0 == strcmp(arg, "jump")) {
+            batch.jump = strtoul(value, NULL, 0);
+            if (batch.jump == 0) { return false; }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
 static void
 handle_args(int argc, char **argv) {
     int fl;
-    while ((fl = getopt(argc, argv, "hc:l:mn:r:s:")) != -1) {
+    while ((fl = getopt(argc, argv, "hB:C:c:F:HK:l:L:mn:o:p:Pr:R:s:S:t:T:w:W:")) != -1) {
         switch (fl) {
         case 'h':               /* help */
             usage();
             break;
+        case 'B':               /* baselines */
+            base_names = optarg;
+            break;
+        case 'C':               /* compare */
+            compare_paths = optarg;
+            break;
         case 'c':               /* cycles */
             cycles = strtoul(optarg, NULL, 0);
             if (cycles == 0) {
@@ -113,21 +428,59 @@ handle_args(int argc, char **argv) {
                 usage();
             }
             break;
+        case 'F':               /* batch benchmark settings */
+            if (!parse_batch(optarg)) {
+                fprintf(stderr, "Bad batch settings: %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'H':               /* hardware counters */
+            use_hwc = true;
+            break;
+        case 'K':               /* key kinds */
+            key_names = optarg;
+            break;
         case 'l':               /* limit */
             if (!parse_limits(optarg)) {
                 fprintf(stderr, "Bad limit(s): %s\n", optarg);
                 usage();
             }
             break;
+        case 'L':               /* latency */
+            latency_batch = strtoul(optarg, NULL, 0);
+            if (latency_batch == 0) {
+                fprintf(stderr, "Bad latency batch: %s\n", optarg);
+                usage();
+            }
+            break;
         case 'm':               /* memory */
             track_memory = true;
             break;
         case 'n':               /* name */
             name = optarg;
             break;
+        case 'o':               /* output format */
+            if (!report_parse_format(optarg, &report_format)) {
+                fprintf(stderr, "Bad output format: %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'p':               /* pin */
+            pin_cpu = (int)strtol(optarg, NULL, 0);
+            break;
+        case 'P':               /* pool */
+            use_pool = true;
+            break;
         case 'r':               /* rng_seed */
             rng_seed = strtoul(optarg, NULL, 0);
             break;
+        case 'R':               /* repetitions */
+            reps = strtoul(optarg, NULL, 0);
+            if (reps == 0 || reps > REPORT_MAX_SAMPLES) {
+                fprintf(stderr, "Bad repetitions: %s\n", optarg);
+                usage();
+            }
+            break;
         case 's':               /* node_size */
             node_size = strtoul(optarg, NULL, 0);
             if (node_size < 2) {
@@ -135,11 +488,72 @@ handle_args(int argc, char **argv) {
                 usage();
             }
             break;
+        case 'S':               /* sweep */
+            if (!sweep_parse(optarg, &sweep)) {
+                fprintf(stderr, "Bad max levels: %s\n", optarg);
+                usage();
+            }
+            use_sweep = true;
+            break;
+        case 't':               /* threads */
+            mt.threads = strtoul(optarg, NULL, 0);
+            if (mt.threads == 0) {
+                fprintf(stderr, "Bad thread count: %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'T':               /* thread mode */
+            if (!mt_parse(optarg, &mt)) {
+                fprintf(stderr, "Bad thread mode: %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'w':               /* workload */
+            if (!ycsb_parse(optarg, &ycsb)) {
+                fprintf(stderr, "Bad workload: %s\n", optarg);
+                usage();
+            }
+            use_ycsb = true;
+            break;
+        case 'W':               /* warmups */
+            warmups = strtoul(optarg, NULL, 0);
+            break;
         case '?':
         default:
             usage();
         }
     }
+
+    if (use_sweep && mt.threads > 0) {
+        fprintf(stderr, "-t and -S can't be combined\n");
+        usage();
+    } else if (use_sweep && !use_ycsb) {
+        if (!ycsb_parse(DEF_SWEEP_WORKLOAD, &ycsb)) { assert(false); }
+        use_ycsb = true;
+    }
+
+    if (mt.mode != NULL && mt.threads == 0) {
+        fprintf(stderr, "-T needs -t\n");
+        usage();
+    } else if (mt.threads > 0 && use_ycsb) {
+        fprintf(stderr, "-t and -w can't be combined\n");
+        usage();
+    } else if (report_format != REPORT_TEXT && (mt.threads > 0 || use_ycsb)) {
+        fprintf(stderr, "-o only applies to the benchmark table and -B\n");
+        usage();
+    } else if (reps > 0 && (mt.threads > 0 || use_ycsb)) {
+        fprintf(stderr, "-R only applies to the benchmark table and -B\n");
+        usage();
+    } else if (use_hwc && (mt.threads > 0 || use_ycsb)) {
+        fprintf(stderr, "-H only applies to the benchmark table and -B\n");
+        usage();
+    } else if (key_names != NULL
+        && (base_names != NULL || mt.threads > 0 || use_ycsb)) {
+        fprintf(stderr, "-K can't be combined with -B, -t, -w, or -S\n");
+        usage();
+    } else if (mt.threads > 0 && mt.mode == NULL) {
+        if (!mt_parse("mutex", &mt)) { assert(false); }
+    }
 }
 
 static int
@@ -188,7 +602,7 @@ get_sequential(size_t limit) {
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = i;
         intptr_t v = 0;
-        skiparray_get(sa, (void *) k, (void **)&v);
+        OP(skiparray_get(sa, (void *) k, (void **)&v));
         assert(v == k);
     }
     TIME(post);
@@ -206,7 +620,7 @@ get_random_access(size_t limit) {
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = (i * prime) % limit;
         intptr_t v = 0;
-        skiparray_get(sa, (void *) k, (void **)&v);
+        OP(skiparray_get(sa, (void *) k, (void **)&v));
         assert(v == k);
     }
     TIME(post);
@@ -223,7 +637,7 @@ get_random_access_no_values(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = (i * prime) % limit;
-        skiparray_get(sa, (void *) k, NULL);
+        OP(skiparray_get(sa, (void *) k, NULL));
     }
     TIME(post);
 
@@ -240,7 +654,7 @@ get_nonexistent(size_t limit) {
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = ((i * prime) % limit) + limit;
         intptr_t v = 0;
-        skiparray_get(sa, (void *) k, (void **)&v);
+        OP(skiparray_get(sa, (void *) k, (void **)&v));
         assert(v == 0);
     }
     TIME(post);
@@ -254,7 +668,8 @@ count(size_t limit) {
     struct skiparray *sa = sequential_build(&sa_config, limit);
 
     TIME(pre);
-    size_t count = skiparray_count(sa);
+    size_t count = 0;
+    OP(count = skiparray_count(sa));
     assert(count == limit);
     TIME(post);
 
@@ -271,7 +686,7 @@ set_sequential(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = i;
-        skiparray_set(sa, (void *) k, (void *) k);
+        OP(skiparray_set(sa, (void *) k, (void *) k));
     }
     TIME(post);
 
@@ -290,9 +705,7 @@ set_sequential_builder(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = i;
-        enum skiparray_builder_append_res bares =
-          skiparray_builder_append(b, (void *) k, (void *) k);
-        (void)bares;
+        OP((void)skiparray_builder_append(b, (void *) k, (void *) k));
     }
 
     struct skiparray *sa = NULL;
@@ -314,9 +727,7 @@ set_sequential_builder_no_chk(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = i;
-        enum skiparray_builder_append_res bares =
-          skiparray_builder_append(b, (void *) k, (void *) k);
-        (void)bares;
+        OP((void)skiparray_builder_append(b, (void *) k, (void *) k));
     }
 
     struct skiparray *sa = NULL;
@@ -336,7 +747,7 @@ set_random_access(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = (i * prime) % limit;
-        skiparray_set(sa, (void *) k, (void *) k);
+        OP(skiparray_set(sa, (void *) k, (void *) k));
     }
     TIME(post);
 
@@ -353,7 +764,7 @@ set_random_access_no_values(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = (i * prime) % limit;
-        skiparray_set(sa, (void *) k, NULL);
+        OP(skiparray_set(sa, (void *) k, NULL));
     }
     TIME(post);
 
@@ -368,7 +779,7 @@ set_replacing_sequential(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = i;
-        skiparray_set(sa, (void *) k, (void *) (k + 1));
+        OP(skiparray_set(sa, (void *) k, (void *) (k + 1)));
     }
     TIME(post);
 
@@ -383,7 +794,7 @@ set_replacing_random_access(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = (i * prime) % limit;
-        skiparray_set(sa, (void *) k, (void *) (k + 1));
+        OP(skiparray_set(sa, (void *) k, (void *) (k + 1)));
     }
     TIME(post);
 
@@ -398,7 +809,7 @@ forget_sequential(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = i;
-        (void)skiparray_forget(sa, (void *) k, NULL);
+        OP((void)skiparray_forget(sa, (void *) k, NULL));
     }
     TIME(post);
 
@@ -413,7 +824,7 @@ forget_random_access(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = (i * prime) % limit;
-        (void)skiparray_forget(sa, (void *) k, NULL);
+        OP((void)skiparray_forget(sa, (void *) k, NULL));
     }
     TIME(post);
 
@@ -428,7 +839,7 @@ forget_random_access_no_values(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = (i * prime) % limit;
-        (void)skiparray_forget(sa, (void *)k, NULL);
+        OP((void)skiparray_forget(sa, (void *)k, NULL));
     }
     TIME(post);
 
@@ -443,7 +854,7 @@ forget_nonexistent(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = ((i * prime) % limit) + limit;
-        (void)skiparray_forget(sa, (void *) k, NULL);
+        OP((void)skiparray_forget(sa, (void *) k, NULL));
     }
     TIME(post);
 
@@ -458,8 +869,8 @@ pop_first(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = 0, v = 0;
-        enum skiparray_pop_res res = skiparray_pop_first(sa,
-            (void *) &k, (void *) &v);
+        enum skiparray_pop_res res = SKIPARRAY_POP_EMPTY;
+        OP(res = skiparray_pop_first(sa, (void *) &k, (void *) &v));
         if (res == SKIPARRAY_POP_EMPTY) { assert(false); }
         assert(res >= 0);
         assert(v == k);
@@ -478,7 +889,8 @@ pop_last(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         intptr_t k = 0, v = 0;
-        int res = skiparray_pop_last(sa, (void *) &k, (void *) &v);
+        int res = 0;
+        OP(res = skiparray_pop_last(sa, (void *) &k, (void *) &v));
         assert(res >= 0);
         assert(v == k);
         (void) res;
@@ -495,7 +907,10 @@ member_sequential(size_t limit) {
 
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
-        assert(skiparray_member(sa, (void *)i));
+        bool found = false;
+        OP(found = skiparray_member(sa, (void *)i));
+        assert(found);
+        (void)found;
     }
     TIME(post);
 
@@ -510,7 +925,10 @@ member_random_access(size_t limit) {
     TIME(pre);
     for (size_t i = 0; i < limit; i++) {
         size_t k = (i * prime) % limit;
-        assert(skiparray_member(sa, (void *)k));
+        bool found = false;
+        OP(found = skiparray_member(sa, (void *)k));
+        assert(found);
+        (void)found;
     }
     TIME(post);
 
@@ -540,11 +958,13 @@ sum(size_t limit) {
 
     skiparray_iter_seek_endpoint(iter, SKIPARRAY_ITER_SEEK_FIRST);
 
+    enum skiparray_iter_step_res step;
     do {
         void *k, *v;
-        skiparray_iter_get(iter, &k, &v);
+        OP(skiparray_iter_get(iter, &k, &v);
+            step = skiparray_iter_next(iter));
         total += (uintptr_t)v;
-    } while (skiparray_iter_next(iter) == SKIPARRAY_ITER_STEP_OK);
+    } while (step == SKIPARRAY_ITER_STEP_OK);
 
     skiparray_iter_free(iter);
 
@@ -579,16 +999,258 @@ sum_partway(size_t limit) {
         assert(false);
     }
 
+    enum skiparray_iter_step_res step;
     do {
         void *k, *v;
-        skiparray_iter_get(iter, &k, &v);
+        OP(skiparray_iter_get(iter, &k, &v);
+            step = skiparray_iter_next(iter));
         (void)v;
-    } while (skiparray_iter_next(iter) == SKIPARRAY_ITER_STEP_OK);
+    } while (step == SKIPARRAY_ITER_STEP_OK);
+
+    skiparray_iter_free(iter);
+
+    TIME(post);
+    TDIFF();
+    skiparray_free(sa);
+}
+
+/* Is K in a FRACTION of keys, spread evenly but not in runs? */
+static bool
+key_selected(uintptr_t k, double fraction) {
+    return (k * 2654435761U) % 10000 < fraction * 10000;
+}
+
+static void
+fold_sum_cb(void *key, void *value, void *udata) {
+    (void)key;
+    uintptr_t *total = udata;
+    *total += (uintptr_t)value;
+}
+
+/* Measure a whole ascending fold. */
+static void
+fold_left(size_t limit) {
+    struct skiparray *sa = sequential_build(&sa_config, limit);
+
+    TIME(pre);
+    uintptr_t total = 0;
+    OP(skiparray_fold(SKIPARRAY_FOLD_LEFT, sa, fold_sum_cb, &total));
+    TIME(post);
+
+    assert(total == (limit * (limit - 1)) / 2);
+    TDIFF();
+    skiparray_free(sa);
+}
+
+/* Same, descending. */
+static void
+fold_right(size_t limit) {
+    struct skiparray *sa = sequential_build(&sa_config, limit);
+
+    TIME(pre);
+    uintptr_t total = 0;
+    OP(skiparray_fold(SKIPARRAY_FOLD_RIGHT, sa, fold_sum_cb, &total));
+    TIME(post);
+
+    assert(total == (limit * (limit - 1)) / 2);
+    TDIFF();
+    skiparray_free(sa);
+}
+
+/* Build -F's inputs for fold_multi, with LIMIT distinct keys between
+ * them: key K goes in input K % inputs, and if selected by the overlap
+ * ratio, in the next input too. Returns how many inputs. */
+static uint8_t
+fold_multi_build_inputs(size_t limit, struct skiparray **inputs) {
+    const uint8_t count = (limit < batch.inputs
+        ? (uint8_t)limit : batch.inputs);
+    struct skiparray_builder *builders[MAX_FOLD_INPUTS];
+    for (uint8_t i = 0; i < count; i++) {
+        if (SKIPARRAY_BUILDER_NEW_OK
+            != skiparray_builder_new(&sa_config, false, &builders[i])) {
+            assert(false);
+        }
+    }
+    for (uintptr_t k = 0; k < limit; k++) {
+        const uint8_t i = k % count;
+        (void)skiparray_builder_append(builders[i], (void *)k, (void *)k);
+        if (count > 1 && key_selected(k, batch.overlap)) {
+            (void)skiparray_builder_append(builders[(i + 1) % count],
+                (void *)k, (void *)k);
+        }
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        skiparray_builder_finish(&builders[i], &inputs[i]);
+    }
+    return count;
+}
+
+static uint8_t
+fold_multi_merge(uint8_t count, const void **keys, void **values,
+    void **merged_value, void *udata) {
+    (void)count;
+    (void)keys;
+    (void)udata;
+    *merged_value = values[0];
+    return 0;
+}
+
+/* Measure merging -F's inputs, stepping through the fold. */
+static void
+fold_multi(size_t limit) {
+    struct skiparray *inputs[MAX_FOLD_INPUTS];
+    const uint8_t count = fold_multi_build_inputs(limit, inputs);
+
+    TIME(pre);
+    uintptr_t total = 0;
+    struct skiparray_fold_state *fs = NULL;
+    if (SKIPARRAY_FOLD_OK != skiparray_fold_multi_init(SKIPARRAY_FOLD_LEFT,
+            count, inputs, fold_sum_cb, fold_multi_merge, &total, &fs)) {
+        assert(false);
+    }
+    enum skiparray_fold_next_res res;
+    do {
+        OP(res = skiparray_fold_next(fs));
+    } while (res == SKIPARRAY_FOLD_NEXT_OK);
+    TIME(post);
+
+    assert(total == (limit * (limit - 1)) / 2);
+    TDIFF();
+    for (uint8_t i = 0; i < count; i++) { skiparray_free(inputs[i]); }
+}
+
+static void
+fold_multi_append_cb(void *key, void *value, void *udata) {
+    struct skiparray_builder *b = udata;
+    (void)skiparray_builder_append(b, key, value);
+}
+
+/* Same, but build a new skiparray from the merged pairs, as a
+ * compaction would. */
+static void
+fold_multi_build(size_t limit) {
+    struct skiparray *inputs[MAX_FOLD_INPUTS];
+    const uint8_t count = fold_multi_build_inputs(limit, inputs);
+
+    TIME(pre);
+    struct skiparray_builder *b = NULL;
+    if (SKIPARRAY_BUILDER_NEW_OK
+        != skiparray_builder_new(&sa_config, true, &b)) {
+        assert(false);
+    }
+    struct skiparray_fold_state *fs = NULL;
+    if (SKIPARRAY_FOLD_OK != skiparray_fold_multi_init(SKIPARRAY_FOLD_LEFT,
+            count, inputs, fold_multi_append_cb, fold_multi_merge, b, &fs)) {
+        assert(false);
+    }
+    enum skiparray_fold_next_res res;
+    do {
+        OP(res = skiparray_fold_next(fs));
+    } while (res == SKIPARRAY_FOLD_NEXT_OK);
+    struct skiparray *merged = NULL;
+    skiparray_builder_finish(&b, &merged);
+    TIME(post);
+
+    assert(skiparray_count(merged) == limit);
+    TDIFF();
+    skiparray_free(merged);
+    for (uint8_t i = 0; i < count; i++) { skiparray_free(inputs[i]); }
+}
+
+static bool
+filter_cb(const void *key, const void *value, void *udata) {
+    (void)value;
+    (void)udata;
+    return key_selected((uintptr_t)key, batch.selectivity);
+}
+
+/* Measure filtering, keeping -F's selectivity of the pairs. */
+static void
+filter(size_t limit) {
+    struct skiparray *sa = sequential_build(&sa_config, limit);
+
+    TIME(pre);
+    struct skiparray *res = NULL;
+    OP(res = skiparray_filter(sa, filter_cb, NULL));
+    TIME(post);
+
+    assert(res != NULL);
+    TDIFF();
+    skiparray_free(res);
+    skiparray_free(sa);
+}
+
+/* Like sum, but iterating backward from the last pair. */
+static void
+sum_reverse(size_t limit) {
+    struct skiparray *sa = sequential_build(&sa_config, limit);
+
+    TIME(pre);
+    uintptr_t total = 0;
+
+    struct skiparray_iter *iter = NULL;
+    if (SKIPARRAY_ITER_NEW_OK != skiparray_iter_new(sa, &iter)) {
+        assert(false);
+    }
+
+    skiparray_iter_seek_endpoint(iter, SKIPARRAY_ITER_SEEK_LAST);
+
+    enum skiparray_iter_step_res step;
+    do {
+        void *k, *v;
+        OP(skiparray_iter_get(iter, &k, &v);
+            step = skiparray_iter_prev(iter));
+        total += (uintptr_t)v;
+    } while (step == SKIPARRAY_ITER_STEP_OK);
 
     skiparray_iter_free(iter);
+    TIME(post);
+
+    assert(total == (limit * (limit - 1)) / 2);
+    TDIFF();
+    skiparray_free(sa);
+}
+
+/* Measure seeking one iterator to keys in random order. */
+static void
+seek_random(size_t limit) {
+    struct skiparray *sa = sequential_build(&sa_config, limit);
+    struct skiparray_iter *iter = NULL;
+    if (SKIPARRAY_ITER_NEW_OK != skiparray_iter_new(sa, &iter)) {
+        assert(false);
+    }
 
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = (i * prime) % limit;
+        OP((void)skiparray_iter_seek(iter, (void *) k));
+    }
     TIME(post);
+
     TDIFF();
+    skiparray_iter_free(iter);
+    skiparray_free(sa);
+}
+
+/* Measure seeking one iterator forward by -F's jump, as a skip scan
+ * would, starting over from the front at the end. */
+static void
+seek_forward(size_t limit) {
+    struct skiparray *sa = sequential_build(&sa_config, limit);
+    struct skiparray_iter *iter = NULL;
+    if (SKIPARRAY_ITER_NEW_OK != skiparray_iter_new(sa, &iter)) {
+        assert(false);
+    }
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = (i * batch.jump) % limit;
+        OP((void)skiparray_iter_seek(iter, (void *) k));
+    }
+    TIME(post);
+
+    TDIFF();
+    skiparray_iter_free(iter);
     skiparray_free(sa);
 }
 
@@ -623,9 +1285,427 @@ static struct benchmark benchmarks[] = {
     { "member_random_access", member_random_access },
     { "sum", sum },
     { "sum_partway", sum_partway },
+    { "sum_reverse", sum_reverse },
+    { "fold_left", fold_left },
+    { "fold_right", fold_right },
+    { "fold_multi", fold_multi },
+    { "fold_multi_build", fold_multi_build },
+    { "filter", filter },
+    { "seek_random", seek_random },
+    { "seek_forward", seek_forward },
+    { NULL, NULL },
+};
+
+/* Baseline comparisons, with -B: the same workloads, run on each
+ * selected structure through the struct baseline interface, so the
+ * skiparray pays for the same indirect calls as the others. */
+static const struct baseline *base;
+static char base_label[64];
+
+static void *
+skiparray_base_new(const struct skiparray_config *config) {
+    struct skiparray *sa = NULL;
+    if (SKIPARRAY_NEW_OK != skiparray_new(config, &sa)) { return NULL; }
+    return sa;
+}
+
+static void
+skiparray_base_free(void *b) {
+    skiparray_free(b);
+}
+
+static bool
+skiparray_base_get(void *b, const void *key, void **value) {
+    return skiparray_get(b, key, value);
+}
+
+static bool
+skiparray_base_set(void *b, void *key, void *value) {
+    return SKIPARRAY_SET_BOUND == skiparray_set(b, key, value);
+}
+
+static bool
+skiparray_base_forget(void *b, const void *key) {
+    return SKIPARRAY_FORGET_OK == skiparray_forget(b, key, NULL);
+}
+
+static void
+skiparray_base_each(void *b, skiparray_fold_fun *cb, void *udata) {
+    struct skiparray_iter *iter = NULL;
+    if (SKIPARRAY_ITER_NEW_OK != skiparray_iter_new(b, &iter)) { return; }
+    do {
+        void *k, *v;
+        skiparray_iter_get(iter, &k, &v);
+        cb(k, v, udata);
+    } while (skiparray_iter_next(iter) == SKIPARRAY_ITER_STEP_OK);
+    skiparray_iter_free(iter);
+}
+
+static const struct baseline baseline_skiparray = {
+    .name = "skiparray",
+    .new = skiparray_base_new,
+    .free = skiparray_base_free,
+    .get = skiparray_base_get,
+    .set = skiparray_base_set,
+    .forget = skiparray_base_forget,
+    .each = skiparray_base_each,
+};
+
+static const struct baseline *baselines[] = {
+    &baseline_skiparray,
+    &baseline_sorted_array,
+    &baseline_rbtree,
+    &baseline_bptree,
+    &baseline_skiplist,
+};
+#define BASELINE_COUNT (sizeof(baselines)/sizeof(baselines[0]))
+
+static void *
+base_build(size_t limit) {
+    void *b = base->new(&sa_config);
+    assert(b != NULL);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = i;
+        (void)base->set(b, (void *) k, (void *) k);
+    }
+    return b;
+}
+
+/* Random writes to a sorted array are O(n), so skip them once
+ * they would take minutes. */
+static bool
+base_skip_writes(size_t limit) {
+    if (base->write_limit == 0 || limit <= base->write_limit) {
+        return false;
+    }
+    if (trial_state != TRIAL_WARMUP && trial_rep == 0) {
+        printf("%-30s limit %9zu skipped, O(n) writes\n", base_label, limit);
+    }
+    return true;
+}
+
+static void
+base_get_sequential(size_t limit) {
+    void *b = base_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = i;
+        intptr_t v = 0;
+        OP(base->get(b, (void *) k, (void **)&v));
+        assert(v == k);
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_get_random_access(size_t limit) {
+    void *b = base_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = (i * prime) % limit;
+        intptr_t v = 0;
+        OP(base->get(b, (void *) k, (void **)&v));
+        assert(v == k);
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_get_nonexistent(size_t limit) {
+    void *b = base_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = ((i * prime) % limit) + limit;
+        intptr_t v = 0;
+        OP(base->get(b, (void *) k, (void **)&v));
+        assert(v == 0);
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_set_sequential(size_t limit) {
+    void *b = base->new(&sa_config);
+    assert(b != NULL);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = i;
+        OP((void)base->set(b, (void *) k, (void *) k));
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_set_random_access(size_t limit) {
+    if (base_skip_writes(limit)) { return; }
+    void *b = base->new(&sa_config);
+    assert(b != NULL);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = (i * prime) % limit;
+        OP((void)base->set(b, (void *) k, (void *) k));
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_set_replacing_random_access(size_t limit) {
+    void *b = base_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = (i * prime) % limit;
+        OP((void)base->set(b, (void *) k, (void *) (k + 1)));
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_forget_sequential(size_t limit) {
+    if (base_skip_writes(limit)) { return; }
+    void *b = base_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = i;
+        OP((void)base->forget(b, (void *) k));
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_forget_random_access(size_t limit) {
+    if (base_skip_writes(limit)) { return; }
+    void *b = base_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        intptr_t k = (i * prime) % limit;
+        OP((void)base->forget(b, (void *) k));
+    }
+    TIME(post);
+
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static void
+base_sum_cb(void *key, void *value, void *udata) {
+    (void)key;
+    uintptr_t *total = udata;
+    *total += (uintptr_t)value;
+}
+
+static void
+base_sum(size_t limit) {
+    void *b = base_build(limit);
+
+    TIME(pre);
+    uintptr_t total = 0;
+    OP(base->each(b, base_sum_cb, &total));
+    TIME(post);
+
+    assert(total == (limit * (limit - 1)) / 2);
+    CMP_TIME(base_label, limit, pre, post);
+    base->free(b);
+}
+
+static struct benchmark base_benchmarks[] = {
+    { "get_sequential", base_get_sequential },
+    { "get_random_access", base_get_random_access },
+    { "get_nonexistent", base_get_nonexistent },
+    { "set_sequential", base_set_sequential },
+    { "set_random_access", base_set_random_access },
+    { "set_replacing_random_access", base_set_replacing_random_access },
+    { "forget_sequential", base_forget_sequential },
+    { "forget_random_access", base_forget_random_access },
+    { "sum", base_sum },
+    { NULL, NULL },
+};
+
+/* Parse -B's list of structures into SELECTED, returning how many. */
+static size_t
+parse_base_names(char *names, const struct baseline **selected) {
+    size_t count = 0;
+    for (char *arg = strtok(names, ","); arg; arg = strtok(NULL, ",")) {
+        bool found = false;
+        for (size_t i = 0; i < BASELINE_COUNT; i++) {
+            if (0 == strcmp(arg, "all")
+                || 0 == strcmp(arg, baselines[i]->name)) {
+                if (count < BASELINE_COUNT) {
+                    selected[count++] = baselines[i];
+                }
+                found = true;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown structure: %s\n", arg);
+            usage();
+        }
+    }
+    return count;
+}
+
+/* Key benchmarks, with -K: point operations with heap-allocated
+ * string or struct keys, whose comparisons chase pointers. */
+static struct skiparray_config keys_config;
+static char keys_label[64];
+
+static struct skiparray *
+key_build(size_t limit) {
+    struct skiparray_builder *b = NULL;
+    if (SKIPARRAY_BUILDER_NEW_OK
+        != skiparray_builder_new(&keys_config, false, &b)) {
+        assert(false);
+    }
+    for (size_t i = 0; i < limit; i++) {
+        enum skiparray_builder_append_res bares =
+          skiparray_builder_append(b, keys->present[i], (void *)i);
+        (void)bares;
+    }
+    struct skiparray *sa = NULL;
+    skiparray_builder_finish(&b, &sa);
+    return sa;
+}
+
+static void
+key_get_sequential(size_t limit) {
+    struct skiparray *sa = key_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        uintptr_t v = 0;
+        OP(skiparray_get(sa, keys->present[i], (void **)&v));
+        assert(v == i);
+    }
+    TIME(post);
+
+    CMP_TIME(keys_label, limit, pre, post);
+    skiparray_free(sa);
+}
+
+static void
+key_get_random_access(size_t limit) {
+    struct skiparray *sa = key_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        const size_t k = (i * prime) % limit;
+        uintptr_t v = 0;
+        OP(skiparray_get(sa, keys->present[k], (void **)&v));
+        assert(v == k);
+    }
+    TIME(post);
+
+    CMP_TIME(keys_label, limit, pre, post);
+    skiparray_free(sa);
+}
+
+static void
+key_get_nonexistent(size_t limit) {
+    struct skiparray *sa = key_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        const size_t k = (i * prime) % limit;
+        OP((void)skiparray_get(sa, keys->absent[k], NULL));
+    }
+    TIME(post);
+
+    CMP_TIME(keys_label, limit, pre, post);
+    skiparray_free(sa);
+}
+
+static void
+key_set_random_access(size_t limit) {
+    struct skiparray *sa = NULL;
+    enum skiparray_new_res nres = skiparray_new(&keys_config, &sa);
+    assert(nres == SKIPARRAY_NEW_OK);
+    (void)nres;
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        const size_t k = (i * prime) % limit;
+        OP((void)skiparray_set(sa, keys->present[k], (void *)k));
+    }
+    TIME(post);
+
+    CMP_TIME(keys_label, limit, pre, post);
+    skiparray_free(sa);
+}
+
+static void
+key_forget_random_access(size_t limit) {
+    struct skiparray *sa = key_build(limit);
+
+    TIME(pre);
+    for (size_t i = 0; i < limit; i++) {
+        const size_t k = (i * prime) % limit;
+        OP((void)skiparray_forget(sa, keys->present[k], NULL));
+    }
+    TIME(post);
+
+    CMP_TIME(keys_label, limit, pre, post);
+    skiparray_free(sa);
+}
+
+static struct benchmark key_benchmarks[] = {
+    { "get_sequential", key_get_sequential },
+    { "get_random_access", key_get_random_access },
+    { "get_nonexistent", key_get_nonexistent },
+    { "set_random_access", key_set_random_access },
+    { "forget_random_access", key_forget_random_access },
     { NULL, NULL },
 };
 
+/* Parse -K's list of key kinds into SELECTED, returning how many. */
+static size_t
+parse_key_names(char *names, enum keys_kind *selected) {
+    size_t count = 0;
+    for (char *arg = strtok(names, ","); arg; arg = strtok(NULL, ",")) {
+        if (0 == strcmp(arg, "all")) {
+            for (size_t i = 0; i < KEYS_KIND_COUNT; i++) {
+                if (count < KEYS_KIND_COUNT) {
+                    selected[count++] = (enum keys_kind)i;
+                }
+            }
+        } else if (count < KEYS_KIND_COUNT
+            && keys_parse(arg, &selected[count])) {
+            count++;
+        } else {
+            fprintf(stderr, "Unknown key kind: %s\n", arg);
+            usage();
+        }
+    }
+    return count;
+}
+
 static void *
 memory_cb(void *p, size_t size, void *udata) {
     /* Do a word-aligned allocation, and save the size immediately
@@ -649,9 +1729,92 @@ memory_cb(void *p, size_t size, void *udata) {
     }
 }
 
+static void
+reset_run(void) {
+    memory_used = 0;
+    memory_hwm = 0;
+    hist_clear(&latency);
+    latency_pending = 0;
+}
+
+/* Run a benchmark once, or with -R, warm up, run it repeatedly,
+ * and summarize. */
+static void
+run_benchmark(benchmark_fun *fun, size_t limit, size_t c_i) {
+    cycle = c_i;
+    reset_run();
+    if (reps == 0) {
+        fun(limit);
+        return;
+    }
+
+    trial_state = TRIAL_WARMUP;
+    for (size_t i = 0; i < warmups; i++) {
+        reset_run();
+        fun(limit);
+    }
+
+    trial_state = TRIAL_TIMED;
+    trial_count = 0;
+    trial_hwm = 0;
+    memset(&trial_hwc, 0x00, sizeof(trial_hwc));
+    trial_cmps = 0;
+    reset_run();
+    for (trial_rep = 0; trial_rep < reps; trial_rep++) {
+        memory_used = 0;
+        memory_hwm = 0;
+        /* Rows are per run; the summary's percentiles cover all runs. */
+        if (report_format != REPORT_TEXT) { reset_run(); }
+        cycle = c_i * reps + trial_rep;
+        fun(limit);
+    }
+    trial_rep = 0;
+    trial_state = TRIAL_OFF;
+    if (report_format == REPORT_TEXT && trial_count > 0) {
+        print_trials(limit);
+    }
+}
+
+/* Run the key benchmarks with KIND's keys, generated once for all. */
+static void
+run_key_benchmarks(enum keys_kind kind, size_t limit, size_t c_i) {
+    keys = keys_new(kind, limit, rng_seed + c_i);
+    if (keys == NULL) {
+        fprintf(stderr, "Error: keys_new\n");
+        exit(EXIT_FAILURE);
+    }
+    keys_config = sa_config;
+    keys_config.cmp = keys_cmp(kind);
+    keys_config.udata = keys;
+
+    for (struct benchmark *b = &key_benchmarks[0]; b->name; b++) {
+        if (name != NULL && 0 != strcmp(name, b->name)) { continue; }
+        snprintf(keys_label, sizeof(keys_label), "%s/%s",
+            keys_name(kind), b->name);
+        run_benchmark(b->fun, limit, c_i);
+    }
+    keys_free(keys);
+    keys = NULL;
+}
+
+/* Compare -C's two CSV files, and exit. */
+static void
+compare(char *paths) {
+    char *base_path = strtok(paths, ",");
+    char *new_path = strtok(NULL, ",");
+    if (base_path == NULL || new_path == NULL) {
+        fprintf(stderr, "Bad comparison: -C needs <base.csv>,<new.csv>\n");
+        usage();
+    }
+    const int regressions = report_compare(base_path, new_path,
+        COMPARE_THRESHOLD);
+    exit(regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
 int
 main(int argc, char **argv) {
     handle_args(argc, argv);
+    if (compare_paths != NULL) { compare(compare_paths); }
 
     if (limit_count == 0) {
         limits[limit_count] = DEF_LIMIT;
@@ -665,22 +1828,99 @@ main(int argc, char **argv) {
     memcpy(&sa_config_no_values, &sa_config, sizeof(sa_config));
     sa_config_no_values.ignore_values = true;
 
+    struct skiparray_pool *pool = NULL;
+    struct skiparray_pool *pool_no_values = NULL;
+    if (use_pool) {
+        struct skiparray_pool_config pool_config = {
+            .node_size = sa_config.node_size,
+            .memory = sa_config.memory,
+        };
+        if (SKIPARRAY_POOL_NEW_OK != skiparray_pool_new(&pool_config, &pool)) {
+            fprintf(stderr, "Error: skiparray_pool_new\n");
+            exit(EXIT_FAILURE);
+        }
+        pool_config.ignore_values = true;
+        if (SKIPARRAY_POOL_NEW_OK != skiparray_pool_new(&pool_config,
+                &pool_no_values)) {
+            fprintf(stderr, "Error: skiparray_pool_new\n");
+            exit(EXIT_FAILURE);
+        }
+        sa_config.pool = pool;
+        sa_config_no_values.pool = pool_no_values;
+    }
+
+    const struct baseline *selected[BASELINE_COUNT];
+    size_t selected_count = 0;
+    if (base_names != NULL) {
+        selected_count = parse_base_names(base_names, selected);
+    }
+    enum keys_kind key_kinds[KEYS_KIND_COUNT];
+    size_t key_kind_count = 0;
+    if (key_names != NULL) {
+        key_kind_count = parse_key_names(key_names, key_kinds);
+    }
+
+    if (pin_cpu >= 0 && !sys_pin_cpu(pin_cpu)) {
+        fprintf(stderr, "Error: can't pin to CPU %d\n", pin_cpu);
+        exit(EXIT_FAILURE);
+    }
+
     if (name != NULL && 0 == strcmp(name, "help")) {
-        for (struct benchmark *b = &benchmarks[0]; b->name; b++) {
+        for (struct benchmark *b = (selected_count > 0 ? &base_benchmarks[0]
+                 : key_kind_count > 0 ? &key_benchmarks[0]
+                 : &benchmarks[0]); b->name; b++) {
             printf("  -- %s\n", b->name);
         }
         exit(EXIT_SUCCESS);
     }
 
+    if (use_hwc) { (void)hwc_open(); }
+
+    uint64_t spin_pre = 0;
+    if (reps > 0) {
+        (void)sys_check_frequency_scaling();
+        (void)sys_spin_ns();    /* let the clock settle first */
+        spin_pre = sys_spin_ns();
+    }
+
     TIME(pre);
 
     for (size_t l_i = 0; l_i < limit_count; l_i++) {
         for (size_t c_i = 0; c_i < cycles; c_i++) {
+            cycle = c_i;
+            if (mt.threads > 0) {
+                mt_run(&mt, &sa_config, limits[l_i], rng_seed + c_i);
+                continue;
+            } else if (use_sweep) {
+                sweep_run(&sweep, &ycsb, &sa_config, limits[l_i],
+                    limits[l_i], rng_seed + c_i);
+                continue;
+            } else if (use_ycsb) {
+                ycsb_run(&ycsb, &sa_config, limits[l_i], limits[l_i],
+                    rng_seed + c_i);
+                continue;
+            } else if (selected_count > 0) {
+                for (struct benchmark *b = &base_benchmarks[0]; b->name; b++) {
+                    if (name != NULL && 0 != strcmp(name, b->name)) {
+                        continue;
+                    }
+                    for (size_t s_i = 0; s_i < selected_count; s_i++) {
+                        base = selected[s_i];
+                        snprintf(base_label, sizeof(base_label), "%s/%s",
+                            base->name, b->name);
+                        run_benchmark(b->fun, limits[l_i], c_i);
+                    }
+                }
+                continue;
+            } else if (key_kind_count > 0) {
+                for (size_t k_i = 0; k_i < key_kind_count; k_i++) {
+                    run_key_benchmarks(key_kinds[k_i], limits[l_i], c_i);
+                }
+                continue;
+            }
             for (struct benchmark *b = &benchmarks[0]; b->name; b++) {
-                memory_used = 0;
-                memory_hwm = 0;
                 if (name == NULL || 0 == strcmp(name, b->name)) {
-                    b->fun(limits[l_i]);
+                    run_benchmark(b->fun, limits[l_i], c_i);
                 }
             }
         }
@@ -688,7 +1928,24 @@ main(int argc, char **argv) {
 
     TIME(post);
 
-    double usec_total = (double)get_usec_delta(&timer_pre, &timer_post);
-    printf("----\n%-30s %.3f sec\n", "total", usec_total / usec_per_sec);
+    if (reps > 0) {
+        /* If the same work now takes a different time, the clock
+         * speed changed during the run (thermal throttling, etc.). */
+        const uint64_t spin_post = sys_spin_ns();
+        const double drift = ((double)spin_post - spin_pre) / spin_pre;
+        if (drift > 0.05 || drift < -0.05) {
+            fprintf(stderr, "Warning: CPU speed changed during the run "
+                "(time for fixed work changed %+.1f%%)\n", 100 * drift);
+        }
+    }
+
+    if (report_format == REPORT_TEXT) {
+        double usec_total = (double)get_usec_delta(&timer_pre, &timer_post);
+        printf("----\n%-30s %.3f sec\n", "total", usec_total / usec_per_sec);
+    }
+
+    hwc_close();
+    skiparray_pool_free(pool);
+    skiparray_pool_free(pool_no_values);
     return 0;
 }
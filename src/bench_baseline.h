@@ -0,0 +1,55 @@
+#ifndef BENCH_BASELINE_H
+#define BENCH_BASELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "skiparray.h"
+
+/* Baseline ordered maps, for comparing skiparrays against the usual
+ * alternatives on the same benchmarks. They are kept simple and
+ * dependency-free, but take the same configuration as a skiparray:
+ * the same cmp callback (and udata), and memory callback (so -m
+ * measures them too), with node_size used for node-based layouts. */
+struct baseline {
+    const char *name;
+    /* If nonzero, writes cost O(n), so skip random set and forget
+     * benchmarks with more than this many pairs. */
+    size_t write_limit;
+
+    void *(*new)(const struct skiparray_config *config);
+    void (*free)(void *b);
+    bool (*get)(void *b, const void *key, void **value);
+    /* Returns true if KEY was new, false if its value was replaced. */
+    bool (*set)(void *b, void *key, void *value);
+    /* Returns whether KEY was found. */
+    bool (*forget)(void *b, const void *key);
+    /* Call CB on each pair, in ascending key order. */
+    void (*each)(void *b, skiparray_fold_fun *cb, void *udata);
+};
+
+extern const struct baseline baseline_sorted_array;
+extern const struct baseline baseline_rbtree;
+extern const struct baseline baseline_bptree;
+extern const struct baseline baseline_skiplist;
+
+/* Allocate and free with CONFIG's memory callback, or malloc and
+ * free if it has none. Frees pass a size of 0, so no realloc. */
+static inline void *
+baseline_alloc(const struct skiparray_config *config, size_t size) {
+    return (config->memory != NULL
+        ? config->memory(NULL, size, config->udata) : malloc(size));
+}
+
+static inline void
+baseline_free(const struct skiparray_config *config, void *p) {
+    if (config->memory != NULL) {
+        (void)config->memory(p, 0, config->udata);
+    } else {
+        free(p);
+    }
+}
+
+#endif
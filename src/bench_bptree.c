@@ -0,0 +1,292 @@
+#include "bench_baseline.h"
+
+#include <string.h>
+
+/* A simple in-memory B+-tree: pairs live in linked leaves of up to
+ * node_size pairs, under internal nodes of up to node_size children.
+ * Nodes split when full, but to keep it simple, deletions don't merge
+ * or rebalance underfull nodes -- they are only freed once empty. */
+
+struct bp_node {
+    bool leaf;
+    uint16_t count;             /* pairs, or children */
+    struct bp_node *prev;       /* leaves only */
+    struct bp_node *next;
+    /* Leaves: COUNT keys and values. Internal nodes: COUNT children,
+     * and COUNT - 1 keys, where keys[I] is the lowest key under
+     * children[I + 1]. Both have room for one extra, before a split. */
+    void **keys;
+    union {
+        void **values;
+        struct bp_node **children;
+    } u;
+};
+
+struct bptree {
+    struct skiparray_config config;
+    uint16_t node_size;
+    struct bp_node *root;
+};
+
+/* What a node split into, to add to its parent. */
+struct split {
+    void *key;
+    struct bp_node *right;
+};
+
+static struct bp_node *
+node_new(struct bptree *t, bool leaf) {
+    const size_t slots = t->node_size + 1;
+    struct bp_node *n = baseline_alloc(&t->config,
+        sizeof(*n) + 2 * slots * sizeof(void *));
+    if (n == NULL) { abort(); }
+    memset(n, 0x00, sizeof(*n));
+    n->leaf = leaf;
+    n->keys = (void **)&n[1];
+    n->u.values = &n->keys[slots];
+    return n;
+}
+
+static void *
+bp_new(const struct skiparray_config *config) {
+    struct bptree *t = baseline_alloc(config, sizeof(*t));
+    if (t == NULL) { return NULL; }
+    t->config = *config;
+    t->node_size = (config->node_size == 0
+        ? SKIPARRAY_DEF_NODE_SIZE : config->node_size);
+    if (t->node_size < 4) { t->node_size = 4; }
+    t->root = node_new(t, true);
+    return t;
+}
+
+static void
+free_node(struct bptree *t, struct bp_node *n) {
+    if (!n->leaf) {
+        for (uint16_t i = 0; i < n->count; i++) {
+            free_node(t, n->u.children[i]);
+        }
+    }
+    baseline_free(&t->config, n);
+}
+
+static void
+bp_free(void *b) {
+    struct bptree *t = b;
+    free_node(t, t->root);
+    baseline_free(&t->config, t);
+}
+
+/* The index of the first key in a leaf >= KEY; sets *FOUND if equal. */
+static uint16_t
+leaf_index(const struct bptree *t, const struct bp_node *n,
+    const void *key, bool *found) {
+    uint16_t lo = 0;
+    uint16_t hi = n->count;
+    while (lo < hi) {
+        const uint16_t mid = lo + (hi - lo)/2;
+        if (t->config.cmp(n->keys[mid], key, t->config.udata) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = (lo < n->count
+        && 0 == t->config.cmp(n->keys[lo], key, t->config.udata));
+    return lo;
+}
+
+/* The index of the child of internal node N that KEY belongs under. */
+static uint16_t
+child_index(const struct bptree *t, const struct bp_node *n,
+    const void *key) {
+    uint16_t lo = 0;
+    uint16_t hi = n->count - 1;
+    while (lo < hi) {
+        const uint16_t mid = lo + (hi - lo)/2;
+        if (t->config.cmp(n->keys[mid], key, t->config.udata) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static struct bp_node *
+find_leaf(const struct bptree *t, const void *key) {
+    struct bp_node *n = t->root;
+    while (!n->leaf) { n = n->u.children[child_index(t, n, key)]; }
+    return n;
+}
+
+static bool
+bp_get(void *b, const void *key, void **value) {
+    const struct bptree *t = b;
+    const struct bp_node *n = find_leaf(t, key);
+    bool found = false;
+    const uint16_t i = leaf_index(t, n, key, &found);
+    if (found && value != NULL) { *value = n->u.values[i]; }
+    return found;
+}
+
+static bool
+split_leaf(struct bptree *t, struct bp_node *n, struct split *s) {
+    struct bp_node *right = node_new(t, true);
+    const uint16_t m = n->count / 2;
+    right->count = n->count - m;
+    memcpy(right->keys, &n->keys[m], right->count * sizeof(void *));
+    memcpy(right->u.values, &n->u.values[m], right->count * sizeof(void *));
+    n->count = m;
+
+    right->next = n->next;
+    if (n->next != NULL) { n->next->prev = right; }
+    right->prev = n;
+    n->next = right;
+
+    s->key = right->keys[0];
+    s->right = right;
+    return true;
+}
+
+static bool
+split_internal(struct bptree *t, struct bp_node *n, struct split *s) {
+    struct bp_node *right = node_new(t, false);
+    const uint16_t m = n->count / 2; /* children staying in N */
+    right->count = n->count - m;
+    memcpy(right->keys, &n->keys[m], (right->count - 1) * sizeof(void *));
+    memcpy(right->u.children, &n->u.children[m],
+        right->count * sizeof(void *));
+    s->key = n->keys[m - 1];
+    s->right = right;
+    n->count = m;
+    return true;
+}
+
+/* Insert into the subtree at N, setting *ADDED if KEY was new.
+ * Returns whether N split, with the new node and its key in *S. */
+static bool
+insert(struct bptree *t, struct bp_node *n, void *key, void *value,
+    bool *added, struct split *s) {
+    if (n->leaf) {
+        bool found = false;
+        const uint16_t i = leaf_index(t, n, key, &found);
+        if (found) {
+            n->u.values[i] = value;
+            return false;
+        }
+        const size_t after = n->count - i;
+        memmove(&n->keys[i + 1], &n->keys[i], after * sizeof(void *));
+        memmove(&n->u.values[i + 1], &n->u.values[i],
+            after * sizeof(void *));
+        n->keys[i] = key;
+        n->u.values[i] = value;
+        n->count++;
+        *added = true;
+        return n->count > t->node_size && split_leaf(t, n, s);
+    }
+
+    const uint16_t i = child_index(t, n, key);
+    if (!insert(t, n->u.children[i], key, value, added, s)) {
+        return false;
+    }
+    const size_t keys_after = n->count - 1 - i;
+    memmove(&n->keys[i + 1], &n->keys[i], keys_after * sizeof(void *));
+    memmove(&n->u.children[i + 2], &n->u.children[i + 1],
+        keys_after * sizeof(void *));
+    n->keys[i] = s->key;
+    n->u.children[i + 1] = s->right;
+    n->count++;
+    return n->count > t->node_size && split_internal(t, n, s);
+}
+
+static bool
+bp_set(void *b, void *key, void *value) {
+    struct bptree *t = b;
+    bool added = false;
+    struct split s;
+    if (insert(t, t->root, key, value, &added, &s)) {
+        struct bp_node *root = node_new(t, false);
+        root->count = 2;
+        root->keys[0] = s.key;
+        root->u.children[0] = t->root;
+        root->u.children[1] = s.right;
+        t->root = root;
+    }
+    return added;
+}
+
+/* Delete from the subtree at N, setting *FOUND if KEY was there.
+ * Returns whether N is now empty. */
+static bool
+delete(struct bptree *t, struct bp_node *n, const void *key, bool *found) {
+    if (n->leaf) {
+        const uint16_t i = leaf_index(t, n, key, found);
+        if (!*found) { return false; }
+        const size_t after = n->count - i - 1;
+        memmove(&n->keys[i], &n->keys[i + 1], after * sizeof(void *));
+        memmove(&n->u.values[i], &n->u.values[i + 1],
+            after * sizeof(void *));
+        n->count--;
+        return n->count == 0;
+    }
+
+    const uint16_t i = child_index(t, n, key);
+    struct bp_node *child = n->u.children[i];
+    if (!delete(t, child, key, found)) { return false; }
+
+    if (child->leaf) {
+        if (child->prev != NULL) { child->prev->next = child->next; }
+        if (child->next != NULL) { child->next->prev = child->prev; }
+    }
+    baseline_free(&t->config, child);
+
+    /* Drop the child and the key bounding it on the left, or for
+     * the first child, the key on its right. */
+    const uint16_t k = (i > 0 ? i - 1 : 0);
+    if (n->count > 1) {
+        memmove(&n->keys[k], &n->keys[k + 1],
+            (n->count - 2 - k) * sizeof(void *));
+    }
+    memmove(&n->u.children[i], &n->u.children[i + 1],
+        (n->count - 1 - i) * sizeof(void *));
+    n->count--;
+    return n->count == 0;
+}
+
+static bool
+bp_forget(void *b, const void *key) {
+    struct bptree *t = b;
+    bool found = false;
+    if (delete(t, t->root, key, &found) && !t->root->leaf) {
+        baseline_free(&t->config, t->root);
+        t->root = node_new(t, true);
+    }
+    while (!t->root->leaf && t->root->count == 1) {
+        struct bp_node *child = t->root->u.children[0];
+        baseline_free(&t->config, t->root);
+        t->root = child;
+    }
+    return found;
+}
+
+static void
+bp_each(void *b, skiparray_fold_fun *cb, void *udata) {
+    struct bptree *t = b;
+    struct bp_node *n = t->root;
+    while (!n->leaf) { n = n->u.children[0]; }
+    for (; n != NULL; n = n->next) {
+        for (uint16_t i = 0; i < n->count; i++) {
+            cb(n->keys[i], n->u.values[i], udata);
+        }
+    }
+}
+
+const struct baseline baseline_bptree = {
+    .name = "bptree",
+    .new = bp_new,
+    .free = bp_free,
+    .get = bp_get,
+    .set = bp_set,
+    .forget = bp_forget,
+    .each = bp_each,
+};
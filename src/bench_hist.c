@@ -0,0 +1,80 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench_hist.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void
+hist_clear(struct hist *h) {
+    memset(h, 0x00, sizeof(*h));
+}
+
+void
+hist_merge(struct hist *dst, const struct hist *src) {
+    if (src->count == 0) { return; }
+    if (dst->count == 0 || src->min < dst->min) { dst->min = src->min; }
+    if (src->max > dst->max) { dst->max = src->max; }
+    dst->count += src->count;
+    dst->total += src->total;
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+}
+
+static uint64_t
+bucket_highest(size_t bucket) {
+    if (bucket < HIST_SUB_COUNT) { return bucket; }
+    const unsigned shift = (unsigned)(bucket >> HIST_SUB_BITS) - 1;
+    const uint64_t lowest = (uint64_t)((bucket & (HIST_SUB_COUNT - 1))
+        + HIST_SUB_COUNT) << shift;
+    return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+uint64_t
+hist_percentile(const struct hist *h, double p) {
+    if (h->count == 0) { return 0; }
+    uint64_t rank = (uint64_t)(p * h->count + 0.5);
+    if (rank < 1) { rank = 1; }
+    if (rank > h->count) { rank = h->count; }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            const uint64_t v = bucket_highest(i);
+            return (v > h->max ? h->max : v < h->min ? h->min : v);
+        }
+    }
+    return h->max;
+}
+
+double
+hist_mean(const struct hist *h) {
+    return (h->count == 0 ? 0 : h->total / (double)h->count);
+}
+
+void
+hist_print(const char *label, const struct hist *h) {
+    static const struct {
+        const char *label;
+        double p;
+    } percentiles[] = {
+        { "p50", 0.50 }, { "p90", 0.90 }, { "p99", 0.99 },
+        { "p99.9", 0.999 }, { "p99.99", 0.9999 },
+    };
+    printf("%-30s ns/op: min %llu", label, (unsigned long long)h->min);
+    for (size_t i = 0; i < sizeof(percentiles)/sizeof(percentiles[0]); i++) {
+        printf(", %s %llu", percentiles[i].label,
+            (unsigned long long)hist_percentile(h, percentiles[i].p));
+    }
+    printf(", max %llu\n", (unsigned long long)h->max);
+}
+
+uint64_t
+hist_now_ns(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) { return 0; }
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,81 @@
+#ifndef BENCH_HIST_H
+#define BENCH_HIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A log-linear latency histogram, in the style of HdrHistogram: values
+ * below 2^HIST_SUB_BITS are counted exactly, and larger ones in
+ * 2^HIST_SUB_BITS buckets per power of two, so each bucket's values
+ * are within about 3% of each other. Values of 2^HIST_MAX_BITS and up
+ * (over 18 minutes, in nanoseconds) share the last bucket. */
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1U << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+struct hist {
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint64_t counts[HIST_BUCKETS];
+};
+
+static inline size_t
+hist_bucket(uint64_t value) {
+    if (value < HIST_SUB_COUNT) { return (size_t)value; }
+    if (value >> HIST_MAX_BITS) { return HIST_BUCKETS - 1; }
+#ifdef __GNUC__
+    const unsigned msb = 63 - __builtin_clzll(value);
+#else
+    unsigned msb = HIST_SUB_BITS;
+    while (value >> (msb + 1)) { msb++; }
+#endif
+    const unsigned shift = msb - HIST_SUB_BITS;
+    return ((size_t)(shift + 1) << HIST_SUB_BITS)
+        + (size_t)((value >> shift) - HIST_SUB_COUNT);
+}
+
+/* Record COUNT occurrences of VALUE. */
+static inline void
+hist_record_n(struct hist *h, uint64_t value, uint64_t count) {
+    if (h->count == 0 || value < h->min) { h->min = value; }
+    if (value > h->max) { h->max = value; }
+    h->count += count;
+    h->total += value * count;
+    h->counts[hist_bucket(value)] += count;
+}
+
+static inline void
+hist_record(struct hist *h, uint64_t value) {
+    hist_record_n(h, value, 1);
+}
+
+void
+hist_clear(struct hist *h);
+
+/* Add SRC's values into DST. */
+void
+hist_merge(struct hist *dst, const struct hist *src);
+
+/* The value at or below which fraction P (0 to 1) of the recorded
+ * values fall, as the highest value in its bucket (but at most the
+ * maximum recorded). Returns 0 if the histogram is empty. */
+uint64_t
+hist_percentile(const struct hist *h, double p);
+
+double
+hist_mean(const struct hist *h);
+
+/* Print LABEL (padded like benchmark names), then H's minimum, p50,
+ * p90, p99, p99.9, p99.99, and maximum, on one line. */
+void
+hist_print(const char *label, const struct hist *h);
+
+/* Nanoseconds on the monotonic clock. */
+uint64_t
+hist_now_ns(void);
+
+#endif
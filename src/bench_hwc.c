@@ -0,0 +1,161 @@
+#define _GNU_SOURCE             /* for syscall */
+
+#include "bench_hwc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char *names[HWC_EVENT_COUNT] = {
+    [HWC_CYCLES] = "cycles",
+    [HWC_INSTRUCTIONS] = "instructions",
+    [HWC_LLC_MISSES] = "llc_misses",
+    [HWC_DTLB_MISSES] = "dtlb_misses",
+    [HWC_BRANCH_MISSES] = "branch_misses",
+};
+
+const char *
+hwc_name(enum hwc_event event) {
+    return names[event];
+}
+
+#ifdef __linux__
+
+/* The events are opened as one group, so they are scheduled onto the
+ * PMU together and read with one read(2). */
+static int leader = -1;
+static int fds[HWC_EVENT_COUNT] = { -1, -1, -1, -1, -1 };
+static size_t group_index[HWC_EVENT_COUNT]; /* position in group reads */
+static size_t group_size;
+
+#define CACHE_READ_MISS(CACHE)                                          \
+    ((CACHE) | (PERF_COUNT_HW_CACHE_OP_READ << 8)                       \
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static int
+open_event(enum hwc_event event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0x00, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (event) {
+    case HWC_CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case HWC_INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case HWC_LLC_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case HWC_DTLB_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+    case HWC_BRANCH_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    default:
+        return -1;
+    }
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP
+        | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = (leader == -1);   /* the group starts together */
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+size_t
+hwc_open(void) {
+    int err = 0;
+    for (size_t i = 0; i < HWC_EVENT_COUNT; i++) {
+        const int fd = open_event((enum hwc_event)i);
+        if (fd == -1) {
+            err = errno;
+            continue;
+        }
+        if (leader == -1) { leader = fd; }
+        fds[i] = fd;
+        group_index[i] = group_size++;
+    }
+    if (err != 0) {
+        fprintf(stderr, "Warning: %s hardware counters are unavailable "
+            "(perf_event_open: %s)\n", group_size == 0 ? "the" : "some",
+            strerror(err));
+    }
+    if (leader != -1) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    return group_size;
+}
+
+bool
+hwc_available(enum hwc_event event) {
+    return fds[event] != -1;
+}
+
+void
+hwc_read(struct hwc_sample *s) {
+    memset(s, 0x00, sizeof(*s));
+    if (leader == -1) { return; }
+
+    /* nr, time_enabled, time_running, then the values */
+    uint64_t buf[3 + HWC_EVENT_COUNT];
+    const ssize_t size = (ssize_t)((3 + group_size) * sizeof(buf[0]));
+    if (read(leader, buf, sizeof(buf)) < size) { return; }
+
+    /* If the PMU was shared out, scale the counts up to estimate
+     * what they would have been, as perf-stat does. */
+    const double scale = (buf[2] == 0 ? 0 : (double)buf[1] / buf[2]);
+    for (size_t i = 0; i < HWC_EVENT_COUNT; i++) {
+        if (fds[i] == -1) { continue; }
+        s->counts[i] = (uint64_t)(buf[3 + group_index[i]] * scale);
+    }
+}
+
+void
+hwc_close(void) {
+    for (size_t i = 0; i < HWC_EVENT_COUNT; i++) {
+        if (fds[i] != -1) { close(fds[i]); }
+        fds[i] = -1;
+    }
+    leader = -1;
+    group_size = 0;
+}
+
+#else
+
+size_t
+hwc_open(void) {
+    fprintf(stderr, "Warning: hardware counters need Linux\n");
+    return 0;
+}
+
+bool
+hwc_available(enum hwc_event event) {
+    (void)event;
+    return false;
+}
+
+void
+hwc_read(struct hwc_sample *s) {
+    memset(s, 0x00, sizeof(*s));
+}
+
+void
+hwc_close(void) {
+}
+
+#endif
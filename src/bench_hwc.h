@@ -0,0 +1,44 @@
+#ifndef BENCH_HWC_H
+#define BENCH_HWC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Hardware performance counters, via Linux's perf_event_open, counting
+ * this process in user space. Elsewhere, none are available. */
+
+enum hwc_event {
+    HWC_CYCLES,
+    HWC_INSTRUCTIONS,
+    HWC_LLC_MISSES,
+    HWC_DTLB_MISSES,
+    HWC_BRANCH_MISSES,
+    HWC_EVENT_COUNT,
+};
+
+struct hwc_sample {
+    uint64_t counts[HWC_EVENT_COUNT];
+};
+
+/* Open and start the counters. Returns how many are available; if
+ * some aren't (unsupported, or not permitted), a reason is printed. */
+size_t
+hwc_open(void);
+
+bool
+hwc_available(enum hwc_event event);
+
+/* A short name for EVENT, e.g. "cycles". */
+const char *
+hwc_name(enum hwc_event event);
+
+/* Read the counters' current totals into S (0 for unavailable ones).
+ * Only differences between samples are meaningful. */
+void
+hwc_read(struct hwc_sample *s);
+
+void
+hwc_close(void);
+
+#endif
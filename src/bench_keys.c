@@ -0,0 +1,210 @@
+#include "bench_keys.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_HEAD 16             /* random characters before the tail */
+#define TAIL 13                 /* base-36 digits of a 64-bit hash */
+#define PREFIX_COUNT 8
+
+/* Long, like paths or qualified names, so comparisons between keys
+ * with the same prefix scan it every time. */
+static const char *prefixes[PREFIX_COUNT] = {
+    "/srv/accounts/us-east-1/tenant-data/users/",
+    "/srv/accounts/us-east-1/tenant-data/orders/",
+    "/srv/accounts/us-west-2/tenant-data/users/",
+    "/srv/accounts/us-west-2/tenant-data/orders/",
+    "/srv/accounts/eu-central-1/tenant-data/users/",
+    "/srv/accounts/eu-central-1/tenant-data/orders/",
+    "/srv/accounts/ap-south-1/tenant-data/users/",
+    "/srv/accounts/ap-south-1/tenant-data/orders/",
+};
+
+/* A composite key, like (tenant, shard, timestamp, id). */
+struct composite {
+    uint32_t tenant;
+    uint32_t shard;
+    uint64_t time;
+    uint64_t id;
+    uint64_t seq;
+};
+
+static const char *names[KEYS_KIND_COUNT] = {
+    [KEYS_STRING] = "string",
+    [KEYS_PREFIX] = "prefix",
+    [KEYS_STRUCT] = "struct",
+};
+
+bool
+keys_parse(const char *name, enum keys_kind *kind) {
+    for (size_t i = 0; i < KEYS_KIND_COUNT; i++) {
+        if (0 == strcmp(name, names[i])) {
+            *kind = (enum keys_kind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *
+keys_name(enum keys_kind kind) {
+    return names[kind];
+}
+
+static uint64_t
+next_u64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* A bijection on 64-bit ints (murmur3's finalizer), so distinct key
+ * numbers give distinct keys. */
+static uint64_t
+key_hash(uint64_t n) {
+    n ^= n >> 33;
+    n *= 0xff51afd7ed558ccdULL;
+    n ^= n >> 33;
+    n *= 0xc4ceb9fe1a85ec53ULL;
+    n ^= n >> 33;
+    return n;
+}
+
+/* A string of random characters, then key N's hash as exactly TAIL
+ * base-36 digits, so strings for different N differ. */
+static char *
+new_string(const char *prefix, size_t head, uint64_t n, uint64_t *rng) {
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    const size_t plen = strlen(prefix);
+    char *s = malloc(plen + head + TAIL + 1);
+    if (s == NULL) { return NULL; }
+    memcpy(s, prefix, plen);
+    for (size_t i = 0; i < head; i++) {
+        s[plen + i] = digits[next_u64(rng) % 36];
+    }
+    uint64_t h = key_hash(n);
+    for (size_t i = 0; i < TAIL; i++) {
+        s[plen + head + TAIL - 1 - i] = digits[h % 36];
+        h /= 36;
+    }
+    s[plen + head + TAIL] = '\0';
+    return s;
+}
+
+static struct composite *
+new_composite(uint64_t n, uint64_t *rng) {
+    struct composite *c = malloc(sizeof(*c));
+    if (c == NULL) { return NULL; }
+    const uint64_t r = next_u64(rng);
+    c->tenant = (uint32_t)(r & 0x0f);
+    c->shard = (uint32_t)((r >> 4) & 0x3f);
+    c->time = next_u64(rng) >> 24;
+    c->id = key_hash(n);
+    c->seq = n & 0x07;
+    return c;
+}
+
+static void *
+new_key(enum keys_kind kind, uint64_t n, uint64_t *rng) {
+    switch (kind) {
+    case KEYS_STRING:
+        return new_string("", next_u64(rng) % (MAX_HEAD + 1), n, rng);
+    case KEYS_PREFIX:
+        return new_string(prefixes[next_u64(rng) % PREFIX_COUNT], 0, n, rng);
+    case KEYS_STRUCT:
+        return new_composite(n, rng);
+    default:
+        return NULL;
+    }
+}
+
+static int
+cmp_string(const void *ka, const void *kb) {
+    return strcmp(ka, kb);
+}
+
+#define CMP_FIELD(A, B, F)                                              \
+    if ((A)->F != (B)->F) { return (A)->F < (B)->F ? -1 : 1; }
+
+static int
+cmp_composite(const void *ka, const void *kb) {
+    const struct composite *a = ka;
+    const struct composite *b = kb;
+    CMP_FIELD(a, b, tenant);
+    CMP_FIELD(a, b, shard);
+    CMP_FIELD(a, b, time);
+    CMP_FIELD(a, b, id);
+    CMP_FIELD(a, b, seq);
+    return 0;
+}
+
+static int
+count_string(const void *ka, const void *kb, void *udata) {
+    ((struct keys *)udata)->cmp_calls++;
+    return cmp_string(ka, kb);
+}
+
+static int
+count_composite(const void *ka, const void *kb, void *udata) {
+    ((struct keys *)udata)->cmp_calls++;
+    return cmp_composite(ka, kb);
+}
+
+skiparray_cmp_fun *
+keys_cmp(enum keys_kind kind) {
+    return kind == KEYS_STRUCT ? count_composite : count_string;
+}
+
+static int
+sort_string(const void *pa, const void *pb) {
+    return cmp_string(*(void * const *)pa, *(void * const *)pb);
+}
+
+static int
+sort_composite(const void *pa, const void *pb) {
+    return cmp_composite(*(void * const *)pa, *(void * const *)pb);
+}
+
+struct keys *
+keys_new(enum keys_kind kind, size_t count, uint64_t seed) {
+    struct keys *keys = calloc(1, sizeof(*keys));
+    if (keys == NULL) { return NULL; }
+    keys->kind = kind;
+    keys->present = calloc(count, sizeof(void *));
+    keys->absent = calloc(count, sizeof(void *));
+    if (keys->present == NULL || keys->absent == NULL) {
+        keys_free(keys);
+        return NULL;
+    }
+
+    /* Key numbers 0 to COUNT - 1 are present, and the next COUNT are
+     * absent. Each key is its own allocation, made in random key
+     * order, so neighbors in the skiparray aren't neighbors in memory. */
+    uint64_t rng = seed;
+    for (size_t i = 0; i < count; i++) {
+        keys->present[i] = new_key(kind, i, &rng);
+        keys->absent[i] = new_key(kind, count + i, &rng);
+        keys->count = i + 1;
+        if (keys->present[i] == NULL || keys->absent[i] == NULL) {
+            keys_free(keys);
+            return NULL;
+        }
+    }
+    qsort(keys->present, count, sizeof(void *),
+        kind == KEYS_STRUCT ? sort_composite : sort_string);
+    return keys;
+}
+
+void
+keys_free(struct keys *keys) {
+    if (keys == NULL) { return; }
+    for (size_t i = 0; i < keys->count; i++) {
+        free(keys->present[i]);
+        free(keys->absent[i]);
+    }
+    free(keys->present);
+    free(keys->absent);
+    free(keys);
+}
@@ -0,0 +1,48 @@
+#ifndef BENCH_KEYS_H
+#define BENCH_KEYS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "skiparray.h"
+
+/* Keys that are costlier to compare than integers, as in production:
+ * each is heap-allocated, and its cmp callback dereferences both. */
+
+enum keys_kind {
+    KEYS_STRING,                /* random strings, 13 to 29 bytes */
+    KEYS_PREFIX,                /* strings sharing a few long prefixes */
+    KEYS_STRUCT,                /* 32-byte structs, compared by field */
+    KEYS_KIND_COUNT,
+};
+
+struct keys {
+    enum keys_kind kind;
+    size_t count;
+    void **present;             /* COUNT distinct keys, ascending */
+    void **absent;              /* COUNT more, distinct from them */
+    uint64_t cmp_calls;         /* by cmp, below */
+};
+
+/* Parse "string", "prefix", or "struct". */
+bool
+keys_parse(const char *name, enum keys_kind *kind);
+
+const char *
+keys_name(enum keys_kind kind);
+
+/* Allocate COUNT keys of KIND, and as many absent ones, from SEED.
+ * Returns NULL on allocation failure. */
+struct keys *
+keys_new(enum keys_kind kind, size_t count, uint64_t seed);
+
+void
+keys_free(struct keys *keys);
+
+/* A cmp callback for KIND's keys, which counts its calls in the
+ * struct keys passed as udata. */
+skiparray_cmp_fun *
+keys_cmp(enum keys_kind kind);
+
+#endif
@@ -0,0 +1,292 @@
+#define _GNU_SOURCE             /* for pthread_setaffinity_np */
+
+#include "bench_mt.h"
+#include "bench_hist.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#define DEF_READ_PCT 90
+
+/* What the threads operate on: the shared skiparray, or one of
+ * the private ones, and a lock if the mode needs one. */
+struct mt_target {
+    struct skiparray *sa;
+    pthread_mutex_t lock;
+};
+
+/* A way of accessing the skiparray(s). New synchronization modes only
+ * need a new entry in modes[]. */
+struct mt_mode {
+    const char *name;
+    bool shared;                /* one skiparray for all threads */
+    bool (*get)(struct mt_target *t, const void *key, void **value);
+    void (*set)(struct mt_target *t, void *key, void *value);
+};
+
+static bool
+mutex_get(struct mt_target *t, const void *key, void **value) {
+    pthread_mutex_lock(&t->lock);
+    const bool res = skiparray_get(t->sa, key, value);
+    pthread_mutex_unlock(&t->lock);
+    return res;
+}
+
+static void
+mutex_set(struct mt_target *t, void *key, void *value) {
+    pthread_mutex_lock(&t->lock);
+    (void)skiparray_set(t->sa, key, value);
+    pthread_mutex_unlock(&t->lock);
+}
+
+static bool
+private_get(struct mt_target *t, const void *key, void **value) {
+    return skiparray_get(t->sa, key, value);
+}
+
+static void
+private_set(struct mt_target *t, void *key, void *value) {
+    (void)skiparray_set(t->sa, key, value);
+}
+
+static const struct mt_mode modes[] = {
+    { "mutex", true, mutex_get, mutex_set },
+    { "private", false, private_get, private_set },
+};
+#define MODE_COUNT (sizeof(modes)/sizeof(modes[0]))
+
+bool
+mt_parse(const char *spec, struct mt_workload *w) {
+    struct mt_workload res = {
+        .mode = NULL,
+        .threads = w->threads,
+        .read_pct = DEF_READ_PCT,
+        .pin = true,
+    };
+    char buf[128];
+    if (strlen(spec) >= sizeof(buf)) { return false; }
+    strcpy(buf, spec);
+
+    char *tok = strtok(buf, ",");
+    if (tok == NULL) { return false; }
+    for (size_t i = 0; i < MODE_COUNT; i++) {
+        if (0 == strcmp(tok, modes[i].name)) { res.mode = &modes[i]; }
+    }
+    if (res.mode == NULL) { return false; }
+
+    while ((tok = strtok(NULL, ",")) != NULL) {
+        if (0 == strncmp(tok, "read=", 5)) {
+            char *end = NULL;
+            const unsigned long pct = strtoul(tok + 5, &end, 10);
+            if (end == tok + 5 || *end != '\0' || pct > 100) { return false; }
+            res.read_pct = (unsigned)pct;
+        } else if (0 == strcmp(tok, "nopin")) {
+            res.pin = false;
+        } else {
+            return false;
+        }
+    }
+
+    *w = res;
+    return true;
+}
+
+/* Threads wait here after their warmup, until all are ready. */
+struct start_gate {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t ready;
+    bool go;
+};
+
+struct thread_env {
+    const struct mt_workload *w;
+    const struct skiparray_config *config;
+    struct mt_target *target;
+    struct start_gate *gate;
+    pthread_t thread;
+    size_t id;
+    size_t limit;
+    uint64_t rng;
+    int cpu;                    /* -1: not pinned */
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uintptr_t checksum;         /* so gets aren't optimized out */
+    struct hist hist;
+};
+
+static volatile uintptr_t checksum_sink;
+
+static uint64_t
+next_u64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void
+pin_thread(struct thread_env *env) {
+    env->cpu = -1;
+    if (!env->w->pin) { return; }
+#ifdef __linux__
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0) { return; }
+    const int cpu = (int)(env->id % (size_t)cpus);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+        env->cpu = cpu;
+    }
+#endif
+}
+
+static struct skiparray *
+load(const struct skiparray_config *config, size_t limit) {
+    struct skiparray *sa = NULL;
+    if (SKIPARRAY_NEW_OK != skiparray_new(config, &sa)) {
+        fprintf(stderr, "Error: skiparray_new\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uintptr_t k = 0; k < limit; k++) {
+        (void)skiparray_set(sa, (void *)k, (void *)k);
+    }
+    return sa;
+}
+
+static void
+run_ops(struct thread_env *env, size_t count, bool timed) {
+    const struct mt_mode *mode = env->w->mode;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t r = next_u64(&env->rng);
+        const uintptr_t k = (uintptr_t)((r >> 8) % env->limit);
+        const bool read = (r & 0xff) % 100 < env->w->read_pct;
+        const uint64_t pre = (timed ? hist_now_ns() : 0);
+        if (read) {
+            void *v = NULL;
+            if (mode->get(env->target, (void *)k, &v)) {
+                env->checksum += (uintptr_t)v;
+            }
+        } else {
+            mode->set(env->target, (void *)k, (void *)(k + i));
+        }
+        if (timed) { hist_record(&env->hist, hist_now_ns() - pre); }
+    }
+}
+
+static void *
+thread_main(void *arg) {
+    struct thread_env *env = arg;
+    pin_thread(env);
+    if (!env->w->mode->shared) {
+        env->target->sa = load(env->config, env->limit);
+    }
+
+    run_ops(env, env->limit / 10, false);
+
+    struct start_gate *gate = env->gate;
+    pthread_mutex_lock(&gate->lock);
+    gate->ready++;
+    pthread_cond_broadcast(&gate->cond);
+    while (!gate->go) { pthread_cond_wait(&gate->cond, &gate->lock); }
+    pthread_mutex_unlock(&gate->lock);
+
+    env->start_ns = hist_now_ns();
+    run_ops(env, env->limit, true);
+    env->end_ns = hist_now_ns();
+    return NULL;
+}
+
+void
+mt_run(const struct mt_workload *w,
+    const struct skiparray_config *config,
+    size_t limit, uint64_t seed) {
+    const size_t threads = w->threads;
+    const bool shared = w->mode->shared;
+    struct skiparray_config cfg = *config;
+    if (!shared) {
+        cfg.memory = NULL;
+        cfg.pool = NULL;
+    }
+
+    struct mt_target *targets = calloc(shared ? 1 : threads,
+        sizeof(*targets));
+    struct thread_env *envs = calloc(threads, sizeof(*envs));
+    assert(targets != NULL && envs != NULL);
+    if (shared) {
+        pthread_mutex_init(&targets[0].lock, NULL);
+        targets[0].sa = load(&cfg, limit);
+    }
+
+    struct start_gate gate = { .ready = 0 };
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+
+    for (size_t i = 0; i < threads; i++) {
+        struct thread_env *env = &envs[i];
+        env->w = w;
+        env->config = &cfg;
+        env->target = &targets[shared ? 0 : i];
+        env->gate = &gate;
+        env->id = i;
+        env->limit = limit;
+        env->rng = seed + i;
+        if (0 != pthread_create(&env->thread, NULL, thread_main, env)) {
+            fprintf(stderr, "Error: pthread_create\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pthread_mutex_lock(&gate.lock);
+    while (gate.ready < threads) { pthread_cond_wait(&gate.cond, &gate.lock); }
+    gate.go = true;
+    pthread_cond_broadcast(&gate.cond);
+    pthread_mutex_unlock(&gate.lock);
+
+    uint64_t start_ns = UINT64_MAX;
+    uint64_t end_ns = 0;
+    for (size_t i = 0; i < threads; i++) {
+        pthread_join(envs[i].thread, NULL);
+        if (envs[i].start_ns < start_ns) { start_ns = envs[i].start_ns; }
+        if (envs[i].end_ns > end_ns) { end_ns = envs[i].end_ns; }
+    }
+
+    char label[64];
+    const double elapsed_ns = (double)(end_ns - start_ns);
+    snprintf(label, sizeof(label), "mt_%s x%zu, %u%% reads",
+        w->mode->name, threads, w->read_pct);
+    printf("%-30s limit %9zu %9.3f msec, %11.3f K ops/sec\n",
+        label, limit, elapsed_ns / 1e6,
+        threads * limit / (elapsed_ns / 1e9) / 1000);
+
+    static struct hist all;
+    hist_clear(&all);
+    for (size_t i = 0; i < threads; i++) {
+        struct thread_env *env = &envs[i];
+        const double ns = (double)(env->end_ns - env->start_ns);
+        snprintf(label, sizeof(label), "  thread %zu cpu %d, %.0f K/s",
+            i, env->cpu, limit / (ns / 1e9) / 1000);
+        hist_print(label, &env->hist);
+        hist_merge(&all, &env->hist);
+        checksum_sink += env->checksum;
+    }
+    hist_print("  all", &all);
+
+    for (size_t i = 0; i < (shared ? 1 : threads); i++) {
+        skiparray_free(targets[i].sa);
+    }
+    if (shared) { pthread_mutex_destroy(&targets[0].lock); }
+    pthread_mutex_destroy(&gate.lock);
+    pthread_cond_destroy(&gate.cond);
+    free(targets);
+    free(envs);
+}
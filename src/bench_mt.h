@@ -0,0 +1,39 @@
+#ifndef BENCH_MT_H
+#define BENCH_MT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "skiparray.h"
+
+/* Multi-threaded benchmarks: several threads doing a mix of random gets
+ * and sets, either against one skiparray through a synchronization
+ * mode, or each against a private skiparray, for a scaling baseline. */
+
+struct mt_mode;
+
+struct mt_workload {
+    const struct mt_mode *mode;
+    size_t threads;
+    unsigned read_pct;          /* gets, out of 100 operations */
+    bool pin;                   /* pin thread I to CPU I % CPUs */
+};
+
+/* Parse a mode, "mutex" (one skiparray behind a mutex) or "private"
+ * (a skiparray per thread), optionally followed by comma-separated
+ * settings: read=<percent>, nopin. Returns false on error. */
+bool
+mt_parse(const char *spec, struct mt_workload *w);
+
+/* Load LIMIT keys into the skiparray(s), have each thread do a warmup
+ * of LIMIT / 10 operations, then time LIMIT operations per thread, and
+ * print the aggregate throughput and each thread's throughput and
+ * latency. In private mode, CONFIG's memory callback and pool (which
+ * are not thread-safe) are not used. */
+void
+mt_run(const struct mt_workload *w,
+    const struct skiparray_config *config,
+    size_t limit, uint64_t seed);
+
+#endif
@@ -0,0 +1,307 @@
+#include "bench_baseline.h"
+
+#include <string.h>
+
+/* A red-black tree with parent pointers and a sentinel, as in Cormen
+ * et al.'s "Introduction to Algorithms" -- the usual std::map-style
+ * balanced BST, with one pair per node. */
+
+struct rb_node {
+    void *key;
+    void *value;
+    struct rb_node *left;
+    struct rb_node *right;
+    struct rb_node *parent;
+    bool red;
+};
+
+struct rbtree {
+    struct skiparray_config config;
+    struct rb_node *root;
+    struct rb_node nil;         /* sentinel for leaves and the root's parent */
+};
+
+static void *
+rb_new(const struct skiparray_config *config) {
+    struct rbtree *t = baseline_alloc(config, sizeof(*t));
+    if (t == NULL) { return NULL; }
+    memset(t, 0x00, sizeof(*t));
+    t->config = *config;
+    t->nil.left = t->nil.right = t->nil.parent = &t->nil;
+    t->root = &t->nil;
+    return t;
+}
+
+static void
+free_subtree(struct rbtree *t, struct rb_node *n) {
+    if (n == &t->nil) { return; }
+    free_subtree(t, n->left);
+    free_subtree(t, n->right);
+    baseline_free(&t->config, n);
+}
+
+static void
+rb_free(void *b) {
+    struct rbtree *t = b;
+    free_subtree(t, t->root);
+    baseline_free(&t->config, t);
+}
+
+static struct rb_node *
+find(const struct rbtree *t, const void *key) {
+    struct rb_node *n = t->root;
+    while (n != &t->nil) {
+        const int res = t->config.cmp(key, n->key, t->config.udata);
+        if (res == 0) { return n; }
+        n = (res < 0 ? n->left : n->right);
+    }
+    return NULL;
+}
+
+static void
+rotate_left(struct rbtree *t, struct rb_node *x) {
+    struct rb_node *y = x->right;
+    x->right = y->left;
+    if (y->left != &t->nil) { y->left->parent = x; }
+    y->parent = x->parent;
+    if (x->parent == &t->nil) {
+        t->root = y;
+    } else if (x == x->parent->left) {
+        x->parent->left = y;
+    } else {
+        x->parent->right = y;
+    }
+    y->left = x;
+    x->parent = y;
+}
+
+static void
+rotate_right(struct rbtree *t, struct rb_node *x) {
+    struct rb_node *y = x->left;
+    x->left = y->right;
+    if (y->right != &t->nil) { y->right->parent = x; }
+    y->parent = x->parent;
+    if (x->parent == &t->nil) {
+        t->root = y;
+    } else if (x == x->parent->right) {
+        x->parent->right = y;
+    } else {
+        x->parent->left = y;
+    }
+    y->right = x;
+    x->parent = y;
+}
+
+static void
+insert_fixup(struct rbtree *t, struct rb_node *z) {
+    while (z->parent->red) {
+        struct rb_node *gp = z->parent->parent;
+        if (z->parent == gp->left) {
+            struct rb_node *uncle = gp->right;
+            if (uncle->red) {
+                z->parent->red = false;
+                uncle->red = false;
+                gp->red = true;
+                z = gp;
+            } else {
+                if (z == z->parent->right) {
+                    z = z->parent;
+                    rotate_left(t, z);
+                }
+                z->parent->red = false;
+                z->parent->parent->red = true;
+                rotate_right(t, z->parent->parent);
+            }
+        } else {
+            struct rb_node *uncle = gp->left;
+            if (uncle->red) {
+                z->parent->red = false;
+                uncle->red = false;
+                gp->red = true;
+                z = gp;
+            } else {
+                if (z == z->parent->left) {
+                    z = z->parent;
+                    rotate_right(t, z);
+                }
+                z->parent->red = false;
+                z->parent->parent->red = true;
+                rotate_left(t, z->parent->parent);
+            }
+        }
+    }
+    t->root->red = false;
+}
+
+/* Replace the subtree at U with the one at V. */
+static void
+transplant(struct rbtree *t, struct rb_node *u, struct rb_node *v) {
+    if (u->parent == &t->nil) {
+        t->root = v;
+    } else if (u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    v->parent = u->parent;
+}
+
+static void
+delete_fixup(struct rbtree *t, struct rb_node *x) {
+    while (x != t->root && !x->red) {
+        if (x == x->parent->left) {
+            struct rb_node *w = x->parent->right;
+            if (w->red) {
+                w->red = false;
+                x->parent->red = true;
+                rotate_left(t, x->parent);
+                w = x->parent->right;
+            }
+            if (!w->left->red && !w->right->red) {
+                w->red = true;
+                x = x->parent;
+            } else {
+                if (!w->right->red) {
+                    w->left->red = false;
+                    w->red = true;
+                    rotate_right(t, w);
+                    w = x->parent->right;
+                }
+                w->red = x->parent->red;
+                x->parent->red = false;
+                w->right->red = false;
+                rotate_left(t, x->parent);
+                x = t->root;
+            }
+        } else {
+            struct rb_node *w = x->parent->left;
+            if (w->red) {
+                w->red = false;
+                x->parent->red = true;
+                rotate_right(t, x->parent);
+                w = x->parent->left;
+            }
+            if (!w->right->red && !w->left->red) {
+                w->red = true;
+                x = x->parent;
+            } else {
+                if (!w->left->red) {
+                    w->right->red = false;
+                    w->red = true;
+                    rotate_left(t, w);
+                    w = x->parent->left;
+                }
+                w->red = x->parent->red;
+                x->parent->red = false;
+                w->left->red = false;
+                rotate_right(t, x->parent);
+                x = t->root;
+            }
+        }
+    }
+    x->red = false;
+}
+
+static struct rb_node *
+minimum(const struct rbtree *t, struct rb_node *n) {
+    while (n->left != &t->nil) { n = n->left; }
+    return n;
+}
+
+static bool
+rb_get(void *b, const void *key, void **value) {
+    struct rb_node *n = find(b, key);
+    if (n != NULL && value != NULL) { *value = n->value; }
+    return n != NULL;
+}
+
+static bool
+rb_set(void *b, void *key, void *value) {
+    struct rbtree *t = b;
+    struct rb_node *parent = &t->nil;
+    struct rb_node **link = &t->root;
+    while (*link != &t->nil) {
+        parent = *link;
+        const int res = t->config.cmp(key, parent->key, t->config.udata);
+        if (res == 0) {
+            parent->value = value;
+            return false;
+        }
+        link = (res < 0 ? &parent->left : &parent->right);
+    }
+
+    struct rb_node *z = baseline_alloc(&t->config, sizeof(*z));
+    if (z == NULL) { abort(); }
+    z->key = key;
+    z->value = value;
+    z->left = z->right = &t->nil;
+    z->parent = parent;
+    z->red = true;
+    *link = z;
+    insert_fixup(t, z);
+    return true;
+}
+
+static bool
+rb_forget(void *b, const void *key) {
+    struct rbtree *t = b;
+    struct rb_node *z = find(t, key);
+    if (z == NULL) { return false; }
+
+    struct rb_node *y = z;
+    struct rb_node *x = NULL;
+    bool y_was_red = y->red;
+    if (z->left == &t->nil) {
+        x = z->right;
+        transplant(t, z, z->right);
+    } else if (z->right == &t->nil) {
+        x = z->left;
+        transplant(t, z, z->left);
+    } else {
+        y = minimum(t, z->right);
+        y_was_red = y->red;
+        x = y->right;
+        if (y->parent == z) {
+            x->parent = y;
+        } else {
+            transplant(t, y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        transplant(t, z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->red = z->red;
+    }
+    if (!y_was_red) { delete_fixup(t, x); }
+    baseline_free(&t->config, z);
+    return true;
+}
+
+static void
+rb_each(void *b, skiparray_fold_fun *cb, void *udata) {
+    struct rbtree *t = b;
+    if (t->root == &t->nil) { return; }
+    struct rb_node *n = minimum(t, t->root);
+    while (n != &t->nil) {
+        cb(n->key, n->value, udata);
+        if (n->right != &t->nil) {
+            n = minimum(t, n->right);
+        } else {
+            while (n->parent != &t->nil && n == n->parent->right) {
+                n = n->parent;
+            }
+            n = n->parent;
+        }
+    }
+}
+
+const struct baseline baseline_rbtree = {
+    .name = "rbtree",
+    .new = rb_new,
+    .free = rb_free,
+    .get = rb_get,
+    .set = rb_set,
+    .forget = rb_forget,
+    .each = rb_each,
+};
@@ -0,0 +1,382 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench_report.h"
+#include "bench_hwc.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#define MAX_LINE 1024
+#define MAX_FIELDS 32
+
+bool
+report_parse_format(const char *s, enum report_format *format) {
+    if (0 == strcmp(s, "text")) {
+        *format = REPORT_TEXT;
+    } else if (0 == strcmp(s, "csv")) {
+        *format = REPORT_CSV;
+    } else if (0 == strcmp(s, "json")) {
+        *format = REPORT_JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+struct host {
+    char name[64];
+    char os[64];
+    char arch[32];
+    long cpus;
+};
+
+/* Copy SRC into DST, replacing anything that would need quoting
+ * in CSV or JSON. */
+static void
+copy_plain(char *dst, size_t size, const char *src) {
+    size_t i = 0;
+    for (; i < size - 1 && src[i] != '\0'; i++) {
+        const char c = src[i];
+        dst[i] = (c == ',' || c == '"' || c == '\\' || c < ' ' ? '_' : c);
+    }
+    dst[i] = '\0';
+}
+
+static const struct host *
+get_host(void) {
+    static struct host host;
+    static bool init;
+    if (init) { return &host; }
+    init = true;
+
+    char name[sizeof(host.name)] = "unknown";
+    if (0 != gethostname(name, sizeof(name))) { strcpy(name, "unknown"); }
+    name[sizeof(name) - 1] = '\0';
+    copy_plain(host.name, sizeof(host.name), name);
+
+    struct utsname u;
+    if (0 == uname(&u)) {
+        char os[sizeof(u.sysname) + sizeof(u.release) + 1];
+        snprintf(os, sizeof(os), "%s %s", u.sysname, u.release);
+        copy_plain(host.os, sizeof(host.os), os);
+        copy_plain(host.arch, sizeof(host.arch), u.machine);
+    } else {
+        strcpy(host.os, "unknown");
+        strcpy(host.arch, "unknown");
+    }
+    host.cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return &host;
+}
+
+/* Format the hardware counts per op, which go last: CSV column names,
+ * CSV fields (blank if not counted), or JSON members (left out). */
+static void
+format_hwc(char *buf, size_t size, enum report_format format, bool header,
+    const double *hwc) {
+    size_t used = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < HWC_EVENT_COUNT && used < size; i++) {
+        const bool have = hwc != NULL && hwc[i] >= 0;
+        int res = 0;
+        if (format == REPORT_CSV && header) {
+            res = snprintf(&buf[used], size - used, ",%s_per_op",
+                hwc_name(i));
+        } else if (format == REPORT_CSV) {
+            res = (have ? snprintf(&buf[used], size - used, ",%.3f", hwc[i])
+                : snprintf(&buf[used], size - used, ","));
+        } else if (have) {
+            res = snprintf(&buf[used], size - used, ", \"%s_per_op\": %.3f",
+                hwc_name(i), hwc[i]);
+        }
+        if (res > 0) { used += (size_t)res; }
+    }
+}
+
+void
+report_result(enum report_format format, const struct report_result *r) {
+    static bool printed_header;
+    const struct host *host = get_host();
+    const double msec = r->usec / 1000.0;
+    const double kops = (r->usec == 0 ? 0
+        : r->limit / (r->usec / 1e6) / 1000);
+    unsigned long long p50 = 0, p99 = 0, p999 = 0;
+    if (r->latency != NULL) {
+        p50 = hist_percentile(r->latency, 0.50);
+        p99 = hist_percentile(r->latency, 0.99);
+        p999 = hist_percentile(r->latency, 0.999);
+    }
+    char cmps[48] = "";         /* blank (CSV) or left out (JSON) */
+    if (r->cmp_per_op >= 0) {
+        snprintf(cmps, sizeof(cmps),
+            format == REPORT_CSV ? "%.3f" : ", \"cmp_per_op\": %.3f",
+            r->cmp_per_op);
+    }
+    char hwc[HWC_EVENT_COUNT * 40];
+
+    if (format == REPORT_CSV) {
+        if (!printed_header) {
+            format_hwc(hwc, sizeof(hwc), format, true, NULL);
+            printf("name,limit,node_size,seed,cycle,msec,kops_per_sec,"
+                "memory_hwm,p50_ns,p99_ns,p999_ns,cmp_per_op,host,os,arch,"
+                "cpus%s\n", hwc);
+            printed_header = true;
+        }
+        format_hwc(hwc, sizeof(hwc), format, false, r->hwc);
+        printf("%s,%zu,%zu,%llu,%zu,%.3f,%.3f,%zu,%llu,%llu,%llu,%s,"
+            "%s,%s,%s,%ld%s\n",
+            r->name, r->limit, r->node_size, (unsigned long long)r->seed,
+            r->cycle, msec, kops, r->memory_hwm, p50, p99, p999, cmps,
+            host->name, host->os, host->arch, host->cpus, hwc);
+    } else if (format == REPORT_JSON) {
+        format_hwc(hwc, sizeof(hwc), format, false, r->hwc);
+        printf("{\"name\": \"%s\", \"limit\": %zu, \"node_size\": %zu, "
+            "\"seed\": %llu, \"cycle\": %zu, \"msec\": %.3f, "
+            "\"kops_per_sec\": %.3f, \"memory_hwm\": %zu, "
+            "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu%s, "
+            "\"host\": \"%s\", \"os\": \"%s\", \"arch\": \"%s\", "
+            "\"cpus\": %ld%s}\n",
+            r->name, r->limit, r->node_size, (unsigned long long)r->seed,
+            r->cycle, msec, kops, r->memory_hwm, p50, p99, p999, cmps,
+            host->name, host->os, host->arch, host->cpus, hwc);
+    }
+}
+
+/* Every run of one benchmark at one limit. */
+struct samples {
+    char name[64];
+    size_t limit;
+    size_t count;
+    size_t capacity;
+    double *kops;
+};
+
+struct result_set {
+    size_t count;
+    size_t capacity;
+    struct samples *samples;
+};
+
+static size_t
+split_fields(char *line, char **fields) {
+    size_t count = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    for (char *p = line; count < MAX_FIELDS; ) {
+        fields[count++] = p;
+        char *comma = strchr(p, ',');
+        if (comma == NULL) { break; }
+        *comma = '\0';
+        p = comma + 1;
+    }
+    return count;
+}
+
+static int
+field_index(char **fields, size_t count, const char *name) {
+    for (size_t i = 0; i < count; i++) {
+        if (0 == strcmp(fields[i], name)) { return (int)i; }
+    }
+    return -1;
+}
+
+static bool
+add_sample(struct result_set *set, const char *name, size_t limit,
+    double kops) {
+    struct samples *s = NULL;
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->samples[i].limit == limit
+            && 0 == strcmp(set->samples[i].name, name)) {
+            s = &set->samples[i];
+            break;
+        }
+    }
+    if (s == NULL) {
+        if (set->count == set->capacity) {
+            const size_t ncapacity = (set->capacity == 0
+                ? 16 : 2 * set->capacity);
+            struct samples *nsamples = realloc(set->samples,
+                ncapacity * sizeof(*nsamples));
+            if (nsamples == NULL) { return false; }
+            set->samples = nsamples;
+            set->capacity = ncapacity;
+        }
+        s = &set->samples[set->count++];
+        memset(s, 0x00, sizeof(*s));
+        copy_plain(s->name, sizeof(s->name), name);
+        s->limit = limit;
+    }
+    if (s->count == s->capacity) {
+        const size_t ncapacity = (s->capacity == 0 ? 4 : 2 * s->capacity);
+        double *nkops = realloc(s->kops, ncapacity * sizeof(*nkops));
+        if (nkops == NULL) { return false; }
+        s->kops = nkops;
+        s->capacity = ncapacity;
+    }
+    s->kops[s->count++] = kops;
+    return true;
+}
+
+static void
+free_set(struct result_set *set) {
+    for (size_t i = 0; i < set->count; i++) { free(set->samples[i].kops); }
+    free(set->samples);
+}
+
+static bool
+read_csv(const char *path, struct result_set *set) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Error: can't open %s\n", path);
+        return false;
+    }
+
+    char line[MAX_LINE];
+    char *fields[MAX_FIELDS];
+    int name_i = -1, limit_i = -1, kops_i = -1;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f) != NULL) {
+        const size_t count = split_fields(line, fields);
+        if (name_i < 0) {       /* header */
+            name_i = field_index(fields, count, "name");
+            limit_i = field_index(fields, count, "limit");
+            kops_i = field_index(fields, count, "kops_per_sec");
+            if (name_i < 0 || limit_i < 0 || kops_i < 0) {
+                fprintf(stderr, "Error: %s isn't benchmark CSV\n", path);
+                ok = false;
+            }
+            continue;
+        }
+        if ((size_t)name_i >= count || (size_t)limit_i >= count
+            || (size_t)kops_i >= count) {
+            continue;
+        }
+        ok = add_sample(set, fields[name_i],
+            strtoul(fields[limit_i], NULL, 10), strtod(fields[kops_i], NULL));
+    }
+    fclose(f);
+    return ok && name_i >= 0;
+}
+
+static void
+mean_var(const struct samples *s, double *mean, double *var) {
+    double sum = 0;
+    for (size_t i = 0; i < s->count; i++) { sum += s->kops[i]; }
+    *mean = sum / s->count;
+    double sq = 0;
+    for (size_t i = 0; i < s->count; i++) {
+        sq += (s->kops[i] - *mean) * (s->kops[i] - *mean);
+    }
+    *var = (s->count > 1 ? sq / (s->count - 1) : 0);
+}
+
+/* Two-sided critical values of Student's t for p < 0.05, rounding
+ * the degrees of freedom down (conservatively). */
+static double
+t_critical(double df) {
+    static const struct { double df; double t; } table[] = {
+        { 1, 12.706 }, { 2, 4.303 }, { 3, 3.182 }, { 4, 2.776 },
+        { 5, 2.571 }, { 6, 2.447 }, { 7, 2.365 }, { 8, 2.306 },
+        { 9, 2.262 }, { 10, 2.228 }, { 12, 2.179 }, { 15, 2.131 },
+        { 20, 2.086 }, { 30, 2.042 }, { 60, 2.000 }, { 120, 1.980 },
+    };
+    double res = table[0].t;
+    for (size_t i = 0; i < sizeof(table)/sizeof(table[0]); i++) {
+        if (df >= table[i].df) { res = table[i].t; }
+    }
+    return res;
+}
+
+static int
+cmp_double(const void *pa, const void *pb) {
+    const double a = *(const double *)pa;
+    const double b = *(const double *)pb;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+void
+report_stats(const double *samples, size_t count, struct report_stats *s) {
+    memset(s, 0x00, sizeof(*s));
+    if (count == 0) { return; }
+    double sorted[REPORT_MAX_SAMPLES];
+    if (count > REPORT_MAX_SAMPLES) { count = REPORT_MAX_SAMPLES; }
+    memcpy(sorted, samples, count * sizeof(sorted[0]));
+    qsort(sorted, count, sizeof(sorted[0]), cmp_double);
+    s->median = (count & 1 ? sorted[count/2]
+        : (sorted[count/2 - 1] + sorted[count/2]) / 2);
+
+    const struct samples set = { .count = count, .kops = sorted };
+    double var = 0;
+    mean_var(&set, &s->mean, &var);
+    s->stddev = sqrt(var);
+    if (count > 1) {
+        s->ci95 = t_critical(count - 1) * s->stddev / sqrt(count);
+    }
+}
+
+/* Is the difference between A and B significant, by Welch's t-test? */
+static bool
+significant(const struct samples *a, const struct samples *b) {
+    double ma, va, mb, vb;
+    mean_var(a, &ma, &va);
+    mean_var(b, &mb, &vb);
+    const double ea = va / a->count;
+    const double eb = vb / b->count;
+    const double se = sqrt(ea + eb);
+    if (se == 0) { return ma != mb; }
+    const double t = fabs(mb - ma) / se;
+    const double df = (ea + eb) * (ea + eb)
+        / (ea * ea / (a->count - 1) + eb * eb / (b->count - 1));
+    return t > t_critical(df);
+}
+
+int
+report_compare(const char *base_path, const char *new_path,
+    double threshold) {
+    struct result_set base = { .count = 0 };
+    struct result_set new = { .count = 0 };
+    if (!read_csv(base_path, &base) || !read_csv(new_path, &new)) {
+        free_set(&base);
+        free_set(&new);
+        return -1;
+    }
+
+    int regressions = 0;
+    for (size_t i = 0; i < new.count; i++) {
+        const struct samples *n = &new.samples[i];
+        const struct samples *b = NULL;
+        for (size_t j = 0; j < base.count; j++) {
+            if (base.samples[j].limit == n->limit
+                && 0 == strcmp(base.samples[j].name, n->name)) {
+                b = &base.samples[j];
+            }
+        }
+        if (b == NULL) { continue; }
+
+        double mb, vb, mn, vn;
+        mean_var(b, &mb, &vb);
+        mean_var(n, &mn, &vn);
+        const double change = (mb == 0 ? 0 : (mn - mb) / mb);
+        const char *verdict = "";
+        if (b->count < 2 || n->count < 2) {
+            verdict = " (needs -c 2+ to test)";
+        } else if (fabs(change) > threshold && significant(b, n)) {
+            if (change < 0) {
+                verdict = " REGRESSION";
+                regressions++;
+            } else {
+                verdict = " improved";
+            }
+        }
+        printf("%-30s limit %9zu %11.3f -> %11.3f K ops/sec, %+6.1f%%%s\n",
+            n->name, n->limit, mb, mn, 100 * change, verdict);
+    }
+    printf("----\n%d significant regression%s (> %g%%, p < 0.05)\n",
+        regressions, regressions == 1 ? "" : "s", 100 * threshold);
+
+    free_set(&base);
+    free_set(&new);
+    return regressions;
+}
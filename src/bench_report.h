@@ -0,0 +1,64 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bench_hist.h"
+
+/* Machine-readable benchmark results, and comparing two runs. */
+
+enum report_format {
+    REPORT_TEXT,                /* the usual human-readable lines */
+    REPORT_CSV,                 /* a header, then one row per result */
+    REPORT_JSON,                /* one JSON object per line */
+};
+
+/* Parse "text", "csv", or "json". */
+bool
+report_parse_format(const char *s, enum report_format *format);
+
+struct report_result {
+    const char *name;
+    size_t limit;
+    size_t node_size;
+    uint64_t seed;
+    size_t cycle;
+    uint64_t usec;
+    size_t memory_hwm;          /* 0: not tracked */
+    const struct hist *latency; /* NULL: not recorded */
+    double cmp_per_op;          /* < 0: not counted */
+    const double *hwc;          /* per op, by enum hwc_event; NULL: not
+                                 * counted, < 0: unavailable */
+};
+
+/* Print a result as a CSV row or JSON object, with host information.
+ * The CSV header is printed before the first row. */
+void
+report_result(enum report_format format, const struct report_result *r);
+
+#define REPORT_MAX_SAMPLES 1000
+
+/* Summary statistics for up to REPORT_MAX_SAMPLES samples. */
+struct report_stats {
+    double median;
+    double mean;
+    double stddev;
+    double ci95;                /* half-width of the mean's 95% CI */
+};
+
+void
+report_stats(const double *samples, size_t count, struct report_stats *s);
+
+/* Compare the CSV results in BASE_PATH and NEW_PATH: for each benchmark
+ * and limit in both, print the mean throughput before and after, and
+ * flag changes of more than THRESHOLD (a fraction) that are significant
+ * by Welch's t-test at p < 0.05, which needs at least two runs of each
+ * (-c or -R). Returns the number of significant regressions, or -1 if either
+ * file can't be read. */
+int
+report_compare(const char *base_path, const char *new_path,
+    double threshold);
+
+#endif
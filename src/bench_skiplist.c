@@ -0,0 +1,158 @@
+#include "bench_baseline.h"
+
+#include <string.h>
+
+/* A plain skip list, as in Pugh's "Skip Lists: A Probabilistic
+ * Alternative to Balanced Trees": one pair per node, with each node
+ * promoted to the next level with probability 1/4. This is what a
+ * skiparray unrolls. */
+
+#define MAX_LEVEL 32
+
+struct sl_node {
+    void *key;
+    void *value;
+    struct sl_node *fwd[];
+};
+
+struct skiplist {
+    struct skiparray_config config;
+    uint64_t prng_state;
+    uint8_t height;
+    struct sl_node *head;       /* no pair, MAX_LEVEL high */
+};
+
+static struct sl_node *
+node_new(struct skiplist *l, uint8_t height) {
+    struct sl_node *n = baseline_alloc(&l->config,
+        sizeof(*n) + height * sizeof(n->fwd[0]));
+    if (n == NULL) { abort(); }
+    return n;
+}
+
+static void *
+sl_new(const struct skiparray_config *config) {
+    struct skiplist *l = baseline_alloc(config, sizeof(*l));
+    if (l == NULL) { return NULL; }
+    l->config = *config;
+    l->prng_state = config->seed;
+    l->height = 1;
+    l->head = node_new(l, MAX_LEVEL);
+    memset(l->head, 0x00, sizeof(*l->head)
+        + MAX_LEVEL * sizeof(l->head->fwd[0]));
+    return l;
+}
+
+static void
+sl_free(void *b) {
+    struct skiplist *l = b;
+    struct sl_node *n = l->head;
+    while (n != NULL) {
+        struct sl_node *next = n->fwd[0];
+        baseline_free(&l->config, n);
+        n = next;
+    }
+    baseline_free(&l->config, l);
+}
+
+/* 1 + the number of pairs of zero bits, from a splitmix64 step. */
+static uint8_t
+random_height(struct skiplist *l) {
+    uint64_t z = (l->prng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    uint8_t height = 1;
+    while (height < MAX_LEVEL && (z & 3) == 0) {
+        height++;
+        z >>= 2;
+    }
+    return height;
+}
+
+/* Find the last node before KEY on each level, into PREV, and return
+ * the node after it on level 0. */
+static struct sl_node *
+search(struct skiplist *l, const void *key, struct sl_node **prev) {
+    struct sl_node *n = l->head;
+    for (int level = l->height - 1; level >= 0; level--) {
+        while (n->fwd[level] != NULL
+            && l->config.cmp(n->fwd[level]->key, key, l->config.udata) < 0) {
+            n = n->fwd[level];
+        }
+        if (prev != NULL) { prev[level] = n; }
+    }
+    return n->fwd[0];
+}
+
+static bool
+matches(const struct skiplist *l, const struct sl_node *n, const void *key) {
+    return n != NULL && 0 == l->config.cmp(n->key, key, l->config.udata);
+}
+
+static bool
+sl_get(void *b, const void *key, void **value) {
+    struct skiplist *l = b;
+    struct sl_node *n = search(l, key, NULL);
+    if (!matches(l, n, key)) { return false; }
+    if (value != NULL) { *value = n->value; }
+    return true;
+}
+
+static bool
+sl_set(void *b, void *key, void *value) {
+    struct skiplist *l = b;
+    struct sl_node *prev[MAX_LEVEL];
+    struct sl_node *n = search(l, key, prev);
+    if (matches(l, n, key)) {
+        n->value = value;
+        return false;
+    }
+
+    const uint8_t height = random_height(l);
+    while (l->height < height) { prev[l->height++] = l->head; }
+    n = node_new(l, height);
+    n->key = key;
+    n->value = value;
+    for (uint8_t level = 0; level < height; level++) {
+        n->fwd[level] = prev[level]->fwd[level];
+        prev[level]->fwd[level] = n;
+    }
+    return true;
+}
+
+static bool
+sl_forget(void *b, const void *key) {
+    struct skiplist *l = b;
+    struct sl_node *prev[MAX_LEVEL];
+    struct sl_node *n = search(l, key, prev);
+    if (!matches(l, n, key)) { return false; }
+
+    for (uint8_t level = 0; level < l->height; level++) {
+        if (prev[level]->fwd[level] != n) { break; }
+        prev[level]->fwd[level] = n->fwd[level];
+    }
+    while (l->height > 1 && l->head->fwd[l->height - 1] == NULL) {
+        l->height--;
+    }
+    baseline_free(&l->config, n);
+    return true;
+}
+
+static void
+sl_each(void *b, skiparray_fold_fun *cb, void *udata) {
+    struct skiplist *l = b;
+    for (struct sl_node *n = l->head->fwd[0]; n != NULL; n = n->fwd[0]) {
+        cb(n->key, n->value, udata);
+    }
+}
+
+const struct baseline baseline_skiplist = {
+    .name = "skiplist",
+    .new = sl_new,
+    .free = sl_free,
+    .get = sl_get,
+    .set = sl_set,
+    .forget = sl_forget,
+    .each = sl_each,
+};
@@ -0,0 +1,132 @@
+#include "bench_baseline.h"
+
+#include <string.h>
+
+/* A sorted array of pairs, with binary search. Lookups and scans are
+ * as cheap as it gets, but inserts and deletions move half the array
+ * on average. */
+
+struct sorted_array {
+    struct skiparray_config config;
+    size_t count;
+    size_t capacity;
+    void **keys;
+    void **values;
+};
+
+#define DEF_CAPACITY 16
+
+static void *
+array_new(const struct skiparray_config *config) {
+    struct sorted_array *a = baseline_alloc(config, sizeof(*a));
+    if (a == NULL) { return NULL; }
+    memset(a, 0x00, sizeof(*a));
+    a->config = *config;
+    return a;
+}
+
+static void
+array_free(void *b) {
+    struct sorted_array *a = b;
+    if (a->keys != NULL) {
+        baseline_free(&a->config, a->keys);
+        baseline_free(&a->config, a->values);
+    }
+    baseline_free(&a->config, a);
+}
+
+/* The index of the first key >= KEY; sets *FOUND if it's equal. */
+static size_t
+lower_bound(const struct sorted_array *a, const void *key, bool *found) {
+    size_t lo = 0;
+    size_t hi = a->count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo)/2;
+        if (a->config.cmp(a->keys[mid], key, a->config.udata) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = (lo < a->count
+        && 0 == a->config.cmp(a->keys[lo], key, a->config.udata));
+    return lo;
+}
+
+static void
+grow(struct sorted_array *a) {
+    const size_t ncapacity = (a->capacity == 0
+        ? DEF_CAPACITY : 2 * a->capacity);
+    void **nkeys = baseline_alloc(&a->config, ncapacity * sizeof(void *));
+    void **nvalues = baseline_alloc(&a->config, ncapacity * sizeof(void *));
+    if (nkeys == NULL || nvalues == NULL) { abort(); }
+    if (a->keys != NULL) {
+        memcpy(nkeys, a->keys, a->count * sizeof(void *));
+        memcpy(nvalues, a->values, a->count * sizeof(void *));
+        baseline_free(&a->config, a->keys);
+        baseline_free(&a->config, a->values);
+    }
+    a->keys = nkeys;
+    a->values = nvalues;
+    a->capacity = ncapacity;
+}
+
+static bool
+array_get(void *b, const void *key, void **value) {
+    struct sorted_array *a = b;
+    bool found = false;
+    const size_t i = lower_bound(a, key, &found);
+    if (found && value != NULL) { *value = a->values[i]; }
+    return found;
+}
+
+static bool
+array_set(void *b, void *key, void *value) {
+    struct sorted_array *a = b;
+    bool found = false;
+    const size_t i = lower_bound(a, key, &found);
+    if (found) {
+        a->values[i] = value;
+        return false;
+    }
+    if (a->count == a->capacity) { grow(a); }
+    const size_t after = a->count - i;
+    memmove(&a->keys[i + 1], &a->keys[i], after * sizeof(void *));
+    memmove(&a->values[i + 1], &a->values[i], after * sizeof(void *));
+    a->keys[i] = key;
+    a->values[i] = value;
+    a->count++;
+    return true;
+}
+
+static bool
+array_forget(void *b, const void *key) {
+    struct sorted_array *a = b;
+    bool found = false;
+    const size_t i = lower_bound(a, key, &found);
+    if (!found) { return false; }
+    const size_t after = a->count - i - 1;
+    memmove(&a->keys[i], &a->keys[i + 1], after * sizeof(void *));
+    memmove(&a->values[i], &a->values[i + 1], after * sizeof(void *));
+    a->count--;
+    return true;
+}
+
+static void
+array_each(void *b, skiparray_fold_fun *cb, void *udata) {
+    struct sorted_array *a = b;
+    for (size_t i = 0; i < a->count; i++) {
+        cb(a->keys[i], a->values[i], udata);
+    }
+}
+
+const struct baseline baseline_sorted_array = {
+    .name = "sorted",
+    .write_limit = 100000,
+    .new = array_new,
+    .free = array_free,
+    .get = array_get,
+    .set = array_set,
+    .forget = array_forget,
+    .each = array_each,
+};
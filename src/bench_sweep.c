@@ -0,0 +1,157 @@
+#include "bench_sweep.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* The recommendation is the smallest configuration (in words per
+ * entry) within these fractions of the best throughput and p99. */
+#define RECOMMEND_THROUGHPUT 0.95
+#define RECOMMEND_P99 1.25
+
+struct point {
+    uint16_t node_size;
+    uint8_t max_level;
+    double kops;
+    uint64_t p99;               /* ns, over all operations */
+    double words;               /* per entry */
+    bool pareto;
+};
+
+bool
+sweep_parse(const char *spec, struct sweep_grid *grid) {
+    struct sweep_grid res = { .level_count = 0 };
+    char buf[128];
+    if (strlen(spec) >= sizeof(buf)) { return false; }
+    strcpy(buf, spec);
+
+    for (char *tok = strtok(buf, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        char *end = NULL;
+        const unsigned long level = strtoul(tok, &end, 0);
+        if (end == tok || *end != '\0') { return false; }
+        if (level < 1 || level > SKIPARRAY_MAX_MAX_LEVEL) { return false; }
+        if (res.level_count == SWEEP_MAX_LEVELS) { return false; }
+        res.levels[res.level_count++] = (uint8_t)level;
+    }
+    if (res.level_count == 0) { return false; }
+
+    *grid = res;
+    return true;
+}
+
+static void
+measure(struct point *p, const struct ycsb_workload *w,
+    const struct skiparray_config *config,
+    size_t records, size_t ops, uint64_t seed) {
+    static struct ycsb_result res;
+    struct skiparray_config cfg = *config;
+    cfg.node_size = p->node_size;
+    cfg.max_level = p->max_level;
+    cfg.pool = NULL;            /* pools only have one node size */
+    ycsb_measure(w, &cfg, records, ops, seed, &res);
+
+    static struct hist all;
+    hist_clear(&all);
+    for (size_t op = 0; op < YCSB_OP_COUNT; op++) {
+        hist_merge(&all, &res.latency[op]);
+    }
+    p->kops = (res.run_ns == 0 ? 0 : ops / (res.run_ns / 1e9) / 1000);
+    p->p99 = hist_percentile(&all, 0.99);
+
+    const struct skiparray_stats *st = &res.stats;
+    const size_t bytes = st->header_bytes + st->key_bytes + st->value_bytes;
+    p->words = (st->pairs == 0 ? 0
+        : bytes / (double)(sizeof(void *) * st->pairs));
+}
+
+/* Is A at least as good as B in every way, and better in one? */
+static bool
+dominates(const struct point *a, const struct point *b) {
+    if (a->kops < b->kops || a->p99 > b->p99 || a->words > b->words) {
+        return false;
+    }
+    return a->kops > b->kops || a->p99 < b->p99 || a->words < b->words;
+}
+
+static const struct point *
+recommend(const struct point *points, size_t count) {
+    double best_kops = 0;
+    uint64_t best_p99 = UINT64_MAX;
+    for (size_t i = 0; i < count; i++) {
+        if (points[i].kops > best_kops) { best_kops = points[i].kops; }
+        if (points[i].p99 < best_p99) { best_p99 = points[i].p99; }
+    }
+
+    /* If nothing is close on both, only require throughput. */
+    const struct point *res = NULL;
+    for (int pass = 0; pass < 2 && res == NULL; pass++) {
+        for (size_t i = 0; i < count; i++) {
+            const struct point *p = &points[i];
+            if (!p->pareto || p->kops < RECOMMEND_THROUGHPUT * best_kops) {
+                continue;
+            }
+            if (pass == 0 && p->p99 > RECOMMEND_P99 * best_p99) { continue; }
+            if (res == NULL || p->words < res->words
+                || (p->words == res->words && p->kops > res->kops)) {
+                res = p;
+            }
+        }
+    }
+    return res;
+}
+
+void
+sweep_run(const struct sweep_grid *grid, const struct ycsb_workload *w,
+    const struct skiparray_config *config,
+    size_t records, size_t ops, uint64_t seed) {
+    size_t sizes = 0;
+    for (size_t s = SWEEP_MIN_NODE_SIZE; s <= SWEEP_MAX_NODE_SIZE; s *= 2) {
+        sizes++;
+    }
+    const size_t count = sizes * grid->level_count;
+    struct point *points = calloc(count, sizeof(*points));
+    if (points == NULL) {
+        fprintf(stderr, "Error: alloc\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t i = 0;
+    for (size_t s = SWEEP_MIN_NODE_SIZE; s <= SWEEP_MAX_NODE_SIZE; s *= 2) {
+        for (size_t l_i = 0; l_i < grid->level_count; l_i++) {
+            points[i].node_size = (uint16_t)s;
+            points[i].max_level = grid->levels[l_i];
+            measure(&points[i], w, config, records, ops, seed);
+            i++;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        points[i].pareto = true;
+        for (size_t j = 0; j < count; j++) {
+            if (dominates(&points[j], &points[i])) {
+                points[i].pareto = false;
+                break;
+            }
+        }
+    }
+
+    printf("sweep of ycsb_%s, %zu records, %zu ops "
+        "(* = Pareto-optimal)\n", w->name, records, ops);
+    printf("%9s %9s %11s %9s %11s\n",
+        "node_size", "max_level", "K ops/sec", "p99 ns", "words/entry");
+    for (i = 0; i < count; i++) {
+        const struct point *p = &points[i];
+        printf("%9u %9u %11.3f %9llu %11.3f%s\n",
+            p->node_size, p->max_level, p->kops,
+            (unsigned long long)p->p99, p->words, p->pareto ? " *" : "");
+    }
+
+    const struct point *r = recommend(points, count);
+    if (r != NULL) {
+        printf("recommended: .node_size = %u, .max_level = %u "
+            "(%.3f K ops/sec, p99 %llu ns, %.3f words/entry)\n",
+            r->node_size, r->max_level, r->kops,
+            (unsigned long long)r->p99, r->words);
+    }
+    free(points);
+}
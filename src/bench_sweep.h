@@ -0,0 +1,39 @@
+#ifndef BENCH_SWEEP_H
+#define BENCH_SWEEP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "skiparray.h"
+#include "bench_ycsb.h"
+
+/* Sweeping node_size and max_level: run a YCSB-style workload at each
+ * point of a grid, and find which configurations are worth using. */
+
+#define SWEEP_MIN_NODE_SIZE 16
+#define SWEEP_MAX_NODE_SIZE 8192
+#define SWEEP_MAX_LEVELS 8
+
+struct sweep_grid {
+    /* Node sizes are the powers of two from SWEEP_MIN_NODE_SIZE to
+     * SWEEP_MAX_NODE_SIZE; max levels are listed. */
+    size_t level_count;
+    uint8_t levels[SWEEP_MAX_LEVELS];
+};
+
+/* Parse a comma-separated list of max levels, e.g. "8,16,32".
+ * Returns false on error. */
+bool
+sweep_parse(const char *spec, struct sweep_grid *grid);
+
+/* Run workload W (RECORDS records, then OPS operations) with CONFIG at
+ * each point of GRID, and print each one's throughput, p99 latency, and
+ * words per entry, marking the Pareto-optimal ones, then recommend one.
+ * CONFIG's node_size, max_level, and pool are replaced. */
+void
+sweep_run(const struct sweep_grid *grid, const struct ycsb_workload *w,
+    const struct skiparray_config *config,
+    size_t records, size_t ops, uint64_t seed);
+
+#endif
@@ -0,0 +1,73 @@
+#define _GNU_SOURCE             /* for sched_setaffinity */
+
+#include "bench_sys.h"
+#include "bench_hist.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+bool
+sys_pin_cpu(int cpu) {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE) { return false; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return 0 == sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/* Read the first line of a file, without the newline. */
+static bool
+read_line(const char *path, char *buf, size_t size) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) { return false; }
+    const bool ok = (fgets(buf, (int)size, f) != NULL);
+    fclose(f);
+    if (ok) { buf[strcspn(buf, "\n")] = '\0'; }
+    return ok;
+}
+
+bool
+sys_check_frequency_scaling(void) {
+    bool warned = false;
+    char buf[64];
+    if (read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor",
+            buf, sizeof(buf)) && 0 != strcmp(buf, "performance")) {
+        fprintf(stderr, "Warning: CPU frequency governor is '%s', "
+            "not 'performance'\n", buf);
+        warned = true;
+    }
+    if (read_line("/sys/devices/system/cpu/intel_pstate/no_turbo",
+            buf, sizeof(buf)) && 0 == strcmp(buf, "0")) {
+        fprintf(stderr, "Warning: turbo boost is enabled\n");
+        warned = true;
+    } else if (read_line("/sys/devices/system/cpu/cpufreq/boost",
+            buf, sizeof(buf)) && 0 == strcmp(buf, "1")) {
+        fprintf(stderr, "Warning: CPU frequency boost is enabled\n");
+        warned = true;
+    }
+    return warned;
+}
+
+uint64_t
+sys_spin_ns(void) {
+    /* A chain of dependent multiplies, which can't be vectorized or
+     * overlapped, so it takes a fixed number of cycles. */
+    volatile uint64_t sink;
+    uint64_t x = 1;
+    const uint64_t pre = hist_now_ns();
+    for (size_t i = 0; i < 20000000; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    sink = x;
+    (void)sink;
+    return hist_now_ns() - pre;
+}
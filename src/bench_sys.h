@@ -0,0 +1,27 @@
+#ifndef BENCH_SYS_H
+#define BENCH_SYS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Controlling and checking the system the benchmarks run on. */
+
+/* Pin the process to CPU. Returns false if that isn't possible
+ * (or supported). */
+bool
+sys_pin_cpu(int cpu);
+
+/* Warn on stderr about CPU settings that make timings vary with
+ * frequency scaling: a CPU frequency governor other than
+ * "performance", or turbo boost being enabled. These are only
+ * detected on Linux. Returns whether there were any warnings. */
+bool
+sys_check_frequency_scaling(void);
+
+/* Time a fixed amount of CPU-bound work, in nanoseconds. Comparing it
+ * before and after a run shows whether the clock speed changed. */
+uint64_t
+sys_spin_ns(void);
+
+#endif
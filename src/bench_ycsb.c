@@ -0,0 +1,504 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench_ycsb.h"
+#include "bench_hist.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+#include <math.h>
+
+#define DEF_THETA 0.99
+#define DEF_HOT_SET 0.2
+#define DEF_HOT_OPS 0.8
+#define DEF_SCAN_MAX 100
+#define MIN_KEY_SIZE 16         /* hex digits of the record's hash */
+
+static const char *op_names[YCSB_OP_COUNT] = {
+    [YCSB_READ] = "read",
+    [YCSB_UPDATE] = "update",
+    [YCSB_INSERT] = "insert",
+    [YCSB_SCAN] = "scan",
+    [YCSB_RMW] = "rmw",
+    [YCSB_DELETE] = "delete",
+};
+
+static const char *dist_names[] = {
+    [YCSB_DIST_UNIFORM] = "uniform",
+    [YCSB_DIST_ZIPFIAN] = "zipfian",
+    [YCSB_DIST_LATEST] = "latest",
+    [YCSB_DIST_HOTSPOT] = "hotspot",
+};
+
+#define PRESET(NAME, DIST, ...)                                         \
+    { .name = NAME, .mix = { __VA_ARGS__ }, .dist = DIST,               \
+      .theta = DEF_THETA, .hot_set = DEF_HOT_SET,                       \
+      .hot_ops = DEF_HOT_OPS, .scan_max = DEF_SCAN_MAX }
+
+/* YCSB's core workloads. */
+static const struct ycsb_workload presets[] = {
+    /* A: update heavy */
+    PRESET("a", YCSB_DIST_ZIPFIAN, [YCSB_READ] = 50, [YCSB_UPDATE] = 50),
+    /* B: read mostly */
+    PRESET("b", YCSB_DIST_ZIPFIAN, [YCSB_READ] = 95, [YCSB_UPDATE] = 5),
+    /* C: read only */
+    PRESET("c", YCSB_DIST_ZIPFIAN, [YCSB_READ] = 100),
+    /* D: read latest */
+    PRESET("d", YCSB_DIST_LATEST, [YCSB_READ] = 95, [YCSB_INSERT] = 5),
+    /* E: short ranges */
+    PRESET("e", YCSB_DIST_ZIPFIAN, [YCSB_SCAN] = 95, [YCSB_INSERT] = 5),
+    /* F: read-modify-write */
+    PRESET("f", YCSB_DIST_ZIPFIAN, [YCSB_READ] = 50, [YCSB_RMW] = 50),
+};
+#define PRESET_COUNT (sizeof(presets)/sizeof(presets[0]))
+
+static bool
+parse_double(const char *s, double *out) {
+    char *end = NULL;
+    *out = strtod(s, &end);
+    return end != s && *end == '\0';
+}
+
+static bool
+parse_size(const char *s, size_t *out) {
+    char *end = NULL;
+    *out = strtoul(s, &end, 0);
+    return end != s && *end == '\0';
+}
+
+static bool
+parse_setting(const char *name, const char *value, struct ycsb_workload *w) {
+    for (size_t i = 0; i < YCSB_OP_COUNT; i++) {
+        if (0 == strcmp(name, op_names[i])) {
+            return parse_double(value, &w->mix[i]) && w->mix[i] >= 0;
+        }
+    }
+    if (0 == strcmp(name, "dist")) {
+        for (size_t i = 0; i < sizeof(dist_names)/sizeof(dist_names[0]); i++) {
+            if (0 == strcmp(value, dist_names[i])) {
+                w->dist = (enum ycsb_dist)i;
+                return true;
+            }
+        }
+        return false;
+    } else if (0 == strcmp(name, "theta")) {
+        return parse_double(value, &w->theta);
+    } else if (0 == strcmp(name, "hot_set")) {
+        return parse_double(value, &w->hot_set);
+    } else if (0 == strcmp(name, "hot_ops")) {
+        return parse_double(value, &w->hot_ops);
+    } else if (0 == strcmp(name, "scan_max")) {
+        return parse_size(value, &w->scan_max);
+    } else if (0 == strcmp(name, "key_size")) {
+        return parse_size(value, &w->key_size);
+    } else if (0 == strcmp(name, "value_size")) {
+        return parse_size(value, &w->value_size);
+    }
+    return false;
+}
+
+bool
+ycsb_parse(const char *spec, struct ycsb_workload *w) {
+    struct ycsb_workload res = PRESET("custom", YCSB_DIST_ZIPFIAN, 0);
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)) { return false; }
+    strcpy(buf, spec);
+
+    size_t i = 0;
+    for (char *tok = strtok(buf, ","); tok != NULL;
+         tok = strtok(NULL, ","), i++) {
+        char *eq = strchr(tok, '=');
+        if (eq == NULL) {       /* preset, first only */
+            if (i > 0) { return false; }
+            bool found = false;
+            for (size_t p_i = 0; p_i < PRESET_COUNT; p_i++) {
+                if (0 == strcasecmp(tok, presets[p_i].name)) {
+                    res = presets[p_i];
+                    found = true;
+                }
+            }
+            if (!found) { return false; }
+        } else {
+            *eq = '\0';
+            if (!parse_setting(tok, eq + 1, &res)) { return false; }
+        }
+    }
+
+    double total = 0;
+    for (size_t op = 0; op < YCSB_OP_COUNT; op++) { total += res.mix[op]; }
+    if (total <= 0) { return false; }
+    if (!(res.theta > 0 && res.theta < 1)) { return false; }
+    if (!(res.hot_set > 0 && res.hot_set < 1)) { return false; }
+    if (!(res.hot_ops >= 0 && res.hot_ops <= 1)) { return false; }
+    if (res.scan_max == 0) { return false; }
+    if (res.key_size != 0 && res.key_size < MIN_KEY_SIZE) { return false; }
+
+    *w = res;
+    return true;
+}
+
+static uint64_t
+next_u64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1). */
+static double
+next_double(uint64_t *state) {
+    return (next_u64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Record numbers are hashed into keys, so that the hot records
+ * (the lowest numbers, or the latest inserts) are spread across
+ * the key space. This is a bijection, so keys never collide. */
+static uint64_t
+record_hash(uint64_t n) {
+    n = (n ^ (n >> 33)) * 0xff51afd7ed558ccdULL;
+    n = (n ^ (n >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return n ^ (n >> 33);
+}
+
+/* Zipfian-distributed numbers in [0, n), per Gray et al., "Quickly
+ * Generating Billion-Record Synthetic Databases" (as in YCSB). Zeta(n)
+ * is extended incrementally as inserts grow n. */
+struct zipf {
+    uint64_t n;
+    double theta;
+    double alpha;
+    double zeta2;
+    double zetan;
+    double eta;
+};
+
+static void
+zipf_grow(struct zipf *z, uint64_t n) {
+    if (n <= z->n) { return; }
+    for (uint64_t i = z->n + 1; i <= n; i++) {
+        z->zetan += 1.0 / pow((double)i, z->theta);
+    }
+    z->n = n;
+    z->eta = (1 - pow(2.0 / n, 1 - z->theta)) / (1 - z->zeta2 / z->zetan);
+}
+
+static void
+zipf_init(struct zipf *z, uint64_t n, double theta) {
+    memset(z, 0x00, sizeof(*z));
+    z->theta = theta;
+    z->alpha = 1 / (1 - theta);
+    z->zeta2 = 1 + pow(0.5, theta);
+    zipf_grow(z, n);
+}
+
+static uint64_t
+zipf_next(const struct zipf *z, uint64_t *state) {
+    const double u = next_double(state);
+    const double uz = u * z->zetan;
+    if (uz < 1) { return 0; }
+    if (uz < z->zeta2) { return 1; }
+    const uint64_t res = (uint64_t)(z->n * pow(z->eta * u - z->eta + 1,
+            z->alpha));
+    return (res < z->n ? res : z->n - 1);
+}
+
+struct env {
+    const struct ycsb_workload *w;
+    uint64_t rng;
+    struct zipf zipf;
+    uint64_t inserted;          /* next record number */
+    char *key_buf;              /* string keys, by record number */
+    unsigned char *scratch;     /* reads copy values out here */
+    void *spare;                /* value buffer for the next update */
+    uint64_t checksum;          /* so reads aren't optimized out */
+};
+
+static volatile uint64_t checksum_sink;
+
+static int
+cmp_intptr_t(const void *ka, const void *kb, void *udata) {
+    (void)udata;
+    intptr_t a = (intptr_t)ka;
+    intptr_t b = (intptr_t)kb;
+    return (a < b ? -1 : a > b ? 1 : 0);
+}
+
+static int
+cmp_string(const void *ka, const void *kb, void *udata) {
+    const struct env *env = udata;
+    return memcmp(ka, kb, env->w->key_size);
+}
+
+static void
+free_value(void *key, void *value, void *udata) {
+    (void)key;
+    (void)udata;
+    free(value);
+}
+
+static void *
+record_key(struct env *env, uint64_t n) {
+    const uint64_t hash = record_hash(n);
+    if (env->w->key_size == 0) { return (void *)(intptr_t)hash; }
+    return &env->key_buf[n * env->w->key_size];
+}
+
+/* Fill in a new record's key, if it's a string. */
+static void *
+new_record_key(struct env *env, uint64_t n) {
+    const size_t size = env->w->key_size;
+    if (size > 0) {
+        char *key = &env->key_buf[n * size];
+        char hex[MIN_KEY_SIZE + 1];
+        snprintf(hex, sizeof(hex), "%016llx",
+            (unsigned long long)record_hash(n));
+        memcpy(key, hex, MIN_KEY_SIZE);
+        memset(&key[MIN_KEY_SIZE], 'x', size - MIN_KEY_SIZE);
+    }
+    return record_key(env, n);
+}
+
+static void *
+new_value(struct env *env, uint64_t n) {
+    if (env->w->value_size == 0) { return (void *)(uintptr_t)n; }
+    void *value = malloc(env->w->value_size);
+    assert(value != NULL);
+    memset(value, (int)(n & 0xff), env->w->value_size);
+    return value;
+}
+
+/* Choose an existing record, per the workload's distribution. */
+static uint64_t
+choose_record(struct env *env) {
+    const uint64_t count = env->inserted;
+    switch (env->w->dist) {
+    default:
+    case YCSB_DIST_UNIFORM:
+        return next_u64(&env->rng) % count;
+    case YCSB_DIST_ZIPFIAN:
+        zipf_grow(&env->zipf, count);
+        return zipf_next(&env->zipf, &env->rng);
+    case YCSB_DIST_LATEST:
+        zipf_grow(&env->zipf, count);
+        return count - 1 - zipf_next(&env->zipf, &env->rng);
+    case YCSB_DIST_HOTSPOT:
+    {
+        uint64_t hot = (uint64_t)(env->w->hot_set * count);
+        if (hot == 0) { hot = 1; }
+        if (hot == count || next_double(&env->rng) < env->w->hot_ops) {
+            return next_u64(&env->rng) % hot;
+        }
+        return hot + next_u64(&env->rng) % (count - hot);
+    }
+    }
+}
+
+static enum ycsb_op
+choose_op(struct env *env, const double *cumulative) {
+    const double x = next_double(&env->rng) * cumulative[YCSB_OP_COUNT - 1];
+    for (size_t op = 0; op < YCSB_OP_COUNT - 1; op++) {
+        if (x < cumulative[op]) { return (enum ycsb_op)op; }
+    }
+    return (enum ycsb_op)(YCSB_OP_COUNT - 1);
+}
+
+static void
+do_read(struct skiparray *sa, struct env *env, void *key) {
+    void *value = NULL;
+    if (!skiparray_get(sa, key, &value)) { return; }
+    if (env->w->value_size > 0) {
+        memcpy(env->scratch, value, env->w->value_size);
+        env->checksum += env->scratch[0];
+    } else {
+        env->checksum += (uintptr_t)value;
+    }
+}
+
+/* Replace the record's value. With value buffers, the new value is
+ * written into the spare buffer, and the replaced one becomes the
+ * spare, so updates don't allocate. */
+static void
+do_update(struct skiparray *sa, struct env *env, void *key) {
+    if (env->w->value_size == 0) {
+        (void)skiparray_set(sa, key, (void *)(uintptr_t)env->rng);
+        return;
+    }
+    memset(env->spare, (int)(env->rng & 0xff), env->w->value_size);
+    struct skiparray_pair prev = { .key = NULL };
+    const enum skiparray_set_res res = skiparray_set_with_pair(sa, key,
+        env->spare, false, &prev);
+    if (res == SKIPARRAY_SET_REPLACED) {
+        env->spare = prev.value;
+    } else {                    /* it had been deleted */
+        assert(res == SKIPARRAY_SET_BOUND);
+        env->spare = new_value(env, 0);
+    }
+}
+
+static void
+do_scan(struct skiparray *sa, struct env *env, void *key) {
+    const size_t length = 1 + next_u64(&env->rng) % env->w->scan_max;
+    struct skiparray_iter *iter = NULL;
+    if (SKIPARRAY_ITER_NEW_OK != skiparray_iter_new(sa, &iter)) { return; }
+    const enum skiparray_iter_seek_res res = skiparray_iter_seek(iter, key);
+    if (res == SKIPARRAY_ITER_SEEK_FOUND
+        || res == SKIPARRAY_ITER_SEEK_NOT_FOUND) {
+        for (size_t i = 0; i < length; i++) {
+            void *k = NULL;
+            void *v = NULL;
+            skiparray_iter_get(iter, &k, &v);
+            env->checksum += (uintptr_t)v;
+            if (skiparray_iter_next(iter) != SKIPARRAY_ITER_STEP_OK) {
+                break;
+            }
+        }
+    }
+    skiparray_iter_free(iter);
+}
+
+static void
+do_delete(struct skiparray *sa, struct env *env, void *key) {
+    struct skiparray_pair forgotten = { .key = NULL };
+    if (SKIPARRAY_FORGET_OK == skiparray_forget(sa, key, &forgotten)
+        && env->w->value_size > 0) {
+        free(forgotten.value);
+    }
+}
+
+void
+ycsb_measure(const struct ycsb_workload *w,
+    const struct skiparray_config *config,
+    size_t records, size_t ops, uint64_t seed, struct ycsb_result *res) {
+    struct env env = {
+        .w = w,
+        .rng = seed,
+    };
+    zipf_init(&env.zipf, records, w->theta);
+
+    const bool has_inserts = w->mix[YCSB_INSERT] > 0;
+    if (w->key_size > 0) {
+        env.key_buf = malloc((records + (has_inserts ? ops : 0))
+            * w->key_size);
+        assert(env.key_buf != NULL);
+    }
+    if (w->value_size > 0) {
+        env.scratch = malloc(w->value_size);
+        env.spare = new_value(&env, 0);
+        assert(env.scratch != NULL);
+    }
+
+    struct skiparray_config cfg = *config;
+    cfg.ignore_values = false;
+    cfg.udata = &env;
+    cfg.cmp = (w->key_size > 0 ? cmp_string : cmp_intptr_t);
+    cfg.free = (w->value_size > 0 ? free_value : NULL);
+
+    struct skiparray *sa = NULL;
+    if (SKIPARRAY_NEW_OK != skiparray_new(&cfg, &sa)) {
+        fprintf(stderr, "Error: skiparray_new\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const uint64_t load_pre = hist_now_ns();
+    for (; env.inserted < records; env.inserted++) {
+        const uint64_t n = env.inserted;
+        (void)skiparray_set(sa, new_record_key(&env, n), new_value(&env, n));
+    }
+    res->load_ns = hist_now_ns() - load_pre;
+
+    double cumulative[YCSB_OP_COUNT];
+    double total = 0;
+    for (size_t op = 0; op < YCSB_OP_COUNT; op++) {
+        total += w->mix[op];
+        cumulative[op] = total;
+    }
+
+    struct hist *hists = res->latency;
+    for (size_t op = 0; op < YCSB_OP_COUNT; op++) { hist_clear(&hists[op]); }
+
+    const uint64_t run_pre = hist_now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        const enum ycsb_op op = choose_op(&env, cumulative);
+        void *key = NULL;
+        uint64_t n = 0;
+        if (op == YCSB_INSERT) {
+            n = env.inserted++;
+            key = new_record_key(&env, n);
+        } else if (env.inserted > 0) {
+            key = record_key(&env, choose_record(&env));
+        }
+        void *value = (op == YCSB_INSERT ? new_value(&env, n) : NULL);
+
+        const uint64_t pre = hist_now_ns();
+        switch (op) {
+        case YCSB_READ:
+            do_read(sa, &env, key);
+            break;
+        case YCSB_UPDATE:
+            do_update(sa, &env, key);
+            break;
+        case YCSB_INSERT:
+            (void)skiparray_set(sa, key, value);
+            break;
+        case YCSB_SCAN:
+            do_scan(sa, &env, key);
+            break;
+        case YCSB_RMW:
+            do_read(sa, &env, key);
+            do_update(sa, &env, key);
+            break;
+        case YCSB_DELETE:
+            do_delete(sa, &env, key);
+            break;
+        default:
+            assert(false);
+        }
+        hist_record(&hists[op], hist_now_ns() - pre);
+    }
+    res->run_ns = hist_now_ns() - run_pre;
+    checksum_sink = env.checksum;
+    skiparray_stats(sa, &res->stats);
+
+    skiparray_free(sa);
+    free(env.key_buf);
+    free(env.scratch);
+    free(env.spare);
+}
+
+void
+ycsb_run(const struct ycsb_workload *w,
+    const struct skiparray_config *config,
+    size_t records, size_t ops, uint64_t seed) {
+    static struct ycsb_result res;
+    ycsb_measure(w, config, records, ops, seed, &res);
+
+    char label[64];
+    snprintf(label, sizeof(label), "ycsb_%s load", w->name);
+    printf("%-30s limit %9zu %9.3f msec, %11.3f K ops/sec\n",
+        label, records, res.load_ns / 1e6,
+        (res.load_ns == 0 ? 0 : records / (res.load_ns / 1e9) / 1000));
+
+    const uint64_t run_ns = res.run_ns;
+    snprintf(label, sizeof(label), "ycsb_%s run", w->name);
+    printf("%-30s limit %9zu %9.3f msec, %11.3f K ops/sec, %s",
+        label, ops, run_ns / 1e6,
+        (run_ns == 0 ? 0 : ops / (run_ns / 1e9) / 1000),
+        dist_names[w->dist]);
+    if (w->dist == YCSB_DIST_HOTSPOT) {
+        printf(" %g/%g", w->hot_set, w->hot_ops);
+    } else if (w->dist != YCSB_DIST_UNIFORM) {
+        printf(" %g", w->theta);
+    }
+    printf("\n");
+
+    for (size_t op = 0; op < YCSB_OP_COUNT; op++) {
+        const struct hist *h = &res.latency[op];
+        if (h->count == 0) { continue; }
+        snprintf(label, sizeof(label), "  %s x%llu, mean %.0f", op_names[op],
+            (unsigned long long)h->count, hist_mean(h));
+        hist_print(label, h);
+    }
+}
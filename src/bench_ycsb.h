@@ -0,0 +1,77 @@
+#ifndef BENCH_YCSB_H
+#define BENCH_YCSB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "skiparray.h"
+#include "bench_hist.h"
+
+/* YCSB-style mixed workloads: load a number of records, then run a
+ * number of operations drawn from a mix, with the records chosen by a
+ * key distribution, and report latency per operation type. */
+
+enum ycsb_op {
+    YCSB_READ,
+    YCSB_UPDATE,
+    YCSB_INSERT,
+    YCSB_SCAN,
+    YCSB_RMW,                   /* read, then update */
+    YCSB_DELETE,
+    YCSB_OP_COUNT,
+};
+
+enum ycsb_dist {
+    YCSB_DIST_UNIFORM,
+    YCSB_DIST_ZIPFIAN,          /* the lowest record numbers are hot */
+    YCSB_DIST_LATEST,           /* the latest inserts are hot */
+    YCSB_DIST_HOTSPOT,          /* hot_ops of operations go to hot_set */
+};
+
+struct ycsb_workload {
+    const char *name;
+    double mix[YCSB_OP_COUNT];  /* relative weights */
+    enum ycsb_dist dist;
+    double theta;               /* zipfian and latest skew, 0 < theta < 1 */
+    double hot_set;             /* hotspot: fraction of records... */
+    double hot_ops;             /* ...getting this fraction of operations */
+    size_t scan_max;            /* scans step through 1 to scan_max pairs */
+    /* Key size in bytes, or 0 for integer keys. String keys are hex
+     * digits, compared with memcmp, and at least 16 bytes. */
+    size_t key_size;
+    /* Value size in bytes, or 0 for pointer-sized values. Larger values
+     * are buffers that reads copy out and updates copy in. */
+    size_t value_size;
+};
+
+/* Parse a workload: a preset, "a" to "f" (mirroring YCSB's core
+ * workloads A to F), and/or comma-separated settings overriding it:
+ * read=, update=, insert=, scan=, rmw=, delete= (weights),
+ * dist=uniform|zipfian|latest|hotspot, theta=, hot_set=, hot_ops=,
+ * scan_max=, key_size=, value_size=. Returns false on error. */
+bool
+ycsb_parse(const char *spec, struct ycsb_workload *w);
+
+/* Load RECORDS records into a skiparray with CONFIG (its cmp and free
+ * callbacks are replaced as needed), run OPS operations, and print the
+ * throughput and per-operation latency. */
+void
+ycsb_run(const struct ycsb_workload *w,
+    const struct skiparray_config *config,
+    size_t records, size_t ops, uint64_t seed);
+
+struct ycsb_result {
+    uint64_t load_ns;
+    uint64_t run_ns;
+    struct hist latency[YCSB_OP_COUNT];
+    struct skiparray_stats stats; /* after the run */
+};
+
+/* Like ycsb_run, but only measure, into *RES. */
+void
+ycsb_measure(const struct ycsb_workload *w,
+    const struct skiparray_config *config,
+    size_t records, size_t ops, uint64_t seed, struct ycsb_result *res);
+
+#endif
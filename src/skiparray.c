@@ -29,16 +29,46 @@ skiparray_new(const struct skiparray_config *config,
 
 #define DEF(FIELD, DEF) (config->FIELD == 0 ? DEF : config->FIELD)
     uint16_t node_size = DEF(node_size, SKIPARRAY_DEF_NODE_SIZE);
+    uint16_t node_size_min = DEF(node_size_min, node_size);
     uint8_t max_level = DEF(max_level, SKIPARRAY_DEF_MAX_LEVEL);
 #undef DEF
+    if (node_size_min < 2 || node_size_min > node_size) {
+        return SKIPARRAY_NEW_ERROR_CONFIG;
+    }
 #define DEF(FIELD, DEF) (config->FIELD == NULL ? DEF : config->FIELD)
     skiparray_memory_fun *mem = DEF(memory, def_memory_fun);
     skiparray_level_fun *level = DEF(level, def_level_fun);
 #undef DEF
 
+    void *mem_udata = config->udata;
+
+    struct skiparray_pool *pool = config->pool;
+    if (pool != NULL) {
+        if (pool->node_size != node_size
+            || pool->max_level < max_level
+            || pool->use_values == config->ignore_values) {
+            return SKIPARRAY_NEW_ERROR_CONFIG;
+        }
+    }
+
+    struct skiparray_arena *arena = config->arena;
+    if (arena != NULL) {
+        /* Everything comes from the arena, so a pool is redundant. */
+        if (pool != NULL) { return SKIPARRAY_NEW_ERROR_CONFIG; }
+        mem = skiparray_arena_memory_fun;
+        mem_udata = arena;
+    }
+
+    /* Pooled nodes can't release their arrays, and arena skiparrays
+     * aren't freed node by node, which the pager relies on. */
+    struct skiparray_pager *pager = config->pager;
+    if (pager != NULL && (pool != NULL || arena != NULL)) {
+        return SKIPARRAY_NEW_ERROR_CONFIG;
+    }
+
     const size_t alloc_size = sizeof(struct skiparray) +
       max_level * sizeof(struct node *);
-    struct skiparray *res = mem(NULL, alloc_size, config->udata);
+    struct skiparray *res = mem(NULL, alloc_size, mem_udata);
     if (res == NULL) { return SKIPARRAY_NEW_ERROR_MEMORY; }
     memset(res, 0x00, alloc_size);
 
@@ -48,6 +78,7 @@ skiparray_new(const struct skiparray_config *config,
 
     struct skiparray fields = {
         .node_size = node_size,
+        .node_size_min = node_size_min,
         .max_level = max_level,
         .height = root_level,
         .use_values = !config->ignore_values,
@@ -57,15 +88,41 @@ skiparray_new(const struct skiparray_config *config,
         .free = config->free,
         .level = level,
         .udata = config->udata,
+        .mem_udata = mem_udata,
+        .pool = pool,
+        .arena = arena,
+        .pager = pager,
+        .wal = config->wal,
+        .next_node_id = 1,
+        .hash = config->hash,
+        .tail_stale = UINT32_MAX,
     };
     memcpy(res, &fields, sizeof(fields));
+#ifdef SKIPARRAY_TRACE
+    res->trace = config->trace;
+#endif
 
-    struct node *root = node_alloc(root_level, node_size,
-        mem, config->udata, fields.use_values);
+    if (pager != NULL && !skiparray_pager_attach(pager, res)) {
+        mem(res, 0, mem_udata);
+        return SKIPARRAY_NEW_ERROR_CONFIG;
+    }
+    if (res->wal != NULL && !skiparray_wal_attach(res->wal, res)) {
+        if (pager != NULL) { skiparray_pager_detach(pager); }
+        mem(res, 0, mem_udata);
+        return SKIPARRAY_NEW_ERROR_CONFIG;
+    }
+
+    const uint16_t root_capacity = (pool == NULL
+        && node_size > NODE_INITIAL_CAPACITY
+        ? NODE_INITIAL_CAPACITY : node_size);
+    struct node *root = node_alloc(res, root_level, root_capacity);
     if (root == NULL) {
-        mem(res, 0, config->udata);
+        if (pager != NULL) { skiparray_pager_detach(pager); }
+        if (res->wal != NULL) { skiparray_wal_detach(res->wal); }
+        mem(res, 0, mem_udata);
         return SKIPARRAY_NEW_ERROR_MEMORY;
     }
+    if (pool != NULL) { pool->users++; }
 
     for (size_t i = 0; i < root_level; i++) {
         res->nodes[i] = root;
@@ -87,28 +144,48 @@ skiparray_new(const struct skiparray_config *config,
 void
 skiparray_free(struct skiparray *sa) {
     assert(sa != NULL);
+    if (sa->wal != NULL) { skiparray_wal_detach(sa->wal); }
+
+    /* Memory from an arena isn't freed individually -- it's all
+     * reclaimed at once when the arena is reset or freed. */
+    const bool in_arena = sa->arena != NULL;
+    if (in_arena && sa->free == NULL) { return; }
+
     struct node *n = sa->nodes[0];
     while (n != NULL) {
         struct node *next = n->fwd[0];
-        if (sa->free != NULL) {
+        if (sa->free != NULL && n->keys == NULL) {
+            /* Paged out: the rest were freed on eviction. */
+            sa->free(n->page->last_key, n->page->last_value, sa->udata);
+        } else if (sa->free != NULL) {
             for (size_t i = 0; i < n->count; i++) {
                 sa->free(n->keys[n->offset + i],
                     sa->use_values ? n->values[n->offset + i] : NULL, sa->udata);
             }
         }
-        node_free(sa, n);
+        if (!in_arena) { node_free(sa, n); }
         n = next;
     }
+    if (in_arena) { return; }
 
     /* Free any remaining iterators */
     struct skiparray_iter *iter = sa->iter;
     while (iter != NULL) {
         struct skiparray_iter *next = iter->next;
-        sa->mem(iter, 0, sa->udata);
+        sa->mem(iter, 0, sa->mem_udata);
         iter = next;
     }
 
-    sa->mem(sa, 0, sa->udata);
+    if (sa->pool != NULL) {
+        assert(sa->pool->users > 0);
+        sa->pool->users--;
+    }
+    if (sa->pager != NULL) { skiparray_pager_detach(sa->pager); }
+    if (sa->tail_digests != NULL) {
+        sa->mem(sa->tail_digests, 0, sa->mem_udata);
+    }
+
+    sa->mem(sa, 0, sa->mem_udata);
 }
 
 bool
@@ -129,6 +206,7 @@ skiparray_get_pair(const struct skiparray *sa,
     LOG(2, "%s: key %p\n", __func__, (void *)key);
     assert(sa != NULL);
     assert(pair != NULL);
+    page_trim(sa, NULL);
 
     struct search_env env = {
         .sa = sa,
@@ -139,6 +217,7 @@ skiparray_get_pair(const struct skiparray *sa,
     default:
         assert(false);
     case SEARCH_NOT_FOUND:
+    case SEARCH_ERROR_PAGE:
         return false;
 
     case SEARCH_FOUND:
@@ -170,6 +249,7 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
     assert(sa);
 
     if (has_iterators(sa)) { return SKIPARRAY_SET_ERROR_LOCKED; }
+    page_trim(sa, NULL);
 
     struct search_env env = {
         .sa = sa,
@@ -177,12 +257,18 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
     };
 
     enum search_res sres = search(&env);
+    if (sres == SEARCH_ERROR_PAGE || !node_will_change(sa, env.n)) {
+        return SKIPARRAY_SET_ERROR_PAGE;
+    }
 
     switch (sres) {
     case SEARCH_FOUND:
     {
         struct node *n = env.n;
         assert(n);
+        if (sa->wal != NULL && !skiparray_wal_log(sa->wal, false, key, value)) {
+            return SKIPARRAY_SET_ERROR_WAL;
+        }
         void **k = &n->keys[n->offset + env.index];
         static void *the_NULL = NULL; /* safe placeholder for *v */
         void **v = sa->use_values
@@ -203,7 +289,10 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
     {
         struct node *n = env.n;
         assert(n);
-        if (env.n->count == sa->node_size) {
+        /* Split and grow the node before logging: both keep its pairs,
+         * so a failed allocation or write leaves them as they were,
+         * and nothing after logging can fail. */
+        if (n->count >= n->limit) {
             /* split, update node; index in env.
              * This is the only code path that changes the overall
              * skiplist structure, and can be fairly rare with large nodes. */
@@ -239,8 +328,9 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
                 for (;;) {
                     assert(cur);
                     assert(cur->count > 0);
+                    COUNTER_ADD(sa, cmp_calls, 1);
                     const int res = sa->cmp(new->keys[new->offset],
-                        cur->keys[cur->offset + cur->count - 1], sa->udata);
+                        node_last_key(cur), sa->udata);
                     LOG(2, "%s: level %zu, cur %p, cmp %d, prev %p\n",
                         __func__, level, (void *)cur, res, (void *)prev);
                     if (res < 0) { /* overshot */
@@ -287,6 +377,9 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
 
             /* If the new node is taller than the current SA height,
              * then increase it and update forward links. */
+            if (new->height > sa->height) {
+                TRACE(sa, HEIGHT, TRACE_NOW, 0, sa->height, new->height);
+            }
             while (new->height > sa->height) {
                 sa->nodes[sa->height] = new;
                 sa->height++;
@@ -299,6 +392,7 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
                 new->fwd[i] = n->fwd[i];
                 n->fwd[i] = new;
             }
+            digest_link(sa, new);
 
             if (env.index > n->count) { /* now inserting on new node */
                 LOG(2, "split, was inserting at %" PRIu16
@@ -309,9 +403,15 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
             }
         }
 
+        if (!grow_node_for_insert(sa, n)) {
+            return SKIPARRAY_SET_ERROR_MEMORY;
+        }
+        if (sa->wal != NULL && !skiparray_wal_log(sa->wal, false, key, value)) {
+            return SKIPARRAY_SET_ERROR_WAL;
+        }
         prepare_node_for_insert(sa, n, env.index);
 
-        assert(n->offset + env.index < sa->node_size);
+        assert(n->offset + env.index < n->capacity);
         n->keys[n->offset + env.index] = key;
 
         if (sa->use_values) {
@@ -321,6 +421,10 @@ skiparray_set_with_pair(struct skiparray *sa, void *key, void *value,
         n->count++;
         LOG(2, "%s: now node %p has %" PRIu16 " pair(s)\n",
             __func__, (void *)n, n->count);
+
+        if (n->writes < UINT16_MAX) { n->writes++; }
+        adapt_node_limit(sa, n);
+        absorb_next_node(sa, n);
         return SKIPARRAY_SET_BOUND;
     }
 
@@ -336,6 +440,7 @@ skiparray_forget(struct skiparray *sa, const void *key,
         __func__, (void *)key);
 
     if (has_iterators(sa)) { return SKIPARRAY_FORGET_ERROR_LOCKED; }
+    page_trim(sa, NULL);
 
     struct search_env env = {
         .sa = sa,
@@ -347,14 +452,23 @@ skiparray_forget(struct skiparray *sa, const void *key,
     case SEARCH_EMPTY:
         return SKIPARRAY_FORGET_NOT_FOUND;
 
+    case SEARCH_ERROR_PAGE:
+        return SKIPARRAY_FORGET_ERROR_PAGE;
+
     case SEARCH_FOUND:
     {
         struct node *n = env.n;
         assert(n);
+        if (!node_will_change(sa, n) || !page_in_neighbor(sa, n)) {
+            return SKIPARRAY_FORGET_ERROR_PAGE;
+        }
 
         LOG(2, "%s: found in node %p at index %" PRIu16 "\n",
             __func__, (void *)n, env.index);
         assert(env.index < n->count);
+        if (sa->wal != NULL && !skiparray_wal_log(sa->wal, true, key, NULL)) {
+            return SKIPARRAY_FORGET_ERROR_WAL;
+        }
 
         if (forgotten != NULL) {
             forgotten->key = n->keys[n->offset + env.index];
@@ -369,15 +483,15 @@ skiparray_forget(struct skiparray *sa, const void *key,
         if (env.index == 0) {   /* first */
             n->offset++;
             /* Deletion shouldn't gradually shift off the end. */
-            if (n->offset == sa->node_size) {
-                n->offset = sa->node_size/2;
+            if (n->offset == n->capacity) {
+                n->offset = n->capacity/2;
             }
             n->count--;
         } else if (env.index == n->count - 1) { /* last */
             n->count--;
         } else {                /* from middle */
             const uint16_t to_move = n->count - env.index - 1;
-            shift_pairs(n, n->offset + env.index,
+            shift_pairs(sa, n, n->offset + env.index,
                 n->offset + env.index + 1, to_move);
             n->count--;
         }
@@ -389,7 +503,11 @@ skiparray_forget(struct skiparray *sa, const void *key,
             dump_raw_bindings("POST-FORGET", sa, n);
         }
 
-        if (n->count < sa->node_size/2) {
+        if (n->writes < UINT16_MAX) { n->writes++; }
+        adapt_node_limit(sa, n);
+        absorb_next_node(sa, n);
+
+        if (n->count < n->limit/2) {
             /* The node is too empty: either shift over entries
              * from the following L0 node (if any), or if it's
              * also too empty, merge with it.*/
@@ -437,6 +555,8 @@ skiparray_first(const struct skiparray *sa,
     if (n->count == 0) {
         return SKIPARRAY_FIRST_EMPTY;
     }
+    page_trim(sa, n);
+    if (!page_in(sa, n, false)) { return SKIPARRAY_FIRST_ERROR_PAGE; }
 
     uint16_t index = n->offset;
 
@@ -481,6 +601,8 @@ skiparray_last(const struct skiparray *sa,
         assert(n == sa->nodes[0]);
         return SKIPARRAY_LAST_EMPTY;
     }
+    page_trim(sa, n);
+    if (!page_in(sa, n, false)) { return SKIPARRAY_LAST_ERROR_PAGE; }
 
     uint16_t index = n->offset + n->count - 1;
 
@@ -512,32 +634,45 @@ skiparray_pop_first(struct skiparray *sa,
         assert(head->fwd[0] == NULL);
         return SKIPARRAY_POP_EMPTY;
     }
+    page_trim(sa, head);
+    if (!node_will_change(sa, head) || !page_in_neighbor(sa, head)) {
+        return SKIPARRAY_POP_ERROR_PAGE;
+    }
+    if (sa->wal != NULL
+        && !skiparray_wal_log(sa->wal, true, head->keys[head->offset], NULL)) {
+        return SKIPARRAY_POP_ERROR_WAL;
+    }
 
     if (key != NULL) { *key = head->keys[head->offset]; }
     if (value != NULL && sa->use_values) {
         *value = head->values[head->offset];
     }
     head->offset++;
-    if (head->offset == sa->node_size) {
-        head->offset = sa->node_size/2;
+    if (head->offset == head->capacity) {
+        head->offset = head->capacity/2;
     }
     head->count--;
 
     /* If the head node is less than half full (and not the only node),
      * either take some pairs from the next node or merge with it. */
     struct node *next = head->fwd[0];
-    const uint16_t required = sa->node_size/2;
-    if (head->count < sa->node_size/2 && next != NULL) {
-        if (head->count + next->count <= sa->node_size) {
+    const uint16_t required = head->limit/2;
+    /* If next can't be read in, leave head under-filled for now; it
+     * was paged in above if head is now empty. */
+    if (head->count < required && next != NULL
+        && node_will_change(sa, next)) {
+        if (head->count + next->count <= head->limit) {
             LOG(2, "%s: combining head with next (%p), which has %" PRIu16 " pairs\n",
                 __func__, (void *)next, next->count);
             const uint16_t to_move = next->count;
+            COUNTER_ADD(sa, merges, 1);
+            TRACE_START(start);
             if (head->offset > 0) {
                 /* move to front, to make room */
-                shift_pairs(head, 0, head->offset, head->count);
+                shift_pairs(sa, head, 0, head->offset, head->count);
                 head->offset = 0;
             }
-            move_pairs(head, next, head->count, next->offset, to_move);
+            move_pairs(sa, head, next, head->count, next->offset, to_move);
             head->count += to_move;
 
             for (size_t i = 0; i < next->height; i++) {
@@ -556,25 +691,30 @@ skiparray_pop_first(struct skiparray *sa,
             if (next->fwd[0] != NULL) {
                 next->fwd[0]->back = head;
             }
+            digest_unlink(sa, next->fwd[0]);
 
             LOG(2, "%s: freeing next node %p\n", __func__, (void *)next);
+            compact_forget_node(sa, next);
             node_free(sa, next);
 
-            /* handle decrease in height */
-            while (sa->height > 1 && sa->nodes[sa->height - 1] == NULL) { sa->height--; }
+            TRACE(sa, MERGE, start, head->count, to_move, 0);
+            shrink_height(sa);
         } else {
             const uint16_t to_move = next->count - required;
             LOG(2, "%s: moving %" PRIu16 " pairs from next (%p) to head\n",
                 __func__, to_move, (void *)next);
+            COUNTER_ADD(sa, shifts, 1);
+            TRACE_START(start);
             if (head->offset > 0) {
                 /* move to front, to make room */
-                shift_pairs(head, 0, head->offset, head->count);
+                shift_pairs(sa, head, 0, head->offset, head->count);
                 head->offset = 0;
             }
-            move_pairs(head, next, head->count, next->offset, to_move);
+            move_pairs(sa, head, next, head->count, next->offset, to_move);
             next->count -= to_move;
             next->offset += to_move;
             head->count += to_move;
+            TRACE(sa, SHIFT, start, head->count, to_move, 0);
         }
     }
 
@@ -615,6 +755,12 @@ skiparray_pop_last(struct skiparray *sa,
     assert(last->count > 0);
     LOG(2, "%s: last node is %p, with %" PRIu16 " pair(s)\n",
         __func__, (void *)last, last->count);
+    page_trim(sa, last);
+    if (!node_will_change(sa, last)) { return SKIPARRAY_POP_ERROR_PAGE; }
+    if (sa->wal != NULL && !skiparray_wal_log(sa->wal, true,
+            last->keys[last->offset + last->count - 1], NULL)) {
+        return SKIPARRAY_POP_ERROR_WAL;
+    }
 
     if (key != NULL) { *key = last->keys[last->offset + last->count - 1]; }
     if (value != NULL && sa->use_values) {
@@ -643,14 +789,22 @@ skiparray_iter_new(struct skiparray *sa,
         return SKIPARRAY_ITER_NEW_EMPTY;
     }
 
+    /* Iterators page in each node as they move onto it, and nodes with
+     * iterators aren't paged out, so skiparray_iter_get can't fail. */
+    if (!page_in(sa, sa->nodes[0], false)) {
+        return SKIPARRAY_ITER_NEW_ERROR_PAGE;
+    }
+
     struct skiparray_iter *si = sa->mem(NULL,
-        sizeof(*si), sa->udata);
+        sizeof(*si), sa->mem_udata);
     if (si == NULL) {
         return SKIPARRAY_ITER_NEW_ERROR_MEMORY;
     }
 
     if (sa->iter != NULL) {
         sa->iter->prev = si;
+    } else {
+        TRACE(sa, LOCK, TRACE_NOW, 0, 0, 0);
     }
 
     *si = (struct skiparray_iter) {
@@ -688,38 +842,47 @@ skiparray_iter_free(struct skiparray_iter *iter) {
         }
     }
 
-    sa->mem(iter, 0, sa->udata);
+    sa->mem(iter, 0, sa->mem_udata);
+    if (sa->iter == NULL) { TRACE(sa, UNLOCK, TRACE_NOW, 0, 0, 0); }
 }
 
-void
+enum skiparray_iter_step_res
 skiparray_iter_seek_endpoint(struct skiparray_iter *iter,
     enum skiparray_iter_seek_endpoint end) {
     assert(iter != NULL);
+    struct node *n = NULL;
     switch (end) {
     case SKIPARRAY_ITER_SEEK_FIRST:
-        iter->n = iter->sa->nodes[0];
-        iter->index = 0;
+        n = iter->sa->nodes[0];
         break;
     case SKIPARRAY_ITER_SEEK_LAST:
-        iter->n = last_node(iter->sa);
-        iter->index = iter->n->count - 1;
+        n = last_node(iter->sa);
         break;
 
     default:
         assert(false);
     }
+
+    if (!page_in(iter->sa, n, false)) {
+        return SKIPARRAY_ITER_STEP_ERROR_PAGE;
+    }
+    iter->n = n;
+    iter->index = (end == SKIPARRAY_ITER_SEEK_FIRST ? 0 : n->count - 1);
+    return SKIPARRAY_ITER_STEP_OK;
 }
 
 enum skiparray_iter_seek_res
 skiparray_iter_seek(struct skiparray_iter *iter,
     const void *key) {
     assert(iter != NULL);
+    page_trim(iter->sa, NULL);
 
     struct search_env env = {
         .sa = iter->sa,
         .key = key,
     };
     enum search_res sres = search(&env);
+    if (sres == SEARCH_ERROR_PAGE) { return SKIPARRAY_ITER_SEEK_ERROR_PAGE; }
     assert(env.n != NULL);
 
     LOG(3, "%s: sres %d, got node %p, index %u\n",
@@ -746,6 +909,9 @@ skiparray_iter_seek(struct skiparray_iter *iter,
     if (env.index == env.n->count) {
         env.n = env.n->fwd[0];
         if (env.n == NULL) { return SKIPARRAY_ITER_SEEK_ERROR_AFTER_LAST; }
+        if (!page_in(iter->sa, env.n, false)) {
+            return SKIPARRAY_ITER_SEEK_ERROR_PAGE;
+        }
         env.index = 0;
     }
 
@@ -766,9 +932,15 @@ skiparray_iter_next(struct skiparray_iter *iter) {
     if (iter->index == iter->n->count) {
         if (iter->n->fwd[0] == NULL) {
             return SKIPARRAY_ITER_STEP_END;
+        } else if (!page_in(iter->sa, iter->n->fwd[0], false)) {
+            iter->index--;
+            return SKIPARRAY_ITER_STEP_ERROR_PAGE;
         } else {
             iter->n = iter->n->fwd[0];
             iter->index = 0;
+            page_trim(iter->sa, NULL);
+            if (iter->n->scans < UINT16_MAX) { iter->n->scans++; }
+            adapt_node_limit(iter->sa, iter->n);
         }
     }
     return SKIPARRAY_ITER_STEP_OK;
@@ -784,9 +956,14 @@ skiparray_iter_prev(struct skiparray_iter *iter) {
     if (iter->index == 0) {
         if (iter->n->back == NULL) {
             return SKIPARRAY_ITER_STEP_END;
+        } else if (!page_in(iter->sa, iter->n->back, false)) {
+            return SKIPARRAY_ITER_STEP_ERROR_PAGE;
         } else {
             iter->n = iter->n->back;
             iter->index = iter->n->count - 1;
+            page_trim(iter->sa, NULL);
+            if (iter->n->scans < UINT16_MAX) { iter->n->scans++; }
+            adapt_node_limit(iter->sa, iter->n);
         }
     } else {
         iter->index--;
@@ -803,6 +980,7 @@ skiparray_iter_get(struct skiparray_iter *iter,
         __func__, iter->index, (void *)iter->n, iter->n->count);
 
     assert(iter->index < iter->n->count);
+    assert(iter->n->keys != NULL); /* paged in when the iterator moved */
     uint16_t n = iter->n->offset + iter->index;
     if (key != NULL) {
         *key = iter->n->keys[n];
@@ -816,6 +994,19 @@ skiparray_iter_get(struct skiparray_iter *iter,
 enum skiparray_builder_new_res
 skiparray_builder_new(const struct skiparray_config *cfg,
     bool skip_ascending_key_check, struct skiparray_builder **builder) {
+    return builder_new(cfg, skip_ascending_key_check, false, builder);
+}
+
+enum skiparray_builder_new_res
+skiparray_builder_new_balanced(const struct skiparray_config *cfg,
+    bool skip_ascending_key_check, struct skiparray_builder **builder) {
+    return builder_new(cfg, skip_ascending_key_check, true, builder);
+}
+
+static enum skiparray_builder_new_res
+builder_new(const struct skiparray_config *cfg,
+    bool skip_ascending_key_check, bool balanced,
+    struct skiparray_builder **builder) {
     if (builder == NULL) { return SKIPARRAY_BUILDER_NEW_ERROR_MISUSE; }
 
     struct skiparray *sa = NULL;
@@ -835,14 +1026,32 @@ skiparray_builder_new(const struct skiparray_config *cfg,
     struct skiparray_builder *b = NULL;
     const size_t alloc_size = sizeof(*b)
       + sa->max_level * sizeof(b->trail[0]);
-    b = sa->mem(NULL, alloc_size, sa->udata);
+    b = sa->mem(NULL, alloc_size, sa->mem_udata);
     if (b == NULL) {
         skiparray_free(sa);
         return SKIPARRAY_BUILDER_NEW_ERROR_MEMORY;
     }
     memset(b, 0x00, alloc_size);
 
+    /* The root is node 0, which would otherwise reach every level;
+     * replace it with a height 1 node so the express lanes start at
+     * the first node that reaches them, and the skiparray's height
+     * tracks the number of nodes built. */
+    if (balanced && sa->height > 1) {
+        struct node *root = node_alloc(sa, 1, sa->nodes[0]->capacity);
+        if (root == NULL) {
+            sa->mem(b, 0, sa->mem_udata);
+            skiparray_free(sa);
+            return SKIPARRAY_BUILDER_NEW_ERROR_MEMORY;
+        }
+        node_free(sa, sa->nodes[0]);
+        sa->nodes[0] = root;
+        for (size_t i = 1; i < sa->height; i++) { sa->nodes[i] = NULL; }
+        sa->height = 1;
+    }
+
     b->sa = sa;
+    b->balanced = balanced;
     b->last = sa->nodes[0];
     b->last->offset = 0;
 
@@ -866,7 +1075,7 @@ skiparray_builder_free(struct skiparray_builder *b) {
     if (b == NULL) { return; }
     assert(b->sa != NULL);
     struct skiparray *sa = b->sa;
-    b->sa->mem(b, 0, sa->udata);
+    b->sa->mem(b, 0, sa->mem_udata);
     skiparray_free(sa);
 }
 
@@ -883,6 +1092,7 @@ skiparray_builder_append(struct skiparray_builder *b,
 
     /* reject key if <= previous; must be ascending */
     if (b->has_prev_key) {
+        COUNTER_ADD(sa, cmp_calls, 1);
         if (sa->cmp(key, b->prev_key, sa->udata) <= 0) {
             return SKIPARRAY_BUILDER_APPEND_ERROR_MISUSE;
         }
@@ -893,13 +1103,24 @@ skiparray_builder_append(struct skiparray_builder *b,
 
     /* If the current last node is full, then allocate a new last node
      * and connect back and forward pointers according to the trail. */
-    if (last->count == sa->node_size) {
-        uint8_t level = sa->level(sa->prng_state,
-            &sa->prng_state, sa->udata) + 1;
-        if (level >= sa->max_level) { level = sa->max_level - 1; }
+    if (last->count == last->capacity && last->capacity < sa->node_size) {
+        uint32_t capacity = 2 * (uint32_t)last->capacity;
+        if (capacity > sa->node_size) { capacity = sa->node_size; }
+        if (!node_resize(sa, last, (uint16_t)capacity)) {
+            return SKIPARRAY_BUILDER_APPEND_ERROR_MEMORY;
+        }
+    } else if (last->count == sa->node_size) {
+        uint8_t height;
+        if (b->balanced) {
+            height = balanced_height(b->node_count + 1, sa->max_level);
+        } else {
+            uint8_t level = sa->level(sa->prng_state,
+                &sa->prng_state, sa->udata) + 1;
+            if (level >= sa->max_level) { level = sa->max_level - 1; }
+            height = level + 1;
+        }
 
-        struct node *new = node_alloc(level + 1, sa->node_size,
-            sa->mem, sa->udata, sa->use_values);
+        struct node *new = node_alloc(sa, height, sa->node_size);
         if (new == NULL) {
             return SKIPARRAY_BUILDER_APPEND_ERROR_MEMORY;
         }
@@ -935,6 +1156,8 @@ skiparray_builder_append(struct skiparray_builder *b,
         new->offset = 0;
         last = new;
         b->last = last;
+        b->node_count++;
+        page_trim(sa, last);
     }
 
     last->keys[last->count] = key;
@@ -959,62 +1182,540 @@ skiparray_builder_finish(struct skiparray_builder **b,
     assert(builder != NULL);
 
     *sa = builder->sa;
-    (*sa)->mem(builder, 0, (*sa)->udata);
+    (*sa)->mem(builder, 0, (*sa)->mem_udata);
 }
 
+/* Walk SA's pairs and CHANGES together, in key order. With B, append
+ * the merged pairs to it; otherwise, pass everything that the merge
+ * drops to the free callback. */
+static bool
+merge_walk(struct skiparray *sa, struct skiparray_builder *b,
+    const struct skiparray_change *changes, size_t count) {
+    struct node *n = sa->nodes[0];
+    uint16_t i = 0;
+    size_t c = 0;
+
+    for (;;) {
+        while (n != NULL && i == n->count) {
+            n = n->fwd[0];
+            i = 0;
+        }
+        if (n == NULL && c == count) { break; }
+
+        void *key = (n == NULL ? NULL : n->keys[n->offset + i]);
+        void *value = (n == NULL || !sa->use_values
+            ? NULL : n->values[n->offset + i]);
+        const struct skiparray_change *ch = (c < count ? &changes[c] : NULL);
+        if (n != NULL && ch != NULL) { COUNTER_ADD(sa, cmp_calls, 1); }
+        const int res = (n == NULL ? 1 : ch == NULL ? -1
+            : sa->cmp(key, ch->key, sa->udata));
+
+        if (res < 0) {          /* unchanged */
+            if (b != NULL && skiparray_builder_append(b, key, value)
+                != SKIPARRAY_BUILDER_APPEND_OK) {
+                return false;
+            }
+            i++;
+            continue;
+        }
+
+        if (!ch->forget) {
+            if (b != NULL && skiparray_builder_append(b, ch->key, ch->value)
+                != SKIPARRAY_BUILDER_APPEND_OK) {
+                return false;
+            }
+        } else if (b == NULL) {
+            sa->free(ch->key, NULL, sa->udata);
+        }
+        if (res == 0) {         /* replaced or forgotten */
+            if (b == NULL) { sa->free(key, value, sa->udata); }
+            i++;
+        }
+        c++;
+    }
+    return true;
+}
+
+bool
+skiparray_merge_changes(struct skiparray *sa,
+    const struct skiparray_change *changes, size_t count) {
+    assert(sa->pager == NULL);
+    assert(!has_iterators(sa));
+
+    /* Build the merged pairs as a new skiparray with the same
+     * settings, then move its nodes over. */
+    struct skiparray_config cfg = {
+        .node_size = sa->node_size,
+        .node_size_min = sa->node_size_min,
+        .max_level = sa->max_level,
+        .seed = sa->prng_state,
+        .ignore_values = !sa->use_values,
+        .cmp = sa->cmp,
+        .memory = (sa->arena == NULL ? sa->mem : NULL),
+        .level = sa->level,
+        .udata = sa->udata,
+        .pool = sa->pool,
+        .arena = sa->arena,
+    };
+    struct skiparray_builder *b = NULL;
+    if (builder_new(&cfg, true, false, &b) != SKIPARRAY_BUILDER_NEW_OK) {
+        return false;
+    }
+    if (!merge_walk(sa, b, changes, count)) {
+        skiparray_builder_free(b);
+        return false;
+    }
+    struct skiparray *merged = NULL;
+    skiparray_builder_finish(&b, &merged);
+
+    if (sa->free != NULL) { (void)merge_walk(sa, NULL, changes, count); }
+
+    struct node *n = sa->nodes[0];
+    while (n != NULL) {
+        struct node *next = n->fwd[0];
+        node_free(sa, n);
+        n = next;
+    }
+    for (size_t i = 0; i < sa->max_level; i++) {
+        sa->nodes[i] = merged->nodes[i];
+    }
+    sa->height = merged->height;
+    sa->prng_state = merged->prng_state;
+    for (n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        n->id = sa->next_node_id++;
+    }
+    sa->tail_stale = UINT32_MAX;
+    sa->compacting = false;
+    sa->compact_cursor = NULL;
+    sa->compact_index = 0;
+
+    if (merged->pool != NULL) { merged->pool->users--; }
+    merged->mem(merged, 0, merged->mem_udata);
+    return true;
+}
+
+enum skiparray_compact_res
+skiparray_compact(struct skiparray *sa, double target_fill) {
+    return skiparray_compact_step(sa, target_fill, SIZE_MAX);
+}
+
+enum skiparray_compact_res
+skiparray_compact_step(struct skiparray *sa, double target_fill,
+    size_t budget) {
+    assert(sa != NULL);
+    if (!(target_fill > 0 && target_fill <= 1.0) || budget == 0) {
+        return SKIPARRAY_COMPACT_ERROR_MISUSE;
+    }
+    if (has_iterators(sa)) { return SKIPARRAY_COMPACT_ERROR_LOCKED; }
+
+    /* An emptied node stays linked only if it's the lone first node,
+     * so an empty cursor has nothing to resume after; start over. */
+    if (!sa->compacting
+        || (sa->compact_cursor != NULL && sa->compact_cursor->count == 0)) {
+        sa->compacting = true;
+        sa->compact_cursor = NULL;
+        sa->compact_index = 0;
+    }
+
+    /* Predecessors of the next node to compact, on each level.
+     * NULL means the next node is (or would be) first on that level. */
+    struct node *trail[SKIPARRAY_MAX_MAX_LEVEL];
+    compact_find_trail(sa, sa->compact_cursor, trail);
+
+    while (budget > 0) {
+        struct node *n = (sa->compact_cursor == NULL
+            ? sa->nodes[0] : sa->compact_cursor->fwd[0]);
+        if (n == NULL || n->count == 0) { break; }
+
+        page_trim(sa, n);
+        if (!node_will_change(sa, n)
+            || !compact_fill_node(sa, n, target_fill)) {
+            return SKIPARRAY_COMPACT_ERROR_PAGE;
+        }
+
+        const uint8_t height = (sa->compact_index == 0
+            ? 1 : balanced_height(sa->compact_index, sa->max_level));
+        if (n->height != height) {
+            n = compact_set_height(sa, n, trail, height);
+            if (n == NULL) { return SKIPARRAY_COMPACT_ERROR_MEMORY; }
+        }
+
+        for (size_t i = 0; i < n->height; i++) { trail[i] = n; }
+        sa->compact_cursor = n;
+        sa->compact_index++;
+        budget--;
+
+        if (n->fwd[0] == NULL) { break; }
+    }
+
+    struct node *cursor = sa->compact_cursor;
+    if (cursor != NULL && cursor->fwd[0] != NULL) {
+        return SKIPARRAY_COMPACT_MORE;
+    }
+    sa->compacting = false;
+    sa->compact_cursor = NULL;
+    return SKIPARRAY_COMPACT_DONE;
+}
+
+/* Find the last node on each level at or before CURSOR, by its last
+ * key, since any node between compaction steps may have changed. */
+static void
+compact_find_trail(const struct skiparray *sa,
+    const struct node *cursor, struct node **trail) {
+    for (size_t i = 0; i < sa->max_level; i++) { trail[i] = NULL; }
+    if (cursor == NULL) { return; }
+    assert(cursor->count > 0);
+
+    const void *key = node_last_key(cursor);
+    struct node *cur = NULL;
+    for (int level = sa->height - 1; level >= 0; level--) {
+        struct node *next = (cur ? cur->fwd[level] : sa->nodes[level]);
+        while (next != NULL
+            && (COUNTER_ADD(sa, cmp_calls, 1),
+                sa->cmp(node_last_key(next), key, sa->udata) <= 0)) {
+            cur = next;
+            next = cur->fwd[level];
+        }
+        trail[level] = cur;
+    }
+    assert(trail[0] == cursor);
+}
+
+/* Move pairs from the following nodes into N until it is filled to
+ * TARGET_FILL of its limit (but at least half), unlinking any nodes
+ * that are emptied. A partially drained node (other than the last) is
+ * never left below half full. Returns false, with N partly filled, if
+ * a following node's page can't be read. */
+static bool
+compact_fill_node(struct skiparray *sa, struct node *n, double target_fill) {
+    uint16_t target = (uint16_t)(target_fill * n->limit);
+    if (target < n->limit/2) { target = n->limit/2; }
+    if (n->count >= target) { return true; }
+
+    if (n->offset > 0) {
+        /* move to front, to make room */
+        shift_pairs(sa, n, 0, n->offset, n->count);
+        n->offset = 0;
+    }
+
+    while (n->count < target && n->fwd[0] != NULL) {
+        struct node *next = n->fwd[0];
+        if (!node_will_change(sa, next)) { return false; }
+        const uint16_t required = next->limit/2;
+        uint16_t to_move = target - n->count;
+        if (to_move >= next->count) {
+            to_move = next->count;
+        } else if (next->count - to_move < required && next->fwd[0] != NULL) {
+            if (n->count + next->count <= n->limit) {
+                to_move = next->count;
+            } else if (next->count > required) {
+                to_move = next->count - required;
+            } else {
+                break;
+            }
+        }
+
+        LOG(2, "%s: moving %" PRIu16 " pairs from %p to %p\n",
+            __func__, to_move, (void *)next, (void *)n);
+        move_pairs(sa, n, next, n->count, next->offset, to_move);
+        n->count += to_move;
+        next->count -= to_move;
+        next->offset += to_move;
+
+        if (next->count > 0) { break; }
+        next->offset = 0;
+        unlink_node(sa, next);
+    }
+    return true;
+}
+
+/* Replace N with a node of the given height, linked after TRAIL on
+ * every level. Returns the new node, or NULL (leaving N in place) on
+ * allocation failure. */
 static struct node *
-node_alloc(uint8_t height, uint16_t node_size,
-    skiparray_memory_fun *mem, void *udata, bool use_values) {
-    LOG(2, "%s: height %u, size %" PRIu16 "\n", __func__, height, node_size);
+compact_set_height(struct skiparray *sa, struct node *n,
+    struct node **trail, uint8_t height) {
+    struct node *new = node_alloc(sa, height, n->capacity);
+    if (new == NULL) { return NULL; }
+
+    move_pairs(sa, new, n, 0, n->offset, n->count);
+    new->count = n->count;
+    new->offset = 0;
+    new->limit = n->limit;
+    new->writes = n->writes;
+    new->scans = n->scans;
+
+    const uint8_t max_height = (height > n->height ? height : n->height);
+    for (size_t i = 0; i < max_height; i++) {
+        struct node *next;
+        if (i < n->height) {
+            next = n->fwd[i];
+        } else if (trail[i] != NULL) {
+            next = trail[i]->fwd[i];
+        } else {
+            next = (i < sa->height ? sa->nodes[i] : NULL);
+        }
+
+        struct node *link = next;
+        if (i < height) {
+            new->fwd[i] = next;
+            link = new;
+        }
+        if (trail[i] != NULL) {
+            trail[i]->fwd[i] = link;
+        } else {
+            sa->nodes[i] = link;
+        }
+    }
+
+    new->back = n->back;
+    if (new->fwd[0] != NULL) { new->fwd[0]->back = new; }
+    digest_link(sa, new);
+
+    while (sa->height < sa->max_level && sa->nodes[sa->height] != NULL) {
+        sa->height++;
+    }
+    while (sa->height > 1 && sa->nodes[sa->height - 1] == NULL) {
+        sa->height--;
+    }
+
+    LOG(2, "%s: replaced %p (height %u) with %p (height %u)\n",
+        __func__, (void *)n, n->height, (void *)new, new->height);
+    node_free(sa, n);
+    return new;
+}
+
+/* If a node is freed while an incremental compaction is in progress,
+ * resume after the node before it. */
+static void
+compact_forget_node(struct skiparray *sa, struct node *n) {
+    if (sa->compacting && sa->compact_cursor == n) {
+        sa->compact_cursor = n->back;
+        if (sa->compact_index > 0) { sa->compact_index--; }
+    }
+}
+
+/* Height for the INDEX-th node (> 0) of a balanced build: one more
+ * than the number of trailing zero bits in its index. */
+static uint8_t
+balanced_height(size_t index, uint8_t max_level) {
+    assert(index > 0);
+    uint8_t height = 1;
+    while ((index & 1) == 0 && height < max_level) {
+        index >>= 1;
+        height++;
+    }
+    return height;
+}
+
+static struct node *
+node_alloc(struct skiparray *sa, uint8_t height, uint16_t capacity) {
+    const uint16_t node_size = sa->node_size;
+    LOG(2, "%s: height %u, capacity %" PRIu16 "\n", __func__, height, capacity);
     assert(height >= 1);
     assert(node_size >= 2);
+    assert(capacity >= 1 && capacity <= node_size);
 
     struct node *res = NULL;
     void **keys = NULL;
     void **values = NULL;
 
-    const size_t alloc_size = sizeof(struct node) +
-      height * sizeof(struct node *);
-    res = mem(NULL, alloc_size, udata);
-    if (res == NULL) { goto cleanup; }
-    memset(res, 0x00, alloc_size);
+    if (sa->pool != NULL) {
+        /* The header, keys, and values share one pooled block. */
+        struct skiparray_pool *pool = sa->pool;
+        assert(height <= pool->max_level);
+        res = skiparray_pool_get(pool);
+        if (res == NULL) { return NULL; }
+        memset(res, 0x00, pool->block_size);
+        keys = (void **)((char *)res + pool->header_size);
+        if (sa->use_values) { values = keys + node_size; }
+        capacity = node_size;
+    } else {
+        skiparray_memory_fun *mem = sa->mem;
+        void *udata = sa->mem_udata;
 
-    keys = mem(NULL, node_size * sizeof(keys[0]), udata);
-    if (keys == NULL) { goto cleanup; }
-    memset(keys, 0x00, node_size * sizeof(keys[0]));
+        const size_t alloc_size = sizeof(struct node) +
+          height * sizeof(struct node *);
+        res = mem(NULL, alloc_size, udata);
+        if (res == NULL) { goto cleanup; }
+        memset(res, 0x00, alloc_size);
 
-    if (use_values) {
-        values = mem(NULL, node_size * sizeof(values[0]), udata);
-        if (values == NULL) { goto cleanup; }
-        memset(values, 0x00, node_size * sizeof(values[0]));
+        keys = mem(NULL, capacity * sizeof(keys[0]), udata);
+        if (keys == NULL) { goto cleanup; }
+        memset(keys, 0x00, capacity * sizeof(keys[0]));
+
+        if (sa->use_values) {
+            values = mem(NULL, capacity * sizeof(values[0]), udata);
+            if (values == NULL) { goto cleanup; }
+            memset(values, 0x00, capacity * sizeof(values[0]));
+        }
     }
 
     struct node fields = {
         .height = height,
-        .offset = node_size / 2,
+        .offset = capacity / 2,
         .count = 0,
+        .capacity = capacity,
+        .limit = node_size,
         .keys = keys,
         .values = values,
+        .id = sa->next_node_id++,
+        .changed = true,
+        .digest_stale = UINT32_MAX,
     };
     memcpy(res, &fields, sizeof(fields));
     for (uint8_t i = 0; i < height; i++) {
         res->fwd[i] = NULL;
     }
+    if (sa->pager != NULL && !skiparray_pager_attach_node(sa->pager, res)) {
+        node_free(sa, res);
+        return NULL;
+    }
     return res;
 
 cleanup:
-    if (res != NULL) { mem(res, 0, udata); }
-    if (keys != NULL) { mem(keys, 0, udata); }
-    if (values != NULL) { mem(values, 0, udata); }
+    if (res != NULL) { sa->mem(res, 0, sa->mem_udata); }
+    if (keys != NULL) { sa->mem(keys, 0, sa->mem_udata); }
+    if (values != NULL) { sa->mem(values, 0, sa->mem_udata); }
     return NULL;
 }
 
+/* Reallocate N's key and value arrays with room for CAPACITY pairs,
+ * keeping the pairs at the same offset if they fit, otherwise moving
+ * them to the front. Returns false (leaving N unchanged) on
+ * allocation failure. Not used with node pools, whose nodes are
+ * always full capacity. */
+static bool
+node_resize(const struct skiparray *sa, struct node *n, uint16_t capacity) {
+    assert(sa->pool == NULL);
+    assert(n->count <= capacity && capacity <= sa->node_size);
+    LOG(2, "%s: %p, capacity %" PRIu16 " -> %" PRIu16 "\n",
+        __func__, (void *)n, n->capacity, capacity);
+
+    skiparray_memory_fun *mem = sa->mem;
+    void *udata = sa->mem_udata;
+
+    void **keys = mem(NULL, capacity * sizeof(keys[0]), udata);
+    if (keys == NULL) { return false; }
+    void **values = NULL;
+    if (n->values != NULL) {
+        values = mem(NULL, capacity * sizeof(values[0]), udata);
+        if (values == NULL) {
+            mem(keys, 0, udata);
+            return false;
+        }
+    }
+
+    const uint16_t offset = (n->offset + n->count <= capacity
+        ? n->offset : 0);
+    memcpy(&keys[offset], &n->keys[n->offset],
+        n->count * sizeof(keys[0]));
+    mem(n->keys, 0, udata);
+    n->keys = keys;
+    if (values != NULL) {
+        memcpy(&values[offset], &n->values[n->offset],
+            n->count * sizeof(values[0]));
+        mem(n->values, 0, udata);
+        n->values = values;
+    }
+    n->offset = offset;
+    n->capacity = capacity;
+    return true;
+}
+
 static void
 node_free(const struct skiparray *sa, struct node *n) {
     if (n == NULL) { return; }
-    sa->mem(n->keys, 0, sa->udata);
-    if (n->values != NULL) { sa->mem(n->values, 0, sa->udata); }
-    sa->mem(n, 0, sa->udata);
+    if (n->rollups != NULL) { sa->mem(n->rollups, 0, sa->mem_udata); }
+    if (sa->pool != NULL) {
+        skiparray_pool_put(sa->pool, n);
+        return;
+    }
+    if (n->page != NULL) { skiparray_pager_detach_node(sa->pager, n); }
+    if (n->keys != NULL) { sa->mem(n->keys, 0, sa->mem_udata); }
+    if (n->values != NULL) { sa->mem(n->values, 0, sa->mem_udata); }
+    sa->mem(n, 0, sa->mem_udata);
+}
+
+/* In paged mode, make sure N's pairs are in memory, noting whether
+ * they are about to change. Returns false if its page can't be read. */
+static bool
+page_in(const struct skiparray *sa, struct node *n, bool dirty) {
+    if (n->page == NULL) { return true; }
+    return skiparray_pager_page_in(sa->pager, n, dirty);
+}
+
+/* Note that N's pairs are about to change: page it in as dirty, flag
+ * it for the next incremental checkpoint, and with digests, mark its
+ * digest (and the rollups over it) stale. Returns false, without
+ * marking anything, if its page can't be read. */
+static bool
+node_will_change(struct skiparray *sa, struct node *n) {
+    if (!page_in(sa, n, true)) { return false; }
+    n->changed = true;
+    if (sa->hash != NULL) { mark_digests_stale(sa, n, false); }
+    return true;
+}
+
+/* Before removing a pair leaves N empty, page in the neighbor that
+ * shift_or_merge (or pop_first) would merge it with, so the removal
+ * can't fail partway through. */
+static bool
+page_in_neighbor(const struct skiparray *sa, struct node *n) {
+    if (n->count > 1) { return true; }
+    struct node *neighbor = (n->fwd[0] != NULL ? n->fwd[0] : n->back);
+    return (neighbor == NULL || page_in(sa, neighbor, false));
+}
+
+/* Mark N's digest stale, and the rollup on each level above over the
+ * span containing it: that of the first node at or after N tall
+ * enough, or past the last one, the tail. Spans over a stale span are
+ * always stale too, so unless FORCE, this stops at the first level
+ * already marked -- for repeated changes to a node, right away. With
+ * FORCE (after nodes are linked or unlinked), N can be NULL, to mark
+ * just the tails. */
+static void
+mark_digests_stale(struct skiparray *sa, struct node *n, bool force) {
+    uint8_t level = 0;
+    for (; level < sa->max_level; level++) {
+        while (n != NULL && n->height <= level) {
+            n = n->fwd[n->height - 1];
+        }
+        if (n == NULL) { break; }
+        const uint32_t bit = (uint32_t)1 << level;
+        if (!force && (n->digest_stale & bit)) { return; }
+        n->digest_stale |= bit;
+    }
+    for (; level < sa->max_level; level++) {
+        const uint32_t bit = (uint32_t)1 << level;
+        if (!force && (sa->tail_stale & bit)) { return; }
+        sa->tail_stale |= bit;
+    }
+}
+
+/* After N is linked in, its spans are new, and the spans after it
+ * that it cut short have changed. */
+static void
+digest_link(struct skiparray *sa, struct node *n) {
+    if (sa->hash == NULL) { return; }
+    mark_digests_stale(sa, n, true);
+    mark_digests_stale(sa, n->fwd[0], true);
+}
+
+/* Before a node is freed (once unlinked), NEXT's spans absorb the ones
+ * that ended at it. */
+static void
+digest_unlink(struct skiparray *sa, struct node *next) {
+    if (sa->hash == NULL) { return; }
+    mark_digests_stale(sa, next, true);
+}
+
+/* In paged mode, page out nodes (other than PIN) to stay within the
+ * cache size. Done at the start of operations, so nodes they use
+ * won't be paged out underneath them. */
+static void
+page_trim(const struct skiparray *sa, const struct node *pin) {
+    if (sa->pager != NULL) { skiparray_pager_trim(sa->pager, pin); }
 }
 
 /* Search for the index <= KEY within KEYS[KEY_COUNT] (according to CMP),
@@ -1057,11 +1758,38 @@ skiparray_bsearch(const void *key, const void * const *keys,
     return false;
 }
 
+#ifdef SKIPARRAY_COUNTERS
+/* Call SA's cmp callback, counting the call. UDATA is SA. */
+static int
+counting_cmp(const void *a, const void *b, void *udata) {
+    const struct skiparray *sa = udata;
+    COUNTER_ADD(sa, cmp_calls, 1);
+    return sa->cmp(a, b, sa->udata);
+}
+
+static void
+count_search(const struct skiparray *sa, uint64_t cmp_calls_before) {
+    uint64_t cmps = sa->counters.cmp_calls - cmp_calls_before;
+    size_t bucket = 0;
+    while (cmps > 0 && bucket < SKIPARRAY_COUNTERS_HIST_BUCKETS - 1) {
+        cmps >>= 1;
+        bucket++;
+    }
+    COUNTER_ADD(sa, searches, 1);
+    COUNTER_ADD(sa, search_cmp_hist[bucket], 1);
+}
+#endif
+
 static bool
 search_within_node(const struct skiparray *sa,
     const void *key, const struct node *n, uint16_t *index) {
+#ifdef SKIPARRAY_COUNTERS
+    return skiparray_bsearch(key, (const void * const *)&n->keys[n->offset],
+        n->count, counting_cmp, (void *)sa, index);
+#else
     return skiparray_bsearch(key, (const void * const *)&n->keys[n->offset],
         n->count, sa->cmp, sa->udata, index);
+#endif
 }
 
 /* Search the chains of nodes, starting at the highest level, and
@@ -1077,6 +1805,9 @@ search(struct search_env *env) {
     skiparray_cmp_fun *cmp = sa->cmp;
     void *udata = sa->udata;
     assert(cmp != NULL);
+#ifdef SKIPARRAY_COUNTERS
+    const uint64_t cmp_calls_before = sa->counters.cmp_calls;
+#endif
 
     struct node *cur = sa->nodes[level];
     LOG(2, "%s: level %d: cur %p\n", __func__, level, (void *)cur);
@@ -1084,6 +1815,9 @@ search(struct search_env *env) {
     if (cur->count == 0) {
         LOG(2, "%s: empty head => NOT_FOUND\n", __func__);
         env->n = cur;
+#ifdef SKIPARRAY_COUNTERS
+        count_search(sa, cmp_calls_before);
+#endif
         return SEARCH_NOT_FOUND;
     }
 
@@ -1101,8 +1835,9 @@ search(struct search_env *env) {
 
         /* Eliminating redundant comparisons after dropping a level
          * doesn't appear to make a significant difference time-wise. */
-        const int cmp_res = cmp(env->key,
-            cur->keys[cur->offset + cur->count - 1], udata);
+        COUNTER_ADD(sa, search_visits[level], 1);
+        COUNTER_ADD(sa, cmp_calls, 1);
+        const int cmp_res = cmp(env->key, node_last_key(cur), udata);
 
         LOG(2, "%s: level %d, cur %p, cmp_res %d\n",
             __func__, level, (void *)cur, cmp_res);
@@ -1110,6 +1845,7 @@ search(struct search_env *env) {
         if (cmp_res < 0) {     /* key < this node's last key */
             /* either in this node or not at all */
             if (level == 0) {   /* find exact pos and return */
+                if (!page_in(sa, cur, false)) { return SEARCH_ERROR_PAGE; }
                 found = search_within_node(sa, env->key, cur, &env->index);
                 LOG(2, "%s: < -- on level 0, found? %d\n", __func__, found);
                 /* If adding a binding to the beginning, put it in the end
@@ -1177,17 +1913,36 @@ search(struct search_env *env) {
     }
 
     if (found) { assert(cur != NULL); }
+    if (!page_in(sa, cur, false)) { return SEARCH_ERROR_PAGE; }
     env->n = cur;
+#ifdef SKIPARRAY_COUNTERS
+    count_search(sa, cmp_calls_before);
+#endif
 
     LOG(2, "%s: exiting with found %d, env->n %p, env->index %" PRIu16 "\n",
         __func__, found, (void *)env->n, env->index);
     return (found ? SEARCH_FOUND : SEARCH_NOT_FOUND);
 }
 
+/* Make sure N has room for one more pair, growing its arrays if
+ * needed. Its pairs are unchanged either way. */
+static bool
+grow_node_for_insert(struct skiparray *sa, struct node *n) {
+    assert(n->count < sa->node_size); /* must fit */
+
+    if (n->count == n->capacity) {
+        uint32_t capacity = 2 * (uint32_t)n->capacity;
+        if (capacity > sa->node_size) { capacity = sa->node_size; }
+        if (!node_resize(sa, n, (uint16_t)capacity)) { return false; }
+    }
+    return true;
+}
+
+/* Open a gap at INDEX for a new pair. N must already have room. */
 static void
 prepare_node_for_insert(struct skiparray *sa,
         struct node *n, uint16_t index) {
-    assert(n->count < sa->node_size); /* must fit */
+    assert(n->count < n->capacity);
 
     LOG(2, "%s: inserting @ %" PRIu16 " on %p, node offset %" PRIu16
         ", count %" PRIu16 "\n",
@@ -1201,27 +1956,27 @@ prepare_node_for_insert(struct skiparray *sa,
             n->offset--;
         } else {                /* shift all forward */
             LOG(2, "%s: shifting all forward by 1\n", __func__);
-            shift_pairs(n, n->offset + 1, n->offset, n->count);
+            shift_pairs(sa, n, n->offset + 1, n->offset, n->count);
         }
     } else if (index < n->count) { /* shift middle */
         if (n->offset > 0) {    /* prefer shifting backward */
             LOG(2, "%s: shifting pairs up to position back 1\n", __func__);
             const uint16_t to_move = index + 1;
-            shift_pairs(n, n->offset - 1, n->offset, to_move);
+            shift_pairs(sa, n, n->offset - 1, n->offset, to_move);
             n->offset--;
         } else {                /* shift forward */
             LOG(2, "%s: shifting pairs after position forward 1\n", __func__);
             assert(n->offset == 0);
             const uint16_t to_move = n->count - index;;
-            shift_pairs(n, index + 1, index, to_move);
+            shift_pairs(sa, n, index + 1, index, to_move);
         }
     } else {                    /* inserting at end */
         assert(index == n->count);
-        assert(n->offset + index <= sa->node_size);
-        if (n->offset + index == sa->node_size) { /* shift all back */
+        assert(n->offset + index <= n->capacity);
+        if (n->offset + index == n->capacity) { /* shift all back */
             LOG(2, "%s: shifting to front, changing offset to 0\n", __func__);
             assert(n->offset > 0);
-            shift_pairs(n, 0, n->offset, n->count);
+            shift_pairs(sa, n, 0, n->offset, n->count);
             n->offset = 0;
         } else {
             LOG(2, "%s: no-op \n", __func__);
@@ -1237,12 +1992,19 @@ prepare_node_for_insert(struct skiparray *sa,
 static bool
 split_node(struct skiparray *sa,
     struct node *n, struct node **res) {
+    TRACE_START(start);
+    /* Only the lone root can have reduced capacity; once it has a
+     * neighbor it may need to absorb a full node in a merge. */
+    if (n->capacity < sa->node_size
+        && !node_resize(sa, n, sa->node_size)) {
+        return false;
+    }
+
     uint8_t level = sa->level(sa->prng_state,
         &sa->prng_state, sa->udata) + 1;
     if (level >= sa->max_level) { level = sa->max_level - 1; }
 
-    struct node *new = node_alloc(level + 1, sa->node_size,
-        sa->mem, sa->udata, sa->use_values);
+    struct node *new = node_alloc(sa, level + 1, sa->node_size);
     if (new == NULL) {
         return false;
     }
@@ -1256,6 +2018,9 @@ split_node(struct skiparray *sa,
     const uint16_t to_move = n->count / 2;
     assert(to_move > 0);
     new->offset = 0;
+    COUNTER_ADD(sa, splits, 1);
+    COUNTER_ADD(sa, moved_bytes, (sa->use_values ? 2 : 1)
+        * to_move * sizeof(n->keys[0]));
 
     memcpy(&new->keys[new->offset],
         &n->keys[n->offset + n->count - to_move],
@@ -1268,6 +2033,7 @@ split_node(struct skiparray *sa,
     n->count -= to_move;
     new->count += to_move;
     new->back = n;
+    new->limit = n->limit;
 
     if (LOG_LEVEL >= 4) {
         dump_raw_bindings("AFTER split n", sa, n);
@@ -1277,6 +2043,7 @@ split_node(struct skiparray *sa,
     *res = new;
     LOG(2, "%s: split node %p (height %u) to %p (height %u), with %u pairs\n",
         __func__, (void *)n, n->height, (void *)new, new->height, new->count);
+    TRACE(sa, SPLIT, start, n->count, new->count, new->height);
     return true;
 }
 
@@ -1289,27 +2056,44 @@ shift_or_merge(struct skiparray *sa, struct node *n) {
      * node is allowed to be empty. */
     if (n == sa->nodes[0] && n->fwd[0] == NULL) {
         LOG(2, "%s: special case, allowing head to be empty\n", __func__);
+        /* Shrink it once it's mostly unused, so skiparrays that grow
+         * and then shrink don't keep their peak memory usage. Failure
+         * just means keeping the larger arrays. */
+        if (sa->pool == NULL && n->capacity > NODE_INITIAL_CAPACITY
+            && n->count <= n->capacity / 4) {
+            (void)node_resize(sa, n, n->capacity / 2);
+        }
         return;
     }
-    const uint16_t required = sa->node_size/2;
+    const uint16_t required = n->limit/2;
     assert(n->count < required); /* node too empty */
+    TRACE_START(start);
 
+    /* If the neighbor can't be read in, leave N under-filled for now.
+     * Callers page it in first when N is empty. */
     struct node *next = n->fwd[0];
+    struct node *neighbor = (next != NULL ? next : n->back);
+    assert(neighbor != NULL);
+    if (!node_will_change(sa, neighbor)) {
+        assert(n->count > 0);
+        return;
+    }
     if (next == NULL) {
-        assert(n->back != NULL);
         struct node *prev = n->back;
 
         /* under-filled last node: possibly combine with previous */
-        if (prev->count + n->count <= sa->node_size) { /* contents will fit */
+        if (prev->count + n->count <= prev->limit) { /* contents will fit */
             LOG(2, "%s: contents will fit in prev, moving and deleting\n",
                 __func__);
             /* move to front, to make room */
-            shift_pairs(prev, 0, prev->offset, prev->count);
+            shift_pairs(sa, prev, 0, prev->offset, prev->count);
             prev->offset = 0;
 
             /* move all pairs */
-            move_pairs(prev, n, prev->count, n->offset, n->count);
+            COUNTER_ADD(sa, merges, 1);
+            move_pairs(sa, prev, n, prev->count, n->offset, n->count);
             prev->count += n->count;
+            TRACE(sa, MERGE, start, prev->count, n->count, 0);
 
             if (n->fwd[0] != NULL) { n->fwd[0]->back = prev; }
             unlink_node(sa, n);
@@ -1318,7 +2102,7 @@ shift_or_merge(struct skiparray *sa, struct node *n) {
             LOG(2, "%s: contents (%" PRIu16 ") won't fit in prev (%"
                 PRIu16 "), leaving alone\n", __func__, n->count, prev->count);
         }
-    } else if (next->count + n->count <= sa->node_size) { /* merge */
+    } else if (next->count + n->count <= n->limit) { /* merge */
         LOG(2, "%s: merging %p with next node %p (%" PRIu16 " + %" PRIu16 ")\n",
             __func__, (void *)n, (void *)next, n->count, next->count);
 
@@ -1329,12 +2113,14 @@ shift_or_merge(struct skiparray *sa, struct node *n) {
 
         if (n->offset > 0) {
             /* move to front, to make room */
-            shift_pairs(n, 0, n->offset, n->count);
+            shift_pairs(sa, n, 0, n->offset, n->count);
             n->offset = 0;
         }
 
-        move_pairs(n, next, n->count, next->offset, next->count);
+        COUNTER_ADD(sa, merges, 1);
+        move_pairs(sa, n, next, n->count, next->offset, next->count);
         n->count += next->count;
+        TRACE(sa, MERGE, start, n->count, next->count, 0);
 
         unlink_node(sa, next);
 
@@ -1345,26 +2131,90 @@ shift_or_merge(struct skiparray *sa, struct node *n) {
             __func__, to_move, (void *)next, (void *)n);
         if (n->offset > 0) {
             /* move to front, to make room */
-            shift_pairs(n, 0, n->offset, n->count);
+            shift_pairs(sa, n, 0, n->offset, n->count);
             n->offset = 0;
         }
 
-        move_pairs(n, next, n->count, next->offset, to_move);
+        COUNTER_ADD(sa, shifts, 1);
+        move_pairs(sa, n, next, n->count, next->offset, to_move);
 
         next->count -= to_move;
         next->offset += to_move;
         n->count += to_move;
         assert(next->count == required);
         assert(n->count <= sa->node_size);
+        TRACE(sa, SHIFT, start, n->count, to_move, 0);
+
+    }
+}
 
+/* With adaptive node sizes, once N has seen enough accesses, halve its
+ * limit if it's mostly written (so later splits leave smaller nodes),
+ * or double it if it's mostly scanned. This doesn't change the
+ * structure, so it's also done while iterating. */
+static void
+adapt_node_limit(struct skiparray *sa, struct node *n) {
+    if (sa->node_size_min == sa->node_size) { return; }
+    if ((uint32_t)n->writes + n->scans < ADAPT_WINDOW) { return; }
+
+    const uint32_t writes = n->writes;
+    const uint32_t scans = n->scans;
+    n->writes = 0;
+    n->scans = 0;
+
+    if (writes > ADAPT_RATIO * scans) {
+        uint16_t limit = n->limit/2;
+        if (limit < sa->node_size_min) { limit = sa->node_size_min; }
+        LOG(2, "%s: hot node %p, limit %" PRIu16 " -> %" PRIu16 "\n",
+            __func__, (void *)n, n->limit, limit);
+        n->limit = limit;
+    } else if (scans > ADAPT_RATIO * writes) {
+        uint32_t limit = 2 * (uint32_t)n->limit;
+        if (limit > sa->node_size) { limit = sa->node_size; }
+        LOG(2, "%s: cold node %p, limit %" PRIu16 " -> %" PRIu32 "\n",
+            __func__, (void *)n, n->limit, limit);
+        n->limit = (uint16_t)limit;
     }
 }
 
+/* With adaptive node sizes, merge the following node into N if both
+ * fit within 3/4 of N's limit, so nodes whose limit has grown
+ * coalesce as they are written. Leaving a quarter free avoids
+ * splitting again right away. */
+static void
+absorb_next_node(struct skiparray *sa, struct node *n) {
+    if (sa->node_size_min == sa->node_size) { return; }
+    struct node *next = n->fwd[0];
+    if (next == NULL) { return; }
+    if ((uint32_t)n->count + next->count > 3 * (uint32_t)n->limit / 4) {
+        return;
+    }
+    if (!node_will_change(sa, next)) { return; } /* try again later */
+    assert(n->capacity == sa->node_size); /* not the lone root */
+
+    LOG(2, "%s: merging %p into %p (%" PRIu16 " + %" PRIu16 ")\n",
+        __func__, (void *)next, (void *)n, next->count, n->count);
+    if (n->offset > 0) {
+        /* move to front, to make room */
+        shift_pairs(sa, n, 0, n->offset, n->count);
+        n->offset = 0;
+    }
+    COUNTER_ADD(sa, merges, 1);
+    TRACE_START(start);
+    move_pairs(sa, n, next, n->count, next->offset, next->count);
+    n->count += next->count;
+    TRACE(sa, MERGE, start, n->count, next->count, 0);
+    next->count = 0;
+    unlink_node(sa, next);
+}
+
 /* Search to find the next-to-last nodes and unlink the now-empty last
  * node from them. */
 static void
 unlink_node(struct skiparray *sa, struct node *n) {
     LOG(2, "%s: unlinking empty node %p\n", __func__, (void *)n);
+    COUNTER_ADD(sa, unlinks, 1);
+    TRACE_START(start);
 
     if (n == sa->nodes[0]) {
         assert(n->fwd[0] != NULL); /* never unlink empty first node */
@@ -1377,16 +2227,22 @@ unlink_node(struct skiparray *sa, struct node *n) {
                 __func__, level, (void *)sa->nodes[level]);
         }
     }
-    while (sa->height > 1 && sa->nodes[sa->height - 1] == NULL) { sa->height--; }
+    shrink_height(sa);
 
     /* Since the node is empty, compare against either the last key
      * in the previous node or the first key in the next. One of
      * them must be available. */
-    const struct node *nearest = (n->back ? n->back : n->fwd[0]);
+    struct node *nearest = (n->back ? n->back : n->fwd[0]);
     assert(nearest != NULL);
-    const uint16_t nearest_index = (n->back
-        ? nearest->offset + nearest->count - 1
-        : nearest->offset);
+    if (n->back == NULL) {
+        /* callers never unlink the first node with the next paged out */
+        const bool paged = page_in(sa, nearest, false);
+        assert(paged);
+        (void)paged;
+    }
+    const void *nearest_key = (n->back
+        ? node_last_key(nearest)
+        : nearest->keys[nearest->offset]);
     /* If using the key in the last node before, compare with <= instead of <. */
     const int cmp_condition = (n->back ? 1 /* res <= 0*/ : 0 /* res < 0 */);
     assert(nearest);
@@ -1399,8 +2255,10 @@ unlink_node(struct skiparray *sa, struct node *n) {
         if (cur == NULL) {
             struct node *head = sa->nodes[level];
             if (head != NULL) {
-                int res = sa->cmp(head->keys[head->offset + head->count - 1],
-                    nearest->keys[nearest_index], sa->udata);
+                COUNTER_ADD(sa, unlink_visits, 1);
+                COUNTER_ADD(sa, cmp_calls, 1);
+                int res = sa->cmp(node_last_key(head),
+                    nearest_key, sa->udata);
                 if (res < cmp_condition) {
                     cur = head;
                 } else {
@@ -1432,8 +2290,10 @@ unlink_node(struct skiparray *sa, struct node *n) {
                 level--;
                 continue;
             }
-            int res = sa->cmp(next->keys[next->offset + next->count - 1],
-                nearest->keys[nearest_index], sa->udata);
+            COUNTER_ADD(sa, unlink_visits, 1);
+            COUNTER_ADD(sa, cmp_calls, 1);
+            int res = sa->cmp(node_last_key(next),
+                nearest_key, sa->udata);
             LOG(2, "%s: cmp_res %d\n", __func__, res);
             if (res < cmp_condition) {
                 LOG(2, "%s: advancing on level %d, %p => %p\n",
@@ -1445,12 +2305,28 @@ unlink_node(struct skiparray *sa, struct node *n) {
             }
         }
     }
+    digest_unlink(sa, n->fwd[0]);
+    compact_forget_node(sa, n);
+    TRACE(sa, UNLINK, start, 0, 0, n->height);
     node_free(sa, n);
 }
 
+/* Drop empty levels from the top, after unlinking a node. */
+static void
+shrink_height(struct skiparray *sa) {
+    uint8_t height = sa->height;
+    while (height > 1 && sa->nodes[height - 1] == NULL) { height--; }
+    if (height != sa->height) {
+        TRACE(sa, HEIGHT, TRACE_NOW, 0, sa->height, height);
+        sa->height = height;
+    }
+}
+
 static void
-shift_pairs(struct node *n,
+shift_pairs(const struct skiparray *sa, struct node *n,
     uint16_t to_pos, uint16_t from_pos, uint16_t count) {
+    COUNTER_ADD(sa, moved_bytes, (sa->use_values ? 2 : 1)
+        * count * sizeof(n->keys[0]));
     memmove(&n->keys[to_pos],
         &n->keys[from_pos],
         count * sizeof(n->keys[0]));
@@ -1462,8 +2338,10 @@ shift_pairs(struct node *n,
 }
 
 static void
-move_pairs(struct node *to, struct node *from,
+move_pairs(const struct skiparray *sa, struct node *to, struct node *from,
     uint16_t to_pos, uint16_t from_pos, uint16_t count) {
+    COUNTER_ADD(sa, moved_bytes, (sa->use_values ? 2 : 1)
+        * count * sizeof(to->keys[0]));
     memcpy(&to->keys[to_pos],
         &from->keys[from_pos],
         count * sizeof(to->keys[0]));
@@ -1477,9 +2355,10 @@ move_pairs(struct node *to, struct node *from,
 static void
 dump_raw_bindings(const char *tag,
     const struct skiparray *sa, const struct node *n) {
+    (void)sa;
     if (LOG_LEVEL > 4) {
         LOG(4, "====== %s\n", tag);
-        for (size_t i = 0; i < sa->node_size; i++) {
+        for (size_t i = 0; i < n->capacity; i++) {
             LOG(4, "%zu: %p => %p\n", i, (void *)n->keys[i],
                 n->values ? (void *)n->values[i] : NULL);
         }
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "skiparray_internal_types.h"
+
+/* Arena: allocations are bumped out of large chunks. Each allocation
+ * is preceded by a word with its (word-rounded) size, so that when it
+ * is released it can go on the free list for allocations of exactly
+ * that size. A skiparray only allocates a handful of distinct sizes
+ * (its header, node headers by height, key and value arrays, iterators,
+ * etc.), so a small fixed table of size classes is enough. */
+
+#define SIZE_CLASS_COUNT 16
+
+struct chunk {
+    struct chunk *next;
+    size_t size;                /* words available in data[] */
+    size_t used;                /* words used */
+    uintptr_t data[];
+};
+
+struct skiparray_arena {
+    size_t chunk_words;
+    skiparray_memory_fun *mem;
+    void *udata;
+
+    struct chunk *chunks;       /* all chunks */
+    struct chunk *current;      /* chunk currently being bumped */
+
+    struct size_class {
+        size_t words;           /* 0: unused */
+        void *head;             /* linked through the first word */
+    } classes[SIZE_CLASS_COUNT];
+
+    struct skiparray_arena_stats stats;
+};
+
+static void *
+arena_def_memory_fun(void *p, size_t nsize, void *udata) {
+    (void)udata;
+    if (p != NULL) {
+        assert(nsize == 0);     /* no realloc used */
+        free(p);
+        return NULL;
+    } else {
+        return malloc(nsize);
+    }
+}
+
+enum skiparray_arena_new_res
+skiparray_arena_new(const struct skiparray_arena_config *config,
+    struct skiparray_arena **arena) {
+    if (config == NULL || arena == NULL) {
+        return SKIPARRAY_ARENA_NEW_ERROR_NULL;
+    }
+
+    skiparray_memory_fun *mem = (config->memory == NULL
+        ? arena_def_memory_fun : config->memory);
+    const size_t chunk_size = (config->chunk_size == 0
+        ? SKIPARRAY_ARENA_DEF_CHUNK_SIZE : config->chunk_size);
+
+    struct skiparray_arena *res = mem(NULL, sizeof(*res), config->udata);
+    if (res == NULL) { return SKIPARRAY_ARENA_NEW_ERROR_MEMORY; }
+    memset(res, 0x00, sizeof(*res));
+
+    res->chunk_words = (chunk_size + sizeof(uintptr_t) - 1)
+      / sizeof(uintptr_t);
+    res->mem = mem;
+    res->udata = config->udata;
+
+    *arena = res;
+    return SKIPARRAY_ARENA_NEW_OK;
+}
+
+void
+skiparray_arena_reset(struct skiparray_arena *arena) {
+    assert(arena != NULL);
+    for (struct chunk *c = arena->chunks; c != NULL; c = c->next) {
+        c->used = 0;
+    }
+    arena->current = arena->chunks;
+    memset(arena->classes, 0x00, sizeof(arena->classes));
+    arena->stats.used = 0;
+}
+
+void
+skiparray_arena_free(struct skiparray_arena *arena) {
+    if (arena == NULL) { return; }
+    struct chunk *c = arena->chunks;
+    while (c != NULL) {
+        struct chunk *next = c->next;
+        arena->mem(c, 0, arena->udata);
+        c = next;
+    }
+    arena->mem(arena, 0, arena->udata);
+}
+
+void
+skiparray_arena_stats(const struct skiparray_arena *arena,
+    struct skiparray_arena_stats *stats) {
+    assert(arena != NULL);
+    assert(stats != NULL);
+    memcpy(stats, &arena->stats, sizeof(*stats));
+}
+
+static struct size_class *
+get_class(struct skiparray_arena *arena, size_t words, bool add) {
+    for (size_t i = 0; i < SIZE_CLASS_COUNT; i++) {
+        struct size_class *sc = &arena->classes[i];
+        if (sc->words == words) { return sc; }
+        if (sc->words == 0) {
+            if (!add) { return NULL; }
+            sc->words = words;
+            return sc;
+        }
+    }
+    return NULL;                /* table full: not recycled */
+}
+
+static uintptr_t *
+bump(struct skiparray_arena *arena, size_t words) {
+    struct chunk *c = arena->current;
+    while (c != NULL && c->size - c->used < words) {
+        /* Only move on to an already allocated chunk (after a reset)
+         * if the allocation fits, otherwise add one after current. */
+        if (c->next == NULL || c->next->size < words) {
+            c = NULL;
+            break;
+        }
+        c = c->next;
+        arena->current = c;
+    }
+
+    if (c == NULL) {
+        const size_t size = (words > arena->chunk_words
+            ? words : arena->chunk_words);
+        c = arena->mem(NULL, sizeof(*c) + size * sizeof(uintptr_t),
+            arena->udata);
+        if (c == NULL) { return NULL; }
+        c->size = size;
+        c->used = 0;
+        if (arena->current == NULL) {
+            c->next = arena->chunks;
+            arena->chunks = c;
+        } else {
+            c->next = arena->current->next;
+            arena->current->next = c;
+        }
+        arena->current = c;
+        arena->stats.chunks++;
+        arena->stats.reserved += size * sizeof(uintptr_t);
+    }
+
+    uintptr_t *res = &c->data[c->used];
+    c->used += words;
+    arena->stats.used += words * sizeof(uintptr_t);
+    return res;
+}
+
+void *
+skiparray_arena_memory_fun(void *p, size_t nsize, void *udata) {
+    struct skiparray_arena *arena = udata;
+    assert(arena != NULL);
+
+    if (p != NULL) {
+        assert(nsize == 0);     /* no realloc used */
+        uintptr_t *header = (uintptr_t *)p - 1;
+        struct size_class *sc = get_class(arena, header[0], true);
+        if (sc != NULL) {
+            memcpy(p, &sc->head, sizeof(void *));
+            sc->head = p;
+        }
+        return NULL;
+    }
+
+    size_t words = (nsize + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+    if (words == 0) { words = 1; } /* room for the free list link */
+
+    struct size_class *sc = get_class(arena, words, false);
+    if (sc != NULL && sc->head != NULL) {
+        void *res = sc->head;
+        memcpy(&sc->head, res, sizeof(void *));
+        arena->stats.recycled++;
+        return res;
+    }
+
+    uintptr_t *header = bump(arena, words + 1);
+    if (header == NULL) { return NULL; }
+    header[0] = words;
+    return &header[1];
+}
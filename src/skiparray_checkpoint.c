@@ -0,0 +1,672 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "skiparray_serialize_internal.h"
+#include "splitmix64_stateless.h"
+
+/* Checkpoint format, version 1:
+ *
+ * Header (CK_HEADER_SIZE bytes):
+ *     0  magic, "SKIPARCK"
+ *     8  u16 version
+ *    10  u16 flags (FORMAT_FLAG_VALUES, FORMAT_FLAG_CHECKSUM, CK_FLAG_BASE)
+ *    12  u16 node_size of the skiparray (informational)
+ *    14  u16 reserved, 0
+ *    16  u64 chain ID, shared by a base and its deltas
+ *    24  u64 sequence number: 0 for the base, then 1, 2, ...
+ *    32  u64 node count in the manifest
+ *    40  u32 reserved, 0
+ *    44  u32 CRC-32 of bytes 0-43, or 0 without FORMAT_FLAG_CHECKSUM
+ *
+ * Then a block per node written (CK_BLOCK_HEADER_SIZE bytes, then
+ * the payload, as in the dump format):
+ *     0  u64 node ID, > 0
+ *     8  u32 pair count, > 0
+ *    12  u32 payload length
+ *    16  payload
+ *     -  u32 CRC-32 of the block header and payload, with
+ *        FORMAT_FLAG_CHECKSUM
+ * and an end block, with everything 0.
+ *
+ * Then the manifest, listing the non-empty nodes' IDs in key order:
+ *     0  u32 length
+ *     4  the difference from the previous ID (starting from 0) of
+ *        each, zigzag encoded, as a LEB128 varint
+ *     -  u32 CRC-32 of the length and IDs, with FORMAT_FLAG_CHECKSUM
+ *
+ * A node's pairs are in the block with its ID in the newest
+ * checkpoint (of the chain) that has one. */
+
+#define CK_MAGIC "SKIPARCK"
+#define CK_VERSION 1
+#define CK_HEADER_SIZE 48
+#define CK_BLOCK_HEADER_SIZE 16
+#define CK_MANIFEST_HEADER_SIZE 4
+#define CK_VARINT_MAX 10
+
+#define CK_FLAG_BASE 0x04
+#define CK_FLAG_MASK (FORMAT_FLAG_MASK | CK_FLAG_BASE)
+
+/* A delta's block, kept while loading until its pairs are appended. */
+struct ck_block {
+    uint64_t id;                /* 0: empty slot */
+    uint32_t count;
+    uint32_t len;
+    size_t file;                /* index of the checkpoint it's from */
+    uint8_t *payload;
+};
+
+struct ck_table {
+    skiparray_memory_fun *mem;
+    void *mem_udata;
+    struct ck_block *blocks;
+    size_t size;                /* power of 2, or 0 */
+    size_t used;
+};
+
+static uint64_t
+zigzag(int64_t x) {
+    return ((uint64_t)x << 1) ^ (uint64_t)(x >> 63);
+}
+
+static int64_t
+unzigzag(uint64_t x) {
+    return (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+}
+
+static void
+put_varint(struct skiparray_buf *b, uint64_t x) {
+    while (x >= 0x80) {
+        b->bytes[b->used++] = (uint8_t)(x | 0x80);
+        x >>= 7;
+    }
+    b->bytes[b->used++] = (uint8_t)x;
+}
+
+static bool
+get_varint(const uint8_t *buf, size_t len, size_t *pos, uint64_t *x) {
+    uint64_t res = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (*pos == len) { return false; }
+        const uint8_t byte = buf[(*pos)++];
+        res |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *x = res;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Add a CRC-32 of B's contents (with CHECKSUM), and write them out. */
+static enum skiparray_dump_res
+write_section(struct skiparray_buf *b,
+    const struct skiparray_dump_config *config) {
+    if (config->checksum) {
+        if (!skiparray_buf_reserve(b, FORMAT_CRC_SIZE)) {
+            return SKIPARRAY_DUMP_ERROR_MEMORY;
+        }
+        put_u32(&b->bytes[b->used], skiparray_crc32(0, b->bytes, b->used));
+        b->used += FORMAT_CRC_SIZE;
+    }
+    if (!config->write(b->bytes, b->used, config->udata)) {
+        return SKIPARRAY_DUMP_ERROR_WRITE;
+    }
+    b->used = 0;
+    return SKIPARRAY_DUMP_OK;
+}
+
+static enum skiparray_dump_res
+write_node_block(const struct skiparray *sa, struct node *n,
+    struct skiparray_buf *b, const struct skiparray_dump_config *config) {
+    if (!dump_page_in(sa, n)) { return SKIPARRAY_DUMP_ERROR_PAGE; }
+    if (!skiparray_buf_reserve(b, CK_BLOCK_HEADER_SIZE)) {
+        return SKIPARRAY_DUMP_ERROR_MEMORY;
+    }
+    b->used = CK_BLOCK_HEADER_SIZE;
+
+    for (uint16_t i = 0; i < n->count; i++) {
+        enum skiparray_dump_res res = skiparray_buf_append_item(b,
+            config->encode_key, n->keys[n->offset + i], config->udata);
+        if (res != SKIPARRAY_DUMP_OK) { return res; }
+        if (sa->use_values) {
+            res = skiparray_buf_append_item(b, config->encode_value,
+                n->values[n->offset + i], config->udata);
+            if (res != SKIPARRAY_DUMP_OK) { return res; }
+        }
+    }
+
+    const size_t payload = b->used - CK_BLOCK_HEADER_SIZE;
+    if (payload > UINT32_MAX) { return SKIPARRAY_DUMP_ERROR_ENCODE; }
+    put_u64(&b->bytes[0], n->id);
+    put_u32(&b->bytes[8], n->count);
+    put_u32(&b->bytes[12], (uint32_t)payload);
+    return write_section(b, config);
+}
+
+static enum skiparray_dump_res
+write_manifest(const struct skiparray *sa, struct skiparray_buf *b,
+    const struct skiparray_dump_config *config) {
+    if (!skiparray_buf_reserve(b, CK_MANIFEST_HEADER_SIZE)) {
+        return SKIPARRAY_DUMP_ERROR_MEMORY;
+    }
+    b->used = CK_MANIFEST_HEADER_SIZE;
+
+    /* Nodes created in order (as by the builder) have consecutive
+     * IDs, so most deltas fit in a byte. */
+    uint64_t prev = 0;
+    for (struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        if (n->count == 0) { continue; }
+        if (!skiparray_buf_reserve(b, CK_VARINT_MAX)) {
+            return SKIPARRAY_DUMP_ERROR_MEMORY;
+        }
+        put_varint(b, zigzag((int64_t)(n->id - prev)));
+        prev = n->id;
+    }
+
+    const size_t len = b->used - CK_MANIFEST_HEADER_SIZE;
+    if (len > UINT32_MAX) { return SKIPARRAY_DUMP_ERROR_ENCODE; }
+    put_u32(&b->bytes[0], (uint32_t)len);
+    return write_section(b, config);
+}
+
+static enum skiparray_dump_res
+checkpoint(struct skiparray *sa, const struct skiparray_dump_config *config,
+    bool base) {
+    if (sa == NULL || config == NULL
+        || config->write == NULL || config->encode_key == NULL
+        || (sa->use_values && config->encode_value == NULL)) {
+        return SKIPARRAY_DUMP_ERROR_MISUSE;
+    }
+    if (sa->checkpoint_chain == 0) { base = true; }
+
+    uint64_t chain = sa->checkpoint_chain;
+    uint64_t seq = sa->checkpoint_seq + 1;
+    if (base) {
+        /* Anything distinct from the previous chain will do; this is
+         * only to catch checkpoints being mixed up. */
+        do {
+            chain = splitmix64_stateless(chain ^ sa->prng_state
+                ^ sa->next_node_id ^ (uint64_t)(uintptr_t)sa);
+        } while (chain == 0 || chain == sa->checkpoint_chain);
+        seq = 0;
+    }
+
+    uint64_t node_count = 0;
+    for (struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        if (n->count > 0) { node_count++; }
+    }
+
+    uint8_t header[CK_HEADER_SIZE];
+    memset(header, 0x00, sizeof(header));
+    memcpy(header, CK_MAGIC, FORMAT_MAGIC_SIZE);
+    put_u16(&header[8], CK_VERSION);
+    put_u16(&header[10], (sa->use_values ? FORMAT_FLAG_VALUES : 0)
+        | (config->checksum ? FORMAT_FLAG_CHECKSUM : 0)
+        | (base ? CK_FLAG_BASE : 0));
+    put_u16(&header[12], sa->node_size);
+    put_u64(&header[16], chain);
+    put_u64(&header[24], seq);
+    put_u64(&header[32], node_count);
+    if (config->checksum) {
+        put_u32(&header[44], skiparray_crc32(0, header, 44));
+    }
+    if (!config->write(header, sizeof(header), config->udata)) {
+        return SKIPARRAY_DUMP_ERROR_WRITE;
+    }
+
+    struct skiparray_buf b = {
+        .mem = sa->mem,
+        .mem_udata = sa->mem_udata,
+    };
+    enum skiparray_dump_res res = SKIPARRAY_DUMP_OK;
+
+    for (struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        if (n->count == 0 || (!base && !n->changed)) { continue; }
+        res = write_node_block(sa, n, &b, config);
+        if (res != SKIPARRAY_DUMP_OK) { goto cleanup; }
+    }
+
+    /* end block */
+    if (!skiparray_buf_reserve(&b, CK_BLOCK_HEADER_SIZE)) {
+        res = SKIPARRAY_DUMP_ERROR_MEMORY;
+        goto cleanup;
+    }
+    memset(b.bytes, 0x00, CK_BLOCK_HEADER_SIZE);
+    b.used = CK_BLOCK_HEADER_SIZE;
+    res = write_section(&b, config);
+    if (res != SKIPARRAY_DUMP_OK) { goto cleanup; }
+
+    res = write_manifest(sa, &b, config);
+    if (res != SKIPARRAY_DUMP_OK) { goto cleanup; }
+
+    /* Only now that it's all written does it count. */
+    for (struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        n->changed = false;
+    }
+    sa->checkpoint_chain = chain;
+    sa->checkpoint_seq = seq;
+
+cleanup:
+    skiparray_buf_free(&b);
+    return res;
+}
+
+enum skiparray_dump_res
+skiparray_checkpoint_incremental(struct skiparray *sa,
+    const struct skiparray_dump_config *config) {
+    return checkpoint(sa, config, false);
+}
+
+enum skiparray_dump_res
+skiparray_checkpoint_base(struct skiparray *sa,
+    const struct skiparray_dump_config *config) {
+    return checkpoint(sa, config, true);
+}
+
+static struct ck_block *
+table_find(const struct ck_table *t, uint64_t id) {
+    const size_t mask = t->size - 1;
+    for (size_t i = splitmix64_stateless(id) & mask; ; i = (i + 1) & mask) {
+        struct ck_block *slot = &t->blocks[i];
+        if (slot->id == id || slot->id == 0) { return slot; }
+    }
+}
+
+/* Make room for one more block, growing at 3/4 full. */
+static bool
+table_grow(struct ck_table *t) {
+    if (t->size > 0 && 4*(t->used + 1) <= 3*t->size) { return true; }
+    const size_t nsize = (t->size == 0 ? 64 : 2*t->size);
+    if (nsize > SIZE_MAX / sizeof(struct ck_block)) { return false; }
+    struct ck_block *nblocks = t->mem(NULL,
+        nsize * sizeof(struct ck_block), t->mem_udata);
+    if (nblocks == NULL) { return false; }
+    memset(nblocks, 0x00, nsize * sizeof(struct ck_block));
+
+    struct ck_table nt = {
+        .mem = t->mem,
+        .mem_udata = t->mem_udata,
+        .blocks = nblocks,
+        .size = nsize,
+        .used = t->used,
+    };
+    for (size_t i = 0; i < t->size; i++) {
+        if (t->blocks[i].id != 0) {
+            *table_find(&nt, t->blocks[i].id) = t->blocks[i];
+        }
+    }
+    if (t->blocks != NULL) { t->mem(t->blocks, 0, t->mem_udata); }
+    *t = nt;
+    return true;
+}
+
+static void
+table_free(struct ck_table *t) {
+    for (size_t i = 0; i < t->size; i++) {
+        if (t->blocks[i].id != 0) {
+            t->mem(t->blocks[i].payload, 0, t->mem_udata);
+        }
+    }
+    if (t->blocks != NULL) { t->mem(t->blocks, 0, t->mem_udata); }
+}
+
+/* Read a section's next LEN bytes into B, after its header (already
+ * there), and check the whole section's CRC-32. */
+static enum skiparray_load_res
+read_section(struct skiparray_buf *b, size_t len, bool checksum,
+    const struct skiparray_load_config *load_config) {
+    const size_t rest = len + (checksum ? FORMAT_CRC_SIZE : 0);
+    if (!skiparray_buf_reserve(b, rest)) {
+        return SKIPARRAY_LOAD_ERROR_MEMORY;
+    }
+    if (rest > 0 && !load_config->read(&b->bytes[b->used], rest,
+            load_config->udata)) {
+        return SKIPARRAY_LOAD_ERROR_READ;
+    }
+    b->used += len;
+    if (checksum && get_u32(&b->bytes[b->used])
+        != skiparray_crc32(0, b->bytes, b->used)) {
+        return SKIPARRAY_LOAD_ERROR_CHECKSUM;
+    }
+    return SKIPARRAY_LOAD_OK;
+}
+
+/* Read a checkpoint's next block into B, setting *ID (0 for the end
+ * block), *COUNT, and *LEN. The payload follows the block header. */
+static enum skiparray_load_res
+read_block(struct skiparray_buf *b, bool checksum,
+    const struct skiparray_load_config *load_config,
+    uint64_t *id, uint32_t *count, uint32_t *len) {
+    b->used = 0;
+    if (!skiparray_buf_reserve(b, CK_BLOCK_HEADER_SIZE)) {
+        return SKIPARRAY_LOAD_ERROR_MEMORY;
+    }
+    if (!load_config->read(b->bytes, CK_BLOCK_HEADER_SIZE,
+            load_config->udata)) {
+        return SKIPARRAY_LOAD_ERROR_READ;
+    }
+    b->used = CK_BLOCK_HEADER_SIZE;
+    *id = get_u64(&b->bytes[0]);
+    *count = get_u32(&b->bytes[8]);
+    *len = get_u32(&b->bytes[12]);
+    if ((*id == 0) != (*count == 0) || (*count == 0 && *len != 0)) {
+        return SKIPARRAY_LOAD_ERROR_FORMAT;
+    }
+    return read_section(b, *len, checksum, load_config);
+}
+
+/* Read the blocks of delta checkpoint FILE into the table, replacing
+ * any older blocks for the same nodes. */
+static enum skiparray_load_res
+read_blocks(struct ck_table *t, struct skiparray_buf *b, size_t file,
+    bool checksum, const struct skiparray_load_config *load_config) {
+    for (;;) {
+        uint64_t id = 0;
+        uint32_t count = 0;
+        uint32_t len = 0;
+        enum skiparray_load_res res = read_block(b, checksum, load_config,
+            &id, &count, &len);
+        if (res != SKIPARRAY_LOAD_OK) { return res; }
+        if (id == 0) { return SKIPARRAY_LOAD_OK; } /* end block */
+
+        uint8_t *payload = t->mem(NULL, len > 0 ? len : 1, t->mem_udata);
+        if (payload == NULL) { return SKIPARRAY_LOAD_ERROR_MEMORY; }
+        memcpy(payload, &b->bytes[CK_BLOCK_HEADER_SIZE], len);
+
+        if (!table_grow(t)) {
+            t->mem(payload, 0, t->mem_udata);
+            return SKIPARRAY_LOAD_ERROR_MEMORY;
+        }
+        struct ck_block *slot = table_find(t, id);
+        if (slot->id == 0) {
+            t->used++;
+        } else {                /* superseded */
+            t->mem(slot->payload, 0, t->mem_udata);
+        }
+        *slot = (struct ck_block) {
+            .id = id,
+            .count = count,
+            .len = len,
+            .file = file,
+            .payload = payload,
+        };
+    }
+}
+
+/* Read the manifest following a checkpoint's blocks into B. */
+static enum skiparray_load_res
+read_manifest(struct skiparray_buf *b, bool checksum,
+    const struct skiparray_load_config *load_config) {
+    b->used = 0;
+    if (!skiparray_buf_reserve(b, CK_MANIFEST_HEADER_SIZE)) {
+        return SKIPARRAY_LOAD_ERROR_MEMORY;
+    }
+    if (!load_config->read(b->bytes, CK_MANIFEST_HEADER_SIZE,
+            load_config->udata)) {
+        return SKIPARRAY_LOAD_ERROR_READ;
+    }
+    b->used = CK_MANIFEST_HEADER_SIZE;
+    return read_section(b, get_u32(&b->bytes[0]), checksum, load_config);
+}
+
+/* Decode the ID after *ID from manifest M, at *POS. */
+static bool
+manifest_next(const struct skiparray_buf *m, size_t *pos, uint64_t *id) {
+    uint64_t delta = 0;
+    if (!get_varint(&m->bytes[CK_MANIFEST_HEADER_SIZE],
+            m->used - CK_MANIFEST_HEADER_SIZE, pos, &delta)) {
+        return false;
+    }
+    *id += (uint64_t)unzigzag(delta);
+    return *id != 0;
+}
+
+static bool
+manifest_done(const struct skiparray_buf *m, size_t pos) {
+    return pos == m->used - CK_MANIFEST_HEADER_SIZE;
+}
+
+/* State for loading a chain. The deltas' blocks are kept in a table,
+ * but the base's are appended as they are read. */
+struct ck_load {
+    struct skiparray_builder *builder;
+    const struct skiparray_config *config;
+    const struct skiparray_load_config *load_configs;
+    bool has_values;
+    bool base_checksum;
+    uint64_t node_count;            /* in the last manifest */
+    struct ck_table table;          /* the deltas' newest blocks */
+    struct skiparray_buf block;     /* block being read */
+    struct skiparray_buf manifest;  /* the last checkpoint's */
+};
+
+/* Read the base's blocks up to the one for node ID, skipping any
+ * superseded or dropped since, and append its pairs. */
+static enum skiparray_load_res
+load_base_block(struct ck_load *l, uint64_t id) {
+    const struct skiparray_load_config *lc = &l->load_configs[0];
+    for (;;) {
+        uint64_t bid = 0;
+        uint32_t count = 0;
+        uint32_t len = 0;
+        enum skiparray_load_res res = read_block(&l->block,
+            l->base_checksum, lc, &bid, &count, &len);
+        if (res != SKIPARRAY_LOAD_OK) { return res; }
+        if (bid == 0) { return SKIPARRAY_LOAD_ERROR_FORMAT; } /* no such node */
+        if (bid == id) {
+            return skiparray_load_pairs(l->builder, l->config, lc,
+                l->has_values, &l->block.bytes[CK_BLOCK_HEADER_SIZE],
+                len, count);
+        }
+    }
+}
+
+/* Append the pairs of each node in the last manifest in order, from
+ * the newest delta with a block for it, or else from the base. Nodes
+ * unchanged since the base still hold the same pairs, so they are in
+ * the same relative order, and the base only needs to be read once. */
+static enum skiparray_load_res
+load_manifest(struct ck_load *l) {
+    size_t pos = 0;
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < l->node_count; i++) {
+        if (!manifest_next(&l->manifest, &pos, &id)) {
+            return SKIPARRAY_LOAD_ERROR_FORMAT;
+        }
+        const struct ck_block *block = (l->table.size == 0
+            ? NULL : table_find(&l->table, id));
+        enum skiparray_load_res res;
+        if (block != NULL && block->id != 0) {
+            res = skiparray_load_pairs(l->builder, l->config,
+                &l->load_configs[block->file], l->has_values,
+                block->payload, block->len, block->count);
+        } else {
+            res = load_base_block(l, id);
+        }
+        if (res != SKIPARRAY_LOAD_OK) { return res; }
+    }
+    return (manifest_done(&l->manifest, pos)
+        ? SKIPARRAY_LOAD_OK : SKIPARRAY_LOAD_ERROR_FORMAT);
+}
+
+/* Load a chain with only a base. Its manifest follows the blocks, which
+ * are already in order, so append them as they are read (noting their
+ * IDs), then check that the manifest lists the same nodes. */
+static enum skiparray_load_res
+load_base_only(struct ck_load *l) {
+    const struct skiparray_load_config *lc = &l->load_configs[0];
+    struct skiparray_buf ids = {
+        .mem = l->block.mem,
+        .mem_udata = l->block.mem_udata,
+    };
+    enum skiparray_load_res res = SKIPARRAY_LOAD_OK;
+    for (;;) {
+        uint64_t id = 0;
+        uint32_t count = 0;
+        uint32_t len = 0;
+        res = read_block(&l->block, l->base_checksum, lc, &id, &count, &len);
+        if (res != SKIPARRAY_LOAD_OK || id == 0) { break; }
+        if (!skiparray_buf_reserve(&ids, sizeof(id))) {
+            res = SKIPARRAY_LOAD_ERROR_MEMORY;
+            break;
+        }
+        put_u64(&ids.bytes[ids.used], id);
+        ids.used += sizeof(id);
+        res = skiparray_load_pairs(l->builder, l->config, lc,
+            l->has_values, &l->block.bytes[CK_BLOCK_HEADER_SIZE],
+            len, count);
+        if (res != SKIPARRAY_LOAD_OK) { break; }
+    }
+    if (res == SKIPARRAY_LOAD_OK) {
+        res = read_manifest(&l->manifest, l->base_checksum, lc);
+    }
+    if (res == SKIPARRAY_LOAD_OK) {
+        if (ids.used / sizeof(uint64_t) != l->node_count) {
+            res = SKIPARRAY_LOAD_ERROR_FORMAT;
+        }
+        size_t pos = 0;
+        uint64_t id = 0;
+        for (size_t i = 0; res == SKIPARRAY_LOAD_OK && i < ids.used;
+             i += sizeof(uint64_t)) {
+            if (!manifest_next(&l->manifest, &pos, &id)
+                || id != get_u64(&ids.bytes[i])) {
+                res = SKIPARRAY_LOAD_ERROR_FORMAT;
+            }
+        }
+        if (res == SKIPARRAY_LOAD_OK && !manifest_done(&l->manifest, pos)) {
+            res = SKIPARRAY_LOAD_ERROR_FORMAT;
+        }
+    }
+    skiparray_buf_free(&ids);
+    return res;
+}
+
+enum skiparray_load_res
+skiparray_load_checkpoints(const struct skiparray_config *config,
+    const struct skiparray_load_config *load_configs, size_t count,
+    struct skiparray **sa) {
+    if (config == NULL || load_configs == NULL || count == 0 || sa == NULL) {
+        return SKIPARRAY_LOAD_ERROR_MISUSE;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (load_configs[i].read == NULL
+            || load_configs[i].decode_key == NULL) {
+            return SKIPARRAY_LOAD_ERROR_MISUSE;
+        }
+    }
+
+    struct skiparray_builder *builder = NULL;
+    enum skiparray_builder_new_res bres = (load_configs[0].balanced
+        ? skiparray_builder_new_balanced(config, true, &builder)
+        : skiparray_builder_new(config, true, &builder));
+    switch (bres) {
+    case SKIPARRAY_BUILDER_NEW_OK:
+        break;
+    case SKIPARRAY_BUILDER_NEW_ERROR_MEMORY:
+        return SKIPARRAY_LOAD_ERROR_MEMORY;
+    default:
+        return SKIPARRAY_LOAD_ERROR_MISUSE;
+    }
+
+    skiparray_memory_fun *mem = builder->sa->mem;
+    void *mem_udata = builder->sa->mem_udata;
+    struct ck_load l = {
+        .builder = builder,
+        .config = config,
+        .load_configs = load_configs,
+        .table = { .mem = mem, .mem_udata = mem_udata },
+        .block = { .mem = mem, .mem_udata = mem_udata },
+        .manifest = { .mem = mem, .mem_udata = mem_udata },
+    };
+    enum skiparray_load_res res = SKIPARRAY_LOAD_OK;
+    uint64_t chain = 0;
+
+    /* Read the base's header, then each delta in full, and only then
+     * the base's blocks, so they can be appended without keeping them. */
+    for (size_t i = 0; i < count; i++) {
+        const struct skiparray_load_config *lc = &load_configs[i];
+        uint8_t header[CK_HEADER_SIZE];
+        if (!lc->read(header, sizeof(header), lc->udata)) {
+            res = SKIPARRAY_LOAD_ERROR_READ;
+            goto cleanup;
+        }
+        const uint16_t flags = get_u16(&header[10]);
+        if (0 != memcmp(header, CK_MAGIC, FORMAT_MAGIC_SIZE)
+            || get_u16(&header[8]) != CK_VERSION
+            || (flags & ~CK_FLAG_MASK) != 0) {
+            res = SKIPARRAY_LOAD_ERROR_FORMAT;
+            goto cleanup;
+        }
+        const bool checksum = flags & FORMAT_FLAG_CHECKSUM;
+        if (checksum
+            && get_u32(&header[44]) != skiparray_crc32(0, header, 44)) {
+            res = SKIPARRAY_LOAD_ERROR_CHECKSUM;
+            goto cleanup;
+        }
+
+        const bool base = flags & CK_FLAG_BASE;
+        const uint64_t seq = get_u64(&header[24]);
+        if (i == 0) {
+            chain = get_u64(&header[16]);
+            l.has_values = flags & FORMAT_FLAG_VALUES;
+            l.base_checksum = checksum;
+            if (!base || seq != 0) {
+                res = SKIPARRAY_LOAD_ERROR_CHAIN;
+                goto cleanup;
+            }
+            if (l.has_values && !config->ignore_values
+                && lc->decode_value == NULL) {
+                res = SKIPARRAY_LOAD_ERROR_MISUSE;
+                goto cleanup;
+            }
+        } else if (base || get_u64(&header[16]) != chain || seq != i
+            || l.has_values != (bool)(flags & FORMAT_FLAG_VALUES)) {
+            res = SKIPARRAY_LOAD_ERROR_CHAIN;
+            goto cleanup;
+        } else if (l.has_values && !config->ignore_values
+            && lc->decode_value == NULL) {
+            res = SKIPARRAY_LOAD_ERROR_MISUSE;
+            goto cleanup;
+        }
+        l.node_count = get_u64(&header[32]);
+        if (i == 0) { continue; }
+
+        res = read_blocks(&l.table, &l.block, i, checksum, lc);
+        if (res != SKIPARRAY_LOAD_OK) { goto cleanup; }
+        /* Only the last checkpoint's manifest matters. */
+        if (i == count - 1) {
+            res = read_manifest(&l.manifest, checksum, lc);
+            if (res != SKIPARRAY_LOAD_OK) { goto cleanup; }
+        }
+    }
+
+    res = (count == 1 ? load_base_only(&l) : load_manifest(&l));
+    if (res != SKIPARRAY_LOAD_OK) { goto cleanup; }
+
+    skiparray_buf_free(&l.block);
+    skiparray_buf_free(&l.manifest);
+    table_free(&l.table);
+    skiparray_builder_finish(&builder, sa);
+    return SKIPARRAY_LOAD_OK;
+
+cleanup:
+    skiparray_buf_free(&l.block);
+    skiparray_buf_free(&l.manifest);
+    table_free(&l.table);
+    skiparray_builder_free(builder);
+    return res;
+}
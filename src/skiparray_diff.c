@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "skiparray_internal_types.h"
+#include "splitmix64_stateless.h"
+
+/* Content digests and diffing.
+ *
+ * A node's digest is the sum of its pairs' mixed hashes, so it only
+ * depends on which pairs it holds, and the digest of any run of nodes
+ * is the sum of theirs. On each level L > 0, the nodes are grouped
+ * into spans, each ending at a node at least L + 1 high (which keeps
+ * the span's rollup), or at the end of the skiparray (the tail, whose
+ * rollup is kept in the skiparray); a span on level L is made of the
+ * spans on level L - 1 within it. Since spans end at their owner, the
+ * rollups over a node can be found by following forward pointers.
+ *
+ * Mutations only mark the digests over the changed nodes stale (see
+ * mark_digests_stale), and they are recomputed here, only for the
+ * stale parts, when a diff asks for them. */
+
+struct side {
+    struct skiparray *sa;
+    struct node *n;             /* NULL once past the end */
+    uint16_t i;
+    const void *last_key;       /* where the tail spans end */
+};
+
+/* In paged mode, read N back in (paging others out first). Returns
+ * false if its page can't be read. */
+static bool
+read_page_in(const struct skiparray *sa, struct node *n) {
+    if (n->page == NULL) { return true; }
+    skiparray_pager_trim(sa->pager, n);
+    return skiparray_pager_page_in(sa->pager, n, false);
+}
+
+static uint64_t
+pair_hash(const struct skiparray *sa, const struct node *n, uint16_t i) {
+    const void *value = (sa->use_values ? n->values[n->offset + i] : NULL);
+    return sa->hash(n->keys[n->offset + i], value, sa->udata);
+}
+
+static bool
+node_digest(struct skiparray *sa, struct node *n, uint64_t *res) {
+    if (n->digest_stale & 1) {
+        if (!read_page_in(sa, n)) { return false; }
+        uint64_t digest = 0;
+        for (uint16_t i = 0; i < n->count; i++) {
+            digest += splitmix64_stateless(pair_hash(sa, n, i));
+        }
+        n->digest = digest;
+        n->digest_stale &= ~(uint32_t)1;
+    }
+    *res = n->digest;
+    return true;
+}
+
+/* The first node at or after N at least LEVEL + 1 high, which ends
+ * the span N is in on LEVEL, or NULL for the tail. */
+static struct node *
+span_end(struct node *n, uint8_t level) {
+    while (n != NULL && n->height <= level) { n = n->fwd[n->height - 1]; }
+    return n;
+}
+
+/* Get the digest of the span on LEVEL from START (which must begin
+ * it) to END, recomputing it from the spans below if stale. */
+static enum skiparray_diff_res
+span_digest(struct skiparray *sa, struct node *start, uint8_t level,
+    struct node *end, uint64_t *digest) {
+    if (start == NULL) {        /* empty tail */
+        *digest = 0;
+        return SKIPARRAY_DIFF_OK;
+    }
+    if (level == 0) {
+        return (node_digest(sa, start, digest)
+            ? SKIPARRAY_DIFF_OK : SKIPARRAY_DIFF_ERROR_PAGE);
+    }
+
+    uint64_t *rollup = NULL;
+    uint32_t *stale = NULL;
+    if (end != NULL) {
+        if (end->rollups == NULL) {
+            end->rollups = sa->mem(NULL,
+                (end->height - 1) * sizeof(uint64_t), sa->mem_udata);
+            if (end->rollups == NULL) { return SKIPARRAY_DIFF_ERROR_MEMORY; }
+        }
+        rollup = &end->rollups[level - 1];
+        stale = &end->digest_stale;
+    } else {
+        if (sa->tail_digests == NULL) {
+            sa->tail_digests = sa->mem(NULL,
+                sa->max_level * sizeof(uint64_t), sa->mem_udata);
+            if (sa->tail_digests == NULL) {
+                return SKIPARRAY_DIFF_ERROR_MEMORY;
+            }
+        }
+        rollup = &sa->tail_digests[level];
+        stale = &sa->tail_stale;
+    }
+
+    const uint32_t bit = (uint32_t)1 << level;
+    if (*stale & bit) {
+        uint64_t sum = 0;
+        struct node *n = start;
+        for (;;) {
+            struct node *sub_end = span_end(n, level - 1);
+            uint64_t sub = 0;
+            const enum skiparray_diff_res res = span_digest(sa, n,
+                level - 1, sub_end, &sub);
+            if (res != SKIPARRAY_DIFF_OK) { return res; }
+            sum += sub;
+            if (sub_end == end) { break; }
+            n = sub_end->fwd[0];
+        }
+        *rollup = sum;
+        *stale &= ~bit;
+    }
+    *digest = *rollup;
+    return SKIPARRAY_DIFF_OK;
+}
+
+static const void *
+last_key(const struct skiparray *sa) {
+    struct node *n = NULL;
+    for (int level = sa->height - 1; level >= 0; level--) {
+        struct node *cur = (n != NULL ? n : sa->nodes[level]);
+        while (cur->fwd[level] != NULL) { cur = cur->fwd[level]; }
+        n = cur;
+    }
+    return (n->count > 0 ? node_last_key(n) : NULL);
+}
+
+/* Fill ENDS with where the spans starting at S's node end, from level
+ * 0 up to the highest level the node begins a span on, stopping at
+ * the first tail. Returns how many there are. */
+static size_t
+span_ends(const struct side *s, struct node **ends) {
+    const struct node *back = s->n->back;
+    const uint8_t levels = (back == NULL ? s->sa->max_level : back->height);
+    struct node *n = s->n;
+    size_t count = 0;
+    for (uint8_t level = 0; level < levels; level++) {
+        n = span_end(n, level);
+        ends[count++] = n;
+        if (n == NULL) { break; }
+    }
+    return count;
+}
+
+static const void *
+end_key(const struct side *s, const struct node *end) {
+    return (end != NULL ? node_last_key(end) : s->last_key);
+}
+
+/* With both sides at the start of a node, find the largest span
+ * starting there on both that ends at the same key, with equal
+ * digests, and skip past it. Sets *SKIPPED. */
+static enum skiparray_diff_res
+try_skip(struct side *a, struct side *b, bool *skipped) {
+    *skipped = false;
+    skiparray_cmp_fun *cmp = a->sa->cmp;
+    void *udata = a->sa->udata;
+
+    if (!read_page_in(a->sa, a->n) || !read_page_in(b->sa, b->n)) {
+        return SKIPARRAY_DIFF_ERROR_PAGE;
+    }
+    if (0 != cmp(a->n->keys[a->n->offset], b->n->keys[b->n->offset], udata)) {
+        return SKIPARRAY_DIFF_OK;
+    }
+
+    struct node *ends_a[SKIPARRAY_MAX_MAX_LEVEL];
+    struct node *ends_b[SKIPARRAY_MAX_MAX_LEVEL];
+    size_t ia = span_ends(a, ends_a);
+    size_t ib = span_ends(b, ends_b);
+
+    /* Both lists of ends are ascending, so walk them down together. */
+    while (ia > 0 && ib > 0) {
+        const int res = cmp(end_key(a, ends_a[ia - 1]),
+            end_key(b, ends_b[ib - 1]), udata);
+        if (res > 0) {
+            ia--;
+        } else if (res < 0) {
+            ib--;
+        } else {
+            uint64_t da = 0;
+            uint64_t db = 0;
+            enum skiparray_diff_res dres = span_digest(a->sa, a->n,
+                ia - 1, ends_a[ia - 1], &da);
+            if (dres == SKIPARRAY_DIFF_OK) {
+                dres = span_digest(b->sa, b->n, ib - 1, ends_b[ib - 1], &db);
+            }
+            if (dres != SKIPARRAY_DIFF_OK) { return dres; }
+            if (da == db) {
+                a->n = (ends_a[ia - 1] ? ends_a[ia - 1]->fwd[0] : NULL);
+                b->n = (ends_b[ib - 1] ? ends_b[ib - 1]->fwd[0] : NULL);
+                *skipped = true;
+                return SKIPARRAY_DIFF_OK;
+            }
+            ia--;
+            ib--;
+        }
+    }
+    return SKIPARRAY_DIFF_OK;
+}
+
+static bool
+get_pair(struct side *s, void **key, void **value) {
+    struct node *n = s->n;
+    if (!read_page_in(s->sa, n)) { return false; }
+    *key = n->keys[n->offset + s->i];
+    *value = (s->sa->use_values ? n->values[n->offset + s->i] : NULL);
+    return true;
+}
+
+static void
+advance(struct side *s) {
+    s->i++;
+    if (s->i == s->n->count) {
+        s->n = s->n->fwd[0];
+        s->i = 0;
+    }
+}
+
+enum skiparray_diff_res
+skiparray_diff(struct skiparray *a, struct skiparray *b,
+    skiparray_fold_fun *on_added, skiparray_fold_fun *on_removed,
+    skiparray_diff_changed_fun *on_changed, void *udata) {
+    if (a == NULL || b == NULL || a->hash == NULL || b->hash == NULL
+        || a->cmp != b->cmp || a->use_values != b->use_values) {
+        return SKIPARRAY_DIFF_ERROR_MISUSE;
+    }
+    if (a == b) { return SKIPARRAY_DIFF_OK; }
+
+    struct side sa = {
+        .sa = a,
+        .n = (a->nodes[0]->count > 0 ? a->nodes[0] : NULL),
+        .last_key = last_key(a),
+    };
+    struct side sb = {
+        .sa = b,
+        .n = (b->nodes[0]->count > 0 ? b->nodes[0] : NULL),
+        .last_key = last_key(b),
+    };
+
+    while (sa.n != NULL && sb.n != NULL) {
+        if (sa.i == 0 && sb.i == 0) {
+            bool skipped = false;
+            const enum skiparray_diff_res res = try_skip(&sa, &sb, &skipped);
+            if (res != SKIPARRAY_DIFF_OK) { return res; }
+            if (skipped) { continue; }
+        }
+
+        void *ka, *va, *kb, *vb;
+        if (!get_pair(&sa, &ka, &va) || !get_pair(&sb, &kb, &vb)) {
+            return SKIPARRAY_DIFF_ERROR_PAGE;
+        }
+        const int res = a->cmp(ka, kb, a->udata);
+        if (res < 0) {
+            if (on_removed != NULL) { on_removed(ka, va, udata); }
+            advance(&sa);
+        } else if (res > 0) {
+            if (on_added != NULL) { on_added(kb, vb, udata); }
+            advance(&sb);
+        } else {
+            if (on_changed != NULL && a->use_values
+                && pair_hash(a, sa.n, sa.i) != pair_hash(b, sb.n, sb.i)) {
+                on_changed(kb, va, vb, udata);
+            }
+            advance(&sa);
+            advance(&sb);
+        }
+    }
+
+    for (; sa.n != NULL; advance(&sa)) {
+        void *key, *value;
+        if (!get_pair(&sa, &key, &value)) { return SKIPARRAY_DIFF_ERROR_PAGE; }
+        if (on_removed != NULL) { on_removed(key, value, udata); }
+    }
+    for (; sb.n != NULL; advance(&sb)) {
+        void *key, *value;
+        if (!get_pair(&sb, &key, &value)) { return SKIPARRAY_DIFF_ERROR_PAGE; }
+        if (on_added != NULL) { on_added(key, value, udata); }
+    }
+    return SKIPARRAY_DIFF_OK;
+}
@@ -38,9 +38,13 @@ skiparray_fold(enum skiparray_fold_type direction,
         sa, cb, udata, &fs);
     if (fres != SKIPARRAY_FOLD_OK) { return fres; }
 
-    while (skiparray_fold_next(fs) != SKIPARRAY_FOLD_NEXT_DONE) {}
+    enum skiparray_fold_next_res nres;
+    do {
+        nres = skiparray_fold_next(fs);
+    } while (nres == SKIPARRAY_FOLD_NEXT_OK);
 
-    return SKIPARRAY_FOLD_OK;
+    return (nres == SKIPARRAY_FOLD_NEXT_DONE
+        ? SKIPARRAY_FOLD_OK : SKIPARRAY_FOLD_ERROR_PAGE);
 }
 
 enum skiparray_fold_res
@@ -71,17 +75,19 @@ skiparray_fold_multi_init(enum skiparray_fold_type type,
 
     skiparray_memory_fun *mem = skiparrays[0]->mem;
     void *sa_udata = skiparrays[0]->udata;
+    void *mem_udata = skiparrays[0]->mem_udata;
 
+    enum skiparray_fold_res err = SKIPARRAY_FOLD_ERROR_MEMORY;
     uint8_t *current_ids = NULL;
     struct skiparray_fold_state *res = NULL;
     const size_t res_alloc_size = sizeof(*res)
       + skiparray_count*sizeof(res->iters[0]);
-    res = mem(NULL, res_alloc_size, sa_udata);
+    res = mem(NULL, res_alloc_size, mem_udata);
     if (res == NULL) { goto cleanup; }
     memset(res, 0x00, res_alloc_size);
 
     const size_t current_ids_alloc_size = skiparray_count * sizeof(uint8_t);
-    current_ids = mem(NULL, current_ids_alloc_size, sa_udata);
+    current_ids = mem(NULL, current_ids_alloc_size, mem_udata);
     if (current_ids == NULL) { goto cleanup; }
     memset(current_ids, 0x00, current_ids_alloc_size);
 
@@ -95,6 +101,9 @@ skiparray_fold_multi_init(enum skiparray_fold_type type,
             assert(false);
         case SKIPARRAY_ITER_NEW_ERROR_MEMORY:
             goto cleanup;
+        case SKIPARRAY_ITER_NEW_ERROR_PAGE:
+            err = SKIPARRAY_FOLD_ERROR_PAGE;
+            goto cleanup;
         case SKIPARRAY_ITER_NEW_EMPTY:
             break;
         case SKIPARRAY_ITER_NEW_OK:
@@ -102,8 +111,12 @@ skiparray_fold_multi_init(enum skiparray_fold_type type,
             break;                  /* continue below */
         }
 
-        if (iter && type == SKIPARRAY_FOLD_RIGHT) {
-            skiparray_iter_seek_endpoint(iter, SKIPARRAY_ITER_SEEK_LAST);
+        if (iter && type == SKIPARRAY_FOLD_RIGHT
+            && skiparray_iter_seek_endpoint(iter, SKIPARRAY_ITER_SEEK_LAST)
+            != SKIPARRAY_ITER_STEP_OK) {
+            skiparray_iter_free(iter);
+            err = SKIPARRAY_FOLD_ERROR_PAGE;
+            goto cleanup;
         }
 
         res->iters[i].iter = iter; /* can be NULL -- immediately empty */
@@ -117,6 +130,7 @@ skiparray_fold_multi_init(enum skiparray_fold_type type,
     res->cbs.fold_udata = udata;
     res->cbs.mem = mem;
     res->cbs.sa_udata = sa_udata;
+    res->cbs.mem_udata = mem_udata;
     res->cbs.cmp = skiparrays[0]->cmp;
     res->cbs.free = skiparrays[0]->free;
     res->cbs.merge = merge;
@@ -130,14 +144,14 @@ skiparray_fold_multi_init(enum skiparray_fold_type type,
     return SKIPARRAY_FOLD_OK;
 
 cleanup:
-    if (current_ids != NULL) { mem(current_ids, 0, sa_udata); }
+    if (current_ids != NULL) { mem(current_ids, 0, mem_udata); }
     if (res != NULL) {
         for (size_t i = 0; i < res->iter_count; i++) {
             skiparray_iter_free(res->iters[i].iter);
         }
-        mem(res, 0, sa_udata);
+        mem(res, 0, mem_udata);
     }
-    return SKIPARRAY_FOLD_ERROR_MEMORY;
+    return err;
 }
 
 void
@@ -152,10 +166,10 @@ skiparray_fold_halt(struct skiparray_fold_state *fs) {
     }
 
     if (fs->ids.current != NULL) {
-        fs->cbs.mem(fs->ids.current, 0, fs->cbs.sa_udata);
+        fs->cbs.mem(fs->ids.current, 0, fs->cbs.mem_udata);
     }
 
-    fs->cbs.mem(fs, 0, fs->cbs.sa_udata);
+    fs->cbs.mem(fs, 0, fs->cbs.mem_udata);
 }
 
 enum skiparray_fold_next_res
@@ -174,12 +188,15 @@ skiparray_fold_next(struct skiparray_fold_state *fs) {
         return SKIPARRAY_FOLD_NEXT_DONE;
     }
 
-    if (fs->iter_live > 0) { step_active_iterators(fs); }
+    if (fs->iter_live > 0 && !step_active_iterators(fs)) {
+        skiparray_fold_halt(fs);
+        return SKIPARRAY_FOLD_NEXT_ERROR_PAGE;
+    }
     call_with_next(fs, fs->iter_count);
     return SKIPARRAY_FOLD_NEXT_OK;
 }
 
-static void
+static bool
 step_active_iterators(struct skiparray_fold_state *fs) {
     /* This could use a next chain, rather than walking the entire
      * array, but it's probably not worth the complexity since
@@ -217,8 +234,10 @@ step_active_iterators(struct skiparray_fold_state *fs) {
             fs->iter_live--;
             continue;
         }
+        if (sres == SKIPARRAY_ITER_STEP_ERROR_PAGE) { return false; }
         assert(sres == SKIPARRAY_ITER_STEP_OK);
     }
+    return true;
 }
 
 static void
@@ -287,13 +306,15 @@ call_with_next(struct skiparray_fold_state *fs, size_t count) {
     void *values[count];
     uint8_t used = 0;
 
+    /* Each EQ pair is equal to the one after it, so the run of equal
+     * pairs ends with the first one that isn't EQ. */
     for (size_t id_i = 0; id_i < fs->ids.available; id_i++) {
         uint8_t id = fs->ids.current[id_i + base];
         struct iter_state *is = &fs->iters[id];
-        if (is->state != PS_AVAILABLE_EQ) { break; }
         keys[used] = is->pair.key;
         values[used] = (fs->use_values ? is->pair.value : NULL);
         used++;
+        if (is->state != PS_AVAILABLE_EQ) { break; }
     }
     assert(used > 0);
 
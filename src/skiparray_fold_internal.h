@@ -24,6 +24,7 @@ struct skiparray_fold_state {
         skiparray_fold_merge_fun *merge;
         skiparray_memory_fun *mem;
         void *sa_udata;
+        void *mem_udata;
     } cbs;
 
     /* Array of iters[] IDs for available pairs, where their keys are in
@@ -43,7 +44,7 @@ struct skiparray_fold_state {
     } iters[];
 };
 
-static void
+static bool
 step_active_iterators(struct skiparray_fold_state *fs);
 
 static void
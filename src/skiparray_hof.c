@@ -34,6 +34,7 @@ skiparray_filter(struct skiparray *sa,
     {
         struct skiparray_config cfg = {
             .node_size = sa->node_size,
+            .node_size_min = sa->node_size_min,
             .max_level = sa->max_level,
             .ignore_values = !sa->use_values,
             .cmp = sa->cmp,
@@ -41,7 +42,13 @@ skiparray_filter(struct skiparray *sa,
             .free = sa->free,
             .level = sa->level,
             .udata = sa->udata,
+            .pool = sa->pool,
+            .arena = sa->arena,
+            .hash = sa->hash,
         };
+#ifdef SKIPARRAY_TRACE
+        cfg.trace = sa->trace;
+#endif
         if (SKIPARRAY_BUILDER_NEW_OK != skiparray_builder_new(&cfg, true, &b)) {
             return NULL;
         }
@@ -13,19 +13,46 @@
     } while(0)
 
 static struct node *
-node_alloc(uint8_t height, uint16_t node_size,
-    skiparray_memory_fun *mem, void *udata, bool use_values);
+node_alloc(struct skiparray *sa, uint8_t height, uint16_t capacity);
+
+static bool
+node_resize(const struct skiparray *sa, struct node *n, uint16_t capacity);
 
 static void node_free(const struct skiparray *sa, struct node *n);
 
+static bool
+page_in(const struct skiparray *sa, struct node *n, bool dirty);
+
+static void
+page_trim(const struct skiparray *sa, const struct node *pin);
+
+static bool
+node_will_change(struct skiparray *sa, struct node *n);
+
+static bool
+page_in_neighbor(const struct skiparray *sa, struct node *n);
+
+static void
+mark_digests_stale(struct skiparray *sa, struct node *n, bool force);
+
+static void
+digest_link(struct skiparray *sa, struct node *n);
+
+static void
+digest_unlink(struct skiparray *sa, struct node *next);
+
 enum search_res {
     SEARCH_FOUND,
     SEARCH_NOT_FOUND,
     SEARCH_EMPTY,
+    SEARCH_ERROR_PAGE,          /* couldn't read a page */
 };
 static enum search_res
 search(struct search_env *env);
 
+static bool
+grow_node_for_insert(struct skiparray *sa, struct node *n);
+
 static void
 prepare_node_for_insert(struct skiparray *sa,
     struct node *n, uint16_t index);
@@ -37,21 +64,52 @@ split_node(struct skiparray *sa,
 static void
 shift_or_merge(struct skiparray *sa, struct node *n);
 
+static void
+adapt_node_limit(struct skiparray *sa, struct node *n);
+
+static void
+absorb_next_node(struct skiparray *sa, struct node *n);
+
 static void
 unlink_node(struct skiparray *sa, struct node *n);
 
+static void
+shrink_height(struct skiparray *sa);
+
 static bool
 search_within_node(const struct skiparray *sa,
     const void *key, const struct node *n, uint16_t *index);
 
 static void
-shift_pairs(struct node *n,
+shift_pairs(const struct skiparray *sa, struct node *n,
     uint16_t to_pos, uint16_t from_pos, uint16_t count);
 
 static void
-move_pairs(struct node *to, struct node *from,
+move_pairs(const struct skiparray *sa, struct node *to, struct node *from,
     uint16_t to_pos, uint16_t from_pos, uint16_t count);
 
+static void
+compact_find_trail(const struct skiparray *sa,
+    const struct node *cursor, struct node **trail);
+
+static bool
+compact_fill_node(struct skiparray *sa, struct node *n, double target_fill);
+
+static struct node *
+compact_set_height(struct skiparray *sa, struct node *n,
+    struct node **trail, uint8_t height);
+
+static void
+compact_forget_node(struct skiparray *sa, struct node *n);
+
+static enum skiparray_builder_new_res
+builder_new(const struct skiparray_config *cfg,
+    bool skip_ascending_key_check, bool balanced,
+    struct skiparray_builder **builder);
+
+static uint8_t
+balanced_height(size_t index, uint8_t max_level);
+
 static void
 *def_memory_fun(void *p, size_t nsize, void *udata);
 
@@ -10,6 +10,7 @@
 
 struct skiparray {
     const uint16_t node_size;
+    const uint16_t node_size_min; /* == node_size unless adaptive */
     const uint8_t max_level;
     uint8_t height;
     bool use_values;
@@ -20,8 +21,38 @@ struct skiparray {
     skiparray_free_fun * const free;
     skiparray_level_fun * const level;
     void *udata;
+    void *mem_udata;            /* udata for mem: udata, or the arena */
 
     struct skiparray_iter *iter;
+    struct skiparray_pool *pool;
+    struct skiparray_arena *arena;
+    struct skiparray_pager *pager;
+    struct skiparray_wal *wal;
+
+    /* With digests: the rollups past the last node on each level
+     * (allocated on first use), and which are stale. */
+    skiparray_hash_fun *hash;
+    uint64_t *tail_digests;
+    uint32_t tail_stale;
+
+    uint64_t next_node_id;      /* starting at 1 */
+    /* The chain the last checkpoint belongs to (0: none yet), and its
+     * position in it, where the base is 0. */
+    uint64_t checkpoint_chain;
+    uint64_t checkpoint_seq;
+
+#ifdef SKIPARRAY_COUNTERS
+    struct skiparray_counters counters;
+#endif
+#ifdef SKIPARRAY_TRACE
+    skiparray_trace_fun *trace;
+#endif
+
+    /* Incremental compaction state: the last node compacted so far
+     * (NULL: none yet), and how many nodes have been compacted. */
+    bool compacting;
+    struct node *compact_cursor;
+    size_t compact_index;
 
     /* Node chains for each level, 0 to max_level, inclusive.
      * Every node is on level 0; a level-1 node will also
@@ -29,24 +60,92 @@ struct skiparray {
     struct node *nodes[];
 };
 
+/* Add N to one of SA's hot-path counters, if they are compiled in.
+ * They are only statistics, so they are updated even through const
+ * pointers (skiparrays are never allocated const). */
+#ifdef SKIPARRAY_COUNTERS
+#define COUNTER_ADD(SA, FIELD, N)                                      \
+    (((struct skiparray *)(SA))->counters.FIELD += (N))
+#else
+#define COUNTER_ADD(SA, FIELD, N) ((void)(SA))
+#endif
+
+/* Report a structural event, if tracing is compiled in. Start timing
+ * an operation with TRACE_START(VAR), and pass VAR as START; instant
+ * events pass TRACE_NOW. */
+#ifdef SKIPARRAY_TRACE
+#define TRACE_START(VAR) const uint64_t VAR = skiparray_trace_now()
+#define TRACE_NOW 0
+#define TRACE(SA, TYPE, START, COUNT, OTHER, HEIGHT)                   \
+    skiparray_trace_event(SA, SKIPARRAY_TRACE_##TYPE, START,           \
+        COUNT, OTHER, HEIGHT)
+
+uint64_t
+skiparray_trace_now(void);
+
+/* START of 0 (TRACE_NOW) means now. */
+void
+skiparray_trace_event(const struct skiparray *sa,
+    enum skiparray_trace_event_type type, uint64_t start_ns,
+    uint16_t count, uint16_t other, uint8_t height);
+#else
+#define TRACE_START(VAR) ((void)0)
+#define TRACE(SA, TYPE, START, COUNT, OTHER, HEIGHT) ((void)0)
+#endif
+
 struct skiparray_builder {
     struct skiparray *sa;
     struct node *last;
     bool check_ascending;
     bool has_prev_key;
     void *prev_key;
+    bool balanced;
+    size_t node_count;          /* nodes so far, if balanced */
 
     struct node *trail[];
 };
 
+/* Initial key/value capacity of a skiparray's first node. It grows
+ * geometrically up to node_size as pairs are added. */
+#define NODE_INITIAL_CAPACITY 4
+
+/* With adaptive node sizes, a node's limit is reconsidered once it has
+ * seen this many writes and scans: if one outweighs the other by
+ * ADAPT_RATIO, the limit is halved (writes) or doubled (scans). */
+#define ADAPT_WINDOW 64
+#define ADAPT_RATIO 2
+
 struct node {
     /* How many levels is this node on? >= 1. */
     const uint8_t height;
     uint16_t offset;
     uint16_t count;
-    void **keys;
+    /* How many pairs the keys and values arrays have room for. This
+     * is only less than node_size when the node is the skiparray's
+     * only node; nodes are always full capacity before splitting. */
+    uint16_t capacity;
+    /* Split once count reaches this, and merge when it drops below
+     * half of it. Always node_size unless node sizes are adaptive. */
+    uint16_t limit;
+    /* Saturating access counters for adaptive node sizes. */
+    uint16_t writes;
+    uint16_t scans;
+    void **keys;                /* NULL while paged out */
     void **values;
-    
+    struct skiparray_page *page; /* paged mode only */
+    /* Unique within the skiparray, to match nodes up across
+     * incremental checkpoints. */
+    uint64_t id;
+    bool changed;               /* since the last checkpoint */
+    /* With digests: bit 0 is set when digest (the sum of the node's
+     * mixed pair hashes) is stale, and bit L when rollups[L - 1] is,
+     * the sum over level L's span ending at this node -- everything
+     * after the previous node at least L + 1 high. Rollups are
+     * allocated when a diff first needs them. */
+    uint32_t digest_stale;
+    uint64_t digest;
+    uint64_t *rollups;
+
     struct node *back;          /* back on level 0 */
 
     /* Forward pointers. A level 0 node will have 0,
@@ -55,6 +154,28 @@ struct node {
     struct node *fwd[];
 };
 
+/* Paging state for a node. */
+struct skiparray_page {
+    struct node *node;
+    /* Ring of resident nodes, swept by the pager's clock hand. */
+    struct skiparray_page *prev;
+    struct skiparray_page *next;
+    uint64_t id;                /* stored page, if size > 0 */
+    size_t size;
+    bool dirty;                 /* changed since it was stored */
+    bool referenced;            /* used since the clock hand passed */
+    /* The node's last pair, while it is paged out. */
+    void *last_key;
+    void *last_value;
+};
+
+/* The last key in N, which stays in memory while N is paged out. */
+static inline void *
+node_last_key(const struct node *n) {
+    return (n->keys != NULL
+        ? n->keys[n->offset + n->count - 1] : n->page->last_key);
+}
+
 struct skiparray_iter {
     struct skiparray *sa;
     struct skiparray_iter *prev;
@@ -63,6 +184,98 @@ struct skiparray_iter {
     uint16_t index;
 };
 
+struct skiparray_pool {
+    const uint16_t node_size;
+    const uint8_t max_level;
+    const bool use_values;
+    const size_t high_watermark;
+    const size_t low_watermark;
+    const size_t header_size;   /* node header, padded */
+    const size_t block_size;    /* header, keys, and values */
+
+    skiparray_memory_fun * const mem;
+    void *udata;
+
+    size_t users;               /* skiparrays using the pool */
+    void *free_list;            /* linked through the first word */
+    struct skiparray_pool_stats stats;
+};
+
+/* Get a block from the pool's free list, or allocate one.
+ * Returns NULL on allocation failure. */
+void *
+skiparray_pool_get(struct skiparray_pool *pool);
+
+/* Return a block to the pool's free list. */
+void
+skiparray_pool_put(struct skiparray_pool *pool, void *block);
+
+/* Memory callback for skiparrays allocated in an arena;
+ * udata is the arena. */
+void *
+skiparray_arena_memory_fun(void *p, size_t nsize, void *udata);
+
+/* Start or stop paging for SA. A pager can only be used by one
+ * skiparray at a time, so attaching returns false if it's in use. */
+bool
+skiparray_pager_attach(struct skiparray_pager *pager, struct skiparray *sa);
+
+void
+skiparray_pager_detach(struct skiparray_pager *pager);
+
+/* Add paging state to N, a new node with its pairs in memory.
+ * Returns false on allocation failure. */
+bool
+skiparray_pager_attach_node(struct skiparray_pager *pager, struct node *n);
+
+/* Release N's page (if any) and paging state, before N is freed. */
+void
+skiparray_pager_detach_node(struct skiparray_pager *pager, struct node *n);
+
+/* Read N's pairs back in if it is paged out, and note the access.
+ * With DIRTY, also note that they are about to change. Returns false,
+ * leaving N paged out, if its page can't be read. */
+bool
+skiparray_pager_page_in(struct skiparray_pager *pager, struct node *n,
+    bool dirty);
+
+/* Page out nodes until within the cache size, other than PIN (if
+ * non-NULL) and any nodes that iterators are on. */
+void
+skiparray_pager_trim(struct skiparray_pager *pager, const struct node *pin);
+
+/* Start or stop logging SA's changes. Attaching returns false if the
+ * WAL is in use, or can't encode SA's values. */
+bool
+skiparray_wal_attach(struct skiparray_wal *wal, struct skiparray *sa);
+
+void
+skiparray_wal_detach(struct skiparray_wal *wal);
+
+/* Log binding KEY to VALUE, or with FORGET, removing KEY, writing the
+ * pending group if it's due. Returns false (with nothing logged) if
+ * the record couldn't be encoded or written. */
+bool
+skiparray_wal_log(struct skiparray_wal *wal, bool forget,
+    const void *key, const void *value);
+
+/* A change for skiparray_merge_changes: bind KEY to VALUE, or with
+ * FORGET, remove KEY. */
+struct skiparray_change {
+    void *key;
+    void *value;
+    bool forget;
+};
+
+/* Rebuild SA's nodes with COUNT changes (sorted by key, at most one
+ * per key) merged into its pairs, in one pass. Replaced and forgotten
+ * pairs, and the keys of forgets without a match, are passed to the
+ * free callback. Returns false, with nothing changed, on allocation
+ * failure. SA can't be paged or have iterators. */
+bool
+skiparray_merge_changes(struct skiparray *sa,
+    const struct skiparray_change *changes, size_t count);
+
 struct search_env {
     const struct skiparray *sa;
     const void *key;
@@ -0,0 +1,646 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "skiparray_serialize_internal.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Mapped format, version 1:
+ *
+ * Header (MAPPED_HEADER_SIZE bytes):
+ *     0  magic, "SKIPARMP"
+ *     8  u16 version
+ *    10  u16 flags (FORMAT_FLAG_VALUES)
+ *    12  u32 reserved, 0
+ *
+ * Then a block per level-0 node, each starting at a multiple of
+ * MAPPED_ALIGN bytes:
+ *     0  u32 pair count, > 0
+ *     4  u32 reserved, 0
+ *     8  u32 key offsets[count + 1], from the start of the block
+ *     -  with FORMAT_FLAG_VALUES, u32 value offsets[count + 1]
+ *     -  key bytes, then value bytes
+ * Key i's bytes are from offset i up to offset i + 1.
+ *
+ * Then the express index, a MAPPED_INDEX_ENTRY_SIZE entry per block:
+ *     0  u64 block offset, from the start of the file
+ *     8  u32 offset of the block's first key in the fence heap
+ *    12  u32 its length
+ * followed by the fence heap, so a search can find the block that
+ * may contain a key without touching any other blocks.
+ *
+ * Trailer (MAPPED_TRAILER_SIZE bytes, at the end of the file):
+ *     0  u64 pair count
+ *     8  u64 block count
+ *    16  u64 index offset
+ *    24  u64 fence heap offset
+ *    32  magic, "SKIPARMP" */
+
+#define MAPPED_MAGIC "SKIPARMP"
+#define MAPPED_VERSION 1
+#define MAPPED_HEADER_SIZE 16
+#define MAPPED_BLOCK_HEADER_SIZE 8
+#define MAPPED_INDEX_ENTRY_SIZE 16
+#define MAPPED_TRAILER_SIZE 40
+#define MAPPED_ALIGN 8
+
+struct skiparray_ro {
+    const uint8_t *map;
+    size_t map_size;
+    skiparray_cmp_fun *cmp;
+    bool use_values;
+    uint64_t pairs;
+    uint64_t blocks;
+    uint64_t index_offset;
+    uint64_t fence_offset;
+};
+
+struct skiparray_ro_iter {
+    struct skiparray_ro *ro;
+    uint64_t block;
+    uint32_t pos;
+};
+
+/* A block, once its bounds have been checked. */
+struct block {
+    const uint8_t *base;
+    size_t size;
+    uint32_t count;
+    const uint8_t *key_offsets;
+    const uint8_t *value_offsets; /* NULL without values */
+};
+
+/*
+ * Writing
+ */
+
+static enum skiparray_dump_res
+pad_to_align(struct skiparray_buf *b) {
+    const size_t pad = (MAPPED_ALIGN - (b->used % MAPPED_ALIGN)) % MAPPED_ALIGN;
+    if (!skiparray_buf_reserve(b, pad)) { return SKIPARRAY_DUMP_ERROR_MEMORY; }
+    memset(&b->bytes[b->used], 0x00, pad);
+    b->used += pad;
+    return SKIPARRAY_DUMP_OK;
+}
+
+/* Append COUNT encoded items to B, storing their offsets in the table
+ * at OFFSETS_POS. */
+static enum skiparray_dump_res
+encode_run(struct skiparray_buf *b, size_t offsets_pos,
+    skiparray_encode_fun *encode, void *const *items, uint16_t count,
+    void *udata) {
+    for (uint16_t i = 0; i < count; i++) {
+        if (b->used > UINT32_MAX) { return SKIPARRAY_DUMP_ERROR_ENCODE; }
+        put_u32(&b->bytes[offsets_pos + 4*i], (uint32_t)b->used);
+        size_t len = 0;
+        enum skiparray_dump_res res = skiparray_buf_append_encoded(b,
+            encode, items[i], udata, &len);
+        if (res != SKIPARRAY_DUMP_OK) { return res; }
+    }
+    if (b->used > UINT32_MAX) { return SKIPARRAY_DUMP_ERROR_ENCODE; }
+    put_u32(&b->bytes[offsets_pos + 4*count], (uint32_t)b->used);
+    return SKIPARRAY_DUMP_OK;
+}
+
+/* Encode node N into block B, and add its index entry and fence key,
+ * given that it will be written at file offset OFFSET. */
+static enum skiparray_dump_res
+encode_block(const struct skiparray *sa, const struct node *n,
+    const struct skiparray_dump_config *config, uint64_t offset,
+    struct skiparray_buf *b, struct skiparray_buf *index,
+    struct skiparray_buf *fences) {
+    const size_t table_size = 4 * ((size_t)n->count + 1);
+    const size_t head = MAPPED_BLOCK_HEADER_SIZE
+      + (sa->use_values ? 2 : 1) * table_size;
+    b->used = 0;
+    if (!skiparray_buf_reserve(b, head)) { return SKIPARRAY_DUMP_ERROR_MEMORY; }
+    memset(b->bytes, 0x00, head);
+    put_u32(&b->bytes[0], n->count);
+    b->used = head;
+
+    enum skiparray_dump_res res = encode_run(b, MAPPED_BLOCK_HEADER_SIZE,
+        config->encode_key, &n->keys[n->offset], n->count, config->udata);
+    if (res != SKIPARRAY_DUMP_OK) { return res; }
+    if (sa->use_values) {
+        res = encode_run(b, MAPPED_BLOCK_HEADER_SIZE + table_size,
+            config->encode_value, &n->values[n->offset], n->count,
+            config->udata);
+        if (res != SKIPARRAY_DUMP_OK) { return res; }
+    }
+
+    const uint32_t fence_start = get_u32(&b->bytes[MAPPED_BLOCK_HEADER_SIZE]);
+    const uint32_t fence_len = get_u32(&b->bytes[MAPPED_BLOCK_HEADER_SIZE + 4])
+      - fence_start;
+    if (fences->used > UINT32_MAX - fence_len) {
+        return SKIPARRAY_DUMP_ERROR_ENCODE;
+    }
+    if (!skiparray_buf_reserve(index, MAPPED_INDEX_ENTRY_SIZE)
+        || !skiparray_buf_reserve(fences, fence_len)) {
+        return SKIPARRAY_DUMP_ERROR_MEMORY;
+    }
+    uint8_t *entry = &index->bytes[index->used];
+    put_u64(&entry[0], offset);
+    put_u32(&entry[8], (uint32_t)fences->used);
+    put_u32(&entry[12], fence_len);
+    index->used += MAPPED_INDEX_ENTRY_SIZE;
+    memcpy(&fences->bytes[fences->used], &b->bytes[fence_start], fence_len);
+    fences->used += fence_len;
+
+    return pad_to_align(b);
+}
+
+enum skiparray_dump_res
+skiparray_dump_mapped(const struct skiparray *sa,
+    const struct skiparray_dump_config *config) {
+    if (sa == NULL || config == NULL
+        || config->write == NULL || config->encode_key == NULL
+        || (sa->use_values && config->encode_value == NULL)) {
+        return SKIPARRAY_DUMP_ERROR_MISUSE;
+    }
+
+    uint8_t header[MAPPED_HEADER_SIZE];
+    memset(header, 0x00, sizeof(header));
+    memcpy(header, MAPPED_MAGIC, FORMAT_MAGIC_SIZE);
+    put_u16(&header[8], MAPPED_VERSION);
+    put_u16(&header[10], sa->use_values ? FORMAT_FLAG_VALUES : 0);
+    if (!config->write(header, sizeof(header), config->udata)) {
+        return SKIPARRAY_DUMP_ERROR_WRITE;
+    }
+
+    struct skiparray_buf b = { .mem = sa->mem, .mem_udata = sa->mem_udata };
+    struct skiparray_buf index = b;
+    struct skiparray_buf fences = b;
+    enum skiparray_dump_res res = SKIPARRAY_DUMP_OK;
+    uint64_t offset = MAPPED_HEADER_SIZE;
+    uint64_t blocks = 0;
+
+    for (struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        if (n->count == 0) { continue; } /* empty root */
+        if (!dump_page_in(sa, n)) {
+            res = SKIPARRAY_DUMP_ERROR_PAGE;
+            goto cleanup;
+        }
+        res = encode_block(sa, n, config, offset, &b, &index, &fences);
+        if (res != SKIPARRAY_DUMP_OK) { goto cleanup; }
+        if (!config->write(b.bytes, b.used, config->udata)) {
+            res = SKIPARRAY_DUMP_ERROR_WRITE;
+            goto cleanup;
+        }
+        offset += b.used;
+        blocks++;
+    }
+
+    const uint64_t index_offset = offset;
+    const uint64_t fence_offset = index_offset + index.used;
+    if ((index.used > 0
+            && !config->write(index.bytes, index.used, config->udata))
+        || (fences.used > 0
+            && !config->write(fences.bytes, fences.used, config->udata))) {
+        res = SKIPARRAY_DUMP_ERROR_WRITE;
+        goto cleanup;
+    }
+
+    uint8_t trailer[MAPPED_TRAILER_SIZE];
+    put_u64(&trailer[0], skiparray_count(sa));
+    put_u64(&trailer[8], blocks);
+    put_u64(&trailer[16], index_offset);
+    put_u64(&trailer[24], fence_offset);
+    memcpy(&trailer[32], MAPPED_MAGIC, FORMAT_MAGIC_SIZE);
+    if (!config->write(trailer, sizeof(trailer), config->udata)) {
+        res = SKIPARRAY_DUMP_ERROR_WRITE;
+    }
+
+cleanup:
+    skiparray_buf_free(&b);
+    skiparray_buf_free(&index);
+    skiparray_buf_free(&fences);
+    return res;
+}
+
+/*
+ * Reading
+ */
+
+enum skiparray_open_mapped_res
+skiparray_open_mapped(const char *path, skiparray_cmp_fun *cmp,
+    struct skiparray_ro **ro) {
+    if (path == NULL || ro == NULL) {
+        return SKIPARRAY_OPEN_MAPPED_ERROR_MISUSE;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) { return SKIPARRAY_OPEN_MAPPED_ERROR_IO; }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return SKIPARRAY_OPEN_MAPPED_ERROR_IO;
+    }
+    if (st.st_size < MAPPED_HEADER_SIZE + MAPPED_TRAILER_SIZE
+        || (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return SKIPARRAY_OPEN_MAPPED_ERROR_FORMAT;
+    }
+    const size_t size = (size_t)st.st_size;
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);                  /* the mapping keeps the file open */
+    if (map == MAP_FAILED) { return SKIPARRAY_OPEN_MAPPED_ERROR_IO; }
+
+    const uint8_t *bytes = map;
+    const uint8_t *trailer = &bytes[size - MAPPED_TRAILER_SIZE];
+    const uint16_t flags = get_u16(&bytes[10]);
+    const uint64_t blocks = get_u64(&trailer[8]);
+    const uint64_t index_offset = get_u64(&trailer[16]);
+    const uint64_t fence_offset = get_u64(&trailer[24]);
+    const uint64_t trailer_offset = size - MAPPED_TRAILER_SIZE;
+
+    if (0 != memcmp(bytes, MAPPED_MAGIC, FORMAT_MAGIC_SIZE)
+        || 0 != memcmp(&trailer[32], MAPPED_MAGIC, FORMAT_MAGIC_SIZE)
+        || get_u16(&bytes[8]) != MAPPED_VERSION
+        || (flags & ~FORMAT_FLAG_VALUES) != 0
+        || index_offset < MAPPED_HEADER_SIZE
+        || index_offset > trailer_offset
+        || blocks > (trailer_offset - index_offset) / MAPPED_INDEX_ENTRY_SIZE
+        || fence_offset != index_offset + blocks * MAPPED_INDEX_ENTRY_SIZE
+        || (blocks == 0) != (get_u64(&trailer[0]) == 0)) {
+        munmap(map, size);
+        return SKIPARRAY_OPEN_MAPPED_ERROR_FORMAT;
+    }
+
+    struct skiparray_ro *res = malloc(sizeof(*res));
+    if (res == NULL) {
+        munmap(map, size);
+        return SKIPARRAY_OPEN_MAPPED_ERROR_MEMORY;
+    }
+    *res = (struct skiparray_ro) {
+        .map = bytes,
+        .map_size = size,
+        .cmp = cmp,
+        .use_values = (flags & FORMAT_FLAG_VALUES) != 0,
+        .pairs = get_u64(&trailer[0]),
+        .blocks = blocks,
+        .index_offset = index_offset,
+        .fence_offset = fence_offset,
+    };
+    *ro = res;
+    return SKIPARRAY_OPEN_MAPPED_OK;
+}
+
+void
+skiparray_close_mapped(struct skiparray_ro *ro) {
+    if (ro == NULL) { return; }
+    munmap((void *)ro->map, ro->map_size);
+    free(ro);
+}
+
+size_t
+skiparray_ro_count(const struct skiparray_ro *ro) {
+    assert(ro != NULL);
+    return (size_t)ro->pairs;
+}
+
+static int
+cmp_bytes(const struct skiparray_ro *ro,
+    const struct skiparray_bytes *a, const struct skiparray_bytes *b) {
+    if (ro->cmp != NULL) { return ro->cmp(a, b, NULL); }
+
+    const size_t len = (a->len < b->len ? a->len : b->len);
+    const int res = (len == 0 ? 0 : memcmp(a->bytes, b->bytes, len));
+    if (res != 0) { return res; }
+    return (a->len < b->len ? -1 : a->len > b->len ? 1 : 0);
+}
+
+/* Get the bytes from OFFSETS[i] to OFFSETS[i + 1] within BASE. Since
+ * the file was not checked on open, out of range offsets give an
+ * empty slice rather than reading outside the mapping. */
+static void
+get_slice(const uint8_t *base, size_t size, const uint8_t *offsets,
+    uint64_t i, struct skiparray_bytes *res) {
+    const uint32_t start = get_u32(&offsets[4*i]);
+    const uint32_t end = get_u32(&offsets[4*(i + 1)]);
+    if (start <= end && end <= size) {
+        res->bytes = &base[start];
+        res->len = end - start;
+    } else {
+        res->bytes = base;
+        res->len = 0;
+    }
+}
+
+static void
+get_fence(const struct skiparray_ro *ro, uint64_t block,
+    struct skiparray_bytes *res) {
+    const uint8_t *entry = &ro->map[ro->index_offset
+        + block * MAPPED_INDEX_ENTRY_SIZE];
+    const uint64_t start = get_u32(&entry[8]);
+    const uint64_t len = get_u32(&entry[12]);
+    const uint64_t heap_size = ro->map_size - MAPPED_TRAILER_SIZE
+      - ro->fence_offset;
+    if (start + len <= heap_size) {
+        res->bytes = &ro->map[ro->fence_offset + start];
+        res->len = (size_t)len;
+    } else {
+        res->bytes = ro->map;
+        res->len = 0;
+    }
+}
+
+/* Find block I's bounds. A block that does not fit (which only
+ * happens in a damaged file) is treated as empty. */
+static void
+get_block(const struct skiparray_ro *ro, uint64_t i, struct block *b) {
+    const uint8_t *entry = &ro->map[ro->index_offset
+        + i * MAPPED_INDEX_ENTRY_SIZE];
+    const uint64_t start = get_u64(&entry[0]);
+    const uint64_t end = (i + 1 < ro->blocks
+        ? get_u64(&entry[MAPPED_INDEX_ENTRY_SIZE]) : ro->index_offset);
+
+    memset(b, 0x00, sizeof(*b));
+    b->base = ro->map;
+    if (start < MAPPED_HEADER_SIZE || start > end || end > ro->index_offset
+        || end - start < MAPPED_BLOCK_HEADER_SIZE) {
+        return;
+    }
+    b->base = &ro->map[start];
+    b->size = (size_t)(end - start);
+
+    const uint64_t count = get_u32(&b->base[0]);
+    const uint64_t tables = (ro->use_values ? 2 : 1) * 4 * (count + 1);
+    if (tables > b->size - MAPPED_BLOCK_HEADER_SIZE) { return; }
+    b->count = (uint32_t)count;
+    b->key_offsets = &b->base[MAPPED_BLOCK_HEADER_SIZE];
+    if (ro->use_values) {
+        b->value_offsets = &b->key_offsets[4 * (count + 1)];
+    }
+}
+
+static void
+get_pair(const struct block *b, uint32_t i,
+    struct skiparray_bytes *key, struct skiparray_bytes *value) {
+    assert(i < b->count);
+    if (key != NULL) { get_slice(b->base, b->size, b->key_offsets, i, key); }
+    if (value != NULL) {
+        if (b->value_offsets != NULL) {
+            get_slice(b->base, b->size, b->value_offsets, i, value);
+        } else {
+            value->bytes = NULL;
+            value->len = 0;
+        }
+    }
+}
+
+/* Find the last block whose first key is <= KEY. Returns false
+ * if KEY is before every block. */
+static bool
+search_index(const struct skiparray_ro *ro,
+    const struct skiparray_bytes *key, uint64_t *block) {
+    uint64_t lo = 0;
+    uint64_t hi = ro->blocks;   /* first block with fence > key */
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo)/2;
+        struct skiparray_bytes fence;
+        get_fence(ro, mid, &fence);
+        if (cmp_bytes(ro, &fence, key) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) { return false; }
+    *block = lo - 1;
+    return true;
+}
+
+/* Find the first position in B with a key >= KEY, which may be
+ * B->count, and whether that key is equal. */
+static uint32_t
+search_block(const struct skiparray_ro *ro, const struct block *b,
+    const struct skiparray_bytes *key, bool *found) {
+    uint32_t lo = 0;
+    uint32_t hi = b->count;
+    *found = false;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo)/2;
+        struct skiparray_bytes k;
+        get_slice(b->base, b->size, b->key_offsets, mid, &k);
+        const int res = cmp_bytes(ro, &k, key);
+        if (res < 0) {
+            lo = mid + 1;
+        } else {
+            if (res == 0) { *found = true; }
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool
+skiparray_ro_get(const struct skiparray_ro *ro,
+    const struct skiparray_bytes *key, struct skiparray_bytes *value) {
+    assert(ro != NULL);
+    assert(key != NULL);
+
+    uint64_t block;
+    if (!search_index(ro, key, &block)) { return false; }
+
+    struct block b;
+    get_block(ro, block, &b);
+    bool found;
+    const uint32_t pos = search_block(ro, &b, key, &found);
+    if (!found) { return false; }
+    get_pair(&b, pos, NULL, value);
+    return true;
+}
+
+enum skiparray_iter_new_res
+skiparray_ro_iter_new(struct skiparray_ro *ro,
+    struct skiparray_ro_iter **res) {
+    assert(ro != NULL);
+    assert(res != NULL);
+    if (ro->pairs == 0) { return SKIPARRAY_ITER_NEW_EMPTY; }
+
+    struct skiparray_ro_iter *iter = malloc(sizeof(*iter));
+    if (iter == NULL) { return SKIPARRAY_ITER_NEW_ERROR_MEMORY; }
+    iter->ro = ro;
+    skiparray_ro_iter_seek_endpoint(iter, SKIPARRAY_ITER_SEEK_FIRST);
+    *res = iter;
+    return SKIPARRAY_ITER_NEW_OK;
+}
+
+void
+skiparray_ro_iter_free(struct skiparray_ro_iter *iter) {
+    free(iter);
+}
+
+/* Move forward from block BLOCK, position POS to the next existing
+ * pair, skipping any empty blocks. */
+static bool
+settle_forward(const struct skiparray_ro *ro, uint64_t block, uint32_t pos,
+    struct skiparray_ro_iter *iter) {
+    while (block < ro->blocks) {
+        struct block b;
+        get_block(ro, block, &b);
+        if (pos < b.count) {
+            iter->block = block;
+            iter->pos = pos;
+            return true;
+        }
+        block++;
+        pos = 0;
+    }
+    return false;
+}
+
+/* Move backward to the last pair in block BLOCK or an earlier one. */
+static bool
+settle_backward(const struct skiparray_ro *ro, uint64_t block,
+    struct skiparray_ro_iter *iter) {
+    for (uint64_t i = block + 1; i > 0; i--) {
+        struct block b;
+        get_block(ro, i - 1, &b);
+        if (b.count > 0) {
+            iter->block = i - 1;
+            iter->pos = b.count - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+skiparray_ro_iter_seek_endpoint(struct skiparray_ro_iter *iter,
+    enum skiparray_iter_seek_endpoint end) {
+    assert(iter != NULL);
+    const struct skiparray_ro *ro = iter->ro;
+    switch (end) {
+    case SKIPARRAY_ITER_SEEK_FIRST:
+        if (!settle_forward(ro, 0, 0, iter)) {
+            iter->block = 0;
+            iter->pos = 0;
+        }
+        break;
+    case SKIPARRAY_ITER_SEEK_LAST:
+        if (!settle_backward(ro, ro->blocks - 1, iter)) {
+            iter->block = 0;
+            iter->pos = 0;
+        }
+        break;
+    default:
+        assert(false);
+    }
+}
+
+enum skiparray_iter_seek_res
+skiparray_ro_iter_seek(struct skiparray_ro_iter *iter,
+    const struct skiparray_bytes *key) {
+    assert(iter != NULL);
+    assert(key != NULL);
+    const struct skiparray_ro *ro = iter->ro;
+
+    uint64_t block = 0;
+    bool found = false;
+    uint32_t pos = 0;
+    if (search_index(ro, key, &block)) {
+        struct block b;
+        get_block(ro, block, &b);
+        pos = search_block(ro, &b, key, &found);
+    }
+
+    if (found) {
+        iter->block = block;
+        iter->pos = pos;
+        return SKIPARRAY_ITER_SEEK_FOUND;
+    }
+
+    struct skiparray_ro_iter next = *iter;
+    if (!settle_forward(ro, block, pos, &next)) {
+        return SKIPARRAY_ITER_SEEK_ERROR_AFTER_LAST;
+    }
+    if (next.block == 0 && next.pos == 0) {
+        /* Either KEY is before every block, or it fell between
+         * the first key and the rest, which is NOT_FOUND. */
+        struct skiparray_bytes first;
+        struct block b;
+        get_block(ro, 0, &b);
+        get_pair(&b, 0, &first, NULL);
+        if (cmp_bytes(ro, key, &first) < 0) {
+            return SKIPARRAY_ITER_SEEK_ERROR_BEFORE_FIRST;
+        }
+    }
+    *iter = next;
+    return SKIPARRAY_ITER_SEEK_NOT_FOUND;
+}
+
+enum skiparray_iter_step_res
+skiparray_ro_iter_next(struct skiparray_ro_iter *iter) {
+    assert(iter != NULL);
+    struct skiparray_ro_iter next = *iter;
+    if (!settle_forward(iter->ro, iter->block, iter->pos + 1, &next)) {
+        return SKIPARRAY_ITER_STEP_END;
+    }
+    *iter = next;
+    return SKIPARRAY_ITER_STEP_OK;
+}
+
+enum skiparray_iter_step_res
+skiparray_ro_iter_prev(struct skiparray_ro_iter *iter) {
+    assert(iter != NULL);
+    if (iter->pos > 0) {
+        iter->pos--;
+        return SKIPARRAY_ITER_STEP_OK;
+    }
+    if (iter->block == 0
+        || !settle_backward(iter->ro, iter->block - 1, iter)) {
+        return SKIPARRAY_ITER_STEP_END;
+    }
+    return SKIPARRAY_ITER_STEP_OK;
+}
+
+void
+skiparray_ro_iter_get(struct skiparray_ro_iter *iter,
+    struct skiparray_bytes *key, struct skiparray_bytes *value) {
+    assert(iter != NULL);
+    struct block b;
+    get_block(iter->ro, iter->block, &b);
+    get_pair(&b, iter->pos, key, value);
+}
+
+enum skiparray_fold_res
+skiparray_ro_fold(enum skiparray_fold_type direction,
+    const struct skiparray_ro *ro, skiparray_fold_fun *cb, void *udata) {
+    if (ro == NULL || cb == NULL) { return SKIPARRAY_FOLD_ERROR_MISUSE; }
+    if (direction != SKIPARRAY_FOLD_LEFT && direction != SKIPARRAY_FOLD_RIGHT) {
+        return SKIPARRAY_FOLD_ERROR_MISUSE;
+    }
+    const bool left = direction == SKIPARRAY_FOLD_LEFT;
+
+    for (uint64_t i = 0; i < ro->blocks; i++) {
+        struct block b;
+        get_block(ro, left ? i : ro->blocks - 1 - i, &b);
+        for (uint32_t j = 0; j < b.count; j++) {
+            struct skiparray_bytes key, value;
+            get_pair(&b, left ? j : b.count - 1 - j, &key, &value);
+            cb(&key, &value, udata);
+        }
+    }
+    return SKIPARRAY_FOLD_OK;
+}
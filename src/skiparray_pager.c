@@ -0,0 +1,524 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "skiparray_serialize_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Paging: resident nodes are kept on a ring, and evicted by the CLOCK
+ * algorithm -- the hand sweeps the ring, giving nodes that were used
+ * since it last passed another chance, and evicting the first one that
+ * wasn't. An evicted node keeps its header and last pair, and the rest
+ * of its pairs are stored as a page:
+ *
+ *     0  u32 pair count (one less than the node's)
+ *     4  per pair, u32 key length, key bytes, and with values,
+ *        u32 value length, value bytes
+ *
+ * (little-endian, as in the dump format). */
+
+#define PAGE_HEADER_SIZE 4
+
+struct skiparray_pager {
+    struct skiparray_pager_config config;
+    struct skiparray *sa;       /* skiparray being paged, if any */
+    struct skiparray_page *hand; /* clock hand, on the resident ring */
+    struct skiparray_buf buf;   /* for encoding and reading pages */
+    struct skiparray_pager_stats stats;
+};
+
+enum skiparray_pager_new_res
+skiparray_pager_new(const struct skiparray_pager_config *config,
+    struct skiparray_pager **pager) {
+    if (config == NULL || pager == NULL) {
+        return SKIPARRAY_PAGER_NEW_ERROR_NULL;
+    }
+    if (config->write == NULL || config->read == NULL
+        || config->encode_key == NULL || config->decode_key == NULL
+        || (config->encode_value == NULL) != (config->decode_value == NULL)) {
+        return SKIPARRAY_PAGER_NEW_ERROR_CONFIG;
+    }
+
+    struct skiparray_pager *res = malloc(sizeof(*res));
+    if (res == NULL) { return SKIPARRAY_PAGER_NEW_ERROR_MEMORY; }
+    memset(res, 0x00, sizeof(*res));
+    res->config = *config;
+    if (res->config.cache_nodes == 0) {
+        res->config.cache_nodes = SKIPARRAY_PAGER_DEF_CACHE_NODES;
+    }
+    *pager = res;
+    return SKIPARRAY_PAGER_NEW_OK;
+}
+
+void
+skiparray_pager_free(struct skiparray_pager *pager) {
+    if (pager == NULL) { return; }
+    assert(pager->sa == NULL);
+    free(pager);
+}
+
+void
+skiparray_pager_stats(const struct skiparray_pager *pager,
+    struct skiparray_pager_stats *stats) {
+    assert(pager != NULL);
+    assert(stats != NULL);
+    memcpy(stats, &pager->stats, sizeof(*stats));
+}
+
+bool
+skiparray_pager_attach(struct skiparray_pager *pager, struct skiparray *sa) {
+    if (pager->sa != NULL) { return false; }
+    if (sa->use_values && pager->config.encode_value == NULL) {
+        return false;
+    }
+    pager->sa = sa;
+    pager->buf = (struct skiparray_buf) {
+        .mem = sa->mem,
+        .mem_udata = sa->mem_udata,
+    };
+    return true;
+}
+
+void
+skiparray_pager_detach(struct skiparray_pager *pager) {
+    assert(pager->stats.resident == 0);
+    skiparray_buf_free(&pager->buf);
+    pager->sa = NULL;
+    pager->hand = NULL;
+}
+
+/* Add P to the ring just behind the hand, so it's the last to be
+ * considered on the next sweep. */
+static void
+ring_add(struct skiparray_pager *pager, struct skiparray_page *p) {
+    struct skiparray_page *hand = pager->hand;
+    if (hand == NULL) {
+        p->prev = p;
+        p->next = p;
+        pager->hand = p;
+    } else {
+        p->prev = hand->prev;
+        p->next = hand;
+        hand->prev->next = p;
+        hand->prev = p;
+    }
+    p->referenced = true;
+    pager->stats.resident++;
+}
+
+static void
+ring_remove(struct skiparray_pager *pager, struct skiparray_page *p) {
+    if (p->next == p) {
+        assert(pager->hand == p);
+        pager->hand = NULL;
+    } else {
+        if (pager->hand == p) { pager->hand = p->next; }
+        p->prev->next = p->next;
+        p->next->prev = p->prev;
+    }
+    p->prev = NULL;
+    p->next = NULL;
+    assert(pager->stats.resident > 0);
+    pager->stats.resident--;
+}
+
+bool
+skiparray_pager_attach_node(struct skiparray_pager *pager, struct node *n) {
+    const struct skiparray *sa = pager->sa;
+    struct skiparray_page *p = sa->mem(NULL, sizeof(*p), sa->mem_udata);
+    if (p == NULL) { return false; }
+    memset(p, 0x00, sizeof(*p));
+    p->node = n;
+    p->dirty = true;
+    n->page = p;
+    ring_add(pager, p);
+    return true;
+}
+
+void
+skiparray_pager_detach_node(struct skiparray_pager *pager, struct node *n) {
+    struct skiparray_page *p = n->page;
+    if (p == NULL) { return; }
+    if (n->keys != NULL) { ring_remove(pager, p); }
+    if (p->size > 0 && pager->config.release != NULL) {
+        pager->config.release(p->id, p->size, pager->config.store_udata);
+    }
+    const struct skiparray *sa = pager->sa;
+    sa->mem(p, 0, sa->mem_udata);
+    n->page = NULL;
+}
+
+static bool
+encode_item(struct skiparray_buf *b, skiparray_encode_fun *encode,
+    const void *x, void *udata) {
+    if (!skiparray_buf_reserve(b, sizeof(uint32_t))) { return false; }
+    const size_t len_pos = b->used;
+    b->used += sizeof(uint32_t);
+    size_t len = 0;
+    if (SKIPARRAY_DUMP_OK != skiparray_buf_append_encoded(b,
+            encode, x, udata, &len)) {
+        return false;
+    }
+    put_u32(&b->bytes[len_pos], (uint32_t)len);
+    return true;
+}
+
+/* Store all but the last of N's pairs in a page, unless the stored
+ * page is still current. */
+static bool
+store_page(struct skiparray_pager *pager, struct node *n) {
+    struct skiparray_page *p = n->page;
+    if (!p->dirty && p->size > 0) { return true; }
+
+    const struct skiparray *sa = pager->sa;
+    const struct skiparray_pager_config *cfg = &pager->config;
+    struct skiparray_buf *b = &pager->buf;
+    b->used = 0;
+    if (!skiparray_buf_reserve(b, PAGE_HEADER_SIZE)) { return false; }
+    put_u32(b->bytes, n->count - 1);
+    b->used = PAGE_HEADER_SIZE;
+
+    for (uint16_t i = 0; i < n->count - 1; i++) {
+        if (!encode_item(b, cfg->encode_key,
+                n->keys[n->offset + i], cfg->udata)) {
+            return false;
+        }
+        if (sa->use_values && !encode_item(b, cfg->encode_value,
+                n->values[n->offset + i], cfg->udata)) {
+            return false;
+        }
+    }
+
+    uint64_t id;
+    if (!cfg->write(b->bytes, b->used, &id, cfg->store_udata)) {
+        return false;
+    }
+    pager->stats.writes++;
+    if (p->size > 0 && cfg->release != NULL) {
+        cfg->release(p->id, p->size, cfg->store_udata);
+    }
+    p->id = id;
+    p->size = b->used;
+    p->dirty = false;
+    return true;
+}
+
+static bool
+evict(struct skiparray_pager *pager, struct node *n) {
+    assert(n->keys != NULL);
+    assert(n->count > 0);
+    if (!store_page(pager, n)) {
+        pager->stats.write_errors++;
+        return false;
+    }
+
+    const struct skiparray *sa = pager->sa;
+    struct skiparray_page *p = n->page;
+    const uint16_t last = n->offset + n->count - 1;
+    p->last_key = n->keys[last];
+    p->last_value = (sa->use_values ? n->values[last] : NULL);
+
+    if (sa->free != NULL) {
+        for (uint16_t i = n->offset; i < last; i++) {
+            sa->free(n->keys[i],
+                sa->use_values ? n->values[i] : NULL, sa->udata);
+        }
+    }
+    sa->mem(n->keys, 0, sa->mem_udata);
+    if (n->values != NULL) { sa->mem(n->values, 0, sa->mem_udata); }
+    n->keys = NULL;
+    n->values = NULL;
+
+    ring_remove(pager, p);
+    pager->stats.evictions++;
+    return true;
+}
+
+static bool
+decode_item(const uint8_t **pos, const uint8_t *end,
+    skiparray_decode_fun *decode, void **x, void *udata) {
+    if ((size_t)(end - *pos) < sizeof(uint32_t)) { return false; }
+    const uint32_t len = get_u32(*pos);
+    *pos += sizeof(uint32_t);
+    if ((size_t)(end - *pos) < len) { return false; }
+    if (!decode(*pos, len, x, udata)) { return false; }
+    *pos += len;
+    return true;
+}
+
+/* Read N's page and decode its pairs into new key and value arrays.
+ * On failure, set *ERROR, and free anything decoded so far. */
+static bool
+read_page(struct skiparray_pager *pager, struct node *n,
+    void ***keys_out, void ***values_out, enum skiparray_pager_error *error) {
+    const struct skiparray *sa = pager->sa;
+    const struct skiparray_pager_config *cfg = &pager->config;
+    const struct skiparray_page *p = n->page;
+
+    struct skiparray_buf *b = &pager->buf;
+    b->used = 0;
+    if (!skiparray_buf_reserve(b, p->size)) {
+        *error = SKIPARRAY_PAGER_ERROR_MEMORY;
+        return false;
+    }
+    if (!cfg->read(p->id, b->bytes, p->size, cfg->store_udata)) {
+        *error = SKIPARRAY_PAGER_ERROR_READ;
+        return false;
+    }
+    if (get_u32(b->bytes) != (uint32_t)n->count - 1) {
+        *error = SKIPARRAY_PAGER_ERROR_DECODE;
+        return false;
+    }
+
+    uint16_t i = 0;             /* pairs decoded */
+    void **keys = sa->mem(NULL, n->capacity * sizeof(keys[0]), sa->mem_udata);
+    void **values = NULL;
+    if (sa->use_values) {
+        values = sa->mem(NULL, n->capacity * sizeof(values[0]), sa->mem_udata);
+    }
+    if (keys == NULL || (sa->use_values && values == NULL)) {
+        *error = SKIPARRAY_PAGER_ERROR_MEMORY;
+        goto cleanup;
+    }
+
+    const uint8_t *pos = b->bytes + PAGE_HEADER_SIZE;
+    const uint8_t *end = b->bytes + p->size;
+    for (; i < n->count - 1; i++) {
+        if (!decode_item(&pos, end, cfg->decode_key, &keys[i], cfg->udata)) {
+            *error = SKIPARRAY_PAGER_ERROR_DECODE;
+            goto cleanup;
+        }
+        if (sa->use_values && !decode_item(&pos, end,
+                cfg->decode_value, &values[i], cfg->udata)) {
+            if (sa->free != NULL) { sa->free(keys[i], NULL, sa->udata); }
+            *error = SKIPARRAY_PAGER_ERROR_DECODE;
+            goto cleanup;
+        }
+    }
+    *keys_out = keys;
+    *values_out = values;
+    return true;
+
+cleanup:
+    if (sa->free != NULL) {
+        for (uint16_t j = 0; j < i; j++) {
+            sa->free(keys[j], sa->use_values ? values[j] : NULL, sa->udata);
+        }
+    }
+    if (keys != NULL) { sa->mem(keys, 0, sa->mem_udata); }
+    if (values != NULL) { sa->mem(values, 0, sa->mem_udata); }
+    return false;
+}
+
+/* Read N back in, retrying for as long as the on_error callback asks
+ * to. Returns false, leaving N paged out, if it gives up. */
+static bool
+load_page(struct skiparray_pager *pager, struct node *n) {
+    const struct skiparray_pager_config *cfg = &pager->config;
+    struct skiparray_page *p = n->page;
+    assert(p->size > 0);
+
+    void **keys = NULL;
+    void **values = NULL;
+    enum skiparray_pager_error error;
+    while (!read_page(pager, n, &keys, &values, &error)) {
+        pager->stats.read_errors++;
+        if (cfg->on_error == NULL
+            || !cfg->on_error(error, p->id, cfg->store_udata)) {
+            return false;
+        }
+    }
+
+    keys[n->count - 1] = p->last_key;
+    if (values != NULL) { values[n->count - 1] = p->last_value; }
+    p->last_key = NULL;
+    p->last_value = NULL;
+
+    n->keys = keys;
+    n->values = values;
+    n->offset = 0;
+    ring_add(pager, p);
+    pager->stats.faults++;
+    return true;
+}
+
+bool
+skiparray_pager_page_in(struct skiparray_pager *pager, struct node *n,
+    bool dirty) {
+    struct skiparray_page *p = n->page;
+    assert(p != NULL);
+    if (n->keys == NULL && !load_page(pager, n)) { return false; }
+    p->referenced = true;
+    if (dirty) { p->dirty = true; }
+    return true;
+}
+
+static bool
+has_iterator(const struct skiparray *sa, const struct node *n) {
+    for (const struct skiparray_iter *i = sa->iter; i != NULL; i = i->next) {
+        if (i->n == n) { return true; }
+    }
+    return false;
+}
+
+void
+skiparray_pager_trim(struct skiparray_pager *pager, const struct node *pin) {
+    const struct skiparray *sa = pager->sa;
+    const size_t limit = pager->config.cache_nodes;
+
+    /* Two passes of the hand clear every reference bit, so after
+     * that, only pinned nodes or failed writes can stop eviction. */
+    size_t steps = 2 * pager->stats.resident;
+    while (pager->stats.resident > limit && steps > 0) {
+        steps--;
+        struct skiparray_page *p = pager->hand;
+        pager->hand = p->next;
+        if (p->referenced) {
+            p->referenced = false;
+            continue;
+        }
+        struct node *n = p->node;
+        if (n == pin || n->count == 0 || has_iterator(sa, n)) { continue; }
+        (void)evict(pager, n);
+    }
+}
+
+/*
+ * Page file
+ */
+
+/* Pages are stored in slots of power-of-two sizes, and freed slots are
+ * kept on a stack per size for reuse. */
+#define PAGE_FILE_MIN_SLOT_BITS 6
+#define PAGE_FILE_SLOT_CLASSES 48
+
+struct skiparray_page_file {
+    int fd;
+    uint64_t end;               /* end of the last slot */
+    struct slot_stack {
+        uint64_t *offsets;
+        size_t count;
+        size_t ceil;
+    } free_slots[PAGE_FILE_SLOT_CLASSES];
+};
+
+enum skiparray_page_file_open_res
+skiparray_page_file_open(const char *path,
+    struct skiparray_page_file **pf) {
+    if (path == NULL || pf == NULL) {
+        return SKIPARRAY_PAGE_FILE_OPEN_ERROR_NULL;
+    }
+    struct skiparray_page_file *res = malloc(sizeof(*res));
+    if (res == NULL) { return SKIPARRAY_PAGE_FILE_OPEN_ERROR_MEMORY; }
+    memset(res, 0x00, sizeof(*res));
+
+    res->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (res->fd == -1) {
+        free(res);
+        return SKIPARRAY_PAGE_FILE_OPEN_ERROR_IO;
+    }
+    *pf = res;
+    return SKIPARRAY_PAGE_FILE_OPEN_OK;
+}
+
+void
+skiparray_page_file_close(struct skiparray_page_file *pf) {
+    if (pf == NULL) { return; }
+    for (size_t i = 0; i < PAGE_FILE_SLOT_CLASSES; i++) {
+        free(pf->free_slots[i].offsets);
+    }
+    close(pf->fd);
+    free(pf);
+}
+
+static size_t
+slot_class(size_t len) {
+    size_t class = 0;
+    while (class < PAGE_FILE_SLOT_CLASSES - 1
+        && ((size_t)1 << (class + PAGE_FILE_MIN_SLOT_BITS)) < len) {
+        class++;
+    }
+    return class;
+}
+
+bool
+skiparray_page_file_write(const uint8_t *buf, size_t len,
+    uint64_t *page_id, void *udata) {
+    struct skiparray_page_file *pf = udata;
+    const size_t class = slot_class(len);
+    const uint64_t slot_size = (uint64_t)1 << (class + PAGE_FILE_MIN_SLOT_BITS);
+    if (len > slot_size) { return false; }
+
+    struct slot_stack *st = &pf->free_slots[class];
+    const bool reused = st->count > 0;
+    const uint64_t offset = (reused ? st->offsets[st->count - 1] : pf->end);
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t wr = pwrite(pf->fd, &buf[done], len - done,
+            (off_t)(offset + done));
+        if (wr == -1) {
+            if (errno == EINTR) { continue; }
+            return false;
+        }
+        done += (size_t)wr;
+    }
+
+    if (reused) {
+        st->count--;
+    } else {
+        pf->end += slot_size;
+    }
+    *page_id = offset;
+    return true;
+}
+
+bool
+skiparray_page_file_read(uint64_t page_id, uint8_t *buf, size_t len,
+    void *udata) {
+    struct skiparray_page_file *pf = udata;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t rd = pread(pf->fd, &buf[done], len - done,
+            (off_t)(page_id + done));
+        if (rd == -1) {
+            if (errno == EINTR) { continue; }
+            return false;
+        }
+        if (rd == 0) { return false; } /* short file */
+        done += (size_t)rd;
+    }
+    return true;
+}
+
+void
+skiparray_page_file_release(uint64_t page_id, size_t len, void *udata) {
+    struct skiparray_page_file *pf = udata;
+    struct slot_stack *st = &pf->free_slots[slot_class(len)];
+    if (st->count == st->ceil) {
+        const size_t nceil = (st->ceil == 0 ? 16 : 2 * st->ceil);
+        uint64_t *noffsets = realloc(st->offsets,
+            nceil * sizeof(noffsets[0]));
+        if (noffsets == NULL) { return; } /* just leak the slot */
+        st->offsets = noffsets;
+        st->ceil = nceil;
+    }
+    st->offsets[st->count++] = page_id;
+}
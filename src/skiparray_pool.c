@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "skiparray_internal_types.h"
+
+/* Node pool: every block has room for a node header at the pool's
+ * max_level, followed by the key array and (optionally) the value
+ * array, so blocks are interchangeable between nodes of any height. */
+
+static void *
+pool_def_memory_fun(void *p, size_t nsize, void *udata) {
+    (void)udata;
+    if (p != NULL) {
+        assert(nsize == 0);     /* no realloc used */
+        free(p);
+        return NULL;
+    } else {
+        return malloc(nsize);
+    }
+}
+
+enum skiparray_pool_new_res
+skiparray_pool_new(const struct skiparray_pool_config *config,
+    struct skiparray_pool **pool) {
+    if (config == NULL || pool == NULL) {
+        return SKIPARRAY_POOL_NEW_ERROR_NULL;
+    }
+
+    if (config->node_size == 1
+        || config->max_level > SKIPARRAY_MAX_MAX_LEVEL) {
+        return SKIPARRAY_POOL_NEW_ERROR_CONFIG;
+    }
+
+#define DEF(FIELD, DEF) (config->FIELD == 0 ? DEF : config->FIELD)
+    const uint16_t node_size = DEF(node_size, SKIPARRAY_DEF_NODE_SIZE);
+    const uint8_t max_level = DEF(max_level, SKIPARRAY_DEF_MAX_LEVEL);
+    const size_t high_watermark = DEF(high_watermark,
+        SKIPARRAY_POOL_DEF_HIGH_WATERMARK);
+    skiparray_memory_fun *mem = (config->memory == NULL
+        ? pool_def_memory_fun : config->memory);
+#undef DEF
+
+    if (config->low_watermark > high_watermark) {
+        return SKIPARRAY_POOL_NEW_ERROR_CONFIG;
+    }
+
+    /* Pad the header so the key array stays word-aligned. */
+    const size_t word = sizeof(void *);
+    size_t header_size = sizeof(struct node)
+      + max_level * sizeof(struct node *);
+    header_size = (header_size + word - 1) & ~(word - 1);
+
+    const size_t array_size = node_size * sizeof(void *);
+    const size_t block_size = header_size
+      + (config->ignore_values ? 1 : 2) * array_size;
+
+    struct skiparray_pool *res = mem(NULL, sizeof(*res), config->udata);
+    if (res == NULL) { return SKIPARRAY_POOL_NEW_ERROR_MEMORY; }
+
+    struct skiparray_pool fields = {
+        .node_size = node_size,
+        .max_level = max_level,
+        .use_values = !config->ignore_values,
+        .high_watermark = high_watermark,
+        .low_watermark = config->low_watermark,
+        .header_size = header_size,
+        .block_size = block_size,
+        .mem = mem,
+        .udata = config->udata,
+        .stats = {
+            .block_size = block_size,
+        },
+    };
+    memcpy(res, &fields, sizeof(fields));
+
+    *pool = res;
+    return SKIPARRAY_POOL_NEW_OK;
+}
+
+static void
+release_cached(struct skiparray_pool *pool, size_t keep) {
+    while (pool->stats.cached > keep) {
+        void *block = pool->free_list;
+        assert(block != NULL);
+        memcpy(&pool->free_list, block, sizeof(void *));
+        pool->mem(block, 0, pool->udata);
+        pool->stats.cached--;
+        pool->stats.frees++;
+    }
+}
+
+void
+skiparray_pool_free(struct skiparray_pool *pool) {
+    if (pool == NULL) { return; }
+    assert(pool->users == 0);
+    assert(pool->stats.in_use == 0);
+    release_cached(pool, 0);
+    pool->mem(pool, 0, pool->udata);
+}
+
+void
+skiparray_pool_trim(struct skiparray_pool *pool) {
+    assert(pool != NULL);
+    release_cached(pool, pool->low_watermark);
+}
+
+bool
+skiparray_pool_reserve(struct skiparray_pool *pool, size_t count) {
+    assert(pool != NULL);
+    if (count > pool->high_watermark) { count = pool->high_watermark; }
+    while (pool->stats.cached < count) {
+        void *block = pool->mem(NULL, pool->block_size, pool->udata);
+        if (block == NULL) { return false; }
+        memcpy(block, &pool->free_list, sizeof(void *));
+        pool->free_list = block;
+        pool->stats.cached++;
+    }
+    return true;
+}
+
+void
+skiparray_pool_stats(const struct skiparray_pool *pool,
+    struct skiparray_pool_stats *stats) {
+    assert(pool != NULL);
+    assert(stats != NULL);
+    memcpy(stats, &pool->stats, sizeof(*stats));
+}
+
+void *
+skiparray_pool_get(struct skiparray_pool *pool) {
+    void *block = pool->free_list;
+    if (block != NULL) {
+        memcpy(&pool->free_list, block, sizeof(void *));
+        pool->stats.cached--;
+        pool->stats.hits++;
+    } else {
+        block = pool->mem(NULL, pool->block_size, pool->udata);
+        if (block == NULL) { return NULL; }
+        pool->stats.misses++;
+    }
+    pool->stats.in_use++;
+    return block;
+}
+
+void
+skiparray_pool_put(struct skiparray_pool *pool, void *block) {
+    assert(block != NULL);
+    assert(pool->stats.in_use > 0);
+    pool->stats.in_use--;
+    pool->stats.releases++;
+
+    if (pool->stats.cached >= pool->high_watermark) {
+        pool->mem(block, 0, pool->udata);
+        pool->stats.frees++;
+        return;
+    }
+
+    memcpy(block, &pool->free_list, sizeof(void *));
+    pool->free_list = block;
+    pool->stats.cached++;
+}
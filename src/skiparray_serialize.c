@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "skiparray_serialize_internal.h"
+
+/* Binary dump and load. See skiparray_serialize_internal.h for the
+ * format. */
+
+bool
+skiparray_buf_reserve(struct skiparray_buf *b, size_t extra) {
+    if (b->size - b->used >= extra) { return true; }
+    size_t nsize = (b->size == 0 ? 4096 : b->size);
+    while (nsize - b->used < extra) {
+        if (nsize > SIZE_MAX / 2) { return false; }
+        nsize *= 2;
+    }
+
+    uint8_t *nbytes = b->mem(NULL, nsize, b->mem_udata);
+    if (nbytes == NULL) { return false; }
+    if (b->bytes != NULL) {
+        memcpy(nbytes, b->bytes, b->used);
+        b->mem(b->bytes, 0, b->mem_udata);
+    }
+    b->bytes = nbytes;
+    b->size = nsize;
+    return true;
+}
+
+void
+skiparray_buf_free(struct skiparray_buf *b) {
+    if (b->bytes != NULL) { b->mem(b->bytes, 0, b->mem_udata); }
+    b->bytes = NULL;
+    b->size = 0;
+    b->used = 0;
+}
+
+enum skiparray_dump_res
+skiparray_buf_append_encoded(struct skiparray_buf *b,
+    skiparray_encode_fun *encode, const void *x, void *udata,
+    size_t *len) {
+    size_t avail = b->size - b->used;
+    size_t need = 0;
+    if (!encode(x, &b->bytes[b->used], avail, &need, udata)) {
+        return SKIPARRAY_DUMP_ERROR_ENCODE;
+    }
+    if (need > UINT32_MAX) { return SKIPARRAY_DUMP_ERROR_ENCODE; }
+
+    if (need > avail) {         /* retry with room */
+        if (!skiparray_buf_reserve(b, need)) {
+            return SKIPARRAY_DUMP_ERROR_MEMORY;
+        }
+        avail = b->size - b->used;
+        if (!encode(x, &b->bytes[b->used], avail, &need, udata)
+            || need > avail) {
+            return SKIPARRAY_DUMP_ERROR_ENCODE;
+        }
+    }
+
+    b->used += need;
+    *len = need;
+    return SKIPARRAY_DUMP_OK;
+}
+
+enum skiparray_dump_res
+skiparray_buf_append_item(struct skiparray_buf *b,
+    skiparray_encode_fun *encode, const void *x, void *udata) {
+    if (!skiparray_buf_reserve(b, sizeof(uint32_t))) {
+        return SKIPARRAY_DUMP_ERROR_MEMORY;
+    }
+    const size_t len_pos = b->used;
+    b->used += sizeof(uint32_t);
+
+    size_t len = 0;
+    enum skiparray_dump_res res = skiparray_buf_append_encoded(b,
+        encode, x, udata, &len);
+    if (res != SKIPARRAY_DUMP_OK) { return res; }
+    put_u32(&b->bytes[len_pos], (uint32_t)len);
+    return SKIPARRAY_DUMP_OK;
+}
+
+/* Finish the block in B (whose header space is reserved), and
+ * write it out. */
+static enum skiparray_dump_res
+write_block(struct skiparray_buf *b, uint32_t count,
+    const struct skiparray_dump_config *config) {
+    const size_t payload = b->used - FORMAT_BLOCK_HEADER_SIZE;
+    if (payload > UINT32_MAX) { return SKIPARRAY_DUMP_ERROR_ENCODE; }
+    put_u32(&b->bytes[0], count);
+    put_u32(&b->bytes[4], (uint32_t)payload);
+
+    if (config->checksum) {
+        if (!skiparray_buf_reserve(b, FORMAT_CRC_SIZE)) {
+            return SKIPARRAY_DUMP_ERROR_MEMORY;
+        }
+        put_u32(&b->bytes[b->used], skiparray_crc32(0, b->bytes, b->used));
+        b->used += FORMAT_CRC_SIZE;
+    }
+
+    if (!config->write(b->bytes, b->used, config->udata)) {
+        return SKIPARRAY_DUMP_ERROR_WRITE;
+    }
+    b->used = 0;
+    return SKIPARRAY_DUMP_OK;
+}
+
+enum skiparray_dump_res
+skiparray_dump(const struct skiparray *sa,
+    const struct skiparray_dump_config *config) {
+    if (sa == NULL || config == NULL
+        || config->write == NULL || config->encode_key == NULL
+        || (sa->use_values && config->encode_value == NULL)) {
+        return SKIPARRAY_DUMP_ERROR_MISUSE;
+    }
+
+    uint8_t header[FORMAT_HEADER_SIZE];
+    memset(header, 0x00, sizeof(header));
+    memcpy(header, FORMAT_MAGIC, FORMAT_MAGIC_SIZE);
+    put_u16(&header[8], FORMAT_VERSION);
+    put_u16(&header[10], (sa->use_values ? FORMAT_FLAG_VALUES : 0)
+        | (config->checksum ? FORMAT_FLAG_CHECKSUM : 0));
+    put_u16(&header[12], sa->node_size);
+    put_u64(&header[16], skiparray_count(sa));
+    if (config->checksum) {
+        put_u32(&header[28], skiparray_crc32(0, header, 28));
+    }
+    if (!config->write(header, sizeof(header), config->udata)) {
+        return SKIPARRAY_DUMP_ERROR_WRITE;
+    }
+
+    struct skiparray_buf b = {
+        .mem = sa->mem,
+        .mem_udata = sa->mem_udata,
+    };
+    enum skiparray_dump_res res = SKIPARRAY_DUMP_OK;
+
+    for (struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        if (n->count == 0) { continue; } /* empty root */
+        if (!dump_page_in(sa, n)) {
+            res = SKIPARRAY_DUMP_ERROR_PAGE;
+            goto cleanup;
+        }
+        if (!skiparray_buf_reserve(&b, FORMAT_BLOCK_HEADER_SIZE)) {
+            res = SKIPARRAY_DUMP_ERROR_MEMORY;
+            goto cleanup;
+        }
+        b.used = FORMAT_BLOCK_HEADER_SIZE;
+
+        for (uint16_t i = 0; i < n->count; i++) {
+            res = skiparray_buf_append_item(&b, config->encode_key,
+                n->keys[n->offset + i], config->udata);
+            if (res != SKIPARRAY_DUMP_OK) { goto cleanup; }
+            if (sa->use_values) {
+                res = skiparray_buf_append_item(&b, config->encode_value,
+                    n->values[n->offset + i], config->udata);
+                if (res != SKIPARRAY_DUMP_OK) { goto cleanup; }
+            }
+        }
+
+        res = write_block(&b, n->count, config);
+        if (res != SKIPARRAY_DUMP_OK) { goto cleanup; }
+    }
+
+    /* end block */
+    if (!skiparray_buf_reserve(&b, FORMAT_BLOCK_HEADER_SIZE)) {
+        res = SKIPARRAY_DUMP_ERROR_MEMORY;
+        goto cleanup;
+    }
+    b.used = FORMAT_BLOCK_HEADER_SIZE;
+    res = write_block(&b, 0, config);
+
+cleanup:
+    skiparray_buf_free(&b);
+    return res;
+}
+
+enum skiparray_load_res
+skiparray_load_pairs(struct skiparray_builder *builder,
+    const struct skiparray_config *config,
+    const struct skiparray_load_config *load_config, bool has_values,
+    const uint8_t *payload, size_t len, uint32_t count) {
+    const bool keep_values = has_values && !config->ignore_values;
+    void *udata = load_config->udata;
+    enum skiparray_load_res res = SKIPARRAY_LOAD_OK;
+    size_t pos = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        void *key = NULL;
+        void *value = NULL;
+
+        if (len - pos < sizeof(uint32_t)
+            || len - pos - sizeof(uint32_t) < get_u32(&payload[pos])) {
+            return SKIPARRAY_LOAD_ERROR_FORMAT;
+        }
+        const uint32_t key_len = get_u32(&payload[pos]);
+        pos += sizeof(uint32_t);
+        if (!load_config->decode_key(&payload[pos], key_len, &key, udata)) {
+            return SKIPARRAY_LOAD_ERROR_DECODE;
+        }
+        pos += key_len;
+
+        if (has_values) {
+            if (len - pos < sizeof(uint32_t)
+                || len - pos - sizeof(uint32_t) < get_u32(&payload[pos])) {
+                res = SKIPARRAY_LOAD_ERROR_FORMAT;
+            } else {
+                const uint32_t value_len = get_u32(&payload[pos]);
+                pos += sizeof(uint32_t);
+                if (keep_values && !load_config->decode_value(&payload[pos],
+                        value_len, &value, udata)) {
+                    res = SKIPARRAY_LOAD_ERROR_DECODE;
+                }
+                pos += value_len;
+            }
+        }
+
+        if (res == SKIPARRAY_LOAD_OK
+            && SKIPARRAY_BUILDER_APPEND_OK
+            != skiparray_builder_append(builder, key, value)) {
+            res = SKIPARRAY_LOAD_ERROR_MEMORY;
+        }
+        if (res != SKIPARRAY_LOAD_OK) {
+            /* not owned by the builder yet */
+            if (config->free != NULL) {
+                config->free(key, value, config->udata);
+            }
+            return res;
+        }
+    }
+    return (pos == len ? SKIPARRAY_LOAD_OK : SKIPARRAY_LOAD_ERROR_FORMAT);
+}
+
+enum skiparray_load_res
+skiparray_load(const struct skiparray_config *config,
+    const struct skiparray_load_config *load_config,
+    struct skiparray **sa) {
+    if (config == NULL || load_config == NULL || sa == NULL
+        || load_config->read == NULL || load_config->decode_key == NULL) {
+        return SKIPARRAY_LOAD_ERROR_MISUSE;
+    }
+    skiparray_read_fun *read = load_config->read;
+    void *udata = load_config->udata;
+
+    uint8_t header[FORMAT_HEADER_SIZE];
+    if (!read(header, sizeof(header), udata)) {
+        return SKIPARRAY_LOAD_ERROR_READ;
+    }
+    if (0 != memcmp(header, FORMAT_MAGIC, FORMAT_MAGIC_SIZE)
+        || get_u16(&header[8]) != FORMAT_VERSION
+        || (get_u16(&header[10]) & ~FORMAT_FLAG_MASK) != 0) {
+        return SKIPARRAY_LOAD_ERROR_FORMAT;
+    }
+    const uint16_t flags = get_u16(&header[10]);
+    const bool checksum = flags & FORMAT_FLAG_CHECKSUM;
+    if (checksum && get_u32(&header[28]) != skiparray_crc32(0, header, 28)) {
+        return SKIPARRAY_LOAD_ERROR_CHECKSUM;
+    }
+    const uint64_t expected_pairs = get_u64(&header[16]);
+    const bool has_values = flags & FORMAT_FLAG_VALUES;
+    if (has_values && !config->ignore_values
+        && load_config->decode_value == NULL) {
+        return SKIPARRAY_LOAD_ERROR_MISUSE;
+    }
+
+    struct skiparray_builder *builder = NULL;
+    enum skiparray_builder_new_res bres = (load_config->balanced
+        ? skiparray_builder_new_balanced(config, true, &builder)
+        : skiparray_builder_new(config, true, &builder));
+    switch (bres) {
+    case SKIPARRAY_BUILDER_NEW_OK:
+        break;
+    case SKIPARRAY_BUILDER_NEW_ERROR_MEMORY:
+        return SKIPARRAY_LOAD_ERROR_MEMORY;
+    default:
+        return SKIPARRAY_LOAD_ERROR_MISUSE;
+    }
+
+    struct skiparray_buf b = {
+        .mem = builder->sa->mem,
+        .mem_udata = builder->sa->mem_udata,
+    };
+    enum skiparray_load_res res = SKIPARRAY_LOAD_OK;
+    uint64_t pairs = 0;
+
+    for (;;) {
+        if (!skiparray_buf_reserve(&b, FORMAT_BLOCK_HEADER_SIZE)) {
+            res = SKIPARRAY_LOAD_ERROR_MEMORY;
+            goto cleanup;
+        }
+        if (!read(b.bytes, FORMAT_BLOCK_HEADER_SIZE, udata)) {
+            res = SKIPARRAY_LOAD_ERROR_READ;
+            goto cleanup;
+        }
+        b.used = FORMAT_BLOCK_HEADER_SIZE;
+        const uint32_t count = get_u32(&b.bytes[0]);
+        const uint32_t len = get_u32(&b.bytes[4]);
+        if (count == 0 && len != 0) {
+            res = SKIPARRAY_LOAD_ERROR_FORMAT;
+            goto cleanup;
+        }
+
+        const size_t rest = (size_t)len + (checksum ? FORMAT_CRC_SIZE : 0);
+        if (!skiparray_buf_reserve(&b, rest)) {
+            res = SKIPARRAY_LOAD_ERROR_MEMORY;
+            goto cleanup;
+        }
+        if (rest > 0 && !read(&b.bytes[b.used], rest, udata)) {
+            res = SKIPARRAY_LOAD_ERROR_READ;
+            goto cleanup;
+        }
+        if (checksum) {
+            const size_t end = FORMAT_BLOCK_HEADER_SIZE + len;
+            if (get_u32(&b.bytes[end]) != skiparray_crc32(0, b.bytes, end)) {
+                res = SKIPARRAY_LOAD_ERROR_CHECKSUM;
+                goto cleanup;
+            }
+        }
+        if (count == 0) { break; } /* end block */
+
+        res = skiparray_load_pairs(builder, config, load_config,
+            has_values, &b.bytes[FORMAT_BLOCK_HEADER_SIZE], len, count);
+        if (res != SKIPARRAY_LOAD_OK) { goto cleanup; }
+        pairs += count;
+    }
+
+    if (pairs != expected_pairs) {
+        res = SKIPARRAY_LOAD_ERROR_FORMAT;
+        goto cleanup;
+    }
+
+    skiparray_buf_free(&b);
+    skiparray_builder_finish(&builder, sa);
+    return SKIPARRAY_LOAD_OK;
+
+cleanup:
+    skiparray_buf_free(&b);
+    skiparray_builder_free(builder);
+    return res;
+}
+
+/* CRC-32 with the reflected polynomial 0xEDB88320, a nibble at a
+ * time, to avoid needing a large table or initialization. */
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t
+skiparray_crc32(uint32_t crc, const uint8_t *buf, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0f];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0f];
+    }
+    return ~crc;
+}
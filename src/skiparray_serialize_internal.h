@@ -0,0 +1,125 @@
+#ifndef SKIPARRAY_SERIALIZE_INTERNAL_H
+#define SKIPARRAY_SERIALIZE_INTERNAL_H
+
+#include "skiparray_internal_types.h"
+
+/* Dump format, version 1:
+ *
+ * Header (HEADER_SIZE bytes):
+ *     0  magic, "SKIPARAY"
+ *     8  u16 version
+ *    10  u16 flags (FORMAT_FLAG_*)
+ *    12  u16 node_size of the dumped skiparray (informational)
+ *    14  u16 reserved, 0
+ *    16  u64 pair count
+ *    24  u32 reserved, 0
+ *    28  u32 CRC-32 of bytes 0-27, or 0 without FORMAT_FLAG_CHECKSUM
+ *
+ * Then a block per node (BLOCK_HEADER_SIZE bytes, then the payload):
+ *     0  u32 pair count, > 0
+ *     4  u32 payload length
+ *     8  payload: per pair, u32 key length, key bytes, and with
+ *        FORMAT_FLAG_VALUES, u32 value length, value bytes
+ *     -  u32 CRC-32 of the block header and payload, with
+ *        FORMAT_FLAG_CHECKSUM
+ *
+ * and finally an end block, with a pair count and length of 0 (and
+ * its CRC-32, with FORMAT_FLAG_CHECKSUM). */
+
+#define FORMAT_MAGIC "SKIPARAY"
+#define FORMAT_MAGIC_SIZE 8
+#define FORMAT_VERSION 1
+#define FORMAT_HEADER_SIZE 32
+#define FORMAT_BLOCK_HEADER_SIZE 8
+#define FORMAT_CRC_SIZE 4
+
+#define FORMAT_FLAG_VALUES 0x01
+#define FORMAT_FLAG_CHECKSUM 0x02
+#define FORMAT_FLAG_MASK (FORMAT_FLAG_VALUES | FORMAT_FLAG_CHECKSUM)
+
+static inline void
+put_u16(uint8_t *buf, uint16_t x) {
+    buf[0] = (uint8_t)x;
+    buf[1] = (uint8_t)(x >> 8);
+}
+
+static inline void
+put_u32(uint8_t *buf, uint32_t x) {
+    for (size_t i = 0; i < 4; i++) { buf[i] = (uint8_t)(x >> (8*i)); }
+}
+
+static inline void
+put_u64(uint8_t *buf, uint64_t x) {
+    for (size_t i = 0; i < 8; i++) { buf[i] = (uint8_t)(x >> (8*i)); }
+}
+
+static inline uint16_t
+get_u16(const uint8_t *buf) {
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static inline uint32_t
+get_u32(const uint8_t *buf) {
+    uint32_t res = 0;
+    for (size_t i = 0; i < 4; i++) { res |= (uint32_t)buf[i] << (8*i); }
+    return res;
+}
+
+static inline uint64_t
+get_u64(const uint8_t *buf) {
+    uint64_t res = 0;
+    for (size_t i = 0; i < 8; i++) { res |= (uint64_t)buf[i] << (8*i); }
+    return res;
+}
+
+/* Growable byte buffer, allocated with a skiparray's memory callback. */
+struct skiparray_buf {
+    skiparray_memory_fun *mem;
+    void *mem_udata;
+    uint8_t *bytes;
+    size_t size;
+    size_t used;
+};
+
+/* Make room for EXTRA more bytes. Returns false on allocation failure. */
+bool
+skiparray_buf_reserve(struct skiparray_buf *b, size_t extra);
+
+void
+skiparray_buf_free(struct skiparray_buf *b);
+
+/* Append X's encoding (without a length prefix), and set *LEN to its
+ * length, which must fit in a u32. */
+enum skiparray_dump_res
+skiparray_buf_append_encoded(struct skiparray_buf *b,
+    skiparray_encode_fun *encode, const void *x, void *udata,
+    size_t *len);
+
+/* Append X's encoding, prefixed with its length as a u32. */
+enum skiparray_dump_res
+skiparray_buf_append_item(struct skiparray_buf *b,
+    skiparray_encode_fun *encode, const void *x, void *udata);
+
+/* Decode a block's COUNT pairs from its LEN-byte PAYLOAD (laid out as
+ * in a dump's blocks) and append them to BUILDER. */
+enum skiparray_load_res
+skiparray_load_pairs(struct skiparray_builder *builder,
+    const struct skiparray_config *config,
+    const struct skiparray_load_config *load_config, bool has_values,
+    const uint8_t *payload, size_t len, uint32_t count);
+
+/* In paged mode, read N back in (paging others out first) before
+ * encoding its pairs. Returns false if its page can't be read. */
+static inline bool
+dump_page_in(const struct skiparray *sa, struct node *n) {
+    if (n->page == NULL) { return true; }
+    skiparray_pager_trim(sa->pager, n);
+    return skiparray_pager_page_in(sa->pager, n, false);
+}
+
+/* Update a CRC-32 (IEEE 802.3, as used by zlib) with LEN bytes.
+ * Start with a CRC of 0. */
+uint32_t
+skiparray_crc32(uint32_t crc, const uint8_t *buf, size_t len);
+
+#endif
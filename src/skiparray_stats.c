@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "skiparray_internal_types.h"
+
+void
+skiparray_stats(const struct skiparray *sa, struct skiparray_stats *stats) {
+    assert(sa != NULL);
+    assert(stats != NULL);
+    memset(stats, 0x00, sizeof(*stats));
+    stats->height = sa->height;
+
+    /* The path to node N passes the nodes on each level L since the
+     * last node on level L + 1 before N (or since the start), so keep
+     * count of those as the nodes go by. */
+    size_t since[SKIPARRAY_MAX_MAX_LEVEL] = { 0 };
+    size_t hops[SKIPARRAY_MAX_MAX_LEVEL] = { 0 };
+
+    const size_t ptr_size = sizeof(void *);
+    for (const struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        stats->nodes++;
+        stats->pairs += n->count;
+
+        size_t bucket = (size_t)n->count * SKIPARRAY_STATS_FILL_BUCKETS
+            / n->limit;
+        if (bucket >= SKIPARRAY_STATS_FILL_BUCKETS) {
+            bucket = SKIPARRAY_STATS_FILL_BUCKETS - 1;
+        }
+        stats->fill[bucket]++;
+        stats->heights[n->height - 1]++;
+
+        for (uint8_t level = 0; level < sa->height; level++) {
+            hops[level] += since[level];
+            if (level + 1 < n->height) {
+                since[level] = 0;
+            } else if (level + 1 == n->height) {
+                since[level]++;
+            }
+        }
+
+        if (n->rollups != NULL) {
+            stats->header_bytes += (n->height - 1) * sizeof(uint64_t);
+        }
+        if (sa->pool != NULL) {
+            stats->header_bytes += sa->pool->header_size;
+            stats->key_bytes += sa->node_size * ptr_size;
+            if (sa->use_values) {
+                stats->value_bytes += sa->node_size * ptr_size;
+            }
+            continue;
+        }
+        stats->header_bytes += sizeof(struct node) + n->height * ptr_size;
+        if (n->keys != NULL) {  /* not paged out */
+            stats->key_bytes += n->capacity * ptr_size;
+            if (n->values != NULL) {
+                stats->value_bytes += n->capacity * ptr_size;
+            }
+        }
+    }
+
+    size_t on_level = 0;
+    for (int level = sa->max_level - 1; level >= 0; level--) {
+        on_level += stats->heights[level];
+        stats->level_nodes[level] = on_level;
+    }
+    if (stats->nodes > 0) {
+        for (uint8_t level = 0; level < sa->height; level++) {
+            stats->avg_hops[level] = (double)hops[level] / stats->nodes;
+        }
+    }
+}
+
+bool
+skiparray_counters(const struct skiparray *sa,
+    struct skiparray_counters *counters) {
+    assert(sa != NULL);
+    assert(counters != NULL);
+#ifdef SKIPARRAY_COUNTERS
+    memcpy(counters, &sa->counters, sizeof(*counters));
+    return true;
+#else
+    (void)sa;
+    memset(counters, 0x00, sizeof(*counters));
+    return false;
+#endif
+}
+
+void
+skiparray_counters_reset(struct skiparray *sa) {
+    assert(sa != NULL);
+#ifdef SKIPARRAY_COUNTERS
+    memset(&sa->counters, 0x00, sizeof(sa->counters));
+#else
+    (void)sa;
+#endif
+}
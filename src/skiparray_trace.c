@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "skiparray_internal_types.h"
+
+#ifdef SKIPARRAY_TRACE
+
+#include <time.h>
+
+#ifdef SKIPARRAY_TRACE_USDT
+#include <sys/sdt.h>
+#endif
+
+uint64_t
+skiparray_trace_now(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) { return 0; }
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void
+skiparray_trace_event(const struct skiparray *sa,
+    enum skiparray_trace_event_type type, uint64_t start_ns,
+    uint16_t count, uint16_t other, uint8_t height) {
+    const uint64_t now = skiparray_trace_now();
+    const struct skiparray_trace_event event = {
+        .type = type,
+        .start_ns = (start_ns == 0 ? now : start_ns),
+        .end_ns = now,
+        .count = count,
+        .other = other,
+        .height = height,
+    };
+
+#ifdef SKIPARRAY_TRACE_USDT
+    /* Probe names must be literal, so there's one site per event. */
+    const uint64_t ns = event.end_ns - event.start_ns;
+    switch (type) {
+    case SKIPARRAY_TRACE_SPLIT:
+        DTRACE_PROBE5(skiparray, split, sa, ns, count, other, height);
+        break;
+    case SKIPARRAY_TRACE_MERGE:
+        DTRACE_PROBE4(skiparray, merge, sa, ns, count, other);
+        break;
+    case SKIPARRAY_TRACE_SHIFT:
+        DTRACE_PROBE4(skiparray, shift, sa, ns, count, other);
+        break;
+    case SKIPARRAY_TRACE_UNLINK:
+        DTRACE_PROBE3(skiparray, unlink, sa, ns, height);
+        break;
+    case SKIPARRAY_TRACE_HEIGHT:
+        DTRACE_PROBE3(skiparray, height, sa, other, height);
+        break;
+    case SKIPARRAY_TRACE_LOCK:
+        DTRACE_PROBE1(skiparray, lock, sa);
+        break;
+    case SKIPARRAY_TRACE_UNLOCK:
+        DTRACE_PROBE1(skiparray, unlock, sa);
+        break;
+    }
+#endif
+
+    if (sa->trace != NULL) { sa->trace(&event, sa->udata); }
+}
+
+#else
+
+/* ISO C doesn't allow an empty translation unit. */
+typedef int skiparray_trace_disabled;
+
+#endif
@@ -0,0 +1,588 @@
+/*
+ * Copyright (c) 2019 Scott Vokes <vokes.s@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "skiparray_serialize_internal.h"
+
+/* Log format: a sequence of frames, each holding a group of records.
+ *
+ * Frame header (WAL_FRAME_HEADER_SIZE bytes):
+ *     0  magic, "SAWL"
+ *     4  u32 record count, > 0
+ *     8  u32 payload length
+ *    12  u32 CRC-32 of bytes 0-11 and the payload
+ *
+ * Payload, per record:
+ *     0  u8 op (WAL_OP_*)
+ *     1  u32 key length, key bytes
+ *     -  for WAL_OP_SET, u32 value length, value bytes
+ *
+ * (little-endian, as in the dump format). Frames are written with a
+ * single write call, so a crash leaves at most the last one cut
+ * short, which fails its length or CRC check when replayed. */
+
+#define WAL_FRAME_MAGIC "SAWL"
+#define WAL_FRAME_MAGIC_SIZE 4
+#define WAL_FRAME_HEADER_SIZE 16
+
+#define WAL_OP_SET 'S'          /* key and value */
+#define WAL_OP_SET_KEY 'K'      /* key only, without values */
+#define WAL_OP_FORGET 'F'       /* key only */
+
+/* Largest group_bytes, so a frame's payload always fits in a u32. */
+#define WAL_MAX_GROUP_BYTES ((size_t)1 << 30)
+
+/* How many records skiparray_replay sorts and applies at once. */
+#define REPLAY_BATCH_RECORDS ((size_t)1 << 18)
+
+/* Batches are only sorted once the skiparray has at least this many
+ * pairs. Below that, it's likely to stay in cache, so searching it is
+ * cheaper than sorting. */
+#define REPLAY_SORT_MIN_PAIRS ((size_t)1 << 17)
+
+/* Merge a sorted batch into a rebuilt skiparray, rather than applying
+ * each change, once it has at least 1/REPLAY_REBUILD_RATIO as many
+ * changes as the skiparray has pairs. */
+#define REPLAY_REBUILD_RATIO 16
+
+struct skiparray_wal {
+    struct skiparray_wal_config config;
+    struct skiparray *sa;       /* skiparray being logged, if any */
+    bool use_values;
+    bool needs_sync;            /* written, but the last sync failed */
+    /* The pending frame, with room for its header at the start once
+     * any records are added. */
+    struct skiparray_buf buf;
+    struct skiparray_wal_stats stats;
+};
+
+/* The buffer outlives any one skiparray, since pending records can
+ * still be flushed after it's freed, so it always uses malloc. */
+static void *
+wal_memory_fun(void *p, size_t nsize, void *udata) {
+    (void)udata;
+    if (p != NULL) {
+        free(p);
+        return NULL;
+    }
+    return malloc(nsize);
+}
+
+enum skiparray_wal_new_res
+skiparray_wal_new(const struct skiparray_wal_config *config,
+    struct skiparray_wal **wal) {
+    if (config == NULL || wal == NULL) {
+        return SKIPARRAY_WAL_NEW_ERROR_NULL;
+    }
+    if (config->write == NULL || config->encode_key == NULL
+        || (config->sync == NULL
+            && config->sync_policy != SKIPARRAY_WAL_SYNC_NONE)
+        || config->sync_policy > SKIPARRAY_WAL_SYNC_EVERY
+        || config->group_bytes > WAL_MAX_GROUP_BYTES) {
+        return SKIPARRAY_WAL_NEW_ERROR_CONFIG;
+    }
+
+    struct skiparray_wal *res = malloc(sizeof(*res));
+    if (res == NULL) { return SKIPARRAY_WAL_NEW_ERROR_MEMORY; }
+    memset(res, 0x00, sizeof(*res));
+    res->config = *config;
+    if (res->config.group_bytes == 0) {
+        res->config.group_bytes = SKIPARRAY_WAL_DEF_GROUP_BYTES;
+    }
+    res->buf.mem = wal_memory_fun;
+    *wal = res;
+    return SKIPARRAY_WAL_NEW_OK;
+}
+
+void
+skiparray_wal_free(struct skiparray_wal *wal) {
+    if (wal == NULL) { return; }
+    assert(wal->sa == NULL);
+    skiparray_buf_free(&wal->buf);
+    free(wal);
+}
+
+void
+skiparray_wal_stats(const struct skiparray_wal *wal,
+    struct skiparray_wal_stats *stats) {
+    assert(wal != NULL);
+    assert(stats != NULL);
+    memcpy(stats, &wal->stats, sizeof(*stats));
+}
+
+bool
+skiparray_wal_attach(struct skiparray_wal *wal, struct skiparray *sa) {
+    if (wal->sa != NULL) { return false; }
+    if (sa->use_values && wal->config.encode_value == NULL) {
+        return false;
+    }
+    wal->sa = sa;
+    wal->use_values = sa->use_values;
+    return true;
+}
+
+void
+skiparray_wal_detach(struct skiparray_wal *wal) {
+    wal->sa = NULL;
+}
+
+static bool
+sync_log(struct skiparray_wal *wal) {
+    if (wal->config.sync_policy == SKIPARRAY_WAL_SYNC_NONE) { return true; }
+    if (!wal->config.sync(wal->config.log_udata)) {
+        wal->stats.sync_errors++;
+        wal->needs_sync = true;
+        return false;
+    }
+    wal->stats.syncs++;
+    wal->needs_sync = false;
+    return true;
+}
+
+/* Write the pending frame, if any. */
+static bool
+write_frame(struct skiparray_wal *wal) {
+    struct skiparray_buf *b = &wal->buf;
+    if (b->used == 0) { return true; }
+    assert(wal->stats.pending > 0);
+
+    const size_t payload = b->used - WAL_FRAME_HEADER_SIZE;
+    memcpy(b->bytes, WAL_FRAME_MAGIC, WAL_FRAME_MAGIC_SIZE);
+    put_u32(&b->bytes[4], (uint32_t)wal->stats.pending);
+    put_u32(&b->bytes[8], (uint32_t)payload);
+    uint32_t crc = skiparray_crc32(0, b->bytes, 12);
+    crc = skiparray_crc32(crc, &b->bytes[WAL_FRAME_HEADER_SIZE], payload);
+    put_u32(&b->bytes[12], crc);
+
+    if (!wal->config.write(b->bytes, b->used, wal->config.log_udata)) {
+        wal->stats.write_errors++;
+        return false;
+    }
+    wal->stats.frames++;
+    wal->stats.bytes += b->used;
+    wal->stats.pending = 0;
+    b->used = 0;
+    return true;
+}
+
+enum skiparray_wal_flush_res
+skiparray_wal_flush(struct skiparray_wal *wal) {
+    assert(wal != NULL);
+    const bool written = wal->buf.used > 0;
+    if (!write_frame(wal)) { return SKIPARRAY_WAL_FLUSH_ERROR_WRITE; }
+    if ((written || wal->needs_sync) && !sync_log(wal)) {
+        return SKIPARRAY_WAL_FLUSH_ERROR_SYNC;
+    }
+    return SKIPARRAY_WAL_FLUSH_OK;
+}
+
+/* Append X's length-prefixed encoding. */
+static bool
+append_item(struct skiparray_buf *b, skiparray_encode_fun *encode,
+    const void *x, void *udata) {
+    if (!skiparray_buf_reserve(b, sizeof(uint32_t))) { return false; }
+    const size_t len_pos = b->used;
+    b->used += sizeof(uint32_t);
+
+    size_t len = 0;
+    if (skiparray_buf_append_encoded(b, encode, x, udata, &len)
+        != SKIPARRAY_DUMP_OK) {
+        return false;
+    }
+    put_u32(&b->bytes[len_pos], (uint32_t)len);
+    return true;
+}
+
+bool
+skiparray_wal_log(struct skiparray_wal *wal, bool forget,
+    const void *key, const void *value) {
+    struct skiparray_buf *b = &wal->buf;
+    const size_t mark = b->used;
+    const struct skiparray_wal_config *cfg = &wal->config;
+
+    const size_t header = (mark == 0 ? WAL_FRAME_HEADER_SIZE : 0);
+    if (!skiparray_buf_reserve(b, header + 1)) { return false; }
+    b->used += header;
+    b->bytes[b->used++] = (forget ? WAL_OP_FORGET
+        : wal->use_values ? WAL_OP_SET : WAL_OP_SET_KEY);
+
+    if (!append_item(b, cfg->encode_key, key, cfg->udata)
+        || (!forget && wal->use_values
+            && !append_item(b, cfg->encode_value, value, cfg->udata))
+        || b->used - WAL_FRAME_HEADER_SIZE > UINT32_MAX) {
+        b->used = mark;
+        return false;
+    }
+    wal->stats.pending++;
+
+    if (cfg->sync_policy == SKIPARRAY_WAL_SYNC_EVERY
+        || b->used >= cfg->group_bytes) {
+        if (!write_frame(wal)) {
+            /* Keep the earlier records for the next attempt, but drop
+             * this one, since its change won't be applied. */
+            b->used = mark;
+            wal->stats.pending--;
+            return false;
+        }
+        /* Once written, the record stands even if the sync fails, and
+         * the sync is retried by the next flush. With SYNC_EVERY the
+         * change must not go ahead until it's durable, though. */
+        if (!sync_log(wal)
+            && cfg->sync_policy == SKIPARRAY_WAL_SYNC_EVERY) {
+            wal->stats.records++;
+            return false;
+        }
+    }
+    wal->stats.records++;
+    return true;
+}
+
+struct replay_env {
+    struct skiparray *sa;
+    const struct skiparray_replay_config *config;
+    struct skiparray_buf buf;   /* frame being read */
+    struct skiparray_change *recs;
+    struct skiparray_change *tmp;     /* scratch space for sorting */
+    size_t count;
+};
+
+static void
+free_rec(const struct skiparray *sa, const struct skiparray_change *r) {
+    if (sa->free != NULL) { sa->free(r->key, r->value, sa->udata); }
+}
+
+static void
+free_recs(struct replay_env *env) {
+    for (size_t i = 0; i < env->count; i++) {
+        free_rec(env->sa, &env->recs[i]);
+    }
+    env->count = 0;
+}
+
+static bool
+decode_item(const struct replay_env *env, skiparray_decode_fun *decode,
+    const uint8_t *payload, size_t len, size_t *pos,
+    void **x, enum skiparray_replay_res *res) {
+    if (len - *pos < sizeof(uint32_t)) {
+        *res = SKIPARRAY_REPLAY_ERROR_FORMAT;
+        return false;
+    }
+    const size_t item_len = get_u32(&payload[*pos]);
+    *pos += sizeof(uint32_t);
+    if (len - *pos < item_len) {
+        *res = SKIPARRAY_REPLAY_ERROR_FORMAT;
+        return false;
+    }
+    if (decode != NULL
+        && !decode(&payload[*pos], item_len, x, env->config->udata)) {
+        *res = SKIPARRAY_REPLAY_ERROR_DECODE;
+        return false;
+    }
+    *pos += item_len;
+    return true;
+}
+
+/* Decode a frame's records onto the end of the batch. */
+static enum skiparray_replay_res
+decode_frame(struct replay_env *env, size_t count,
+    const uint8_t *payload, size_t len) {
+    const struct skiparray *sa = env->sa;
+    const struct skiparray_replay_config *cfg = env->config;
+    enum skiparray_replay_res res = SKIPARRAY_REPLAY_OK;
+    size_t pos = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (pos == len) { return SKIPARRAY_REPLAY_ERROR_FORMAT; }
+        const uint8_t op = payload[pos++];
+        if (op != WAL_OP_SET && op != WAL_OP_SET_KEY && op != WAL_OP_FORGET) {
+            return SKIPARRAY_REPLAY_ERROR_FORMAT;
+        }
+
+        struct skiparray_change *r = &env->recs[env->count];
+        *r = (struct skiparray_change) { .forget = op == WAL_OP_FORGET };
+        if (!decode_item(env, cfg->decode_key, payload, len, &pos,
+                &r->key, &res)) {
+            return res;
+        }
+        if (op == WAL_OP_SET) {
+            /* If ignoring values, skip them without decoding. */
+            if (!decode_item(env, sa->use_values ? cfg->decode_value : NULL,
+                    payload, len, &pos, &r->value, &res)) {
+                if (sa->free != NULL) { sa->free(r->key, NULL, sa->udata); }
+                return res;
+            }
+        }
+        env->count++;
+    }
+    return (pos == len ? SKIPARRAY_REPLAY_OK : SKIPARRAY_REPLAY_ERROR_FORMAT);
+}
+
+/* Stable merge sort of the batch by key, bottom-up. Runs that are
+ * already in order (as with sequential keys) aren't merged. */
+static void
+sort_recs(struct replay_env *env) {
+    const struct skiparray *sa = env->sa;
+    struct skiparray_change *src = env->recs;
+    struct skiparray_change *dst = env->tmp;
+    const size_t count = env->count;
+
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2*width) {
+            const size_t mid = (lo + width < count ? lo + width : count);
+            const size_t hi = (lo + 2*width < count ? lo + 2*width : count);
+            if (mid == hi
+                || sa->cmp(src[mid - 1].key, src[mid].key, sa->udata) <= 0) {
+                memcpy(&dst[lo], &src[lo], (hi - lo) * sizeof(src[0]));
+                continue;
+            }
+            size_t a = lo;
+            size_t b = mid;
+            for (size_t i = lo; i < hi; i++) {
+                if (a < mid && (b == hi
+                        || sa->cmp(src[a].key, src[b].key, sa->udata) <= 0)) {
+                    dst[i] = src[a++];
+                } else {
+                    dst[i] = src[b++];
+                }
+            }
+        }
+        struct skiparray_change *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != env->recs) {
+        memcpy(env->recs, src, count * sizeof(src[0]));
+    }
+}
+
+static enum skiparray_replay_res
+apply_changes(struct replay_env *env);
+
+/* Apply the batch. For a large skiparray, sort the batch and apply
+ * only the last record for each key, merging it with the existing
+ * pairs in one pass if it's big enough; otherwise, sorting at least
+ * makes the searches touch nodes in order. */
+static enum skiparray_replay_res
+apply_batch(struct replay_env *env) {
+    struct skiparray *sa = env->sa;
+    const size_t pairs = skiparray_count(sa);
+    if (pairs < REPLAY_SORT_MIN_PAIRS) { return apply_changes(env); }
+    sort_recs(env);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < env->count; i++) {
+        const struct skiparray_change *r = &env->recs[i];
+        if (i + 1 < env->count
+            && sa->cmp(r->key, env->recs[i + 1].key, sa->udata) == 0) {
+            free_rec(sa, r);    /* superseded */
+        } else {
+            env->recs[kept++] = *r;
+        }
+    }
+    env->count = kept;
+
+    if (sa->pager == NULL
+        && kept * REPLAY_REBUILD_RATIO >= pairs
+        && skiparray_merge_changes(sa, env->recs, kept)) {
+        env->count = 0;
+        return SKIPARRAY_REPLAY_OK;
+    }
+    return apply_changes(env);
+}
+
+/* Free the batch's records from FROM on, after an error. */
+static enum skiparray_replay_res
+drop_changes(struct replay_env *env, size_t from,
+    enum skiparray_replay_res res) {
+    for (size_t j = from; j < env->count; j++) {
+        free_rec(env->sa, &env->recs[j]);
+    }
+    env->count = 0;
+    return res;
+}
+
+/* Apply the batch's records one by one, in order. */
+static enum skiparray_replay_res
+apply_changes(struct replay_env *env) {
+    struct skiparray *sa = env->sa;
+    for (size_t i = 0; i < env->count; i++) {
+        const struct skiparray_change *r = &env->recs[i];
+
+        if (r->forget) {
+            struct skiparray_pair forgotten;
+            switch (skiparray_forget(sa, r->key, &forgotten)) {
+            case SKIPARRAY_FORGET_OK:
+                if (sa->free != NULL) {
+                    sa->free(forgotten.key, forgotten.value, sa->udata);
+                }
+                break;
+            case SKIPARRAY_FORGET_ERROR_PAGE:
+                return drop_changes(env, i, SKIPARRAY_REPLAY_ERROR_PAGE);
+            default:
+                break;
+            }
+            free_rec(sa, r);
+        } else {
+            struct skiparray_pair previous;
+            switch (skiparray_set_with_pair(sa, r->key, r->value,
+                    true, &previous)) {
+            case SKIPARRAY_SET_BOUND:
+                break;
+            case SKIPARRAY_SET_REPLACED:
+                if (sa->free != NULL) {
+                    sa->free(previous.key, previous.value, sa->udata);
+                }
+                break;
+            case SKIPARRAY_SET_ERROR_PAGE:
+                return drop_changes(env, i, SKIPARRAY_REPLAY_ERROR_PAGE);
+            default:
+                return drop_changes(env, i, SKIPARRAY_REPLAY_ERROR_MEMORY);
+            }
+        }
+    }
+    env->count = 0;
+    return SKIPARRAY_REPLAY_OK;
+}
+
+/* Read the next frame into env->buf, and set *COUNT to its record
+ * count. Returns OK and a count of 0 at the end of the log. */
+static enum skiparray_replay_res
+read_frame(struct replay_env *env, bool first, size_t *count) {
+    const struct skiparray_replay_config *cfg = env->config;
+    struct skiparray_buf *b = &env->buf;
+    b->used = 0;
+    *count = 0;
+    if (!skiparray_buf_reserve(b, WAL_FRAME_HEADER_SIZE)) {
+        return SKIPARRAY_REPLAY_ERROR_MEMORY;
+    }
+
+    /* The read callback can't tell a clean end from a cut-short
+     * header, so both end the log. */
+    if (!cfg->read(b->bytes, WAL_FRAME_HEADER_SIZE, cfg->udata)) {
+        return SKIPARRAY_REPLAY_OK;
+    }
+    if (0 != memcmp(b->bytes, WAL_FRAME_MAGIC, WAL_FRAME_MAGIC_SIZE)) {
+        return (first ? SKIPARRAY_REPLAY_ERROR_FORMAT
+            : SKIPARRAY_REPLAY_TRUNCATED);
+    }
+    const size_t frame_count = get_u32(&b->bytes[4]);
+    const size_t payload = get_u32(&b->bytes[8]);
+    const uint32_t crc = get_u32(&b->bytes[12]);
+    /* Every record takes at least 5 bytes. */
+    if (frame_count == 0 || payload / 5 < frame_count) {
+        return SKIPARRAY_REPLAY_TRUNCATED;
+    }
+
+    b->used = WAL_FRAME_HEADER_SIZE;
+    if (!skiparray_buf_reserve(b, payload)) {
+        return SKIPARRAY_REPLAY_ERROR_MEMORY;
+    }
+    uint8_t *p = &b->bytes[WAL_FRAME_HEADER_SIZE];
+    if (!cfg->read(p, payload, cfg->udata)) {
+        return SKIPARRAY_REPLAY_TRUNCATED;
+    }
+    if (crc != skiparray_crc32(skiparray_crc32(0, b->bytes, 12),
+            p, payload)) {
+        return SKIPARRAY_REPLAY_TRUNCATED;
+    }
+    b->used += payload;
+    *count = frame_count;
+    return SKIPARRAY_REPLAY_OK;
+}
+
+static enum skiparray_replay_res
+replay(struct replay_env *env) {
+    struct skiparray *sa = env->sa;
+    size_t ceil = 0;
+    enum skiparray_replay_res res = SKIPARRAY_REPLAY_OK;
+
+    for (bool first = true; ; first = false) {
+        size_t count = 0;
+        res = read_frame(env, first, &count);
+        if (res != SKIPARRAY_REPLAY_OK || count == 0) { break; }
+
+        /* Apply the batch before it would overflow (or grow it to
+         * fit an oversized frame). */
+        if (env->count > 0 && env->count + count > REPLAY_BATCH_RECORDS) {
+            res = apply_batch(env);
+            if (res != SKIPARRAY_REPLAY_OK) { return res; }
+        }
+        if (env->count + count > ceil) {
+            size_t nceil = (ceil == 0 ? 64 : ceil);
+            while (nceil < env->count + count) { nceil *= 2; }
+            const size_t nsize = nceil * sizeof(env->recs[0]);
+            struct skiparray_change *nrecs = sa->mem(NULL, nsize, sa->mem_udata);
+            struct skiparray_change *ntmp = sa->mem(NULL, nsize, sa->mem_udata);
+            if (nrecs == NULL || ntmp == NULL) {
+                if (nrecs != NULL) { sa->mem(nrecs, 0, sa->mem_udata); }
+                if (ntmp != NULL) { sa->mem(ntmp, 0, sa->mem_udata); }
+                return SKIPARRAY_REPLAY_ERROR_MEMORY;
+            }
+            if (env->recs != NULL) {
+                memcpy(nrecs, env->recs, env->count * sizeof(env->recs[0]));
+                sa->mem(env->recs, 0, sa->mem_udata);
+                sa->mem(env->tmp, 0, sa->mem_udata);
+            }
+            env->recs = nrecs;
+            env->tmp = ntmp;
+            ceil = nceil;
+        }
+
+        res = decode_frame(env, count,
+            &env->buf.bytes[WAL_FRAME_HEADER_SIZE],
+            env->buf.used - WAL_FRAME_HEADER_SIZE);
+        if (res != SKIPARRAY_REPLAY_OK) { return res; }
+    }
+    if (res < 0) { return res; }
+
+    /* Apply the rest, keeping TRUNCATED if that's how it ended. */
+    const enum skiparray_replay_res ares = apply_batch(env);
+    return (ares != SKIPARRAY_REPLAY_OK ? ares : res);
+}
+
+enum skiparray_replay_res
+skiparray_replay(struct skiparray *sa,
+    const struct skiparray_replay_config *config) {
+    if (sa == NULL || config == NULL || config->read == NULL
+        || config->decode_key == NULL
+        || (sa->use_values && config->decode_value == NULL)) {
+        return SKIPARRAY_REPLAY_ERROR_MISUSE;
+    }
+    if (sa->iter != NULL) { return SKIPARRAY_REPLAY_ERROR_LOCKED; }
+
+    struct replay_env env = {
+        .sa = sa,
+        .config = config,
+        .buf = {
+            .mem = sa->mem,
+            .mem_udata = sa->mem_udata,
+        },
+    };
+
+    /* Replayed changes are already in the log. */
+    struct skiparray_wal *wal = sa->wal;
+    sa->wal = NULL;
+    const enum skiparray_replay_res res = replay(&env);
+    sa->wal = wal;
+
+    free_recs(&env);
+    if (env.recs != NULL) {
+        sa->mem(env.recs, 0, sa->mem_udata);
+        sa->mem(env.tmp, 0, sa->mem_udata);
+    }
+    skiparray_buf_free(&env.buf);
+    return res;
+}
@@ -7,9 +7,20 @@ int main(int argc, char **argv) {
     GREATEST_MAIN_BEGIN();      /* command-line arguments, initialization. */
     RUN_SUITE(basic);
     RUN_SUITE(builder);
+    RUN_SUITE(compact);
+    RUN_SUITE(adaptive);
     RUN_SUITE(fold);
     RUN_SUITE(hof);
     RUN_SUITE(integration);
+    RUN_SUITE(pool);
+    RUN_SUITE(arena);
+    RUN_SUITE(serialize);
+    RUN_SUITE(mapped);
+    RUN_SUITE(pager);
+    RUN_SUITE(wal);
+    RUN_SUITE(checkpoint);
+    RUN_SUITE(diff);
+    RUN_SUITE(stats);
     RUN_SUITE(prop);
     GREATEST_MAIN_END();        /* display results */
 }
@@ -13,10 +13,21 @@ bool test_skiparray_invariants(struct skiparray *sa, int verbosity);
 
 SUITE_EXTERN(basic);
 SUITE_EXTERN(builder);
+SUITE_EXTERN(compact);
+SUITE_EXTERN(adaptive);
 SUITE_EXTERN(fold);
 SUITE_EXTERN(prop);
 SUITE_EXTERN(hof);
 SUITE_EXTERN(integration);
+SUITE_EXTERN(pool);
+SUITE_EXTERN(arena);
+SUITE_EXTERN(serialize);
+SUITE_EXTERN(mapped);
+SUITE_EXTERN(pager);
+SUITE_EXTERN(wal);
+SUITE_EXTERN(checkpoint);
+SUITE_EXTERN(diff);
+SUITE_EXTERN(stats);
 
 struct test_env {
     char tag;
@@ -92,4 +103,57 @@ int test_skiparray_cmp_intptr_t(const void *ka,
 struct skiparray *
 test_skiparray_sequential_build(size_t limit);
 
+/* In-memory byte stream, for the write and read callbacks of dumps,
+ * checkpoints, and logs. Reads stop at END; rewinding sets it to
+ * everything written. */
+struct test_skiparray_stream {
+    uint8_t *buf;
+    size_t size;
+    size_t used;
+    size_t pos;
+    size_t end;
+    bool fail_writes;
+};
+
+bool
+test_skiparray_stream_write(const uint8_t *buf, size_t len, void *udata);
+
+bool
+test_skiparray_stream_read(uint8_t *buf, size_t len, void *udata);
+
+void
+test_skiparray_stream_rewind(struct test_skiparray_stream *s);
+
+void
+test_skiparray_stream_free(struct test_skiparray_stream *s);
+
+/* Encode and decode uintptr_t keys and values as their bytes. */
+bool
+test_skiparray_encode_uintptr(const void *x, uint8_t *buf, size_t buf_size,
+    size_t *len, void *udata);
+
+bool
+test_skiparray_decode_uintptr(const uint8_t *buf, size_t len, void **x,
+    void *udata);
+
+/* Make a skiparray with CONFIG, binding keys 0, 3, ..., 3*(limit - 1)
+ * to 1, 2, ..., limit. */
+struct skiparray *
+test_skiparray_make_sa(const struct skiparray_config *config, size_t limit);
+
+/* xorshift64; STATE must be nonzero. */
+uint64_t
+test_skiparray_next_rand(uint64_t *state);
+
+/* Memory callback counting the bytes live (and their high-water mark)
+ * in a struct test_skiparray_memory, through a size header prepended
+ * to each allocation. */
+struct test_skiparray_memory {
+    size_t live;
+    size_t peak;
+};
+
+void *
+test_skiparray_counting_memory(void *p, size_t nsize, void *udata);
+
 #endif
@@ -0,0 +1,138 @@
+#include "test_skiparray.h"
+#include "skiparray_internal_types.h"
+
+TEST reject_bad_node_size_min(void) {
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 64,
+        .node_size_min = 1,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG, skiparray_new(&cfg, &sa), "%d");
+    cfg.node_size_min = 65;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG, skiparray_new(&cfg, &sa), "%d");
+    cfg.node_size_min = 64;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    skiparray_free(sa);
+    PASS();
+}
+
+struct limit_stats {
+    size_t nodes;
+    size_t limit_sum;
+};
+
+/* Collect node counts and limits for nodes entirely below SPLIT
+ * (hot) and entirely at or above it (cold). */
+static void
+collect(const struct skiparray *sa, uintptr_t split,
+    struct limit_stats *hot, struct limit_stats *cold) {
+    memset(hot, 0x00, sizeof(*hot));
+    memset(cold, 0x00, sizeof(*cold));
+    for (const struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        if (n->count == 0) { continue; }
+        const uintptr_t first = (uintptr_t)n->keys[n->offset];
+        const uintptr_t last = (uintptr_t)n->keys[n->offset + n->count - 1];
+        struct limit_stats *st = (last < split ? hot
+            : first >= split ? cold : NULL);
+        if (st == NULL) { continue; }
+        st->nodes++;
+        st->limit_sum += n->limit;
+    }
+}
+
+/* Write heavily to the bottom eighth of the key range and repeatedly
+ * scan the rest, with an occasional write there. Hot nodes should
+ * shrink toward node_size_min, and cold ones grow toward node_size. */
+TEST hot_writes_cold_scans(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 256,
+        .node_size_min = 16,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    /* Even keys are always present; odd keys in the hot range toggle. */
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)(2 * i), NULL), "%d");
+    }
+    const uintptr_t split = 2 * (limit / 8);
+    bool present[split];
+    memset(present, 0x00, sizeof(present));
+
+    uint64_t state = 1;
+    for (size_t round = 0; round < 200; round++) {
+        for (size_t w = 0; w < 50; w++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            const uintptr_t k = 2 * ((state >> 33) % (split / 2)) + 1;
+            if (present[k]) {
+                ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+                    skiparray_forget(sa, (void *)k, NULL), "%d");
+            } else {
+                ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+                    skiparray_set(sa, (void *)k, NULL), "%d");
+            }
+            present[k] = !present[k];
+        }
+
+        struct skiparray_iter *iter = NULL;
+        ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK,
+            skiparray_iter_new(sa, &iter), "%d");
+        ASSERT(skiparray_iter_seek(iter, (void *)split)
+            == SKIPARRAY_ITER_SEEK_FOUND);
+        size_t seen = 0;
+        do { seen++; } while (skiparray_iter_next(iter) == SKIPARRAY_ITER_STEP_OK);
+        skiparray_iter_free(iter);
+        ASSERT_EQ_FMT((size_t)(limit - split / 2), seen, "%zu");
+
+        /* touch a cold key so its node re-evaluates its limit */
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uintptr_t ck = split + 2 * ((state >> 33) % (limit - split / 2));
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)ck, NULL), "%d");
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)ck, NULL), "%d");
+
+        if (round % 20 == 0) {
+            ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+        }
+    }
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+
+    for (uintptr_t k = 0; k < 2 * limit; k++) {
+        const bool exp = (k % 2 == 0) || (k < split && present[k]);
+        ASSERT_EQ(exp, skiparray_member(sa, (void *)k));
+    }
+
+    struct limit_stats hot, cold;
+    collect(sa, split, &hot, &cold);
+    if (verbosity > 0) {
+        fprintf(GREATEST_STDOUT, "hot: %zu nodes, avg limit %zu; "
+            "cold: %zu nodes, avg limit %zu\n",
+            hot.nodes, hot.nodes ? hot.limit_sum / hot.nodes : 0,
+            cold.nodes, cold.nodes ? cold.limit_sum / cold.nodes : 0);
+    }
+    ASSERT(hot.nodes > 0);
+    ASSERT(cold.nodes > 0);
+    ASSERT(hot.limit_sum / hot.nodes < cold.limit_sum / cold.nodes);
+    ASSERT(hot.limit_sum / hot.nodes <= 2 * cfg.node_size_min);
+    ASSERT(cold.limit_sum / cold.nodes >= cfg.node_size / 2);
+
+    skiparray_free(sa);
+    PASS();
+}
+
+SUITE(adaptive) {
+    RUN_TEST(reject_bad_node_size_min);
+
+    for (size_t i = 1000; i <= 100000; i *= 10) {
+        char buf[8];
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) { assert(false); }
+
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(hot_writes_cold_scans, i);
+    }
+}
@@ -0,0 +1,195 @@
+#include "test_skiparray.h"
+
+static struct skiparray_arena *
+make_arena(size_t chunk_size) {
+    struct skiparray_arena_config acfg = {
+        .chunk_size = chunk_size,
+    };
+    struct skiparray_arena *arena = NULL;
+    if (SKIPARRAY_ARENA_NEW_OK != skiparray_arena_new(&acfg, &arena)) {
+        return NULL;
+    }
+    return arena;
+}
+
+static bool
+keep_even(const void *key, const void *value, void *udata) {
+    (void)value;
+    (void)udata;
+    return ((uintptr_t)key & 1) == 0;
+}
+
+TEST reject_pool_and_arena(void) {
+    struct skiparray_arena *arena = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ARENA_NEW_ERROR_NULL,
+        skiparray_arena_new(NULL, &arena), "%d");
+
+    arena = make_arena(0);
+    ASSERT(arena != NULL);
+
+    struct skiparray_pool_config pcfg = { .node_size = 0 };
+    struct skiparray_pool *pool = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_POOL_NEW_OK, skiparray_pool_new(&pcfg, &pool), "%d");
+
+    struct skiparray *sa = NULL;
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .pool = pool,
+        .arena = arena,
+    };
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG,
+        skiparray_new(&cfg, &sa), "%d");
+
+    skiparray_pool_free(pool);
+    skiparray_arena_free(arena);
+    PASS();
+}
+
+/* Fill, partially drain, iterate, and filter skiparrays in an arena,
+ * then drop everything with a reset rather than skiparray_free. */
+TEST churn_then_reset(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    struct skiparray_arena *arena = make_arena(4096);
+    ASSERT(arena != NULL);
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 8,
+        .arena = arena,
+    };
+
+    struct skiparray_arena_stats st;
+    size_t reserved_after_first_round = 0;
+
+    for (size_t round = 0; round < 3; round++) {
+        struct skiparray *sa = NULL;
+        ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+        for (uintptr_t i = 0; i < limit; i++) {
+            ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+                skiparray_set(sa, (void *)i, (void *)i), "%d");
+        }
+        for (uintptr_t i = 0; i < limit; i += 3) {
+            ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+                skiparray_forget(sa, (void *)i, NULL), "%d");
+        }
+        ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+
+        struct skiparray_iter *iter = NULL;
+        ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK,
+            skiparray_iter_new(sa, &iter), "%d");
+        size_t seen = 0;
+        do {
+            uintptr_t k = 0;
+            skiparray_iter_get(iter, (void **)&k, NULL);
+            ASSERT(k % 3 != 0);
+            seen++;
+        } while (skiparray_iter_next(iter) == SKIPARRAY_ITER_STEP_OK);
+        ASSERT_EQ_FMT(skiparray_count(sa), seen, "%zu");
+        skiparray_iter_free(iter);
+
+        struct skiparray *even = skiparray_filter(sa, keep_even, NULL);
+        ASSERT(even != NULL);
+        ASSERT(test_skiparray_invariants(even, verbosity - 1));
+        for (uintptr_t i = 0; i < limit; i++) {
+            const bool exp = (i % 3 != 0) && (i % 2 == 0);
+            ASSERT_EQ(exp, skiparray_member(even, (void *)i));
+        }
+
+        skiparray_arena_stats(arena, &st);
+        ASSERT(st.chunks > 0);
+        ASSERT(st.used <= st.reserved);
+        if (limit >= 100) {
+            /* Nodes freed by merges were reused. */
+            ASSERT(st.recycled > 0);
+        }
+
+        if (round == 0) {
+            reserved_after_first_round = st.reserved;
+        } else {
+            /* The same work fits in the chunks kept by the reset. */
+            ASSERT_EQ_FMT(reserved_after_first_round, st.reserved, "%zu");
+        }
+
+        skiparray_arena_reset(arena);
+        skiparray_arena_stats(arena, &st);
+        ASSERT_EQ_FMT((size_t)0, st.used, "%zu");
+    }
+
+    skiparray_arena_free(arena);
+    PASS();
+}
+
+static size_t free_calls;
+
+static void
+count_free(void *key, void *value, void *udata) {
+    (void)key;
+    (void)value;
+    (void)udata;
+    free_calls++;
+}
+
+TEST free_callback_still_called(void) {
+    struct skiparray_arena *arena = make_arena(0);
+    ASSERT(arena != NULL);
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .free = count_free,
+        .arena = arena,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    for (uintptr_t i = 0; i < 1000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+
+    free_calls = 0;
+    skiparray_free(sa);
+    ASSERT_EQ_FMT((size_t)1000, free_calls, "%zu");
+
+    skiparray_arena_free(arena);
+    PASS();
+}
+
+/* Allocations larger than a chunk get a dedicated chunk. */
+TEST oversized_allocation(void) {
+    struct skiparray_arena *arena = make_arena(256);
+    ASSERT(arena != NULL);
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 1024,
+        .arena = arena,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    for (uintptr_t i = 0; i < 5000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    ASSERT(test_skiparray_invariants(sa, greatest_get_verbosity() - 1));
+
+    struct skiparray_arena_stats st;
+    skiparray_arena_stats(arena, &st);
+    ASSERT(st.reserved >= 1024 * sizeof(void *));
+
+    skiparray_arena_free(arena);
+    PASS();
+}
+
+SUITE(arena) {
+    RUN_TEST(reject_pool_and_arena);
+    RUN_TEST(free_callback_still_called);
+    RUN_TEST(oversized_allocation);
+
+    for (size_t i = 10; i <= 10000; i *= 10) {
+        char buf[8];
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) { assert(false); }
+
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(churn_then_reset, i);
+    }
+}
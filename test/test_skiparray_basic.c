@@ -391,11 +391,72 @@ TEST iteration(void) {
     PASS();
 }
 
+TEST node_capacity_follows_count(bool use_builder) {
+    const int verbosity = greatest_get_verbosity();
+    struct test_skiparray_memory mem = { .live = 0 };
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 1024,
+        .memory = test_skiparray_counting_memory,
+        .udata = &mem,
+    };
+    const size_t full_node = 2 * cfg.node_size * sizeof(void *);
+
+    struct skiparray *sa = NULL;
+    if (use_builder) {
+        struct skiparray_builder *b = NULL;
+        ASSERT_EQ_FMT(SKIPARRAY_BUILDER_NEW_OK,
+            skiparray_builder_new(&cfg, false, &b), "%d");
+        for (uintptr_t i = 0; i < 10; i++) {
+            ASSERT_EQ_FMT(SKIPARRAY_BUILDER_APPEND_OK,
+                skiparray_builder_append(b, (void *)i, (void *)i), "%d");
+        }
+        skiparray_builder_finish(&b, &sa);
+    } else {
+        ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+        for (uintptr_t i = 0; i < 10; i++) {
+            ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+                skiparray_set(sa, (void *)i, (void *)i), "%d");
+        }
+    }
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    ASSERT(mem.live < full_node / 8);
+
+    /* Grow to several full nodes... */
+    for (uintptr_t i = 10; i < 5000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    ASSERT(mem.live > 4 * full_node);
+
+    /* ...then shrink back down. */
+    for (uintptr_t i = 3; i < 5000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)i, NULL), "%d");
+    }
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    ASSERT_EQ_FMT((size_t)3, skiparray_count(sa), "%zu");
+    ASSERT(mem.live < full_node / 8);
+
+    for (uintptr_t i = 0; i < 3; i++) {
+        uintptr_t v = 0;
+        ASSERT(skiparray_get(sa, (void *)i, (void **)&v));
+        ASSERT_EQ_FMT(i, v, "%"PRIuPTR);
+    }
+
+    skiparray_free(sa);
+    ASSERT_EQ_FMT((size_t)0, mem.live, "%zu");
+    PASS();
+}
+
 SUITE(basic) {
     RUN_TEST(binary_search);
     RUN_TESTp(iteration_locks_collection, false);
     RUN_TESTp(iteration_locks_collection, true);
     RUN_TEST(iteration);
+    RUN_TESTp(node_capacity_follows_count, false);
+    RUN_TESTp(node_capacity_follows_count, true);
 
     for (size_t i = 10; i <= 10000; i *= 10) {
         if (greatest_get_verbosity() > 0) {
@@ -1,4 +1,5 @@
 #include "test_skiparray.h"
+#include "skiparray_internal_types.h"
 
 static struct skiparray_config config = {
     .cmp = test_skiparray_cmp_intptr_t,
@@ -92,6 +93,64 @@ TEST build_ascending(size_t limit) {
     PASS();
 }
 
+/* Every 2^k-th node should reach exactly level k (capped by
+ * max_level), and each level should link all nodes that reach it. */
+TEST build_balanced(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    struct skiparray_config cfg = config;
+    cfg.max_level = 6;
+    struct skiparray_builder *b = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_BUILDER_NEW_OK,
+        skiparray_builder_new_balanced(&cfg, false, &b), "%d");
+
+    for (size_t i = 0; i < limit; i++) {
+        const uintptr_t k = (uintptr_t)i;
+        ASSERT_EQ_FMT(SKIPARRAY_BUILDER_APPEND_OK,
+            skiparray_builder_append(b, (void *)k, (void *)(k + 1)), "%d");
+    }
+
+    struct skiparray *sa = NULL;
+    skiparray_builder_finish(&b, &sa);
+    ASSERT(sa != NULL);
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+
+    uint8_t max_height = 0;
+    size_t index = 0;
+    for (struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        uint8_t exp = 1;
+        if (index > 0) {
+            for (size_t i = index; (i & 1) == 0 && exp < cfg.max_level; i >>= 1) {
+                exp++;
+            }
+        }
+        ASSERT_EQ_FMT(exp, n->height, "%u");
+        if (n->height > max_height) { max_height = n->height; }
+
+        for (uint8_t l = 1; l < n->height; l++) {
+            struct node *next = n->fwd[0];
+            while (next != NULL && next->height <= l) { next = next->fwd[0]; }
+            ASSERT_EQ(next, n->fwd[l]);
+        }
+        index++;
+    }
+    ASSERT_EQ_FMT(max_height, sa->height, "%u");
+
+    for (size_t i = 0; i < limit; i++) {
+        const uintptr_t k = (uintptr_t)i;
+        uintptr_t v;
+        ASSERT(skiparray_get(sa, (void *)k, (void **)&v));
+        ASSERT_EQ_FMT(k + 1, v, "%"PRIuPTR);
+    }
+
+    /* Later insertions still work as usual. */
+    ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+        skiparray_set(sa, (void *)(uintptr_t)limit, NULL), "%d");
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+
+    skiparray_free(sa);
+    PASS();
+}
+
 SUITE(builder) {
     RUN_TEST(reject_missing_parameters);
     RUN_TEST(reject_descending_key);
@@ -107,5 +166,6 @@ SUITE(builder) {
 
         greatest_set_test_suffix(buf);
         RUN_TESTp(build_ascending, i);
+        RUN_TESTp(build_balanced, i);
     }
 }
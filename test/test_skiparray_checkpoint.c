@@ -0,0 +1,337 @@
+#include "test_skiparray.h"
+
+#define MAX_CHAIN 16
+
+static struct skiparray_config config = {
+    .cmp = test_skiparray_cmp_intptr_t,
+    .node_size = 16,
+};
+
+static enum skiparray_dump_res
+write_checkpoint(struct skiparray *sa, struct test_skiparray_stream *s,
+    bool checksum, bool base) {
+    struct skiparray_dump_config dcfg = {
+        .write = test_skiparray_stream_write,
+        .encode_key = test_skiparray_encode_uintptr,
+        .encode_value = test_skiparray_encode_uintptr,
+        .checksum = checksum,
+        .udata = s,
+    };
+    return (base
+        ? skiparray_checkpoint_base(sa, &dcfg)
+        : skiparray_checkpoint_incremental(sa, &dcfg));
+}
+
+static enum skiparray_load_res
+load(struct test_skiparray_stream **streams, size_t count,
+    struct skiparray **sa) {
+    struct skiparray_load_config lcfgs[MAX_CHAIN];
+    assert(count <= MAX_CHAIN);
+    for (size_t i = 0; i < count; i++) {
+        lcfgs[i] = (struct skiparray_load_config) {
+            .read = test_skiparray_stream_read,
+            .decode_key = test_skiparray_decode_uintptr,
+            .decode_value = test_skiparray_decode_uintptr,
+            .udata = streams[i],
+        };
+        test_skiparray_stream_rewind(streams[i]);
+    }
+    return skiparray_load_checkpoints(&config, lcfgs, count, sa);
+}
+
+static bool
+same_pairs(struct skiparray *a, struct skiparray *b) {
+    if (skiparray_count(a) != skiparray_count(b)) { return false; }
+    struct skiparray_iter *ia = NULL;
+    struct skiparray_iter *ib = NULL;
+    if (SKIPARRAY_ITER_NEW_OK != skiparray_iter_new(a, &ia)) { return false; }
+    if (SKIPARRAY_ITER_NEW_OK != skiparray_iter_new(b, &ib)) {
+        skiparray_iter_free(ia);
+        return false;
+    }
+
+    bool res = true;
+    for (;;) {
+        void *ka, *va, *kb, *vb;
+        skiparray_iter_get(ia, &ka, &va);
+        skiparray_iter_get(ib, &kb, &vb);
+        if (ka != kb || va != vb) {
+            res = false;
+            break;
+        }
+        if (skiparray_iter_next(ia) != SKIPARRAY_ITER_STEP_OK) { break; }
+        if (skiparray_iter_next(ib) != SKIPARRAY_ITER_STEP_OK) {
+            res = false;
+            break;
+        }
+    }
+    skiparray_iter_free(ia);
+    skiparray_iter_free(ib);
+    return res;
+}
+
+static bool
+load_matches(struct skiparray *sa, struct test_skiparray_stream **streams,
+    size_t count) {
+    struct skiparray *loaded = NULL;
+    if (SKIPARRAY_LOAD_OK != load(streams, count, &loaded)) { return false; }
+    bool res = test_skiparray_invariants(loaded, 0)
+        && (skiparray_count(sa) == 0
+            ? skiparray_count(loaded) == 0 : same_pairs(sa, loaded));
+    skiparray_free(loaded);
+    return res;
+}
+
+static void
+free_streams(struct test_skiparray_stream *streams, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        test_skiparray_stream_free(&streams[i]);
+    }
+}
+
+TEST chain_matches(size_t limit, bool checksum) {
+    struct skiparray *sa = test_skiparray_make_sa(&config, limit);
+    ASSERT(sa != NULL);
+    struct test_skiparray_stream s[MAX_CHAIN];
+    struct test_skiparray_stream *ps[MAX_CHAIN];
+    memset(s, 0x00, sizeof(s));
+    for (size_t i = 0; i < MAX_CHAIN; i++) { ps[i] = &s[i]; }
+
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[0], checksum, false), "%d");
+    ASSERT(load_matches(sa, ps, 1));
+
+    uint64_t state = 0x5eed + limit;
+    const size_t changes = limit/10 + 1;
+    for (size_t round = 1; round < MAX_CHAIN; round++) {
+        for (size_t i = 0; i < changes; i++) {
+            const uintptr_t key = test_skiparray_next_rand(&state)
+                % (3*limit + 10);
+            switch (test_skiparray_next_rand(&state) % 8) {
+            default:
+                (void)skiparray_set(sa, (void *)key, (void *)round);
+                break;
+            case 5: case 6:
+                (void)skiparray_forget(sa, (void *)key, NULL);
+                break;
+            case 7:
+                (void)(i & 1 ? skiparray_pop_first(sa, NULL, NULL)
+                    : skiparray_pop_last(sa, NULL, NULL));
+                break;
+            }
+        }
+        if (round % 5 == 0) {
+            ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE,
+                skiparray_compact(sa, 1.0), "%d");
+        }
+
+        ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+            write_checkpoint(sa, &s[round], checksum, false), "%d");
+        ASSERT(load_matches(sa, ps, round + 1));
+    }
+
+    skiparray_free(sa);
+    free_streams(s, MAX_CHAIN);
+    PASS();
+}
+
+TEST delta_writes_only_changed_nodes(void) {
+    const size_t limit = 10000;
+    struct skiparray *sa = test_skiparray_make_sa(&config, limit);
+    ASSERT(sa != NULL);
+    struct test_skiparray_stream s[3];
+    struct test_skiparray_stream *ps[3] = { &s[0], &s[1], &s[2] };
+    memset(s, 0x00, sizeof(s));
+
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[0], true, false), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+        skiparray_set(sa, (void *)(3*5000 + 1), NULL), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[1], true, false), "%d");
+
+    /* One or two node blocks, plus a manifest with a byte per node. */
+    const size_t nodes = limit / (config.node_size/2);
+    const size_t bound = 2*config.node_size*2*sizeof(uintptr_t) + nodes + 256;
+    if (s[1].used > bound) {
+        FAILm("delta is too large");
+    }
+    ASSERT(s[1].used < s[0].used / 10);
+
+    /* Misses and reads don't count as changes. */
+    ASSERT_EQ_FMT(SKIPARRAY_FORGET_NOT_FOUND,
+        skiparray_forget(sa, (void *)2, NULL), "%d");
+    ASSERT(skiparray_member(sa, (void *)3));
+    const size_t before = s[1].used;
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[2], true, false), "%d");
+    ASSERT(s[2].used < before);
+    ASSERT(load_matches(sa, ps, 3));
+
+    skiparray_free(sa);
+    free_streams(s, 3);
+    PASS();
+}
+
+TEST reject_broken_chain(void) {
+    struct skiparray *sa = test_skiparray_make_sa(&config, 1000);
+    ASSERT(sa != NULL);
+    struct test_skiparray_stream s[5];
+    memset(s, 0x00, sizeof(s));
+
+    for (size_t i = 0; i < 5; i++) {
+        (void)skiparray_set(sa, (void *)(3*100*i + 1), NULL);
+        ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+            write_checkpoint(sa, &s[i], false, i == 3), "%d");
+    }
+    /* s[0] is a base with deltas s[1] and s[2], and s[3] is a new
+     * base with delta s[4]. */
+    struct skiparray *loaded = NULL;
+    struct test_skiparray_stream *skipped[] = { &s[0], &s[2] };
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_CHAIN, load(skipped, 2, &loaded), "%d");
+    struct test_skiparray_stream *no_base[] = { &s[1], &s[2] };
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_CHAIN, load(no_base, 2, &loaded), "%d");
+    struct test_skiparray_stream *mixed[] = { &s[0], &s[4] };
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_CHAIN, load(mixed, 2, &loaded), "%d");
+    struct test_skiparray_stream *two_bases[] = { &s[0], &s[3] };
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_CHAIN,
+        load(two_bases, 2, &loaded), "%d");
+
+    struct test_skiparray_stream *latest[] = { &s[3], &s[4] };
+    ASSERT(load_matches(sa, latest, 2));
+    struct test_skiparray_stream *older[] = { &s[0], &s[1], &s[2] };
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK, load(older, 3, &loaded), "%d");
+    ASSERT(skiparray_member(loaded, (void *)(3*100*2 + 1)));
+    ASSERT(!skiparray_member(loaded, (void *)(3*100*3 + 1)));
+    skiparray_free(loaded);
+
+    /* damaged manifest */
+    s[4].buf[s[4].used - 5] ^= 0x40;
+    ASSERT(SKIPARRAY_LOAD_OK != load(latest, 2, &loaded));
+
+    skiparray_free(sa);
+    free_streams(s, 5);
+    PASS();
+}
+
+TEST write_failure_keeps_changes(void) {
+    struct skiparray *sa = test_skiparray_make_sa(&config, 1000);
+    ASSERT(sa != NULL);
+    struct test_skiparray_stream s[3];
+    struct test_skiparray_stream *ps[2] = { &s[0], &s[2] };
+    memset(s, 0x00, sizeof(s));
+
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[0], true, false), "%d");
+    (void)skiparray_set(sa, (void *)7, NULL);
+    (void)skiparray_forget(sa, (void *)(3*900), NULL);
+
+    s[1].fail_writes = true;
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_ERROR_WRITE,
+        write_checkpoint(sa, &s[1], true, false), "%d");
+
+    /* The next delta has everything the failed one would have. */
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[2], true, false), "%d");
+    ASSERT(load_matches(sa, ps, 2));
+
+    skiparray_free(sa);
+    free_streams(s, 3);
+    PASS();
+}
+
+TEST loaded_starts_new_chain(void) {
+    struct skiparray *sa = test_skiparray_make_sa(&config, 500);
+    ASSERT(sa != NULL);
+    struct test_skiparray_stream s[3];
+    memset(s, 0x00, sizeof(s));
+    struct test_skiparray_stream *first[] = { &s[0] };
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[0], false, false), "%d");
+
+    struct skiparray *loaded = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK, load(first, 1, &loaded), "%d");
+    (void)skiparray_set(loaded, (void *)1, NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(loaded, &s[1], false, false), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(loaded, &s[2], false, false), "%d");
+
+    struct test_skiparray_stream *chain[] = { &s[1], &s[2] };
+    ASSERT(load_matches(loaded, chain, 2));
+    struct test_skiparray_stream *mixed[] = { &s[0], &s[2] };
+    struct skiparray *res = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_CHAIN, load(mixed, 2, &res), "%d");
+
+    skiparray_free(sa);
+    skiparray_free(loaded);
+    free_streams(s, 3);
+    PASS();
+}
+
+/* Loading streams the base, so it only needs a little more memory
+ * than the loaded skiparray, however large the base is. */
+TEST load_streams_base(size_t count) {
+    struct skiparray *sa = test_skiparray_make_sa(&config, 100000);
+    ASSERT(sa != NULL);
+    struct test_skiparray_stream s[2];
+    memset(s, 0x00, sizeof(s));
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[0], true, false), "%d");
+    for (uintptr_t i = 0; i < 100; i++) {
+        (void)skiparray_set(sa, (void *)(3*1000*i + 1), NULL);
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK,
+        write_checkpoint(sa, &s[1], true, false), "%d");
+
+    struct test_skiparray_memory mem = { .live = 0 };
+    struct skiparray_config cfg = config;
+    cfg.memory = test_skiparray_counting_memory;
+    cfg.udata = &mem;
+    struct skiparray_load_config lcfgs[2];
+    for (size_t i = 0; i < count; i++) {
+        lcfgs[i] = (struct skiparray_load_config) {
+            .read = test_skiparray_stream_read,
+            .decode_key = test_skiparray_decode_uintptr,
+            .decode_value = test_skiparray_decode_uintptr,
+            .udata = &s[i],
+        };
+        test_skiparray_stream_rewind(&s[i]);
+    }
+    struct skiparray *loaded = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK,
+        skiparray_load_checkpoints(&cfg, lcfgs, count, &loaded), "%d");
+    ASSERT_EQ_FMT(count == 1 ? (size_t)100000 : skiparray_count(sa),
+        skiparray_count(loaded), "%zu");
+
+    const size_t extra = mem.peak - mem.live;
+    if (extra > s[0].used / 8) {
+        FAILm("loading kept too much of the base in memory");
+    }
+
+    skiparray_free(loaded);
+    skiparray_free(sa);
+    free_streams(s, 2);
+    PASS();
+}
+
+SUITE(checkpoint) {
+    RUN_TEST(delta_writes_only_changed_nodes);
+    RUN_TEST(reject_broken_chain);
+    RUN_TEST(write_failure_keeps_changes);
+    RUN_TEST(loaded_starts_new_chain);
+    RUN_TESTp(load_streams_base, 1);
+    RUN_TESTp(load_streams_base, 2);
+
+    for (size_t i = 1; i <= 100000; i *= 10) {
+        char buf[32];
+        for (int cs = 0; cs < 2; cs++) {
+            if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu%s",
+                    i, cs ? "_crc" : "")) {
+                assert(false);
+            }
+            greatest_set_test_suffix(buf);
+            RUN_TESTp(chain_matches, i, cs);
+        }
+    }
+}
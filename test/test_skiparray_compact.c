@@ -0,0 +1,213 @@
+#include "test_skiparray.h"
+#include "skiparray_internal_types.h"
+
+static struct skiparray *
+make_churned(size_t limit, uint16_t node_size) {
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = node_size,
+    };
+    struct skiparray *sa = NULL;
+    if (SKIPARRAY_NEW_OK != skiparray_new(&cfg, &sa)) { return NULL; }
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        if (SKIPARRAY_SET_BOUND != skiparray_set(sa, (void *)i, (void *)i)) {
+            return NULL;
+        }
+    }
+    /* Leave every third key, so most nodes end up near half full. */
+    for (uintptr_t i = 0; i < limit; i++) {
+        if (i % 3 == 0) { continue; }
+        if (SKIPARRAY_FORGET_OK != skiparray_forget(sa, (void *)i, NULL)) {
+            return NULL;
+        }
+    }
+    return sa;
+}
+
+static size_t
+count_nodes(const struct skiparray *sa) {
+    size_t res = 0;
+    for (const struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        res++;
+    }
+    return res;
+}
+
+TEST reject_misuse(void) {
+    struct skiparray *sa = make_churned(100, 8);
+    ASSERT(sa != NULL);
+
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_ERROR_MISUSE,
+        skiparray_compact(sa, 0.0), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_ERROR_MISUSE,
+        skiparray_compact(sa, 1.5), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_ERROR_MISUSE,
+        skiparray_compact_step(sa, 1.0, 0), "%d");
+
+    struct skiparray_iter *iter = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK, skiparray_iter_new(sa, &iter), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_ERROR_LOCKED,
+        skiparray_compact(sa, 1.0), "%d");
+    skiparray_iter_free(iter);
+
+    skiparray_free(sa);
+    PASS();
+}
+
+TEST compact_empty(void) {
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE, skiparray_compact(sa, 1.0), "%d");
+    ASSERT(test_skiparray_invariants(sa, greatest_get_verbosity() - 1));
+
+    ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+        skiparray_set(sa, (void *)1, NULL), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE, skiparray_compact(sa, 1.0), "%d");
+    ASSERT(skiparray_member(sa, (void *)1));
+
+    skiparray_free(sa);
+    PASS();
+}
+
+TEST compact_all(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    const uint16_t node_size = 16;
+    struct skiparray *sa = make_churned(limit, node_size);
+    ASSERT(sa != NULL);
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    const size_t count = skiparray_count(sa);
+    const size_t before = count_nodes(sa);
+
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE, skiparray_compact(sa, 1.0), "%d");
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    ASSERT_EQ_FMT(count, skiparray_count(sa), "%zu");
+
+    /* Every node but the last should be full. */
+    const size_t after = count_nodes(sa);
+    ASSERT_EQ_FMT((count + node_size - 1) / node_size, after, "%zu");
+    ASSERT(after <= before);
+
+    /* Heights follow the node index, as in a balanced build. */
+    size_t index = 0;
+    for (const struct node *n = sa->nodes[0]; n != NULL; n = n->fwd[0]) {
+        uint8_t exp = 1;
+        if (index > 0) {
+            for (size_t i = index; (i & 1) == 0 && exp < sa->max_level; i >>= 1) {
+                exp++;
+            }
+        }
+        ASSERT_EQ_FMT(exp, n->height, "%u");
+        index++;
+    }
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ(i % 3 == 0, skiparray_member(sa, (void *)i));
+    }
+
+    skiparray_free(sa);
+    PASS();
+}
+
+/* Interleave single-node compaction steps with inserts and deletes
+ * anywhere in the key range, checking the structure after each. */
+TEST compact_interleaved(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    struct skiparray *sa = make_churned(limit, 8);
+    ASSERT(sa != NULL);
+
+    uintptr_t k = 1;
+    size_t steps = 0;
+    enum skiparray_compact_res res;
+    do {
+        res = skiparray_compact_step(sa, 0.75, 1);
+        ASSERT(res == SKIPARRAY_COMPACT_MORE || res == SKIPARRAY_COMPACT_DONE);
+        steps++;
+
+        /* Toggle some key's membership, moving around the key range. */
+        k = (k + 7919) % limit;
+        if (k % 3 == 0) {
+            ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+                skiparray_forget(sa, (void *)k, NULL), "%d");
+            ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+                skiparray_set(sa, (void *)k, (void *)k), "%d");
+        } else {
+            ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+                skiparray_set(sa, (void *)k, (void *)k), "%d");
+            ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+                skiparray_forget(sa, (void *)k, NULL), "%d");
+        }
+        ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+        ASSERT(steps <= limit);
+    } while (res == SKIPARRAY_COMPACT_MORE);
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ(i % 3 == 0, skiparray_member(sa, (void *)i));
+    }
+
+    skiparray_free(sa);
+    PASS();
+}
+
+/* Empty the skiparray between compaction steps, leaving the saved
+ * position on an empty node, then refill it and compact again. */
+TEST compact_step_after_emptied(void) {
+    struct skiparray *sa = make_churned(64, 8);
+    ASSERT(sa != NULL);
+
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_MORE,
+        skiparray_compact_step(sa, 1.0, 1), "%d");
+    while (skiparray_count(sa) > 0) {
+        ASSERT_EQ_FMT(SKIPARRAY_POP_OK,
+            skiparray_pop_first(sa, NULL, NULL), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE,
+        skiparray_compact_step(sa, 1.0, 1), "%d");
+    ASSERT(test_skiparray_invariants(sa, greatest_get_verbosity() - 1));
+
+    /* the same, emptying it by forgetting every key */
+    for (uintptr_t i = 0; i < 64; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_MORE,
+        skiparray_compact_step(sa, 1.0, 1), "%d");
+    for (uintptr_t i = 0; i < 64; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)i, NULL), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE,
+        skiparray_compact_step(sa, 1.0, 1), "%d");
+
+    for (uintptr_t i = 0; i < 64; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE, skiparray_compact(sa, 1.0), "%d");
+    ASSERT(test_skiparray_invariants(sa, greatest_get_verbosity() - 1));
+    ASSERT_EQ_FMT((size_t)64, skiparray_count(sa), "%zu");
+
+    skiparray_free(sa);
+    PASS();
+}
+
+SUITE(compact) {
+    RUN_TEST(reject_misuse);
+    RUN_TEST(compact_empty);
+    RUN_TEST(compact_step_after_emptied);
+
+    for (size_t i = 10; i <= 100000; i *= 10) {
+        char buf[8];
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) { assert(false); }
+
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(compact_all, i);
+        if (i <= 10000) {
+            greatest_set_test_suffix(buf);
+            RUN_TESTp(compact_interleaved, i);
+        }
+    }
+}
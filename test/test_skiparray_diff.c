@@ -0,0 +1,261 @@
+#include "test_skiparray.h"
+
+static size_t hash_calls;
+
+static uint64_t
+hash_pair(const void *key, const void *value, void *udata) {
+    (void)udata;
+    hash_calls++;
+    return (uint64_t)(uintptr_t)key * 31 + (uint64_t)(uintptr_t)value;
+}
+
+static struct skiparray_config config = {
+    .cmp = test_skiparray_cmp_intptr_t,
+    .hash = hash_pair,
+    .node_size = 16,
+    .seed = 12345,
+};
+
+/* The differences found, as +key (added), -key (removed), or
+ * key * 2^32 + value (changed), in order. */
+struct record {
+    int64_t *items;
+    size_t count;
+    size_t size;
+};
+
+static void
+push(struct record *r, int64_t x) {
+    if (r->count == r->size) {
+        r->size = (r->size == 0 ? 64 : 2 * r->size);
+        r->items = realloc(r->items, r->size * sizeof(r->items[0]));
+        assert(r->items != NULL);
+    }
+    r->items[r->count++] = x;
+}
+
+static void
+on_added(void *key, void *value, void *udata) {
+    (void)value;
+    push(udata, (intptr_t)key + 1);
+}
+
+static void
+on_removed(void *key, void *value, void *udata) {
+    (void)value;
+    push(udata, -((intptr_t)key + 1));
+}
+
+static void
+on_changed(void *key, void *value_a, void *value_b, void *udata) {
+    (void)value_a;
+    push(udata, (int64_t)(intptr_t)key * ((int64_t)1 << 32)
+        + (intptr_t)value_b);
+}
+
+static bool
+get_at(struct skiparray_iter *iter, bool *more,
+    intptr_t *key, intptr_t *value) {
+    if (!*more) { return false; }
+    void *k, *v;
+    skiparray_iter_get(iter, &k, &v);
+    *key = (intptr_t)k;
+    *value = (intptr_t)v;
+    return true;
+}
+
+/* Diff by comparing every pair, for reference. */
+static void
+naive_diff(struct skiparray *a, struct skiparray *b, struct record *r) {
+    struct skiparray_iter *ia = NULL;
+    struct skiparray_iter *ib = NULL;
+    bool more_a = (skiparray_count(a) > 0
+        && SKIPARRAY_ITER_NEW_OK == skiparray_iter_new(a, &ia));
+    bool more_b = (skiparray_count(b) > 0
+        && SKIPARRAY_ITER_NEW_OK == skiparray_iter_new(b, &ib));
+
+    for (;;) {
+        intptr_t ka, va, kb, vb;
+        const bool has_a = get_at(ia, &more_a, &ka, &va);
+        const bool has_b = get_at(ib, &more_b, &kb, &vb);
+        if (!has_a && !has_b) { break; }
+        if (has_a && (!has_b || ka < kb)) {
+            push(r, -(ka + 1));
+            more_a = skiparray_iter_next(ia) == SKIPARRAY_ITER_STEP_OK;
+        } else if (!has_a || kb < ka) {
+            push(r, kb + 1);
+            more_b = skiparray_iter_next(ib) == SKIPARRAY_ITER_STEP_OK;
+        } else {
+            if (va != vb) { push(r, (int64_t)kb * ((int64_t)1 << 32) + vb); }
+            more_a = skiparray_iter_next(ia) == SKIPARRAY_ITER_STEP_OK;
+            more_b = skiparray_iter_next(ib) == SKIPARRAY_ITER_STEP_OK;
+        }
+    }
+    if (ia != NULL) { skiparray_iter_free(ia); }
+    if (ib != NULL) { skiparray_iter_free(ib); }
+}
+
+static bool
+diff_matches(struct skiparray *a, struct skiparray *b) {
+    struct record got = { .count = 0 };
+    struct record exp = { .count = 0 };
+    naive_diff(a, b, &exp);
+    bool res = SKIPARRAY_DIFF_OK == skiparray_diff(a, b,
+        on_added, on_removed, on_changed, &got);
+    res = res && got.count == exp.count
+        && (got.count == 0
+            || 0 == memcmp(got.items, exp.items,
+                got.count * sizeof(got.items[0])));
+    free(got.items);
+    free(exp.items);
+    return res;
+}
+
+/* Apply the same random changes to every skiparray in SAS. */
+static void
+churn(struct skiparray **sas, size_t count, size_t changes,
+    uintptr_t key_limit, uint64_t *state) {
+    for (size_t i = 0; i < changes; i++) {
+        const uintptr_t key = test_skiparray_next_rand(state) % key_limit;
+        const uintptr_t value = test_skiparray_next_rand(state) % 1000;
+        const uint64_t op = test_skiparray_next_rand(state) % 8;
+        for (size_t s = 0; s < count; s++) {
+            switch (op) {
+            default:
+                (void)skiparray_set(sas[s], (void *)key, (void *)value);
+                break;
+            case 5: case 6:
+                (void)skiparray_forget(sas[s], (void *)key, NULL);
+                break;
+            case 7:
+                (void)(i & 1 ? skiparray_pop_first(sas[s], NULL, NULL)
+                    : skiparray_pop_last(sas[s], NULL, NULL));
+                break;
+            }
+        }
+    }
+}
+
+TEST reject_misuse(void) {
+    struct skiparray_config no_hash = config;
+    no_hash.hash = NULL;
+    struct skiparray_config no_values = config;
+    no_values.ignore_values = true;
+
+    struct skiparray *a = test_skiparray_make_sa(&config, 10);
+    struct skiparray *b = test_skiparray_make_sa(&no_hash, 10);
+    struct skiparray *c = test_skiparray_make_sa(&no_values, 10);
+    ASSERT(a != NULL && b != NULL && c != NULL);
+
+    ASSERT_EQ_FMT(SKIPARRAY_DIFF_ERROR_MISUSE,
+        skiparray_diff(a, b, NULL, NULL, NULL, NULL), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_DIFF_ERROR_MISUSE,
+        skiparray_diff(a, c, NULL, NULL, NULL, NULL), "%d");
+    ASSERT(diff_matches(a, a));
+
+    skiparray_free(a);
+    skiparray_free(b);
+    skiparray_free(c);
+    PASS();
+}
+
+/* Replicas that get the same changes diff correctly as they diverge,
+ * whether or not they were ever equal. */
+TEST replicas(size_t limit) {
+    struct skiparray *a = test_skiparray_make_sa(&config, limit);
+    struct skiparray *b = test_skiparray_make_sa(&config, limit);
+    ASSERT(a != NULL && b != NULL);
+    struct skiparray *both[] = { a, b };
+    uint64_t state = 0x5eed + limit;
+    const uintptr_t key_limit = 3*limit + 10;
+
+    ASSERT(diff_matches(a, b));
+    for (size_t round = 0; round < 8; round++) {
+        churn(both, 2, limit/4 + 1, key_limit, &state);
+        churn(&a, 1, round, key_limit, &state);
+        churn(&b, 1, round % 3, key_limit, &state);
+        if (round == 4) {
+            ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE,
+                skiparray_compact(a, 1.0), "%d");
+        }
+        ASSERT(diff_matches(a, b));
+        ASSERT(diff_matches(b, a));
+    }
+
+    skiparray_free(a);
+    skiparray_free(b);
+    PASS();
+}
+
+/* Skiparrays with the same pairs in differently shaped nodes still
+ * diff correctly, pair by pair. */
+TEST different_shapes(size_t limit) {
+    struct skiparray_config small = config;
+    small.node_size = 5;
+    small.seed = 99;
+    struct skiparray *a = test_skiparray_make_sa(&config, limit);
+    struct skiparray *b = test_skiparray_make_sa(&small, limit);
+    ASSERT(a != NULL && b != NULL);
+    uint64_t state = 0xd1ff + limit;
+
+    ASSERT(diff_matches(a, b));
+    for (size_t round = 0; round < 4; round++) {
+        churn(&a, 1, limit/8 + 1, 3*limit + 10, &state);
+        churn(&b, 1, limit/8 + 1, 3*limit + 10, &state);
+        ASSERT(diff_matches(a, b));
+    }
+
+    skiparray_free(a);
+    skiparray_free(b);
+    PASS();
+}
+
+/* Once the digests are up to date, a small change only costs
+ * rehashing the nodes it touched. */
+TEST work_proportional_to_changes(void) {
+    const size_t limit = 100000;
+    struct skiparray *a = test_skiparray_make_sa(&config, limit);
+    struct skiparray *b = test_skiparray_make_sa(&config, limit);
+    ASSERT(a != NULL && b != NULL);
+    ASSERT(diff_matches(a, b));
+
+    struct record r = { .count = 0 };
+    for (size_t i = 0; i < 10; i++) {
+        const uintptr_t key = 3 * (i * 7919 % limit);
+        ASSERT_EQ_FMT(SKIPARRAY_SET_REPLACED,
+            skiparray_set(b, (void *)key, (void *)(uintptr_t)1000000), "%d");
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(a, (void *)(key + 1), NULL), "%d");
+
+        hash_calls = 0;
+        r.count = 0;
+        ASSERT_EQ_FMT(SKIPARRAY_DIFF_OK, skiparray_diff(a, b,
+                on_added, on_removed, on_changed, &r), "%d");
+        ASSERT_EQ_FMT((size_t)2*(i + 1), r.count, "%zu");
+        /* a few nodes' worth on each side, not 2 * limit */
+        if (hash_calls > 64 * config.node_size * (i + 1)) {
+            FAILm("too many hash calls");
+        }
+    }
+
+    free(r.items);
+    skiparray_free(a);
+    skiparray_free(b);
+    PASS();
+}
+
+SUITE(diff) {
+    RUN_TEST(reject_misuse);
+    RUN_TEST(work_proportional_to_changes);
+
+    for (size_t i = 1; i <= 10000; i *= 10) {
+        char buf[32];
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) {
+            assert(false);
+        }
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(replicas, i);
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(different_shapes, i);
+    }
+}
@@ -205,6 +205,9 @@ TEST fold_multi_and_check_merge(size_t limit) {
     do {
     } while (skiparray_fold_next(fs) != SKIPARRAY_FOLD_NEXT_DONE);
 
+    /* Each key was appended once, in ascending order. */
+    ASSERT(env.ok);
+
     /* Finish the result builder */
     struct skiparray *res = NULL;
     skiparray_builder_finish(&env.b, &res);
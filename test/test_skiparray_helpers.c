@@ -0,0 +1,110 @@
+#include "test_skiparray.h"
+
+#include <string.h>
+
+bool
+test_skiparray_stream_write(const uint8_t *buf, size_t len, void *udata) {
+    struct test_skiparray_stream *s = udata;
+    if (s->fail_writes) { return false; }
+    if (s->used + len > s->size) {
+        size_t nsize = (s->size == 0 ? 256 : 2 * s->size);
+        while (nsize < s->used + len) { nsize *= 2; }
+        uint8_t *nbuf = realloc(s->buf, nsize);
+        if (nbuf == NULL) { return false; }
+        s->buf = nbuf;
+        s->size = nsize;
+    }
+    memcpy(&s->buf[s->used], buf, len);
+    s->used += len;
+    return true;
+}
+
+bool
+test_skiparray_stream_read(uint8_t *buf, size_t len, void *udata) {
+    struct test_skiparray_stream *s = udata;
+    if (s->end - s->pos < len) { return false; }
+    memcpy(buf, &s->buf[s->pos], len);
+    s->pos += len;
+    return true;
+}
+
+void
+test_skiparray_stream_rewind(struct test_skiparray_stream *s) {
+    s->pos = 0;
+    s->end = s->used;
+}
+
+void
+test_skiparray_stream_free(struct test_skiparray_stream *s) {
+    free(s->buf);
+    memset(s, 0x00, sizeof(*s));
+}
+
+bool
+test_skiparray_encode_uintptr(const void *x, uint8_t *buf, size_t buf_size,
+    size_t *len, void *udata) {
+    (void)udata;
+    uintptr_t v = (uintptr_t)x;
+    *len = sizeof(v);
+    if (*len > buf_size) { return true; }
+    memcpy(buf, &v, sizeof(v));
+    return true;
+}
+
+bool
+test_skiparray_decode_uintptr(const uint8_t *buf, size_t len, void **x,
+    void *udata) {
+    (void)udata;
+    uintptr_t v;
+    if (len != sizeof(v)) { return false; }
+    memcpy(&v, buf, sizeof(v));
+    *x = (void *)v;
+    return true;
+}
+
+struct skiparray *
+test_skiparray_make_sa(const struct skiparray_config *config, size_t limit) {
+    struct skiparray *sa = NULL;
+    if (SKIPARRAY_NEW_OK != skiparray_new(config, &sa)) { return NULL; }
+    for (uintptr_t i = 0; i < limit; i++) {
+        if (SKIPARRAY_SET_BOUND != skiparray_set(sa,
+                (void *)(3 * i), (void *)(i + 1))) {
+            skiparray_free(sa);
+            return NULL;
+        }
+    }
+    return sa;
+}
+
+uint64_t
+test_skiparray_next_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+void *
+test_skiparray_counting_memory(void *p, size_t nsize, void *udata) {
+    struct test_skiparray_memory *m = udata;
+    size_t *header = NULL;
+    if (p != NULL) {
+        header = (size_t *)p - 1;
+        m->live -= header[0];
+        if (nsize == 0) {
+            free(header);
+            return NULL;
+        }
+    }
+    size_t *nheader = realloc(header, sizeof(size_t) + nsize);
+    if (nheader == NULL) {
+        if (header != NULL) { m->live += header[0]; }
+        return NULL;
+    }
+    nheader[0] = nsize;
+    m->live += nsize;
+    if (m->live > m->peak) { m->peak = m->live; }
+    return &nheader[1];
+}
@@ -74,7 +74,9 @@ bool test_skiparray_invariants(struct skiparray *sa, int verbosity) {
 
     /* For every node linked on level 0:
      *
-     * - All nodes except the last must have at least node_size/2 keys.
+     * - All nodes except the last must have at least node_size/2 keys
+     *   (node_size_min/2 with adaptive node sizes).
+     * - Node limits are between node_size_min and node_size.
      * - No node can overflow its key buffer.
      * - The last key in a node must be less than the first key in the
      *   next node, if there is one.
@@ -99,7 +101,9 @@ bool test_skiparray_invariants(struct skiparray *sa, int verbosity) {
             LOG(2, "    -- fwd[%zu]: %p\n", i, (void *)cur->fwd[i]);
         }
 
-        for (size_t i = 0; i < cur->count; i++) {
+        /* A paged out node only has its last key in memory. */
+        const bool resident = cur->keys != NULL;
+        for (size_t i = 0; resident && i < cur->count; i++) {
             LOG(3, "%zd: %p => %p\n",
                 i, (void *)cur->keys[cur->offset + i],
                 (void *)cur->values[cur->offset + i]);
@@ -119,8 +123,9 @@ bool test_skiparray_invariants(struct skiparray *sa, int verbosity) {
                 "Back pointer mismatch on %p: prev %p, cur->back %p\n",
                 (void *)cur, (void *)prev, (void *)cur->back);
             if (cur->count > 0) {
-                CHECK(sa->cmp(prev->keys[prev->offset + prev->count - 1],
-                        cur->keys[cur->offset], sa->udata) < 0,
+                CHECK(sa->cmp(node_last_key(prev), resident
+                        ? cur->keys[cur->offset] : node_last_key(cur),
+                        sa->udata) < 0,
                     "Last key in prev node must be less than first key in cur node, prev %p, cur %p\n",
                     (void *)prev, (void *)cur);
             }
@@ -133,15 +138,23 @@ bool test_skiparray_invariants(struct skiparray *sa, int verbosity) {
                 CHECK(cur->count > 0, "Only root node can be empty\n");
             }
         } else {                /* not last node */
-            CHECK(cur->count >= sa->node_size / 2,
+            CHECK(cur->count >= sa->node_size_min / 2,
                 "Node must be at least half full\n");
         }
 
-        CHECK(cur->count <= sa->node_size, "Cannot have excess keys\n");
-        CHECK(cur->offset + cur->count <= sa->node_size,
+        CHECK(cur->limit >= sa->node_size_min && cur->limit <= sa->node_size,
+            "Node limit out of range: %u\n", cur->limit);
+
+        CHECK(cur->capacity <= sa->node_size, "Capacity exceeds node_size\n");
+        if (cur->capacity < sa->node_size) {
+            CHECK(cur == sa->nodes[0] && next == NULL,
+                "Only a lone root node can have reduced capacity\n");
+        }
+        CHECK(cur->count <= cur->capacity, "Cannot have excess keys\n");
+        CHECK(cur->offset + cur->count <= cur->capacity,
             "Must not overflow key buffer\n");
 
-        for (size_t i = 1; i < cur->count; i++) {
+        for (size_t i = 1; resident && i < cur->count; i++) {
             CHECK(sa->cmp(cur->keys[cur->offset + i - 1],
                     cur->keys[cur->offset + i],
                     sa->udata) < 0,
@@ -173,8 +186,9 @@ bool test_skiparray_invariants(struct skiparray *sa, int verbosity) {
                     "Node with height %u should not be linked on level %zd\n",
                     next->height, li);
 
-                CHECK(sa->cmp(cur->keys[cur->offset + cur->count - 1],
-                        next->keys[next->offset], sa->udata) < 0,
+                CHECK(sa->cmp(node_last_key(cur), next->keys != NULL
+                        ? next->keys[next->offset] : node_last_key(next),
+                        sa->udata) < 0,
                     "Last key in node must be less than first key in next node\n");
             }
 
@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_skiparray.h"
+
+#include <unistd.h>
+
+/* Keys are even integers, encoded big-endian so the default bytewise
+ * comparison matches their order. Values are encoded little-endian,
+ * with a varying amount of padding in front. */
+static bool
+encode_key_be(const void *x, uint8_t *buf, size_t buf_size,
+    size_t *len, void *udata) {
+    (void)udata;
+    uint64_t v = (uintptr_t)x;
+    *len = 8;
+    if (*len > buf_size) { return true; }
+    for (size_t i = 0; i < 8; i++) { buf[i] = (uint8_t)(v >> (56 - 8*i)); }
+    return true;
+}
+
+static bool
+encode_value_le(const void *x, uint8_t *buf, size_t buf_size,
+    size_t *len, void *udata) {
+    (void)udata;
+    uint64_t v = (uintptr_t)x;
+    const size_t pad = v % 5;
+    *len = pad + 8;
+    if (*len > buf_size) { return true; }
+    memset(buf, 0xAA, pad);
+    for (size_t i = 0; i < 8; i++) { buf[pad + i] = (uint8_t)(v >> (8*i)); }
+    return true;
+}
+
+static uint64_t
+key_of(const struct skiparray_bytes *b) {
+    assert(b->len == 8);
+    uint64_t res = 0;
+    for (size_t i = 0; i < 8; i++) { res = (res << 8) | b->bytes[i]; }
+    return res;
+}
+
+static uint64_t
+value_of(const struct skiparray_bytes *b) {
+    assert(b->len >= 8);
+    uint64_t res = 0;
+    for (size_t i = 0; i < 8; i++) {
+        res |= (uint64_t)b->bytes[b->len - 8 + i] << (8*i);
+    }
+    return res;
+}
+
+static struct skiparray_bytes
+key_bytes(uint64_t k, uint8_t buf[8]) {
+    size_t len;
+    encode_key_be((void *)(uintptr_t)k, buf, 8, &len, NULL);
+    return (struct skiparray_bytes){ .bytes = buf, .len = len };
+}
+
+/* Reverse the order, to check a comparison callback is used. */
+static int
+cmp_reversed(const void *ka, const void *kb, void *udata) {
+    (void)udata;
+    const uint64_t a = key_of(ka);
+    const uint64_t b = key_of(kb);
+    return (a < b ? 1 : a > b ? -1 : 0);
+}
+
+static bool
+file_write(const uint8_t *buf, size_t len, void *udata) {
+    return len == fwrite(buf, 1, len, udata);
+}
+
+/* Dump the skiparray to a fresh temporary file, and return its path
+ * (in PATH, which should be freed with unlink). */
+static bool
+dump_to_file(const struct skiparray *sa, char *path, size_t path_size) {
+    if (path_size < (size_t)snprintf(path, path_size,
+            "/tmp/test_skiparray_mapped.XXXXXX")) {
+        return false;
+    }
+    int fd = mkstemp(path);
+    if (fd == -1) { return false; }
+    FILE *f = fdopen(fd, "wb");
+    if (f == NULL) {
+        close(fd);
+        unlink(path);
+        return false;
+    }
+
+    struct skiparray_dump_config dcfg = {
+        .write = file_write,
+        .encode_key = encode_key_be,
+        .encode_value = encode_value_le,
+        .udata = f,
+    };
+    enum skiparray_dump_res res = skiparray_dump_mapped(sa, &dcfg);
+    if (fclose(f) != 0 || res != SKIPARRAY_DUMP_OK) {
+        unlink(path);
+        return false;
+    }
+    return true;
+}
+
+/* Keys 0, 2, ..., 2*(limit - 1), key K bound to K + 1. */
+static struct skiparray *
+make_sa(size_t limit, bool ignore_values) {
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+        .ignore_values = ignore_values,
+    };
+    struct skiparray *sa = NULL;
+    if (SKIPARRAY_NEW_OK != skiparray_new(&cfg, &sa)) { return NULL; }
+    for (uintptr_t i = 0; i < limit; i++) {
+        /* insert out of order, so nodes aren't all full */
+        uintptr_t k = 2 * ((i * 7919) % limit);
+        if (SKIPARRAY_SET_BOUND != skiparray_set(sa,
+                (void *)k, (void *)(k + 1))) {
+            skiparray_free(sa);
+            return NULL;
+        }
+    }
+    return sa;
+}
+
+static struct skiparray_ro *
+make_ro(size_t limit, bool ignore_values, skiparray_cmp_fun *cmp) {
+    struct skiparray *sa = make_sa(limit, ignore_values);
+    if (sa == NULL) { return NULL; }
+    char path[64];
+    const bool ok = dump_to_file(sa, path, sizeof(path));
+    skiparray_free(sa);
+    if (!ok) { return NULL; }
+
+    struct skiparray_ro *ro = NULL;
+    enum skiparray_open_mapped_res res = skiparray_open_mapped(path, cmp, &ro);
+    unlink(path);               /* the mapping stays valid */
+    return res == SKIPARRAY_OPEN_MAPPED_OK ? ro : NULL;
+}
+
+TEST get_and_seek(size_t limit, bool ignore_values) {
+    struct skiparray_ro *ro = make_ro(limit, ignore_values, NULL);
+    ASSERT(ro != NULL);
+    ASSERT_EQ_FMT(limit, skiparray_ro_count(ro), "%zu");
+
+    uint8_t buf[8];
+    for (uint64_t k = 0; k <= 2 * limit; k++) {
+        struct skiparray_bytes key = key_bytes(k, buf);
+        struct skiparray_bytes value;
+        const bool expected = (k % 2 == 0 && k < 2 * limit);
+        ASSERT_EQ(expected, skiparray_ro_get(ro, &key, &value));
+        if (expected) {
+            if (ignore_values) {
+                ASSERT_EQ_FMT((size_t)0, value.len, "%zu");
+            } else {
+                ASSERT_EQ_FMT(k + 1, value_of(&value), "%"PRIu64);
+            }
+        }
+    }
+
+    struct skiparray_ro_iter *iter = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK,
+        skiparray_ro_iter_new(ro, &iter), "%d");
+    for (uint64_t k = 0; k < 2 * limit - 1; k++) {
+        struct skiparray_bytes key = key_bytes(k, buf);
+        ASSERT_EQ_FMT(k % 2 == 0
+            ? SKIPARRAY_ITER_SEEK_FOUND : SKIPARRAY_ITER_SEEK_NOT_FOUND,
+            skiparray_ro_iter_seek(iter, &key), "%d");
+        struct skiparray_bytes found;
+        skiparray_ro_iter_get(iter, &found, NULL);
+        ASSERT_EQ_FMT(k + (k % 2), key_of(&found), "%"PRIu64);
+    }
+
+    /* past the end: position not updated */
+    struct skiparray_bytes key = key_bytes(2 * limit - 1, buf);
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_SEEK_ERROR_AFTER_LAST,
+        skiparray_ro_iter_seek(iter, &key), "%d");
+    struct skiparray_bytes found;
+    skiparray_ro_iter_get(iter, &found, NULL);
+    ASSERT_EQ_FMT(2 * limit - 2, key_of(&found), "%"PRIu64);
+
+    skiparray_ro_iter_free(iter);
+    skiparray_close_mapped(ro);
+    PASS();
+}
+
+TEST iterate_both_ways(size_t limit) {
+    struct skiparray_ro *ro = make_ro(limit, false, NULL);
+    ASSERT(ro != NULL);
+
+    struct skiparray_ro_iter *iter = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK,
+        skiparray_ro_iter_new(ro, &iter), "%d");
+
+    struct skiparray_bytes key, value;
+    for (uint64_t i = 0; i < limit; i++) {
+        skiparray_ro_iter_get(iter, &key, &value);
+        ASSERT_EQ_FMT(2 * i, key_of(&key), "%"PRIu64);
+        ASSERT_EQ_FMT(2 * i + 1, value_of(&value), "%"PRIu64);
+        ASSERT_EQ_FMT(i + 1 < limit
+            ? SKIPARRAY_ITER_STEP_OK : SKIPARRAY_ITER_STEP_END,
+            skiparray_ro_iter_next(iter), "%d");
+    }
+
+    skiparray_ro_iter_seek_endpoint(iter, SKIPARRAY_ITER_SEEK_LAST);
+    for (uint64_t i = limit; i > 0; i--) {
+        skiparray_ro_iter_get(iter, &key, NULL);
+        ASSERT_EQ_FMT(2 * (i - 1), key_of(&key), "%"PRIu64);
+        ASSERT_EQ_FMT(i > 1
+            ? SKIPARRAY_ITER_STEP_OK : SKIPARRAY_ITER_STEP_END,
+            skiparray_ro_iter_prev(iter), "%d");
+    }
+
+    skiparray_ro_iter_free(iter);
+    skiparray_close_mapped(ro);
+    PASS();
+}
+
+struct fold_env {
+    uint64_t next;
+    int64_t step;
+    bool ok;
+};
+
+static void
+fold_cb(void *key, void *value, void *udata) {
+    struct fold_env *env = udata;
+    if (key_of(key) != env->next || value_of(value) != env->next + 1) {
+        env->ok = false;
+    }
+    env->next += env->step;
+}
+
+TEST fold_both_ways(size_t limit) {
+    struct skiparray_ro *ro = make_ro(limit, false, NULL);
+    ASSERT(ro != NULL);
+
+    struct fold_env env = { .next = 0, .step = 2, .ok = true };
+    ASSERT_EQ_FMT(SKIPARRAY_FOLD_OK,
+        skiparray_ro_fold(SKIPARRAY_FOLD_LEFT, ro, fold_cb, &env), "%d");
+    ASSERT(env.ok);
+    ASSERT_EQ_FMT(2 * limit, env.next, "%"PRIu64);
+
+    env = (struct fold_env){ .next = 2 * (limit - 1), .step = -2, .ok = true };
+    ASSERT_EQ_FMT(SKIPARRAY_FOLD_OK,
+        skiparray_ro_fold(SKIPARRAY_FOLD_RIGHT, ro, fold_cb, &env), "%d");
+    ASSERT(env.ok);
+
+    skiparray_close_mapped(ro);
+    PASS();
+}
+
+TEST custom_comparison(void) {
+    const size_t limit = 1000;
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)(i << 1), (void *)((i << 1) + 1)), "%d");
+    }
+    char path[64];
+    ASSERT(dump_to_file(sa, path, sizeof(path)));
+    skiparray_free(sa);
+
+    /* The file's keys are ascending, so reversing the comparison
+     * finds keys only by luck; with the default it finds all of them. */
+    struct skiparray_ro *ro = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_OPEN_MAPPED_OK,
+        skiparray_open_mapped(path, cmp_reversed, &ro), "%d");
+    size_t found = 0;
+    uint8_t buf[8];
+    for (uint64_t k = 0; k < 2 * limit; k += 2) {
+        struct skiparray_bytes key = key_bytes(k, buf);
+        if (skiparray_ro_get(ro, &key, NULL)) { found++; }
+    }
+    ASSERT(found < limit);
+    skiparray_close_mapped(ro);
+
+    ASSERT_EQ_FMT(SKIPARRAY_OPEN_MAPPED_OK,
+        skiparray_open_mapped(path, NULL, &ro), "%d");
+    found = 0;
+    for (uint64_t k = 0; k < 2 * limit; k += 2) {
+        struct skiparray_bytes key = key_bytes(k, buf);
+        if (skiparray_ro_get(ro, &key, NULL)) { found++; }
+    }
+    ASSERT_EQ_FMT(limit, found, "%zu");
+    skiparray_close_mapped(ro);
+
+    unlink(path);
+    PASS();
+}
+
+TEST empty(void) {
+    struct skiparray_ro *ro = make_ro(0, false, NULL);
+    ASSERT(ro != NULL);
+    ASSERT_EQ_FMT((size_t)0, skiparray_ro_count(ro), "%zu");
+
+    uint8_t buf[8];
+    struct skiparray_bytes key = key_bytes(0, buf);
+    ASSERT_FALSE(skiparray_ro_get(ro, &key, NULL));
+
+    struct skiparray_ro_iter *iter = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_EMPTY,
+        skiparray_ro_iter_new(ro, &iter), "%d");
+
+    struct fold_env env = { .ok = true };
+    ASSERT_EQ_FMT(SKIPARRAY_FOLD_OK,
+        skiparray_ro_fold(SKIPARRAY_FOLD_LEFT, ro, fold_cb, &env), "%d");
+    ASSERT_EQ_FMT((uint64_t)0, env.next, "%"PRIu64);
+
+    skiparray_close_mapped(ro);
+    PASS();
+}
+
+TEST reject_bad_files(void) {
+    struct skiparray_ro *ro = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_OPEN_MAPPED_ERROR_MISUSE,
+        skiparray_open_mapped(NULL, NULL, &ro), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_OPEN_MAPPED_ERROR_IO,
+        skiparray_open_mapped("/nonexistent/skiparray", NULL, &ro), "%d");
+
+    struct skiparray *sa = make_sa(100, false);
+    ASSERT(sa != NULL);
+    char path[64];
+    ASSERT(dump_to_file(sa, path, sizeof(path)));
+    skiparray_free(sa);
+
+    /* damage the trailer's magic */
+    FILE *f = fopen(path, "r+b");
+    ASSERT(f != NULL);
+    ASSERT_EQ(0, fseek(f, -1, SEEK_END));
+    ASSERT_EQ('P', fgetc(f));
+    ASSERT_EQ(0, fseek(f, -1, SEEK_END));
+    ASSERT_EQ('X', fputc('X', f));
+    ASSERT_EQ(0, fclose(f));
+    ASSERT_EQ_FMT(SKIPARRAY_OPEN_MAPPED_ERROR_FORMAT,
+        skiparray_open_mapped(path, NULL, &ro), "%d");
+
+    /* too short for a header and trailer */
+    f = fopen(path, "wb");
+    ASSERT(f != NULL);
+    ASSERT_EQ(0, fclose(f));
+    ASSERT_EQ_FMT(SKIPARRAY_OPEN_MAPPED_ERROR_FORMAT,
+        skiparray_open_mapped(path, NULL, &ro), "%d");
+
+    unlink(path);
+    PASS();
+}
+
+SUITE(mapped) {
+    RUN_TEST(empty);
+    RUN_TEST(reject_bad_files);
+    RUN_TEST(custom_comparison);
+
+    for (size_t i = 1; i <= 100000; i *= 10) {
+        char buf[32];
+        for (int v = 0; v < 2; v++) {
+            if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu_%s",
+                    i, v ? "keys" : "values")) { assert(false); }
+            greatest_set_test_suffix(buf);
+            RUN_TESTp(get_and_seek, i, v == 1);
+        }
+
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) { assert(false); }
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(iterate_both_ways, i);
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(fold_both_ways, i);
+    }
+}
@@ -0,0 +1,558 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "test_skiparray.h"
+
+#include <unistd.h>
+
+/* In-memory page store, which can be told to fail writes or reads.
+ * With retry_reads set, the on_error hook fixes reads and retries. */
+struct store {
+    uint8_t **pages;
+    size_t *sizes;
+    size_t ceil;
+    size_t live;
+    bool fail_writes;
+    bool fail_reads;
+    bool retry_reads;
+    size_t errors;
+};
+
+static bool
+store_write(const uint8_t *buf, size_t len, uint64_t *page_id, void *udata) {
+    struct store *st = udata;
+    if (st->fail_writes) { return false; }
+
+    size_t id = 0;
+    while (id < st->ceil && st->pages[id] != NULL) { id++; }
+    if (id == st->ceil) {
+        const size_t nceil = (st->ceil == 0 ? 16 : 2 * st->ceil);
+        uint8_t **npages = realloc(st->pages, nceil * sizeof(npages[0]));
+        if (npages == NULL) { return false; }
+        st->pages = npages;
+        size_t *nsizes = realloc(st->sizes, nceil * sizeof(nsizes[0]));
+        if (nsizes == NULL) { return false; }
+        st->sizes = nsizes;
+        for (size_t i = st->ceil; i < nceil; i++) { st->pages[i] = NULL; }
+        st->ceil = nceil;
+    }
+
+    uint8_t *page = malloc(len);
+    if (page == NULL) { return false; }
+    memcpy(page, buf, len);
+    st->pages[id] = page;
+    st->sizes[id] = len;
+    st->live++;
+    *page_id = id;
+    return true;
+}
+
+static bool
+store_read(uint64_t page_id, uint8_t *buf, size_t len, void *udata) {
+    struct store *st = udata;
+    if (st->fail_reads) { return false; }
+    if (page_id >= st->ceil || st->pages[page_id] == NULL
+        || st->sizes[page_id] != len) {
+        return false;
+    }
+    memcpy(buf, st->pages[page_id], len);
+    return true;
+}
+
+static void
+store_release(uint64_t page_id, size_t len, void *udata) {
+    struct store *st = udata;
+    assert(page_id < st->ceil && st->pages[page_id] != NULL);
+    assert(st->sizes[page_id] == len);
+    free(st->pages[page_id]);
+    st->pages[page_id] = NULL;
+    st->live--;
+}
+
+static bool
+store_on_error(enum skiparray_pager_error error, uint64_t page_id,
+    void *udata) {
+    struct store *st = udata;
+    (void)page_id;
+    assert(error == SKIPARRAY_PAGER_ERROR_READ);
+    st->errors++;
+    if (st->retry_reads) { st->fail_reads = false; }
+    return st->retry_reads;
+}
+
+static void
+store_free(struct store *st) {
+    for (size_t i = 0; i < st->ceil; i++) { free(st->pages[i]); }
+    free(st->pages);
+    free(st->sizes);
+}
+
+static struct skiparray_pager *
+make_pager(struct store *st, size_t cache_nodes) {
+    struct skiparray_pager_config pcfg = {
+        .cache_nodes = cache_nodes,
+        .write = store_write,
+        .read = store_read,
+        .release = store_release,
+        .on_error = store_on_error,
+        .store_udata = st,
+        .encode_key = test_skiparray_encode_uintptr,
+        .encode_value = test_skiparray_encode_uintptr,
+        .decode_key = test_skiparray_decode_uintptr,
+        .decode_value = test_skiparray_decode_uintptr,
+    };
+    struct skiparray_pager *pager = NULL;
+    if (SKIPARRAY_PAGER_NEW_OK != skiparray_pager_new(&pcfg, &pager)) {
+        return NULL;
+    }
+    return pager;
+}
+
+TEST reject_bad_config(void) {
+    struct skiparray_pager_config pcfg = {
+        .write = store_write,
+        .read = store_read,
+    };
+    struct skiparray_pager *pager = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_PAGER_NEW_ERROR_NULL,
+        skiparray_pager_new(NULL, &pager), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_PAGER_NEW_ERROR_CONFIG,
+        skiparray_pager_new(&pcfg, &pager), "%d");
+
+    struct store st = { .live = 0 };
+    pager = make_pager(&st, 4);
+    ASSERT(pager != NULL);
+
+    struct skiparray_pool_config pool_cfg = { .node_size = 8 };
+    struct skiparray_pool *pool = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_POOL_NEW_OK,
+        skiparray_pool_new(&pool_cfg, &pool), "%d");
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 8,
+        .pager = pager,
+        .pool = pool,
+    };
+    struct skiparray *a = NULL;
+    struct skiparray *b = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG,
+        skiparray_new(&cfg, &a), "%d");
+
+    /* only one skiparray per pager */
+    cfg.pool = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &a), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG,
+        skiparray_new(&cfg, &b), "%d");
+    skiparray_free(a);
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &b), "%d");
+    skiparray_free(b);
+
+    skiparray_pool_free(pool);
+    skiparray_pager_free(pager);
+    store_free(&st);
+    PASS();
+}
+
+/* Insert, look up, iterate, and remove with far more nodes than the
+ * cache holds, checking against the expected contents throughout. */
+TEST churn(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    const size_t cache_nodes = 8;
+    struct store st = { .live = 0 };
+    struct skiparray_pager *pager = make_pager(&st, cache_nodes);
+    ASSERT(pager != NULL);
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+        .pager = pager,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        const uintptr_t k = (i * 7919) % limit;
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)k, (void *)(k + 1)), "%d");
+    }
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    ASSERT_EQ_FMT(limit, skiparray_count(sa), "%zu");
+
+    struct skiparray_pager_stats ps;
+    skiparray_pager_stats(pager, &ps);
+    ASSERT(ps.resident <= cache_nodes + 4);
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        uintptr_t v = 0;
+        ASSERT(skiparray_get(sa, (void *)i, (void **)&v));
+        ASSERT_EQ_FMT(i + 1, v, "%"PRIuPTR);
+    }
+    ASSERT_FALSE(skiparray_member(sa, (void *)limit));
+
+    struct skiparray_iter *iter = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK, skiparray_iter_new(sa, &iter), "%d");
+    for (uintptr_t i = 0; i < limit; i++) {
+        uintptr_t k = 0;
+        skiparray_iter_get(iter, (void **)&k, NULL);
+        ASSERT_EQ_FMT(i, k, "%"PRIuPTR);
+        (void)skiparray_iter_next(iter);
+    }
+    skiparray_iter_free(iter);
+
+    /* Remove the odd keys, and replace the even ones' values. */
+    for (uintptr_t i = 0; i < limit; i++) {
+        if (i & 1) {
+            ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+                skiparray_forget(sa, (void *)i, NULL), "%d");
+        } else {
+            ASSERT_EQ_FMT(SKIPARRAY_SET_REPLACED,
+                skiparray_set(sa, (void *)i, (void *)(i + 2)), "%d");
+        }
+    }
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    for (uintptr_t i = 0; i < limit; i++) {
+        uintptr_t v = 0;
+        ASSERT_EQ(!(i & 1), skiparray_get(sa, (void *)i, (void **)&v));
+        if (!(i & 1)) { ASSERT_EQ_FMT(i + 2, v, "%"PRIuPTR); }
+    }
+
+    skiparray_pager_stats(pager, &ps);
+    ASSERT(ps.resident <= cache_nodes + 4);
+    if (limit >= 1000) {
+        ASSERT(ps.evictions > 0);
+        ASSERT(ps.faults > 0);
+        ASSERT(ps.writes <= ps.evictions);
+    }
+    ASSERT_EQ_FMT((size_t)0, ps.write_errors, "%zu");
+
+    skiparray_free(sa);
+    ASSERT_EQ_FMT((size_t)0, st.live, "%zu");
+    skiparray_pager_free(pager);
+    store_free(&st);
+    PASS();
+}
+
+/* Keys and values are heap allocated, so evicting must free them and
+ * paging back in must decode new ones (checked under a leak checker). */
+static int
+cmp_boxed(const void *ka, const void *kb, void *udata) {
+    (void)udata;
+    const uintptr_t a = *(const uintptr_t *)ka;
+    const uintptr_t b = *(const uintptr_t *)kb;
+    return (a < b ? -1 : a > b ? 1 : 0);
+}
+
+static void *
+box(uintptr_t x) {
+    uintptr_t *res = malloc(sizeof(*res));
+    if (res != NULL) { *res = x; }
+    return res;
+}
+
+static bool
+encode_boxed(const void *x, uint8_t *buf, size_t buf_size,
+    size_t *len, void *udata) {
+    return test_skiparray_encode_uintptr((void *)*(const uintptr_t *)x,
+        buf, buf_size, len, udata);
+}
+
+static bool
+decode_boxed(const uint8_t *buf, size_t len, void **x, void *udata) {
+    void *v = NULL;
+    if (!test_skiparray_decode_uintptr(buf, len, &v, udata)) { return false; }
+    *x = box((uintptr_t)v);
+    return *x != NULL;
+}
+
+static void
+free_boxed(void *key, void *value, void *udata) {
+    size_t *freed = udata;
+    free(key);
+    free(value);
+    (*freed)++;
+}
+
+TEST owned_pairs(size_t limit) {
+    struct store st = { .live = 0 };
+    struct skiparray_pager_config pcfg = {
+        .cache_nodes = 4,
+        .write = store_write,
+        .read = store_read,
+        .release = store_release,
+        .store_udata = &st,
+        .encode_key = encode_boxed,
+        .encode_value = encode_boxed,
+        .decode_key = decode_boxed,
+        .decode_value = decode_boxed,
+    };
+    struct skiparray_pager *pager = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_PAGER_NEW_OK,
+        skiparray_pager_new(&pcfg, &pager), "%d");
+
+    size_t freed = 0;
+    struct skiparray_config cfg = {
+        .cmp = cmp_boxed,
+        .free = free_boxed,
+        .udata = &freed,
+        .node_size = 8,
+        .pager = pager,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, box(i), box(10 * i)), "%d");
+    }
+    for (uintptr_t i = 0; i < limit; i += 3) {
+        uintptr_t key = i;
+        void *v = NULL;
+        ASSERT(skiparray_get(sa, &key, &v));
+        ASSERT_EQ_FMT(10 * i, *(uintptr_t *)v, "%"PRIuPTR);
+    }
+
+    /* pop from both ends, taking ownership */
+    for (size_t i = 0; i < limit / 4; i++) {
+        void *k = NULL;
+        void *v = NULL;
+        ASSERT_EQ_FMT(SKIPARRAY_POP_OK, skiparray_pop_first(sa, &k, &v), "%d");
+        ASSERT_EQ_FMT((uintptr_t)i, *(uintptr_t *)k, "%"PRIuPTR);
+        free(k);
+        free(v);
+        ASSERT_EQ_FMT(SKIPARRAY_POP_OK, skiparray_pop_last(sa, &k, &v), "%d");
+        ASSERT_EQ_FMT((uintptr_t)(limit - 1 - i), *(uintptr_t *)k, "%"PRIuPTR);
+        free(k);
+        free(v);
+    }
+
+    struct skiparray_pager_stats ps;
+    skiparray_pager_stats(pager, &ps);
+    if (limit >= 1000) { ASSERT(ps.evictions > 0); }
+
+    skiparray_free(sa);
+    ASSERT(freed > 0);
+    ASSERT_EQ_FMT((size_t)0, st.live, "%zu");
+    skiparray_pager_free(pager);
+    store_free(&st);
+    PASS();
+}
+
+/* If pages can't be written, nodes just stay in memory. */
+TEST write_failure_keeps_nodes(void) {
+    struct store st = { .fail_writes = true };
+    struct skiparray_pager *pager = make_pager(&st, 2);
+    ASSERT(pager != NULL);
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 8,
+        .pager = pager,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    for (uintptr_t i = 0; i < 1000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+
+    struct skiparray_pager_stats ps;
+    skiparray_pager_stats(pager, &ps);
+    ASSERT(ps.write_errors > 0);
+    ASSERT_EQ_FMT((size_t)0, ps.evictions, "%zu");
+
+    /* once writes work again, the cache shrinks back down */
+    st.fail_writes = false;
+    for (uintptr_t i = 0; i < 1000; i++) {
+        uintptr_t v = 0;
+        ASSERT(skiparray_get(sa, (void *)i, (void **)&v));
+        ASSERT_EQ_FMT(i, v, "%"PRIuPTR);
+    }
+    skiparray_pager_stats(pager, &ps);
+    ASSERT(ps.resident <= 2 + 4);
+
+    skiparray_free(sa);
+    skiparray_pager_free(pager);
+    store_free(&st);
+    PASS();
+}
+
+static void
+sum_fold_cb(void *key, void *value, void *udata) {
+    (void)value;
+    *(uintptr_t *)udata += (uintptr_t)key;
+}
+
+/* If pages can't be read, operations that need them report
+ * ERROR_PAGE and leave the skiparray as it was. */
+TEST read_failure_reports_error(void) {
+    const int verbosity = greatest_get_verbosity();
+    const uintptr_t limit = 1000;
+    struct store st = { .live = 0 };
+    struct skiparray_pager *pager = make_pager(&st, 2);
+    ASSERT(pager != NULL);
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 8,
+        .pager = pager,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    uintptr_t expected[1000];
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+        expected[i] = i;
+    }
+
+    st.fail_reads = true;
+    size_t failed = 0;
+    for (uintptr_t i = 0; i < limit; i++) {
+        const enum skiparray_set_res res = skiparray_set(sa, (void *)i,
+            (void *)(i + limit));
+        if (res == SKIPARRAY_SET_ERROR_PAGE) {
+            failed++;
+        } else {
+            ASSERT_EQ_FMT(SKIPARRAY_SET_REPLACED, res, "%d");
+            expected[i] = i + limit;
+        }
+    }
+    ASSERT(failed > 0);
+
+    failed = 0;
+    size_t count = limit;
+    for (uintptr_t i = 1; i < limit; i += 2) {
+        const enum skiparray_forget_res res = skiparray_forget(sa,
+            (void *)i, NULL);
+        if (res == SKIPARRAY_FORGET_ERROR_PAGE) {
+            failed++;
+        } else {
+            ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK, res, "%d");
+            expected[i] = UINTPTR_MAX;
+            count--;
+        }
+    }
+    ASSERT(failed > 0);
+    ASSERT_EQ_FMT(count, skiparray_count(sa), "%zu");
+
+    uintptr_t sum = 0;
+    ASSERT_EQ_FMT(SKIPARRAY_FOLD_ERROR_PAGE,
+        skiparray_fold(SKIPARRAY_FOLD_LEFT, sa, sum_fold_cb, &sum), "%d");
+
+    struct skiparray_pager_stats ps;
+    skiparray_pager_stats(pager, &ps);
+    ASSERT(ps.read_errors > 0);
+    ASSERT_EQ_FMT(ps.read_errors, st.errors, "%zu");
+
+    /* once reads work again, nothing was lost */
+    st.fail_reads = false;
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    for (uintptr_t i = 0; i < limit; i++) {
+        uintptr_t v = 0;
+        const bool found = skiparray_get(sa, (void *)i, (void **)&v);
+        ASSERT_EQ_FMT(expected[i] != UINTPTR_MAX, found, "%d");
+        if (found) { ASSERT_EQ_FMT(expected[i], v, "%"PRIuPTR); }
+    }
+
+    /* with retries, failed reads are transparent */
+    st.fail_reads = true;
+    st.retry_reads = true;
+    st.errors = 0;
+    sum = 0;
+    ASSERT_EQ_FMT(SKIPARRAY_FOLD_OK,
+        skiparray_fold(SKIPARRAY_FOLD_LEFT, sa, sum_fold_cb, &sum), "%d");
+    ASSERT_EQ_FMT((size_t)1, st.errors, "%zu");
+    uintptr_t expected_sum = 0;
+    for (uintptr_t i = 0; i < limit; i++) {
+        if (expected[i] != UINTPTR_MAX) { expected_sum += i; }
+    }
+    ASSERT_EQ_FMT(expected_sum, sum, "%"PRIuPTR);
+
+    skiparray_free(sa);
+    skiparray_pager_free(pager);
+    store_free(&st);
+    PASS();
+}
+
+/* Build, compact, and dump a paged skiparray backed by a page file. */
+TEST page_file(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    char path[64];
+    if (sizeof(path) < (size_t)snprintf(path, sizeof(path),
+            "/tmp/test_skiparray_pager.XXXXXX")) { FAIL(); }
+    int fd = mkstemp(path);
+    ASSERT(fd != -1);
+    close(fd);
+
+    struct skiparray_page_file *pf = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_PAGE_FILE_OPEN_OK,
+        skiparray_page_file_open(path, &pf), "%d");
+    unlink(path);
+
+    struct skiparray_pager_config pcfg = {
+        .cache_nodes = 16,
+        .write = skiparray_page_file_write,
+        .read = skiparray_page_file_read,
+        .release = skiparray_page_file_release,
+        .store_udata = pf,
+        .encode_key = test_skiparray_encode_uintptr,
+        .decode_key = test_skiparray_decode_uintptr,
+    };
+    struct skiparray_pager *pager = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_PAGER_NEW_OK,
+        skiparray_pager_new(&pcfg, &pager), "%d");
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 32,
+        .ignore_values = true,
+        .pager = pager,
+    };
+    struct skiparray_builder *b = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_BUILDER_NEW_OK,
+        skiparray_builder_new(&cfg, false, &b), "%d");
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_BUILDER_APPEND_OK,
+            skiparray_builder_append(b, (void *)(2 * i), NULL), "%d");
+    }
+    struct skiparray *sa = NULL;
+    skiparray_builder_finish(&b, &sa);
+
+    for (uintptr_t i = 0; i < limit; i += 2) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)(2 * i), NULL), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_COMPACT_DONE, skiparray_compact(sa, 1.0), "%d");
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+
+    struct skiparray_pager_stats ps;
+    skiparray_pager_stats(pager, &ps);
+    ASSERT(ps.resident <= 16 + 4);
+
+    for (uintptr_t i = 0; i < 2 * limit; i++) {
+        ASSERT_EQ_FMT(i % 4 == 2, skiparray_member(sa, (void *)i), "%d");
+    }
+
+    skiparray_free(sa);
+    skiparray_pager_free(pager);
+    skiparray_page_file_close(pf);
+    PASS();
+}
+
+SUITE(pager) {
+    RUN_TEST(reject_bad_config);
+    RUN_TEST(write_failure_keeps_nodes);
+    RUN_TEST(read_failure_reports_error);
+
+    for (size_t i = 10; i <= 100000; i *= 10) {
+        char buf[8];
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) { assert(false); }
+
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(churn, i);
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(owned_pairs, i);
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(page_file, i);
+    }
+}
@@ -0,0 +1,165 @@
+#include "test_skiparray.h"
+
+static struct skiparray_pool *
+make_pool(uint16_t node_size, size_t high, size_t low) {
+    struct skiparray_pool_config pcfg = {
+        .node_size = node_size,
+        .high_watermark = high,
+        .low_watermark = low,
+    };
+    struct skiparray_pool *pool = NULL;
+    if (SKIPARRAY_POOL_NEW_OK != skiparray_pool_new(&pcfg, &pool)) {
+        return NULL;
+    }
+    return pool;
+}
+
+TEST reject_mismatched_config(void) {
+    struct skiparray_pool_config pcfg = {
+        .high_watermark = 1,
+        .low_watermark = 2,
+    };
+    struct skiparray_pool *pool = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_POOL_NEW_ERROR_NULL,
+        skiparray_pool_new(NULL, &pool), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_POOL_NEW_ERROR_CONFIG,
+        skiparray_pool_new(&pcfg, &pool), "%d");
+
+    pool = make_pool(8, 0, 0);
+    ASSERT(pool != NULL);
+
+    struct skiparray *sa = NULL;
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+        .pool = pool,
+    };
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG,
+        skiparray_new(&cfg, &sa), "%d");
+
+    cfg.node_size = 8;
+    cfg.ignore_values = true;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG,
+        skiparray_new(&cfg, &sa), "%d");
+
+    cfg.ignore_values = false;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    skiparray_free(sa);
+
+    skiparray_pool_free(pool);
+    PASS();
+}
+
+/* Interleave inserts and deletes across two skiparrays that share a
+ * pool, so blocks freed by one are reused by the other. */
+TEST shared_pool_churn(size_t limit) {
+    const int verbosity = greatest_get_verbosity();
+    struct skiparray_pool *pool = make_pool(8, 1000, 4);
+    ASSERT(pool != NULL);
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 8,
+        .pool = pool,
+    };
+    struct skiparray *a = NULL;
+    struct skiparray *b = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &a), "%d");
+    cfg.seed = 1;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &b), "%d");
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(a, (void *)i, (void *)i), "%d");
+    }
+    ASSERT(test_skiparray_invariants(a, verbosity - 1));
+
+    struct skiparray_pool_stats st;
+    skiparray_pool_stats(pool, &st);
+    const size_t misses_after_fill = st.misses;
+
+    /* Move everything from a to b. */
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(a, (void *)i, NULL), "%d");
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(b, (void *)i, (void *)(i + 1)), "%d");
+    }
+    ASSERT(test_skiparray_invariants(a, verbosity - 1));
+    ASSERT(test_skiparray_invariants(b, verbosity - 1));
+    ASSERT_EQ_FMT((size_t)0, skiparray_count(a), "%zu");
+    ASSERT_EQ_FMT((size_t)limit, skiparray_count(b), "%zu");
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        uintptr_t v = 0;
+        ASSERT(skiparray_get(b, (void *)i, (void **)&v));
+        ASSERT_EQ_FMT(i + 1, v, "%"PRIuPTR);
+    }
+
+    /* Most of b's nodes should have come from blocks a released. */
+    skiparray_pool_stats(pool, &st);
+    ASSERT(st.hits > 0);
+    ASSERT(st.misses < 2 * misses_after_fill);
+    ASSERT(st.cached <= 1000);
+
+    skiparray_free(a);
+    skiparray_free(b);
+
+    skiparray_pool_stats(pool, &st);
+    ASSERT_EQ_FMT((size_t)0, st.in_use, "%zu");
+    ASSERT_EQ_FMT(st.misses, st.cached + st.frees, "%zu");
+
+    skiparray_pool_trim(pool);
+    skiparray_pool_stats(pool, &st);
+    ASSERT(st.cached <= 4);
+
+    skiparray_pool_free(pool);
+    PASS();
+}
+
+TEST high_watermark_bounds_cache(void) {
+    struct skiparray_pool *pool = make_pool(4, 2, 0);
+    ASSERT(pool != NULL);
+
+    ASSERT(skiparray_pool_reserve(pool, 10));
+    struct skiparray_pool_stats st;
+    skiparray_pool_stats(pool, &st);
+    ASSERT_EQ_FMT((size_t)2, st.cached, "%zu");
+
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 4,
+        .pool = pool,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    for (uintptr_t i = 0; i < 100; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    skiparray_free(sa);
+
+    skiparray_pool_stats(pool, &st);
+    ASSERT_EQ_FMT((size_t)2, st.cached, "%zu");
+    ASSERT_EQ_FMT((size_t)0, st.in_use, "%zu");
+
+    skiparray_pool_trim(pool);
+    skiparray_pool_stats(pool, &st);
+    ASSERT_EQ_FMT((size_t)0, st.cached, "%zu");
+
+    skiparray_pool_free(pool);
+    PASS();
+}
+
+SUITE(pool) {
+    RUN_TEST(reject_mismatched_config);
+    RUN_TEST(high_watermark_bounds_cache);
+
+    for (size_t i = 10; i <= 10000; i *= 10) {
+        char buf[8];
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) { assert(false); }
+
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(shared_pool_churn, i);
+    }
+}
@@ -0,0 +1,257 @@
+#include "test_skiparray.h"
+#include "skiparray_serialize_internal.h"
+
+/* In-memory stream for dump and load. The shared stream comes first,
+ * so a stream can be passed to the shared stream callbacks. */
+struct stream {
+    struct test_skiparray_stream s;
+
+    /* for decode failure tests */
+    size_t decoded;
+    size_t fail_decode_at;
+};
+
+/* Encode integers as a varying number of bytes, to exercise the
+ * retry when the encoding buffer is too small. */
+static bool
+encode_uintptr(const void *x, uint8_t *buf, size_t buf_size,
+    size_t *len, void *udata) {
+    (void)udata;
+    uintptr_t v = (uintptr_t)x;
+    /* padding to vary the size, occasionally past the buffer size */
+    size_t need = (v % 97 == 0 ? 5000 : v % 8);
+    *len = need + sizeof(v);
+    if (*len > buf_size) { return true; }
+    memset(buf, 0xAA, need);
+    memcpy(&buf[need], &v, sizeof(v));
+    return true;
+}
+
+static bool
+decode_uintptr(const uint8_t *buf, size_t len, void **x, void *udata) {
+    struct stream *s = udata;
+    uintptr_t v;
+    if (len < sizeof(v)) { return false; }
+    if (s->fail_decode_at != 0 && s->decoded == s->fail_decode_at) {
+        return false;
+    }
+    s->decoded++;
+    memcpy(&v, &buf[len - sizeof(v)], sizeof(v));
+    *x = (void *)v;
+    return true;
+}
+
+static struct skiparray_config config = {
+    .cmp = test_skiparray_cmp_intptr_t,
+    .node_size = 16,
+};
+
+static struct skiparray *
+make_sa(size_t limit, bool ignore_values) {
+    struct skiparray_config cfg = config;
+    cfg.ignore_values = ignore_values;
+    return test_skiparray_make_sa(&cfg, limit);
+}
+
+static enum skiparray_dump_res
+dump(const struct skiparray *sa, struct stream *s, bool checksum) {
+    struct skiparray_dump_config dcfg = {
+        .write = test_skiparray_stream_write,
+        .encode_key = encode_uintptr,
+        .encode_value = encode_uintptr,
+        .checksum = checksum,
+        .udata = s,
+    };
+    return skiparray_dump(sa, &dcfg);
+}
+
+static enum skiparray_load_res
+load(const struct skiparray_config *cfg, struct stream *s,
+    bool balanced, struct skiparray **sa) {
+    struct skiparray_load_config lcfg = {
+        .read = test_skiparray_stream_read,
+        .decode_key = decode_uintptr,
+        .decode_value = decode_uintptr,
+        .balanced = balanced,
+        .udata = s,
+    };
+    test_skiparray_stream_rewind(&s->s);
+    return skiparray_load(cfg, &lcfg, sa);
+}
+
+TEST crc32_check_value(void) {
+    const char *check = "123456789";
+    ASSERT_EQ_FMT(0xCBF43926U,
+        skiparray_crc32(0, (const uint8_t *)check, strlen(check)), "0x%08x");
+    /* incremental */
+    uint32_t crc = skiparray_crc32(0, (const uint8_t *)check, 4);
+    crc = skiparray_crc32(crc, (const uint8_t *)&check[4], 5);
+    ASSERT_EQ_FMT(0xCBF43926U, crc, "0x%08x");
+    PASS();
+}
+
+TEST roundtrip(size_t limit, bool checksum, bool balanced) {
+    const int verbosity = greatest_get_verbosity();
+    struct skiparray *sa = make_sa(limit, false);
+    ASSERT(sa != NULL);
+
+    struct stream s = { .decoded = 0 };
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK, dump(sa, &s, checksum), "%d");
+    skiparray_free(sa);
+
+    struct skiparray *loaded = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK, load(&config, &s, balanced, &loaded), "%d");
+    ASSERT_EQ_FMT(s.s.used, s.s.pos, "%zu");
+    ASSERT(test_skiparray_invariants(loaded, verbosity - 1));
+    ASSERT_EQ_FMT(limit, skiparray_count(loaded), "%zu");
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        uintptr_t v = 0;
+        ASSERT(skiparray_get(loaded, (void *)(3 * i), (void **)&v));
+        ASSERT_EQ_FMT(i + 1, v, "%"PRIuPTR);
+        ASSERT(!skiparray_member(loaded, (void *)(3 * i + 1)));
+    }
+
+    /* The loaded skiparray can be modified as usual. */
+    ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+        skiparray_set(loaded, (void *)1, NULL), "%d");
+    ASSERT(test_skiparray_invariants(loaded, verbosity - 1));
+
+    skiparray_free(loaded);
+    test_skiparray_stream_free(&s.s);
+    PASS();
+}
+
+TEST values_present_or_ignored(void) {
+    struct stream s = { .decoded = 0 };
+
+    /* no values in the stream: loaded values are NULL */
+    struct skiparray *sa = make_sa(100, true);
+    ASSERT(sa != NULL);
+    struct skiparray_dump_config dcfg = {
+        .write = test_skiparray_stream_write,
+        .encode_key = encode_uintptr,
+        .udata = &s,
+    };
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK, skiparray_dump(sa, &dcfg), "%d");
+    skiparray_free(sa);
+
+    struct skiparray *loaded = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK, load(&config, &s, false, &loaded), "%d");
+    void *v = (void *)1;
+    ASSERT(skiparray_get(loaded, (void *)(3 * 99), &v));
+    ASSERT_EQ(NULL, v);
+    skiparray_free(loaded);
+
+    /* values in the stream, but ignored: skipped without decoding */
+    s.s.used = 0;
+    sa = make_sa(100, false);
+    ASSERT(sa != NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK, dump(sa, &s, true), "%d");
+    skiparray_free(sa);
+
+    struct skiparray_config cfg = config;
+    cfg.ignore_values = true;
+    s.decoded = 0;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK, load(&cfg, &s, false, &loaded), "%d");
+    ASSERT_EQ_FMT((size_t)100, s.decoded, "%zu");
+    ASSERT_EQ_FMT((size_t)100, skiparray_count(loaded), "%zu");
+    skiparray_free(loaded);
+
+    test_skiparray_stream_free(&s.s);
+    PASS();
+}
+
+TEST reject_damaged_input(void) {
+    struct skiparray *sa = make_sa(1000, false);
+    ASSERT(sa != NULL);
+    struct stream s = { .decoded = 0 };
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK, dump(sa, &s, true), "%d");
+    skiparray_free(sa);
+
+    struct skiparray *loaded = NULL;
+
+    /* flipped bit in a block */
+    s.s.buf[s.s.used / 2] ^= 0x10;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_CHECKSUM,
+        load(&config, &s, false, &loaded), "%d");
+    s.s.buf[s.s.used / 2] ^= 0x10;
+
+    /* truncated */
+    const size_t used = s.s.used;
+    s.s.used = used - 1;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_READ,
+        load(&config, &s, false, &loaded), "%d");
+    s.s.used = used;
+
+    /* bad magic */
+    s.s.buf[0] = 'X';
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_FORMAT,
+        load(&config, &s, false, &loaded), "%d");
+    s.s.buf[0] = FORMAT_MAGIC[0];
+
+    /* unknown version */
+    s.s.buf[8]++;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_FORMAT,
+        load(&config, &s, false, &loaded), "%d");
+    s.s.buf[8]--;
+
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK, load(&config, &s, false, &loaded), "%d");
+    skiparray_free(loaded);
+    test_skiparray_stream_free(&s.s);
+    PASS();
+}
+
+static size_t freed;
+
+static void
+count_free(void *key, void *value, void *udata) {
+    (void)key;
+    (void)value;
+    (void)udata;
+    freed++;
+}
+
+TEST decode_failure_frees_pairs(void) {
+    struct skiparray *sa = make_sa(1000, false);
+    ASSERT(sa != NULL);
+    struct stream s = { .decoded = 0 };
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK, dump(sa, &s, false), "%d");
+    skiparray_free(sa);
+
+    /* Fail decoding the value of the 501st pair: 500 pairs have been
+     * appended, and the 501st key was decoded. */
+    struct skiparray_config cfg = config;
+    cfg.free = count_free;
+    s.decoded = 0;
+    s.fail_decode_at = 1001;
+    freed = 0;
+    struct skiparray *loaded = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_ERROR_DECODE,
+        load(&cfg, &s, false, &loaded), "%d");
+    ASSERT_EQ_FMT((size_t)501, freed, "%zu");
+
+    test_skiparray_stream_free(&s.s);
+    PASS();
+}
+
+SUITE(serialize) {
+    RUN_TEST(crc32_check_value);
+    RUN_TEST(values_present_or_ignored);
+    RUN_TEST(reject_damaged_input);
+    RUN_TEST(decode_failure_frees_pairs);
+
+    for (size_t i = 1; i <= 100000; i *= 10) {
+        char buf[32];
+        for (int cs = 0; cs < 2; cs++) {
+            for (int bal = 0; bal < 2; bal++) {
+                if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu%s%s",
+                        i, cs ? "_crc" : "", bal ? "_balanced" : "")) {
+                    assert(false);
+                }
+                greatest_set_test_suffix(buf);
+                RUN_TESTp(roundtrip, i, cs, bal);
+            }
+        }
+    }
+}
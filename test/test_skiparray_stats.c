@@ -0,0 +1,310 @@
+#include "test_skiparray.h"
+
+static size_t
+sum(const size_t *counts, size_t length) {
+    size_t res = 0;
+    for (size_t i = 0; i < length; i++) { res += counts[i]; }
+    return res;
+}
+
+static bool
+consistent(const struct skiparray *sa, struct skiparray_stats *st) {
+    skiparray_stats(sa, st);
+    if (st->pairs != skiparray_count(sa)) { return false; }
+    if (sum(st->fill, SKIPARRAY_STATS_FILL_BUCKETS) != st->nodes
+        || sum(st->heights, SKIPARRAY_MAX_MAX_LEVEL) != st->nodes
+        || st->level_nodes[0] != st->nodes) {
+        return false;
+    }
+    for (size_t i = 1; i < SKIPARRAY_MAX_MAX_LEVEL; i++) {
+        if (st->level_nodes[i] > st->level_nodes[i - 1]) {
+            return false;
+        }
+        if (i >= st->height && st->level_nodes[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST empty(void) {
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .ignore_values = true,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    struct skiparray_stats st;
+    ASSERT(consistent(sa, &st));
+    ASSERT_EQ_FMT((size_t)1, st.nodes, "%zu");
+    ASSERT_EQ_FMT((size_t)0, st.pairs, "%zu");
+    ASSERT_EQ_FMT((size_t)1, st.fill[0], "%zu");
+    ASSERT(st.header_bytes > 0);
+    ASSERT(st.key_bytes > 0);
+    ASSERT_EQ_FMT((size_t)0, st.value_bytes, "%zu");
+    for (size_t i = 0; i < SKIPARRAY_MAX_MAX_LEVEL; i++) {
+        ASSERT_EQ_FMT(0.0, st.avg_hops[i], "%g");
+    }
+
+    skiparray_free(sa);
+    PASS();
+}
+
+/* The bytes reported account for everything the nodes allocate, so
+ * they only differ from the live total by the skiparray itself. */
+TEST bytes_match_allocations(size_t limit) {
+    struct test_skiparray_memory mem = { .live = 0 };
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 32,
+        .memory = test_skiparray_counting_memory,
+        .udata = &mem,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    struct skiparray_stats st;
+    ASSERT(consistent(sa, &st));
+    const size_t overhead = mem.live
+        - (st.header_bytes + st.key_bytes + st.value_bytes);
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        const uintptr_t key = (i * 7919) % limit;
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)key, (void *)i), "%d");
+    }
+    for (uintptr_t i = 0; i < limit; i += 3) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)i, NULL), "%d");
+    }
+
+    ASSERT(consistent(sa, &st));
+    ASSERT_EQ_FMT(overhead,
+        mem.live - (st.header_bytes + st.key_bytes + st.value_bytes), "%zu");
+    ASSERT_EQ_FMT(st.key_bytes, st.value_bytes, "%zu");
+
+    skiparray_free(sa);
+    PASS();
+}
+
+/* Pooled nodes are counted by their blocks. */
+TEST pooled(void) {
+    struct skiparray_pool_config pcfg = { .node_size = 16 };
+    struct skiparray_pool *pool = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_POOL_NEW_OK,
+        skiparray_pool_new(&pcfg, &pool), "%d");
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+        .pool = pool,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+    for (uintptr_t i = 0; i < 1000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+
+    struct skiparray_stats st;
+    struct skiparray_pool_stats pst;
+    ASSERT(consistent(sa, &st));
+    skiparray_pool_stats(pool, &pst);
+    ASSERT_EQ_FMT(pst.in_use, st.nodes, "%zu");
+    ASSERT_EQ_FMT(pst.in_use * pst.block_size,
+        st.header_bytes + st.key_bytes + st.value_bytes, "%zu");
+
+    skiparray_free(sa);
+    skiparray_pool_free(pool);
+    PASS();
+}
+
+/* A balanced skiparray has full nodes, and exactly one node on each
+ * level between consecutive nodes on the level above, so paths pass
+ * at most one node per level below the top. */
+TEST balanced(size_t limit) {
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 8,
+    };
+    struct skiparray_builder *b = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_BUILDER_NEW_OK,
+        skiparray_builder_new_balanced(&cfg, false, &b), "%d");
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_BUILDER_APPEND_OK,
+            skiparray_builder_append(b, (void *)i, (void *)i), "%d");
+    }
+    struct skiparray *sa = NULL;
+    skiparray_builder_finish(&b, &sa);
+
+    struct skiparray_stats st;
+    ASSERT(consistent(sa, &st));
+    ASSERT_EQ_FMT((limit + cfg.node_size - 1) / cfg.node_size,
+        st.nodes, "%zu");
+    ASSERT_EQ_FMT(limit / cfg.node_size,
+        st.fill[SKIPARRAY_STATS_FILL_BUCKETS - 1], "%zu");
+    for (size_t i = 0; i + 1 < st.height; i++) {
+        if (st.avg_hops[i] > 1.0) {
+            FAILm("more than one hop per level");
+        }
+    }
+    if (st.nodes > 1) {
+        ASSERT(st.avg_hops[0] > 0.0);
+    }
+
+    skiparray_free(sa);
+    PASS();
+}
+
+static int
+counting_cmp(const void *a, const void *b, void *udata) {
+    size_t *calls = udata;
+    (*calls)++;
+    return test_skiparray_cmp_intptr_t(a, b, NULL);
+}
+
+/* With SKIPARRAY_COUNTERS, the counters see every comparison and
+ * structural change; without it, they stay zero. */
+TEST counters(size_t limit) {
+    size_t calls = 0;
+    struct skiparray_config cfg = {
+        .cmp = counting_cmp,
+        .node_size = 8,
+        .udata = &calls,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    for (uintptr_t i = 0; i < limit; i++) {
+        const uintptr_t key = (i * 7919) % limit;
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)key, (void *)i), "%d");
+    }
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)i, NULL), "%d");
+    }
+
+    struct skiparray_counters c;
+    if (!skiparray_counters(sa, &c)) {
+        const struct skiparray_counters zero = { .cmp_calls = 0 };
+        ASSERT_MEM_EQ(&zero, &c, sizeof(c));
+        skiparray_free(sa);
+        PASS();
+    }
+
+    ASSERT_EQ_FMT((uint64_t)calls, c.cmp_calls, "%" PRIu64);
+    ASSERT_EQ_FMT((uint64_t)2 * limit, c.searches, "%" PRIu64);
+    uint64_t hist = 0;
+    uint64_t visits = 0;
+    for (size_t i = 0; i < SKIPARRAY_COUNTERS_HIST_BUCKETS; i++) {
+        hist += c.search_cmp_hist[i];
+    }
+    for (size_t i = 0; i < SKIPARRAY_MAX_MAX_LEVEL; i++) {
+        visits += c.search_visits[i];
+    }
+    ASSERT_EQ_FMT(c.searches, hist, "%" PRIu64);
+    ASSERT(visits <= c.cmp_calls);
+    ASSERT(c.search_visits[0] >= c.searches - 1); /* but the first */
+    if (limit > cfg.node_size) {
+        ASSERT(c.splits > 0);
+        ASSERT(c.merges > 0);
+        ASSERT_EQ_FMT(c.splits, c.unlinks, "%" PRIu64);
+        ASSERT(c.moved_bytes > 0);
+    }
+
+    skiparray_counters_reset(sa);
+    ASSERT(skiparray_counters(sa, &c));
+    ASSERT_EQ_FMT((uint64_t)0, c.cmp_calls, "%" PRIu64);
+
+    skiparray_free(sa);
+    PASS();
+}
+
+struct trace_log {
+    size_t counts[SKIPARRAY_TRACE_UNLOCK + 1];
+    bool ordered;
+};
+
+static void
+trace_cb(const struct skiparray_trace_event *event, void *udata) {
+    struct trace_log *log = udata;
+    log->counts[event->type]++;
+    if (event->start_ns > event->end_ns) { log->ordered = false; }
+}
+
+/* With SKIPARRAY_TRACE, structural changes and iterator locking are
+ * reported as they happen; without it, nothing is. */
+TEST trace_events(void) {
+    struct trace_log log = { .ordered = true };
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 4,
+        .trace = trace_cb,
+        .udata = &log,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    for (uintptr_t i = 0; i < 1000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    struct skiparray_iter *a = NULL;
+    struct skiparray_iter *b = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK, skiparray_iter_new(sa, &a), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK, skiparray_iter_new(sa, &b), "%d");
+    skiparray_iter_free(a);
+    skiparray_iter_free(b);
+    for (uintptr_t i = 0; i < 1000; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)i, NULL), "%d");
+    }
+
+#ifdef SKIPARRAY_TRACE
+    /* with both, the counters and the trace agree */
+    struct skiparray_counters c;
+    if (skiparray_counters(sa, &c)) {
+        ASSERT_EQ_FMT((size_t)c.splits,
+            log.counts[SKIPARRAY_TRACE_SPLIT], "%zu");
+        ASSERT_EQ_FMT((size_t)c.merges,
+            log.counts[SKIPARRAY_TRACE_MERGE], "%zu");
+        ASSERT_EQ_FMT((size_t)c.unlinks,
+            log.counts[SKIPARRAY_TRACE_UNLINK], "%zu");
+    }
+
+    ASSERT(log.counts[SKIPARRAY_TRACE_SPLIT] > 0);
+    ASSERT_EQ_FMT(log.counts[SKIPARRAY_TRACE_SPLIT],
+        log.counts[SKIPARRAY_TRACE_UNLINK], "%zu");
+    ASSERT(log.counts[SKIPARRAY_TRACE_HEIGHT] >= 2);
+    ASSERT_EQ_FMT((size_t)1, log.counts[SKIPARRAY_TRACE_LOCK], "%zu");
+    ASSERT_EQ_FMT((size_t)1, log.counts[SKIPARRAY_TRACE_UNLOCK], "%zu");
+    ASSERT(log.ordered);
+#else
+    for (size_t i = 0; i <= SKIPARRAY_TRACE_UNLOCK; i++) {
+        ASSERT_EQ_FMT((size_t)0, log.counts[i], "%zu");
+    }
+#endif
+
+    skiparray_free(sa);
+    PASS();
+}
+
+SUITE(stats) {
+    RUN_TEST(empty);
+    RUN_TEST(pooled);
+    RUN_TEST(trace_events);
+
+    for (size_t i = 10; i <= 100000; i *= 10) {
+        char buf[32];
+        if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu", i)) {
+            assert(false);
+        }
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(bytes_match_allocations, i);
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(balanced, i);
+        greatest_set_test_suffix(buf);
+        RUN_TESTp(counters, i);
+    }
+}
@@ -0,0 +1,637 @@
+#include "test_skiparray.h"
+
+/* In-memory log, which can be told to fail writes or syncs. The
+ * stream comes first, so a log can be passed to the stream callbacks. */
+struct log {
+    struct test_skiparray_stream s;
+    bool fail_syncs;
+    size_t syncs;
+};
+
+static bool
+log_sync(void *udata) {
+    struct log *l = udata;
+    if (l->fail_syncs) { return false; }
+    l->syncs++;
+    return true;
+}
+
+static struct skiparray_wal *
+make_wal(struct log *l, enum skiparray_wal_sync sync_policy,
+    size_t group_bytes) {
+    struct skiparray_wal_config wcfg = {
+        .write = test_skiparray_stream_write,
+        .sync = log_sync,
+        .log_udata = l,
+        .sync_policy = sync_policy,
+        .group_bytes = group_bytes,
+        .encode_key = test_skiparray_encode_uintptr,
+        .encode_value = test_skiparray_encode_uintptr,
+    };
+    struct skiparray_wal *wal = NULL;
+    if (SKIPARRAY_WAL_NEW_OK != skiparray_wal_new(&wcfg, &wal)) {
+        return NULL;
+    }
+    return wal;
+}
+
+static struct skiparray *
+make_sa(struct skiparray_wal *wal) {
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+        .wal = wal,
+    };
+    struct skiparray *sa = NULL;
+    if (SKIPARRAY_NEW_OK != skiparray_new(&cfg, &sa)) { return NULL; }
+    return sa;
+}
+
+static enum skiparray_replay_res
+replay(struct skiparray *sa, struct log *l, size_t from, size_t to) {
+    struct skiparray_replay_config rcfg = {
+        .read = test_skiparray_stream_read,
+        .decode_key = test_skiparray_decode_uintptr,
+        .decode_value = test_skiparray_decode_uintptr,
+        .udata = l,
+    };
+    l->s.pos = from;
+    l->s.end = to;
+    return skiparray_replay(sa, &rcfg);
+}
+
+/* Do COUNT pseudo-random sets, replacements, forgets, and pops. */
+static bool
+churn(struct skiparray *sa, uint64_t *state, size_t count, size_t limit) {
+    for (size_t i = 0; i < count; i++) {
+        *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t r = *state >> 33;
+        const uintptr_t key = (uintptr_t)((r >> 4) % limit);
+        switch (r % 8) {
+        default:
+            if (skiparray_set(sa, (void *)key, (void *)(uintptr_t)r) < 0) {
+                return false;
+            }
+            break;
+        case 5:
+        case 6:
+            if (skiparray_forget(sa, (void *)key, NULL) < 0) { return false; }
+            break;
+        case 7:
+            if (((r >> 3) & 1 ? skiparray_pop_first(sa, NULL, NULL)
+                    : skiparray_pop_last(sa, NULL, NULL)) < 0) {
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+static bool
+same_contents(struct skiparray *a, struct skiparray *b) {
+    if (skiparray_count(a) != skiparray_count(b)) { return false; }
+    struct skiparray_iter *ia = NULL;
+    struct skiparray_iter *ib = NULL;
+    if (skiparray_iter_new(a, &ia) != SKIPARRAY_ITER_NEW_OK
+        || skiparray_iter_new(b, &ib) != SKIPARRAY_ITER_NEW_OK) {
+        skiparray_iter_free(ia);
+        return skiparray_count(a) == 0;
+    }
+    bool res = true;
+    do {
+        void *ka, *va, *kb, *vb;
+        skiparray_iter_get(ia, &ka, &va);
+        skiparray_iter_get(ib, &kb, &vb);
+        if (ka != kb || va != vb) {
+            res = false;
+            break;
+        }
+    } while (skiparray_iter_next(ia) == SKIPARRAY_ITER_STEP_OK
+        && skiparray_iter_next(ib) == SKIPARRAY_ITER_STEP_OK);
+    skiparray_iter_free(ia);
+    skiparray_iter_free(ib);
+    return res;
+}
+
+TEST reject_bad_config(void) {
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal_config wcfg = {
+        .write = test_skiparray_stream_write,
+        .sync_policy = SKIPARRAY_WAL_SYNC_GROUP,
+        .encode_key = test_skiparray_encode_uintptr,
+    };
+    struct skiparray_wal *wal = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_NEW_ERROR_NULL,
+        skiparray_wal_new(NULL, &wal), "%d");
+    /* sync policy without a sync callback */
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_NEW_ERROR_CONFIG,
+        skiparray_wal_new(&wcfg, &wal), "%d");
+
+    /* no value encoder, so it can only log sets of keys */
+    wcfg.sync_policy = SKIPARRAY_WAL_SYNC_NONE;
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_NEW_OK, skiparray_wal_new(&wcfg, &wal), "%d");
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .wal = wal,
+    };
+    struct skiparray *a = NULL;
+    struct skiparray *b = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG, skiparray_new(&cfg, &a), "%d");
+    cfg.ignore_values = true;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &a), "%d");
+
+    /* only one skiparray per WAL */
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_ERROR_CONFIG, skiparray_new(&cfg, &b), "%d");
+
+    struct skiparray_replay_config rcfg = {
+        .read = test_skiparray_stream_read,
+    };
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_ERROR_MISUSE,
+        skiparray_replay(a, &rcfg), "%d");
+
+    skiparray_free(a);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+/* Replaying a log onto an empty skiparray, or onto a snapshot taken
+ * partway through, gives the same contents as the logged skiparray. */
+TEST replay_matches(size_t limit, enum skiparray_wal_sync sync_policy) {
+    const int verbosity = greatest_get_verbosity();
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal *wal = make_wal(&l, sync_policy, 512);
+    ASSERT(wal != NULL);
+    struct skiparray *sa = make_sa(wal);
+    ASSERT(sa != NULL);
+
+    uint64_t state = limit;
+    ASSERT(churn(sa, &state, 4 * limit, limit));
+
+    /* checkpoint: flush, and snapshot the skiparray as of the log's
+     * current end */
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+    const size_t checkpoint = l.s.used;
+    struct test_skiparray_stream snapshot = { .used = 0 };
+    struct skiparray_dump_config dcfg = {
+        .write = test_skiparray_stream_write,
+        .encode_key = test_skiparray_encode_uintptr,
+        .encode_value = test_skiparray_encode_uintptr,
+        .udata = &snapshot,
+    };
+    ASSERT_EQ_FMT(SKIPARRAY_DUMP_OK, skiparray_dump(sa, &dcfg), "%d");
+
+    ASSERT(churn(sa, &state, 4 * limit, limit));
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+
+    struct skiparray_wal_stats ws;
+    skiparray_wal_stats(wal, &ws);
+    ASSERT_EQ_FMT((size_t)0, ws.pending, "%zu");
+    ASSERT_EQ_FMT(l.s.used, ws.bytes, "%zu");
+    switch (sync_policy) {
+    case SKIPARRAY_WAL_SYNC_NONE:
+        ASSERT_EQ_FMT((size_t)0, l.syncs, "%zu");
+        break;
+    case SKIPARRAY_WAL_SYNC_GROUP:
+        ASSERT_EQ_FMT(ws.frames, l.syncs, "%zu");
+        break;
+    case SKIPARRAY_WAL_SYNC_EVERY:
+        ASSERT_EQ_FMT(ws.records, ws.frames, "%zu");
+        ASSERT_EQ_FMT(ws.records, l.syncs, "%zu");
+        break;
+    }
+
+    /* the whole log, from empty */
+    struct skiparray *from_empty = make_sa(NULL);
+    ASSERT(from_empty != NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_OK,
+        replay(from_empty, &l, 0, l.s.used), "%d");
+    ASSERT(test_skiparray_invariants(from_empty, verbosity - 1));
+    ASSERT(same_contents(sa, from_empty));
+
+    /* the snapshot, then the log since it */
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+    };
+    struct skiparray_load_config lcfg = {
+        .read = test_skiparray_stream_read,
+        .decode_key = test_skiparray_decode_uintptr,
+        .decode_value = test_skiparray_decode_uintptr,
+        .udata = &snapshot,
+    };
+    test_skiparray_stream_rewind(&snapshot);
+    struct skiparray *recovered = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_LOAD_OK,
+        skiparray_load(&cfg, &lcfg, &recovered), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_OK,
+        replay(recovered, &l, checkpoint, l.s.used), "%d");
+    ASSERT(test_skiparray_invariants(recovered, verbosity - 1));
+    ASSERT(same_contents(sa, recovered));
+
+    skiparray_free(recovered);
+    skiparray_free(from_empty);
+    skiparray_free(sa);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&snapshot);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+/* A log whose last frame was cut short replays everything before it. */
+TEST replay_torn_tail(void) {
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal *wal = make_wal(&l, SKIPARRAY_WAL_SYNC_NONE, 256);
+    ASSERT(wal != NULL);
+    struct skiparray *sa = make_sa(wal);
+    ASSERT(sa != NULL);
+
+    for (uintptr_t i = 0; i < 100; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+    const size_t complete = l.s.used;
+    for (uintptr_t i = 100; i < 110; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+
+    for (size_t cut = complete + 1; cut < l.s.used; cut += 7) {
+        struct skiparray *torn = make_sa(NULL);
+        ASSERT(torn != NULL);
+        /* A cut-short header looks like the end of the log. */
+        const enum skiparray_replay_res exp = (cut - complete < 16
+            ? SKIPARRAY_REPLAY_OK : SKIPARRAY_REPLAY_TRUNCATED);
+        ASSERT_EQ_FMT(exp, replay(torn, &l, 0, cut), "%d");
+        ASSERT_EQ_FMT((size_t)100, skiparray_count(torn), "%zu");
+        skiparray_free(torn);
+    }
+
+    /* flip a byte in the last frame's payload */
+    l.s.buf[l.s.used - 3] ^= 0x01;
+    struct skiparray *damaged = make_sa(NULL);
+    ASSERT(damaged != NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_TRUNCATED,
+        replay(damaged, &l, 0, l.s.used), "%d");
+    ASSERT_EQ_FMT((size_t)100, skiparray_count(damaged), "%zu");
+    skiparray_free(damaged);
+
+    /* not a log at all */
+    struct skiparray *other = make_sa(NULL);
+    ASSERT(other != NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_ERROR_FORMAT,
+        replay(other, &l, 1, l.s.used), "%d");
+    skiparray_free(other);
+
+    skiparray_free(sa);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+/* If a record can't be written, the change isn't applied. */
+TEST write_failure_changes_nothing(void) {
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal *wal = make_wal(&l, SKIPARRAY_WAL_SYNC_EVERY, 0);
+    ASSERT(wal != NULL);
+    struct skiparray *sa = make_sa(wal);
+    ASSERT(sa != NULL);
+
+    for (uintptr_t i = 0; i < 100; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+
+    l.s.fail_writes = true;
+    ASSERT_EQ_FMT(SKIPARRAY_SET_ERROR_WAL,
+        skiparray_set(sa, (void *)1000, (void *)1), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_SET_ERROR_WAL,
+        skiparray_set(sa, (void *)5, (void *)1), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_FORGET_ERROR_WAL,
+        skiparray_forget(sa, (void *)5, NULL), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_POP_ERROR_WAL,
+        skiparray_pop_first(sa, NULL, NULL), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_POP_ERROR_WAL,
+        skiparray_pop_last(sa, NULL, NULL), "%d");
+    /* not found, so nothing to log */
+    ASSERT_EQ_FMT(SKIPARRAY_FORGET_NOT_FOUND,
+        skiparray_forget(sa, (void *)1000, NULL), "%d");
+
+    ASSERT_EQ_FMT((size_t)100, skiparray_count(sa), "%zu");
+    uintptr_t v = 0;
+    ASSERT(skiparray_get(sa, (void *)5, (void **)&v));
+    ASSERT_EQ_FMT((uintptr_t)5, v, "%"PRIuPTR);
+
+    struct skiparray_wal_stats ws;
+    skiparray_wal_stats(wal, &ws);
+    ASSERT_EQ_FMT((size_t)5, ws.write_errors, "%zu");
+    ASSERT_EQ_FMT((size_t)100, ws.records, "%zu");
+
+    /* With SYNC_EVERY, a failed sync fails the change too, though
+     * its record was written. The sync is retried by the next flush. */
+    l.s.fail_writes = false;
+    l.fail_syncs = true;
+    ASSERT_EQ_FMT(SKIPARRAY_SET_ERROR_WAL,
+        skiparray_set(sa, (void *)1000, (void *)1), "%d");
+    ASSERT_FALSE(skiparray_member(sa, (void *)1000));
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_ERROR_SYNC,
+        skiparray_wal_flush(wal), "%d");
+    l.fail_syncs = false;
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+    skiparray_wal_stats(wal, &ws);
+    ASSERT_EQ_FMT((size_t)2, ws.sync_errors, "%zu");
+    ASSERT_EQ_FMT((size_t)101, ws.syncs, "%zu");
+    ASSERT_EQ_FMT((size_t)101, ws.records, "%zu");
+
+    /* so the log has the change; apply it here as well */
+    ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+        skiparray_set(sa, (void *)1000, (void *)1), "%d");
+
+    struct skiparray *replayed = make_sa(NULL);
+    ASSERT(replayed != NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_OK, replay(replayed, &l, 0, l.s.used), "%d");
+    ASSERT(same_contents(sa, replayed));
+
+    skiparray_free(replayed);
+    skiparray_free(sa);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+/* A failed write on an insert into a node whose pairs have been
+ * shifted by pops leaves that node as it was. */
+TEST write_failure_after_pops(void) {
+    const int verbosity = greatest_get_verbosity();
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal *wal = make_wal(&l, SKIPARRAY_WAL_SYNC_EVERY, 0);
+    ASSERT(wal != NULL);
+    struct skiparray *sa = make_sa(wal);
+    ASSERT(sa != NULL);
+
+    for (uintptr_t i = 10; i < 30; i += 2) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    for (uintptr_t i = 11; i < 30; i += 2) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)i, (void *)i), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_POP_OK, skiparray_pop_first(sa, NULL, NULL), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_POP_OK, skiparray_pop_first(sa, NULL, NULL), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+        skiparray_forget(sa, (void *)21, NULL), "%d");
+    const size_t count = skiparray_count(sa);
+
+    l.s.fail_writes = true;
+    ASSERT_EQ_FMT(SKIPARRAY_SET_ERROR_WAL,
+        skiparray_set(sa, (void *)21, (void *)21), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_SET_ERROR_WAL,
+        skiparray_set(sa, (void *)5, (void *)5), "%d");
+    ASSERT_EQ_FMT(SKIPARRAY_SET_ERROR_WAL,
+        skiparray_set(sa, (void *)99, (void *)99), "%d");
+    l.s.fail_writes = false;
+
+    ASSERT_EQ_FMT(count, skiparray_count(sa), "%zu");
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+
+    struct skiparray_iter *iter = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_ITER_NEW_OK, skiparray_iter_new(sa, &iter), "%d");
+    uintptr_t expected = 12;
+    size_t seen = 0;
+    do {
+        void *k = NULL;
+        void *v = NULL;
+        skiparray_iter_get(iter, &k, &v);
+        ASSERT_EQ_FMT(expected, (uintptr_t)k, "%"PRIuPTR);
+        ASSERT_EQ_FMT(expected, (uintptr_t)v, "%"PRIuPTR);
+        seen++;
+        expected += (expected == 20 ? 2 : 1);
+    } while (skiparray_iter_next(iter) == SKIPARRAY_ITER_STEP_OK);
+    skiparray_iter_free(iter);
+    ASSERT_EQ_FMT(count, seen, "%zu");
+    ASSERT_EQ_FMT((uintptr_t)30, expected, "%"PRIuPTR);
+
+    /* and the log still replays to the same contents */
+    struct skiparray *replayed = make_sa(NULL);
+    ASSERT(replayed != NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_OK, replay(replayed, &l, 0, l.s.used), "%d");
+    ASSERT(same_contents(sa, replayed));
+
+    skiparray_free(replayed);
+    skiparray_free(sa);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+/* Memory callback that fails allocations (but not frees) while
+ * *udata is true. */
+static void *
+failing_memory(void *p, size_t nsize, void *udata) {
+    const bool *fail = udata;
+    if (nsize == 0) {
+        free(p);
+        return NULL;
+    }
+    return (*fail ? NULL : realloc(p, nsize));
+}
+
+/* An insert whose split or growth fails leaves nothing in the log. */
+TEST memory_failure_logs_nothing(void) {
+    const int verbosity = greatest_get_verbosity();
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal *wal = make_wal(&l, SKIPARRAY_WAL_SYNC_GROUP, 0);
+    ASSERT(wal != NULL);
+    bool fail = false;
+    struct skiparray_config cfg = {
+        .cmp = test_skiparray_cmp_intptr_t,
+        .node_size = 16,
+        .memory = failing_memory,
+        .udata = &fail,
+        .wal = wal,
+    };
+    struct skiparray *sa = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &sa), "%d");
+
+    /* The first node grows before it splits, so both fail here. */
+    size_t failures = 0;
+    for (uintptr_t i = 0; i < 100; i++) {
+        fail = (i % 3 == 0);
+        const enum skiparray_set_res res = skiparray_set(sa,
+            (void *)i, (void *)i);
+        if (res == SKIPARRAY_SET_ERROR_MEMORY) {
+            failures++;
+        } else {
+            ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND, res, "%d");
+        }
+    }
+    fail = false;
+    ASSERT(failures > 0);
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+
+    struct skiparray_wal_stats ws;
+    skiparray_wal_stats(wal, &ws);
+    ASSERT_EQ_FMT(skiparray_count(sa), ws.records, "%zu");
+
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+    struct skiparray *replayed = make_sa(NULL);
+    ASSERT(replayed != NULL);
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_OK, replay(replayed, &l, 0, l.s.used), "%d");
+    ASSERT(same_contents(sa, replayed));
+
+    skiparray_free(replayed);
+    skiparray_free(sa);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+/* With heap-allocated keys and values, replaying frees superseded
+ * records and replaced pairs (checked under a leak checker). */
+static int
+cmp_boxed(const void *ka, const void *kb, void *udata) {
+    (void)udata;
+    const uintptr_t a = *(const uintptr_t *)ka;
+    const uintptr_t b = *(const uintptr_t *)kb;
+    return (a < b ? -1 : a > b ? 1 : 0);
+}
+
+static bool
+decode_boxed(const uint8_t *buf, size_t len, void **x, void *udata) {
+    void *v = NULL;
+    if (!test_skiparray_decode_uintptr(buf, len, &v, udata)) { return false; }
+    uintptr_t *box = malloc(sizeof(*box));
+    if (box == NULL) { return false; }
+    *box = (uintptr_t)v;
+    *x = box;
+    return true;
+}
+
+static void
+free_boxed(void *key, void *value, void *udata) {
+    (void)udata;
+    free(key);
+    free(value);
+}
+
+TEST replay_owned_pairs(uintptr_t limit) {
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal *wal = make_wal(&l, SKIPARRAY_WAL_SYNC_NONE, 0);
+    ASSERT(wal != NULL);
+    struct skiparray *sa = make_sa(wal);
+    ASSERT(sa != NULL);
+
+    /* set every key three times, and forget every third */
+    for (uintptr_t round = 0; round < 3; round++) {
+        for (uintptr_t i = 0; i < limit; i++) {
+            ASSERT(skiparray_set(sa, (void *)i, (void *)(i + round)) >= 0);
+        }
+    }
+    for (uintptr_t i = 0; i < limit; i += 3) {
+        ASSERT_EQ_FMT(SKIPARRAY_FORGET_OK,
+            skiparray_forget(sa, (void *)i, NULL), "%d");
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+
+    struct skiparray_config cfg = {
+        .cmp = cmp_boxed,
+        .free = free_boxed,
+        .node_size = 16,
+    };
+    struct skiparray *boxed = NULL;
+    ASSERT_EQ_FMT(SKIPARRAY_NEW_OK, skiparray_new(&cfg, &boxed), "%d");
+    struct skiparray_replay_config rcfg = {
+        .read = test_skiparray_stream_read,
+        .decode_key = decode_boxed,
+        .decode_value = decode_boxed,
+        .udata = &l,
+    };
+
+    /* replay it twice: the second time replaces every pair */
+    for (size_t pass = 0; pass < 2; pass++) {
+        test_skiparray_stream_rewind(&l.s);
+        ASSERT_EQ_FMT(SKIPARRAY_REPLAY_OK, skiparray_replay(boxed, &rcfg), "%d");
+    }
+
+    ASSERT_EQ_FMT(skiparray_count(sa), skiparray_count(boxed), "%zu");
+    for (uintptr_t i = 0; i < limit; i++) {
+        void *v = NULL;
+        ASSERT_EQ(i % 3 != 0, skiparray_get(boxed, &i, &v));
+        if (v != NULL) { ASSERT_EQ_FMT(i + 2, *(uintptr_t *)v, "%"PRIuPTR); }
+    }
+
+    skiparray_free(boxed);
+    skiparray_free(sa);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+/* A short log onto a large skiparray applies the sorted changes one
+ * by one, rather than rebuilding it. */
+TEST replay_short_log(void) {
+    const int verbosity = greatest_get_verbosity();
+    const uintptr_t limit = 300000;
+    struct log l = { .syncs = 0 };
+    struct skiparray_wal *wal = make_wal(&l, SKIPARRAY_WAL_SYNC_NONE, 0);
+    ASSERT(wal != NULL);
+    struct skiparray *sa = make_sa(NULL);
+    struct skiparray *logged = make_sa(wal);
+    ASSERT(sa != NULL);
+    ASSERT(logged != NULL);
+    for (uintptr_t i = 0; i < limit; i++) {
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(sa, (void *)(2 * i), (void *)i), "%d");
+        ASSERT_EQ_FMT(SKIPARRAY_SET_BOUND,
+            skiparray_set(logged, (void *)(2 * i), (void *)i), "%d");
+    }
+    l.s.used = 0;                 /* as if checkpointed here */
+
+    for (uintptr_t i = 0; i < 3000; i++) {
+        const uintptr_t key = (i * 7919) % (2 * limit);
+        if (i % 3 == 0) {
+            ASSERT(skiparray_forget(logged, (void *)key, NULL) >= 0);
+        } else {
+            ASSERT(skiparray_set(logged, (void *)key, (void *)i) >= 0);
+        }
+    }
+    ASSERT_EQ_FMT(SKIPARRAY_WAL_FLUSH_OK, skiparray_wal_flush(wal), "%d");
+
+    ASSERT_EQ_FMT(SKIPARRAY_REPLAY_OK, replay(sa, &l, 0, l.s.used), "%d");
+    ASSERT(test_skiparray_invariants(sa, verbosity - 1));
+    ASSERT(same_contents(sa, logged));
+
+    skiparray_free(sa);
+    skiparray_free(logged);
+    skiparray_wal_free(wal);
+    test_skiparray_stream_free(&l.s);
+    PASS();
+}
+
+SUITE(wal) {
+    RUN_TEST(reject_bad_config);
+    RUN_TEST(replay_torn_tail);
+    RUN_TEST(write_failure_changes_nothing);
+    RUN_TEST(write_failure_after_pops);
+    RUN_TEST(memory_failure_logs_nothing);
+    RUN_TEST(replay_short_log);
+    greatest_set_test_suffix("1000");
+    RUN_TESTp(replay_owned_pairs, 1000);
+    greatest_set_test_suffix("300000");
+    RUN_TESTp(replay_owned_pairs, 300000);
+
+    for (size_t i = 10; i <= 100000; i *= 10) {
+        for (int p = SKIPARRAY_WAL_SYNC_NONE; p <= SKIPARRAY_WAL_SYNC_EVERY; p++) {
+            char buf[16];
+            if (sizeof(buf) < (size_t)snprintf(buf, sizeof(buf), "%zu_%d", i, p)) {
+                assert(false);
+            }
+            greatest_set_test_suffix(buf);
+            RUN_TESTp(replay_matches, i, (enum skiparray_wal_sync)p);
+        }
+    }
+}